@@ -153,6 +153,12 @@ class ContentSandboxHelper : public gpu::GpuSandboxHelper {
  private:
   // SandboxHelper:
   void PreSandboxStartup() override {
+#if BUILDFLAG(USE_OMX_CODEC)
+    // Starts probing the OMX components in the background; it overlaps with
+    // GL initialization until EnsureSandboxInitialized().
+    media::OmxrVideoDecodeAccelerator::PreSandboxInitialization();
+#endif
+
     // Warm up resources that don't need access to GPUInfo.
     {
       TRACE_EVENT0("gpu", "Warm up rand");
@@ -168,9 +174,6 @@ class ContentSandboxHelper : public gpu::GpuSandboxHelper {
     media::DXVAVideoDecodeAccelerator::PreSandboxInitialization();
     media::MediaFoundationVideoEncodeAccelerator::PreSandboxInitialization();
 #endif
-#if BUILDFLAG(USE_OMX_CODEC)
-    media::OmxrVideoDecodeAccelerator::PreSandboxInitialization();
-#endif
 
     // On Linux, reading system memory doesn't work through the GPU sandbox.
     // This value is cached, so access it here to populate the cache.
@@ -180,6 +183,10 @@ class ContentSandboxHelper : public gpu::GpuSandboxHelper {
   bool EnsureSandboxInitialized(gpu::GpuWatchdogThread* watchdog_thread,
                                 const gpu::GPUInfo* gpu_info,
                                 const gpu::GpuPreferences& gpu_prefs) override {
+#if BUILDFLAG(USE_OMX_CODEC)
+    // The sandbox must not be engaged with the probe thread still around.
+    media::OmxrVideoDecodeAccelerator::WaitForPreSandboxInitialization();
+#endif
 #if defined(OS_LINUX)
     return StartSandboxLinux(watchdog_thread, gpu_info, gpu_prefs);
 #elif defined(OS_WIN)
@@ -31,6 +31,9 @@
 #include "ui/gl/gl_surface_egl.h"
 #endif
 #if BUILDFLAG(USE_OMX_CODEC)
+#include "media/gpu/omx/omxr_features.h"
+#include "media/gpu/omx/omxr_hybrid_video_decode_accelerator.h"
+#include "media/gpu/omx/omxr_parallel_gop_decoder.h"
 #include "media/gpu/omx/omxr_video_decode_accelerator.h"
 #include "ui/gl/gl_surface_egl.h"
 #endif
@@ -185,6 +188,8 @@ GpuVideoDecodeAcceleratorFactory::CreateVDA(
     &GpuVideoDecodeAcceleratorFactory::CreateVaapiVDA,
 #endif
 #if BUILDFLAG(USE_OMX_CODEC)
+    &GpuVideoDecodeAcceleratorFactory::CreateOMXRParallelGopVDA,
+    &GpuVideoDecodeAcceleratorFactory::CreateOMXRHybridVDA,
     &GpuVideoDecodeAcceleratorFactory::CreateOMXRVDA,
 #endif
 #if defined(OS_MACOSX)
@@ -280,6 +285,42 @@ GpuVideoDecodeAcceleratorFactory::CreateOMXRVDA(
   return decoder;
 }
 
+// Only takes H.264; other codecs fail to initialize and fall through to
+// CreateOMXRVDA().
+std::unique_ptr<VideoDecodeAccelerator>
+GpuVideoDecodeAcceleratorFactory::CreateOMXRParallelGopVDA(
+    const gpu::GpuDriverBugWorkarounds& workarounds,
+    const gpu::GpuPreferences& gpu_preferences,
+    MediaLog* media_log) const {
+  std::unique_ptr<VideoDecodeAccelerator> decoder;
+  if (!base::FeatureList::IsEnabled(kOmxrParallelGopDecoding))
+    return decoder;
+  decoder.reset(OmxrParallelGopDecoder::Create(
+                    gl::GLSurfaceEGL::GetHardwareDisplay(),
+                    make_context_current_cb_, kOmxrParallelGopLanes.Get(),
+                    kOmxrParallelGopReorderPictures.Get())
+                    .release());
+  return decoder;
+}
+
+// Like CreateOMXRParallelGopVDA(), only takes H.264.
+std::unique_ptr<VideoDecodeAccelerator>
+GpuVideoDecodeAcceleratorFactory::CreateOMXRHybridVDA(
+    const gpu::GpuDriverBugWorkarounds& workarounds,
+    const gpu::GpuPreferences& gpu_preferences,
+    MediaLog* media_log) const {
+  std::unique_ptr<VideoDecodeAccelerator> decoder;
+  const OmxrHybridVideoDecodeAccelerator::DecoderFactory& software_factory =
+      OmxrHybridVideoDecodeAccelerator::GetSoftwareFactory();
+  if (!base::FeatureList::IsEnabled(kOmxrHybridDecoding) || !software_factory)
+    return decoder;
+  decoder.reset(OmxrHybridVideoDecodeAccelerator::Create(
+                    gl::GLSurfaceEGL::GetHardwareDisplay(),
+                    make_context_current_cb_, software_factory)
+                    .release());
+  return decoder;
+}
+
 #endif
 
 
@@ -0,0 +1,415 @@
+// Copyright (c) 2019 Renesas Electronics Corporation
+// Use of this source code is governed by a BSD-style license that can be
+// found in the LICENSE file.
+
+#include "media/gpu/omx/omxr_bitstream_framer.h"
+
+#include "base/logging.h"
+#include "base/macros.h"
+
+namespace media {
+
+namespace {
+
+// Role of a NAL unit in access unit framing.
+enum NalKind {
+  NAL_FIRST_SLICE,  // First slice of a picture.
+  NAL_SLICE,        // Any further slice of a picture.
+  NAL_AU_START,     // Non-VCL unit that can only precede a picture.
+  NAL_VPS,
+  NAL_SPS,
+  NAL_PPS,
+  NAL_OTHER,
+};
+
+// Classify() sets |keyframe| and |reference| for slices only.
+struct H264Traits {
+  static NalKind Classify(const uint8_t* nal,
+                          size_t size,
+                          bool* keyframe,
+                          bool* reference) {
+    int type = nal[0] & 0x1f;
+    switch (type) {
+      case 1:  // Non-IDR slice.
+      case 5:  // IDR slice.
+        *keyframe = type == 5;
+        // nal_ref_idc.
+        *reference = (nal[0] & 0x60) != 0;
+        // first_mb_in_slice is ue(v); a leading 1 bit means 0.
+        return size > 1 && (nal[1] & 0x80) ? NAL_FIRST_SLICE : NAL_SLICE;
+      case 7:
+        return NAL_SPS;
+      case 8:
+        return NAL_PPS;
+      case 6:   // SEI.
+      case 9:   // Access unit delimiter.
+      case 10:  // End of sequence.
+      case 11:  // End of stream.
+        return NAL_AU_START;
+      default:
+        return NAL_OTHER;
+    }
+  }
+};
+
+struct HevcTraits {
+  static NalKind Classify(const uint8_t* nal,
+                          size_t size,
+                          bool* keyframe,
+                          bool* reference) {
+    int type = (nal[0] >> 1) & 0x3f;
+    if (type <= 31) {
+      // IRAP pictures are 16 to 23.
+      *keyframe = type >= 16 && type <= 23;
+      // Even types up to 14 are sub-layer non-reference pictures.
+      *reference = type > 14 || type % 2;
+      // first_slice_segment_in_pic_flag follows the two byte header.
+      return size > 2 && (nal[2] & 0x80) ? NAL_FIRST_SLICE : NAL_SLICE;
+    }
+    switch (type) {
+      case 32:
+        return NAL_VPS;
+      case 33:
+        return NAL_SPS;
+      case 34:
+        return NAL_PPS;
+      case 35:  // Access unit delimiter.
+      case 36:  // End of sequence.
+      case 37:  // End of bitstream.
+      case 39:  // Prefix SEI.
+        return NAL_AU_START;
+      default:
+        return NAL_OTHER;
+    }
+  }
+};
+
+struct Vp8Traits {
+  static bool ParseKeyframe(const uint8_t* data, size_t size, bool* keyframe) {
+    // The frame tag is three bytes; its lowest bit is 0 for keyframes.
+    if (size < 3)
+      return false;
+    *keyframe = !(data[0] & 0x01);
+    return true;
+  }
+};
+
+struct Vp9Traits {
+  static bool ParseKeyframe(const uint8_t* data, size_t size, bool* keyframe) {
+    // frame_marker(2) profile_low_bit(1) profile_high_bit(1)
+    // [reserved_zero(1) if profile 3] show_existing_frame(1) frame_type(1)
+    if (size < 1 || (data[0] >> 6) != 2)
+      return false;
+    int profile = ((data[0] >> 5) & 1) | (((data[0] >> 4) & 1) << 1);
+    int show_existing_frame_shift = profile == 3 ? 2 : 3;
+    bool show_existing_frame = (data[0] >> show_existing_frame_shift) & 1;
+    bool frame_type = (data[0] >> (show_existing_frame_shift - 1)) & 1;
+    *keyframe = !show_existing_frame && !frame_type;
+    return true;
+  }
+};
+
+// Returns the offset of the next 00 00 01 start code prefix at or after
+// |pos|, or |size| if there is none.
+inline size_t FindStartCode(const uint8_t* data, size_t size, size_t pos) {
+  while (pos + 3 <= size) {
+    // No start code can begin at |pos|, |pos| + 1 or |pos| + 2 when the third
+    // byte is neither 0 nor 1.
+    if (data[pos + 2] > 1) {
+      pos += 3;
+      continue;
+    }
+    if (data[pos + 2] == 1 && data[pos + 1] == 0 && data[pos] == 0)
+      return pos;
+    ++pos;
+  }
+  return size;
+}
+
+// A NAL unit as found by a reader.  |start| is where the bytes belonging to
+// it begin, prefix included.
+struct NalUnit {
+  size_t start;
+  const uint8_t* data;
+  size_t size;
+};
+
+enum ReadResult {
+  READ_OK,
+  READ_END,
+  READ_ERROR,
+};
+
+// Reads NAL units separated by start codes (Annex-B).
+class StartCodeReader {
+ public:
+  size_t Begin(const uint8_t* data, size_t size) {
+    unit_start_ = 0;
+    return FindStartCode(data, size, 0);
+  }
+
+  ReadResult Next(const uint8_t* data,
+                  size_t size,
+                  size_t* pos,
+                  NalUnit* unit) {
+    if (*pos >= size)
+      return READ_END;
+    size_t nal_offset = *pos + 3;
+    size_t next = FindStartCode(data, size, nal_offset);
+    // Zero bytes before the next start code are trailing_zero_8bits or the
+    // first byte of a four byte start code; they go with the next unit.
+    size_t nal_end = next;
+    while (nal_end > nal_offset && !data[nal_end - 1])
+      --nal_end;
+    unit->start = unit_start_;
+    unit->data = data + nal_offset;
+    unit->size = nal_end - nal_offset;
+    unit_start_ = nal_end;
+    *pos = next;
+    return READ_OK;
+  }
+
+ private:
+  size_t unit_start_ = 0;
+};
+
+// Reads NAL units behind big-endian length fields of one, two or four bytes
+// (ISO/IEC 14496-15, as stored in MP4), without looking at their payload.
+class LengthPrefixReader {
+ public:
+  explicit LengthPrefixReader(int length_size) : length_size_(length_size) {}
+
+  size_t Begin(const uint8_t* data, size_t size) { return 0; }
+
+  ReadResult Next(const uint8_t* data,
+                  size_t size,
+                  size_t* pos,
+                  NalUnit* unit) {
+    if (*pos >= size)
+      return READ_END;
+    if (size - *pos < static_cast<size_t>(length_size_))
+      return READ_ERROR;
+    size_t length = 0;
+    for (int i = 0; i < length_size_; ++i)
+      length = (length << 8) | data[*pos + i];
+    size_t nal_offset = *pos + length_size_;
+    if (size - nal_offset < length)
+      return READ_ERROR;
+    unit->start = *pos;
+    unit->data = data + nal_offset;
+    unit->size = length;
+    *pos = nal_offset + length;
+    return READ_OK;
+  }
+
+ private:
+  const int length_size_;
+};
+
+// Framer for H.264 and HEVC: access units start at parameter sets, SEI,
+// delimiters or the first slice of a picture, once the access unit in
+// progress holds picture data.  |Reader| finds the NAL units.
+template <typename Traits, typename Reader>
+class OmxrNalFramer final : public OmxrBitstreamFramer {
+ public:
+  explicit OmxrNalFramer(const Reader& reader = Reader())
+      : reader_(reader), au_has_picture_data_(false) {}
+  ~OmxrNalFramer() override {}
+
+  void Reset() override { au_has_picture_data_ = false; }
+
+  bool Split(const uint8_t* data,
+             size_t size,
+             std::vector<Span>* spans,
+             std::vector<ParameterSet>* parameter_sets) override {
+    spans->clear();
+    if (!size)
+      return true;
+
+    Span span = {0, 0, false, false, false, false};
+    // Whether |span| holds slices, and any that must be kept.
+    bool span_has_slices = false;
+    bool span_needed = false;
+    size_t pos = reader_.Begin(data, size);
+    NalUnit unit;
+    ReadResult result;
+    while ((result = reader_.Next(data, size, &pos, &unit)) == READ_OK) {
+      if (!unit.size)
+        continue;
+      if (unit.data[0] & 0x80) {
+        DVLOG(1) << "forbidden_zero_bit set";
+        return false;
+      }
+
+      bool keyframe = false;
+      bool reference = false;
+      NalKind kind =
+          Traits::Classify(unit.data, unit.size, &keyframe, &reference);
+      if (kind != NAL_SLICE && kind != NAL_OTHER && au_has_picture_data_) {
+        if (unit.start > span.offset) {
+          span.size = unit.start - span.offset;
+          span.disposable = span_has_slices && !span_needed;
+          spans->push_back(span);
+          span = Span{unit.start, 0, false, false, false, false};
+          span_has_slices = span_needed = false;
+        }
+        span.starts_access_unit = true;
+        au_has_picture_data_ = false;
+      }
+
+      switch (kind) {
+        case NAL_FIRST_SLICE:
+        case NAL_SLICE:
+          au_has_picture_data_ = true;
+          span.keyframe |= keyframe;
+          span_has_slices = true;
+          span_needed |= reference;
+          break;
+        case NAL_VPS:
+        case NAL_SPS:
+        case NAL_PPS:
+          span_needed = true;
+          if (parameter_sets) {
+            ParameterSetType type =
+                kind == NAL_VPS ? VPS : kind == NAL_SPS ? SPS : PPS;
+            parameter_sets->push_back(
+                ParameterSet{type, unit.data, unit.size});
+          }
+          break;
+        case NAL_AU_START:
+        case NAL_OTHER:
+          break;
+      }
+    }
+    if (result == READ_ERROR) {
+      DVLOG(1) << "Truncated NAL unit";
+      return false;
+    }
+
+    span.size = size - span.offset;
+    span.disposable = span_has_slices && !span_needed;
+    spans->push_back(span);
+    return true;
+  }
+
+  bool ContainsKeyframe(const uint8_t* data, size_t size) const override {
+    Reader reader = reader_;
+    size_t pos = reader.Begin(data, size);
+    NalUnit unit;
+    while (reader.Next(data, size, &pos, &unit) == READ_OK) {
+      bool keyframe = false;
+      bool reference = false;
+      if (unit.size) {
+        Traits::Classify(unit.data, unit.size, &keyframe, &reference);
+        if (keyframe)
+          return true;
+      }
+    }
+    return false;
+  }
+
+ private:
+  Reader reader_;
+  // The access unit in progress holds at least one slice.
+  bool au_has_picture_data_;
+
+  DISALLOW_COPY_AND_ASSIGN(OmxrNalFramer);
+};
+
+// Framer for codecs carrying one frame (or VP9 superframe) per buffer.
+template <typename Traits>
+class OmxrFrameFramer final : public OmxrBitstreamFramer {
+ public:
+  OmxrFrameFramer() {}
+  ~OmxrFrameFramer() override {}
+
+  void Reset() override {}
+
+  bool Split(const uint8_t* data,
+             size_t size,
+             std::vector<Span>* spans,
+             std::vector<ParameterSet>* parameter_sets) override {
+    spans->clear();
+    if (!size)
+      return true;
+    bool keyframe = false;
+    if (!Traits::ParseKeyframe(data, size, &keyframe)) {
+      DVLOG(1) << "Invalid frame header";
+      return false;
+    }
+    spans->push_back(Span{0, size, true, true, keyframe, false});
+    return true;
+  }
+
+  bool ContainsKeyframe(const uint8_t* data, size_t size) const override {
+    bool keyframe = false;
+    return Traits::ParseKeyframe(data, size, &keyframe) && keyframe;
+  }
+
+ private:
+  DISALLOW_COPY_AND_ASSIGN(OmxrFrameFramer);
+};
+
+}  // namespace
+
+// static
+std::unique_ptr<OmxrBitstreamFramer> OmxrBitstreamFramer::Create(
+    VideoCodec codec) {
+  switch (codec) {
+    case kCodecH264:
+      return std::make_unique<OmxrNalFramer<H264Traits, StartCodeReader>>();
+    case kCodecHEVC:
+      return std::make_unique<OmxrNalFramer<HevcTraits, StartCodeReader>>();
+    case kCodecVP8:
+      return std::make_unique<OmxrFrameFramer<Vp8Traits>>();
+    case kCodecVP9:
+      return std::make_unique<OmxrFrameFramer<Vp9Traits>>();
+    default:
+      return nullptr;
+  }
+}
+
+// static
+std::unique_ptr<OmxrBitstreamFramer> OmxrBitstreamFramer::CreateAvcc(
+    int length_size) {
+  DCHECK(length_size == 1 || length_size == 2 || length_size == 4);
+  return std::make_unique<OmxrNalFramer<H264Traits, LengthPrefixReader>>(
+      LengthPrefixReader(length_size));
+}
+
+// static
+bool OmxrBitstreamFramer::ParseAvcConfigurationRecord(
+    const uint8_t* data,
+    size_t size,
+    int* length_size,
+    std::vector<ParameterSet>* parameter_sets) {
+  // configurationVersion, AVCProfileIndication, profile_compatibility,
+  // AVCLevelIndication, lengthSizeMinusOne, numOfSequenceParameterSets.
+  if (size < 6 || data[0] != 1)
+    return false;
+  *length_size = (data[4] & 0x3) + 1;
+  if (*length_size == 3)
+    return false;
+
+  parameter_sets->clear();
+  size_t pos = 5;
+  for (ParameterSetType type : {SPS, PPS}) {
+    if (pos >= size)
+      return false;
+    int count = type == SPS ? data[pos] & 0x1f : data[pos];
+    ++pos;
+    for (int i = 0; i < count; ++i) {
+      if (size - pos < 2)
+        return false;
+      size_t length = (data[pos] << 8) | data[pos + 1];
+      pos += 2;
+      if (size - pos < length)
+        return false;
+      parameter_sets->push_back(ParameterSet{type, data + pos, length});
+      pos += length;
+    }
+  }
+  return true;
+}
+
+}  // namespace media
@@ -0,0 +1,90 @@
+// Copyright (c) 2019 Renesas Electronics Corporation
+// Use of this source code is governed by a BSD-style license that can be
+// found in the LICENSE file.
+
+#ifndef MEDIA_GPU_OMX_OMXR_BITSTREAM_FRAMER_H_
+#define MEDIA_GPU_OMX_OMXR_BITSTREAM_FRAMER_H_
+
+#include <stddef.h>
+#include <stdint.h>
+
+#include <memory>
+#include <vector>
+
+#include "media/base/video_codecs.h"
+#include "media/gpu/media_gpu_export.h"
+
+namespace media {
+
+// Finds the access unit boundaries in the bitstream buffers handed to
+// Decode(), so that whole access units can be submitted to the component.
+// One implementation is instantiated per codec from a template, keeping the
+// per-byte scanning free of codec checks.
+class MEDIA_GPU_EXPORT OmxrBitstreamFramer {
+ public:
+  // A run of bytes of a bitstream buffer belonging to one access unit.  The
+  // spans of a buffer cover it completely, in order.
+  struct Span {
+    size_t offset;
+    size_t size;
+    // The access unit assembled so far is complete; this span starts the
+    // next one.
+    bool starts_access_unit;
+    // Nothing else belongs to the access unit ending with this span.
+    bool ends_access_unit;
+    // The span carries (part of) a keyframe.
+    bool keyframe;
+    // The span holds slices of a picture that no other picture references,
+    // and no parameter sets; it can be dropped without breaking decoding.
+    bool disposable;
+  };
+
+  enum ParameterSetType {
+    VPS,
+    SPS,
+    PPS,
+  };
+
+  // A parameter set NAL unit, without its start code, pointing into the
+  // buffer passed to Split().
+  struct ParameterSet {
+    ParameterSetType type;
+    const uint8_t* data;
+    size_t size;
+  };
+
+  // Returns null for codecs without a framer.
+  static std::unique_ptr<OmxrBitstreamFramer> Create(VideoCodec codec);
+  // Framer for H.264 NAL units behind |length_size| byte length fields (AVCC,
+  // as stored in MP4) instead of start codes.
+  static std::unique_ptr<OmxrBitstreamFramer> CreateAvcc(int length_size);
+
+  // Parses an AVCDecoderConfigurationRecord (avcC box payload) into the NAL
+  // length field size of the samples and the parameter sets, which point into
+  // |data|.
+  static bool ParseAvcConfigurationRecord(
+      const uint8_t* data,
+      size_t size,
+      int* length_size,
+      std::vector<ParameterSet>* parameter_sets);
+
+  virtual ~OmxrBitstreamFramer() {}
+
+  // Forgets the access unit in progress.
+  virtual void Reset() = 0;
+
+  // Splits |data| into |spans|, adding the parameter sets found to
+  // |parameter_sets| if not null.  Returns false if the data is malformed.
+  virtual bool Split(const uint8_t* data,
+                     size_t size,
+                     std::vector<Span>* spans,
+                     std::vector<ParameterSet>* parameter_sets) = 0;
+
+  // Returns whether |data| holds (part of) a keyframe, leaving the access
+  // unit in progress alone.  For looking ahead at buffers not split yet.
+  virtual bool ContainsKeyframe(const uint8_t* data, size_t size) const = 0;
+};
+
+}  // namespace media
+
+#endif  // MEDIA_GPU_OMX_OMXR_BITSTREAM_FRAMER_H_
@@ -0,0 +1,116 @@
+// Copyright (c) 2019 Renesas Electronics Corporation
+// Use of this source code is governed by a BSD-style license that can be
+// found in the LICENSE file.
+
+#include <string>
+#include <vector>
+
+#include "base/time/time.h"
+#include "media/gpu/omx/omxr_bitstream_framer.h"
+#include "media/gpu/omx/omxr_h264_stream_generator.h"
+#include "testing/gtest/include/gtest/gtest.h"
+#include "testing/perf/perf_test.h"
+
+namespace media {
+namespace {
+
+const size_t kBufferSize = 64 * 1024;
+const int kIterations = 2000;
+
+// Fills a buffer with slices of |slice_size| bytes of pseudo-random payload,
+// each behind a start code and a slice header starting a new picture.
+std::vector<uint8_t> MakeNalStream(uint8_t nal_header0,
+                                   uint8_t nal_header1,
+                                   size_t header_size,
+                                   size_t slice_size) {
+  std::vector<uint8_t> data;
+  uint32_t seed = 1;
+  while (data.size() + slice_size <= kBufferSize) {
+    const uint8_t kStartCode[] = {0, 0, 0, 1};
+    data.insert(data.end(), kStartCode, kStartCode + sizeof(kStartCode));
+    data.push_back(nal_header0);
+    if (header_size > 1)
+      data.push_back(nal_header1);
+    data.push_back(0x80);
+    for (size_t i = header_size + 1; i < slice_size; ++i) {
+      seed = seed * 1103515245 + 12345;
+      // No zero bytes, so the payload never contains a start code.
+      uint8_t byte = seed >> 16;
+      data.push_back(byte ? byte : 0xff);
+    }
+  }
+  return data;
+}
+
+// Generates |kBufferSize| bytes or more of synthetic H.264.
+std::vector<uint8_t> MakeSyntheticStream(
+    const OmxrH264StreamGenerator::Config& config) {
+  OmxrH264StreamGenerator generator(config);
+  std::vector<uint8_t> data;
+  while (data.size() < kBufferSize)
+    generator.AppendAccessUnit(&data);
+  return data;
+}
+
+void RunFramer(VideoCodec codec,
+               const std::string& name,
+               const std::vector<uint8_t>& data) {
+  auto framer = OmxrBitstreamFramer::Create(codec);
+  ASSERT_TRUE(framer);
+  std::vector<OmxrBitstreamFramer::Span> spans;
+
+  base::TimeTicks start = base::TimeTicks::Now();
+  for (int i = 0; i < kIterations; ++i)
+    ASSERT_TRUE(framer->Split(data.data(), data.size(), &spans, nullptr));
+  base::TimeDelta elapsed = base::TimeTicks::Now() - start;
+
+  double megabytes = static_cast<double>(data.size()) * kIterations / 1e6;
+  perf_test::PrintResult("omxr_bitstream_framer", "", name,
+                         megabytes / elapsed.InSecondsF(), "MB/s", true);
+}
+
+TEST(OmxrBitstreamFramerPerfTest, H264) {
+  RunFramer(kCodecH264, "h264", MakeNalStream(0x41, 0, 1, 4096));
+}
+
+TEST(OmxrBitstreamFramerPerfTest, H264Synthetic) {
+  OmxrH264StreamGenerator::Config config;
+  config.sizes = {gfx::Size(320, 240)};
+
+  // Many small slices per picture.
+  config.slices_per_picture = 32;
+  config.min_intra_macroblocks = 32;
+  config.max_intra_macroblocks = 64;
+  RunFramer(kCodecH264, "h264_many_slices", MakeSyntheticStream(config));
+
+  // Tiny skipped P pictures, a new SPS every GOP, no delimiters.
+  config.slices_per_picture = 1;
+  config.min_intra_macroblocks = config.max_intra_macroblocks = 0;
+  config.gop_length = 8;
+  config.access_unit_delimiters = false;
+  RunFramer(kCodecH264, "h264_tiny_pictures", MakeSyntheticStream(config));
+
+  // Huge IDRs only.
+  config.sizes = {gfx::Size(1920, 1080)};
+  config.gop_length = 1;
+  RunFramer(kCodecH264, "h264_huge_idrs", MakeSyntheticStream(config));
+}
+
+TEST(OmxrBitstreamFramerPerfTest, Hevc) {
+  RunFramer(kCodecHEVC, "hevc", MakeNalStream(0x02, 0x01, 2, 4096));
+}
+
+TEST(OmxrBitstreamFramerPerfTest, Vp8) {
+  std::vector<uint8_t> data(kBufferSize, 0x5a);
+  data[0] = 0x50;
+  RunFramer(kCodecVP8, "vp8", data);
+}
+
+TEST(OmxrBitstreamFramerPerfTest, Vp9) {
+  std::vector<uint8_t> data(kBufferSize, 0x5a);
+  data[0] = 0x82;
+  RunFramer(kCodecVP9, "vp9", data);
+}
+
+}  // namespace
+}  // namespace media
@@ -0,0 +1,285 @@
+// Copyright (c) 2019 Renesas Electronics Corporation
+// Use of this source code is governed by a BSD-style license that can be
+// found in the LICENSE file.
+
+#include "media/gpu/omx/omxr_bitstream_framer.h"
+
+#include <vector>
+
+#include "testing/gtest/include/gtest/gtest.h"
+
+namespace media {
+namespace {
+
+using Span = OmxrBitstreamFramer::Span;
+using ParameterSet = OmxrBitstreamFramer::ParameterSet;
+
+// H.264 NAL units with four byte start codes.
+const uint8_t kH264Sps[] = {0, 0, 0, 1, 0x67, 0x42, 0x00, 0x1e};
+const uint8_t kH264Pps[] = {0, 0, 0, 1, 0x68, 0xce, 0x38, 0x80};
+const uint8_t kH264IdrFirstSlice[] = {0, 0, 0, 1, 0x65, 0x88, 0x84, 0x21};
+const uint8_t kH264IdrSecondSlice[] = {0, 0, 0, 1, 0x65, 0x40, 0x84, 0x21};
+const uint8_t kH264FirstSlice[] = {0, 0, 0, 1, 0x41, 0x9a, 0x21, 0x4c};
+const uint8_t kH264Sei[] = {0, 0, 0, 1, 0x06, 0x05, 0x01, 0x80};
+// nal_ref_idc 0: no other picture refers to it.
+const uint8_t kH264NonReferenceSlice[] = {0, 0, 0, 1, 0x01, 0x9a, 0x21, 0x4c};
+
+std::vector<uint8_t> Concat(
+    std::initializer_list<std::pair<const uint8_t*, size_t>> parts) {
+  std::vector<uint8_t> data;
+  for (const auto& part : parts)
+    data.insert(data.end(), part.first, part.first + part.second);
+  return data;
+}
+
+#define NALU(x) std::make_pair(x, sizeof(x))
+
+// Turns start code prefixed NAL units into AVCC with |length_size| byte
+// length fields.
+std::vector<uint8_t> ToAvcc(
+    std::initializer_list<std::pair<const uint8_t*, size_t>> parts,
+    int length_size) {
+  std::vector<uint8_t> data;
+  for (const auto& part : parts) {
+    size_t nal_size = part.second - 4;
+    for (int i = length_size - 1; i >= 0; --i)
+      data.push_back(nal_size >> (8 * i));
+    data.insert(data.end(), part.first + 4, part.first + part.second);
+  }
+  return data;
+}
+
+TEST(OmxrBitstreamFramerTest, H264WholeAccessUnitsPerBuffer) {
+  auto framer = OmxrBitstreamFramer::Create(kCodecH264);
+  std::vector<Span> spans;
+  std::vector<ParameterSet> parameter_sets;
+
+  std::vector<uint8_t> idr = Concat({NALU(kH264Sps), NALU(kH264Pps),
+                                     NALU(kH264IdrFirstSlice),
+                                     NALU(kH264IdrSecondSlice)});
+  ASSERT_TRUE(framer->Split(idr.data(), idr.size(), &spans, &parameter_sets));
+  ASSERT_EQ(1u, spans.size());
+  EXPECT_EQ(0u, spans[0].offset);
+  EXPECT_EQ(idr.size(), spans[0].size);
+  EXPECT_FALSE(spans[0].starts_access_unit);
+  EXPECT_TRUE(spans[0].keyframe);
+  ASSERT_EQ(2u, parameter_sets.size());
+  EXPECT_EQ(OmxrBitstreamFramer::SPS, parameter_sets[0].type);
+  EXPECT_EQ(idr.data() + 4, parameter_sets[0].data);
+  EXPECT_EQ(4u, parameter_sets[0].size);
+  EXPECT_EQ(OmxrBitstreamFramer::PPS, parameter_sets[1].type);
+
+  std::vector<uint8_t> p = Concat({NALU(kH264FirstSlice)});
+  ASSERT_TRUE(framer->Split(p.data(), p.size(), &spans, nullptr));
+  ASSERT_EQ(1u, spans.size());
+  EXPECT_TRUE(spans[0].starts_access_unit);
+  EXPECT_FALSE(spans[0].keyframe);
+  EXPECT_FALSE(spans[0].ends_access_unit);
+}
+
+TEST(OmxrBitstreamFramerTest, H264SlicesSplitAcrossBuffers) {
+  auto framer = OmxrBitstreamFramer::Create(kCodecH264);
+  std::vector<Span> spans;
+
+  std::vector<uint8_t> first = Concat({NALU(kH264IdrFirstSlice)});
+  ASSERT_TRUE(framer->Split(first.data(), first.size(), &spans, nullptr));
+  ASSERT_EQ(1u, spans.size());
+
+  // A further slice of the same picture does not start an access unit.
+  std::vector<uint8_t> second = Concat({NALU(kH264IdrSecondSlice)});
+  ASSERT_TRUE(framer->Split(second.data(), second.size(), &spans, nullptr));
+  ASSERT_EQ(1u, spans.size());
+  EXPECT_FALSE(spans[0].starts_access_unit);
+  EXPECT_TRUE(spans[0].keyframe);
+}
+
+TEST(OmxrBitstreamFramerTest, H264TwoAccessUnitsInOneBuffer) {
+  auto framer = OmxrBitstreamFramer::Create(kCodecH264);
+  std::vector<Span> spans;
+
+  std::vector<uint8_t> data = Concat({NALU(kH264IdrFirstSlice),
+                                      NALU(kH264Sei), NALU(kH264FirstSlice)});
+  ASSERT_TRUE(framer->Split(data.data(), data.size(), &spans, nullptr));
+  ASSERT_EQ(2u, spans.size());
+  EXPECT_EQ(0u, spans[0].offset);
+  EXPECT_EQ(sizeof(kH264IdrFirstSlice), spans[0].size);
+  EXPECT_TRUE(spans[0].keyframe);
+  // The SEI opens the second access unit, including its start code.
+  EXPECT_EQ(sizeof(kH264IdrFirstSlice), spans[1].offset);
+  EXPECT_EQ(data.size() - spans[1].offset, spans[1].size);
+  EXPECT_TRUE(spans[1].starts_access_unit);
+  EXPECT_FALSE(spans[1].keyframe);
+}
+
+TEST(OmxrBitstreamFramerTest, H264ResetForgetsAccessUnit) {
+  auto framer = OmxrBitstreamFramer::Create(kCodecH264);
+  std::vector<Span> spans;
+
+  std::vector<uint8_t> data = Concat({NALU(kH264FirstSlice)});
+  ASSERT_TRUE(framer->Split(data.data(), data.size(), &spans, nullptr));
+  framer->Reset();
+  ASSERT_TRUE(framer->Split(data.data(), data.size(), &spans, nullptr));
+  EXPECT_FALSE(spans[0].starts_access_unit);
+}
+
+TEST(OmxrBitstreamFramerTest, H264DisposableSpans) {
+  auto framer = OmxrBitstreamFramer::Create(kCodecH264);
+  std::vector<Span> spans;
+
+  std::vector<uint8_t> data =
+      Concat({NALU(kH264IdrFirstSlice), NALU(kH264Sei),
+              NALU(kH264NonReferenceSlice), NALU(kH264FirstSlice),
+              NALU(kH264Sps), NALU(kH264Pps), NALU(kH264NonReferenceSlice)});
+  ASSERT_TRUE(framer->Split(data.data(), data.size(), &spans, nullptr));
+  ASSERT_EQ(4u, spans.size());
+  EXPECT_FALSE(spans[0].disposable);
+  EXPECT_TRUE(spans[1].disposable);
+  EXPECT_FALSE(spans[2].disposable);
+  // Parameter sets must reach the decoder even with a non-reference slice.
+  EXPECT_FALSE(spans[3].disposable);
+
+  EXPECT_TRUE(framer->ContainsKeyframe(data.data(), data.size()));
+  EXPECT_FALSE(framer->ContainsKeyframe(data.data() + spans[1].offset,
+                                        data.size() - spans[1].offset));
+}
+
+TEST(OmxrBitstreamFramerTest, H264RejectsForbiddenBit) {
+  auto framer = OmxrBitstreamFramer::Create(kCodecH264);
+  std::vector<Span> spans;
+  const uint8_t kInvalid[] = {0, 0, 1, 0xe5, 0x88};
+  EXPECT_FALSE(framer->Split(kInvalid, sizeof(kInvalid), &spans, nullptr));
+}
+
+TEST(OmxrBitstreamFramerTest, AvccAccessUnits) {
+  for (int length_size : {1, 2, 4}) {
+    auto framer = OmxrBitstreamFramer::CreateAvcc(length_size);
+    std::vector<Span> spans;
+    std::vector<ParameterSet> parameter_sets;
+
+    std::vector<uint8_t> data =
+        ToAvcc({NALU(kH264Pps), NALU(kH264IdrFirstSlice),
+                NALU(kH264IdrSecondSlice), NALU(kH264Sei),
+                NALU(kH264FirstSlice)},
+               length_size);
+    ASSERT_TRUE(
+        framer->Split(data.data(), data.size(), &spans, &parameter_sets));
+    ASSERT_EQ(2u, spans.size());
+    EXPECT_EQ(0u, spans[0].offset);
+    EXPECT_TRUE(spans[0].keyframe);
+    // The SEI starts the second access unit, length field included.
+    EXPECT_EQ(3u * (length_size + 4), spans[1].offset);
+    EXPECT_EQ(data.size(), spans[1].offset + spans[1].size);
+    EXPECT_TRUE(spans[1].starts_access_unit);
+    EXPECT_FALSE(spans[1].keyframe);
+    ASSERT_EQ(1u, parameter_sets.size());
+    EXPECT_EQ(OmxrBitstreamFramer::PPS, parameter_sets[0].type);
+    EXPECT_EQ(data.data() + length_size, parameter_sets[0].data);
+    EXPECT_EQ(4u, parameter_sets[0].size);
+  }
+}
+
+TEST(OmxrBitstreamFramerTest, AvccRejectsTruncatedNalUnit) {
+  auto framer = OmxrBitstreamFramer::CreateAvcc(4);
+  std::vector<Span> spans;
+
+  std::vector<uint8_t> data = ToAvcc({NALU(kH264IdrFirstSlice)}, 4);
+  EXPECT_FALSE(framer->Split(data.data(), data.size() - 1, &spans, nullptr));
+  EXPECT_FALSE(framer->Split(data.data(), 3, &spans, nullptr));
+}
+
+TEST(OmxrBitstreamFramerTest, AvcConfigurationRecord) {
+  // Version 1, Baseline level 3.0, four byte lengths, one SPS, one PPS.
+  const uint8_t kRecord[] = {0x01, 0x42, 0x00, 0x1e, 0xff, 0xe1,
+                             0x00, 0x04, 0x67, 0x42, 0x00, 0x1e,
+                             0x01, 0x00, 0x04, 0x68, 0xce, 0x38, 0x80};
+  int length_size = 0;
+  std::vector<ParameterSet> parameter_sets;
+  ASSERT_TRUE(OmxrBitstreamFramer::ParseAvcConfigurationRecord(
+      kRecord, sizeof(kRecord), &length_size, &parameter_sets));
+  EXPECT_EQ(4, length_size);
+  ASSERT_EQ(2u, parameter_sets.size());
+  EXPECT_EQ(OmxrBitstreamFramer::SPS, parameter_sets[0].type);
+  EXPECT_EQ(kRecord + 8, parameter_sets[0].data);
+  EXPECT_EQ(4u, parameter_sets[0].size);
+  EXPECT_EQ(OmxrBitstreamFramer::PPS, parameter_sets[1].type);
+  EXPECT_EQ(kRecord + 15, parameter_sets[1].data);
+  EXPECT_EQ(4u, parameter_sets[1].size);
+
+  EXPECT_FALSE(OmxrBitstreamFramer::ParseAvcConfigurationRecord(
+      kRecord, sizeof(kRecord) - 1, &length_size, &parameter_sets));
+  const uint8_t kThreeByteLengths[] = {0x01, 0x42, 0x00, 0x1e, 0xfe, 0xe0,
+                                       0x00};
+  EXPECT_FALSE(OmxrBitstreamFramer::ParseAvcConfigurationRecord(
+      kThreeByteLengths, sizeof(kThreeByteLengths), &length_size,
+      &parameter_sets));
+}
+
+TEST(OmxrBitstreamFramerTest, HevcAccessUnits) {
+  auto framer = OmxrBitstreamFramer::Create(kCodecHEVC);
+  std::vector<Span> spans;
+  std::vector<ParameterSet> parameter_sets;
+
+  // VPS, SPS, PPS, IDR_W_RADL first slice; then a TRAIL_R first slice.
+  const uint8_t kIdr[] = {0, 0, 0, 1, 0x40, 0x01, 0x0c, 0, 0, 0, 1, 0x42,
+                          0x01, 0x01, 0,    0,    0,    1, 0x44, 0x01, 0xc1,
+                          0,    0,    0,    1,    0x26, 0x01, 0xaf, 0x13};
+  const uint8_t kTrail[] = {0, 0, 0, 1, 0x02, 0x01, 0xd0, 0x13};
+
+  ASSERT_TRUE(framer->Split(kIdr, sizeof(kIdr), &spans, &parameter_sets));
+  ASSERT_EQ(1u, spans.size());
+  EXPECT_TRUE(spans[0].keyframe);
+  ASSERT_EQ(3u, parameter_sets.size());
+  EXPECT_EQ(OmxrBitstreamFramer::VPS, parameter_sets[0].type);
+  EXPECT_EQ(OmxrBitstreamFramer::SPS, parameter_sets[1].type);
+  EXPECT_EQ(OmxrBitstreamFramer::PPS, parameter_sets[2].type);
+
+  ASSERT_TRUE(framer->Split(kTrail, sizeof(kTrail), &spans, nullptr));
+  ASSERT_EQ(1u, spans.size());
+  EXPECT_TRUE(spans[0].starts_access_unit);
+  EXPECT_FALSE(spans[0].keyframe);
+}
+
+TEST(OmxrBitstreamFramerTest, Vp8FramePerBuffer) {
+  auto framer = OmxrBitstreamFramer::Create(kCodecVP8);
+  std::vector<Span> spans;
+
+  const uint8_t kKeyframe[] = {0x50, 0x42, 0x00, 0x9d, 0x01, 0x2a};
+  ASSERT_TRUE(framer->Split(kKeyframe, sizeof(kKeyframe), &spans, nullptr));
+  ASSERT_EQ(1u, spans.size());
+  EXPECT_TRUE(spans[0].starts_access_unit);
+  EXPECT_TRUE(spans[0].ends_access_unit);
+  EXPECT_TRUE(spans[0].keyframe);
+
+  const uint8_t kInterframe[] = {0x31, 0x05, 0x00};
+  ASSERT_TRUE(
+      framer->Split(kInterframe, sizeof(kInterframe), &spans, nullptr));
+  EXPECT_FALSE(spans[0].keyframe);
+}
+
+TEST(OmxrBitstreamFramerTest, Vp9Keyframes) {
+  auto framer = OmxrBitstreamFramer::Create(kCodecVP9);
+  std::vector<Span> spans;
+
+  // Profile 0: frame_marker 10, profile 00, show_existing_frame, frame_type.
+  const uint8_t kKeyframe[] = {0x82, 0x49, 0x83};
+  const uint8_t kInterframe[] = {0x86, 0x00};
+  const uint8_t kShowExisting[] = {0x88};
+  const uint8_t kProfile3Keyframe[] = {0xb0};
+  const uint8_t kBadMarker[] = {0x02, 0x49};
+
+  ASSERT_TRUE(framer->Split(kKeyframe, sizeof(kKeyframe), &spans, nullptr));
+  EXPECT_TRUE(spans[0].keyframe);
+  ASSERT_TRUE(
+      framer->Split(kInterframe, sizeof(kInterframe), &spans, nullptr));
+  EXPECT_FALSE(spans[0].keyframe);
+  ASSERT_TRUE(
+      framer->Split(kShowExisting, sizeof(kShowExisting), &spans, nullptr));
+  EXPECT_FALSE(spans[0].keyframe);
+  ASSERT_TRUE(framer->Split(kProfile3Keyframe, sizeof(kProfile3Keyframe),
+                            &spans, nullptr));
+  EXPECT_TRUE(spans[0].keyframe);
+  EXPECT_FALSE(framer->Split(kBadMarker, sizeof(kBadMarker), &spans, nullptr));
+}
+
+}  // namespace
+}  // namespace media
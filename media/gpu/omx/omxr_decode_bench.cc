@@ -0,0 +1,784 @@
+// Copyright (c) 2019 Renesas Electronics Corporation
+// Use of this source code is governed by a BSD-style license that can be
+// found in the LICENSE file.
+
+// Headless decode benchmark for qualifying boards: decodes an H.264 file on
+// a number of concurrent OmxrVideoDecodeAccelerators as fast as they go and
+// prints the throughput, the Decode() to PictureReady() latency percentiles,
+// the peak carveout use and the decoders' CPU time per frame.
+//
+//   omxr_decode_bench --input=clip.mp4 [--instances=N] [--depth=K]
+//
+// The input is an MP4 file or an Annex-B elementary stream, memory mapped.
+// |depth| bitstream buffers are in flight per instance (default 4).  Pictures
+// are handed back as soon as they arrive; nothing is rendered, but the
+// decoder still needs an EGL display and textures for its output, so an
+// offscreen GL context is set up.
+//
+// With --convert=i420, rgba, downscale2 or downscale4 every picture is also
+// converted on the CPU by the omxr_nv12 kernels, straight from its carveout
+// mapping, and the time this takes is printed.
+//
+// With --step-back=N each instance then steps backward over the last N
+// pictures of the stream with StepToCachedPicture(), one at a time, as a
+// scrubbing UI does.  This turns on the OmxrGopCache feature; the latency
+// from each step to its picture and the memory the GOP cache and decoded
+// ring hold are printed.  Features and their parameters can also be set with
+// --enable-features and --disable-features.
+//
+//   omxr_decode_bench --soak-minutes=M [--depth=K] [--probe-limit-mb=256]
+//
+// Soak mode instead creates, decodes with, resets and destroys one decoder
+// after another on generated streams of random sizes, as a kiosk does over
+// days.  Every cycle checks that the decoder left no carveout or component
+// behind, and records how long Destroy() blocked, the largest carveout block
+// still allocatable and the decoding throughput.  The run fails on a leak or
+// when the last cycles are markedly worse than the first ones.
+
+#include <stddef.h>
+#include <stdint.h>
+#include <stdio.h>
+
+#include <algorithm>
+#include <cstring>
+#include <map>
+#include <memory>
+#include <string>
+#include <utility>
+#include <vector>
+
+#include "base/at_exit.h"
+#include "base/bind.h"
+#include "base/base_switches.h"
+#include "base/command_line.h"
+#include "base/feature_list.h"
+#include "base/files/file_path.h"
+#include "base/files/memory_mapped_file.h"
+#include "base/logging.h"
+#include "base/macros.h"
+#include "base/memory/shared_memory.h"
+#include "base/message_loop/message_loop.h"
+#include "base/rand_util.h"
+#include "base/run_loop.h"
+#include "base/strings/string_number_conversions.h"
+#include "base/strings/string_util.h"
+#include "base/threading/thread_task_runner_handle.h"
+#include "base/time/time.h"
+#include "media/gpu/omx/omxr_bitstream_framer.h"
+#include "media/gpu/omx/omxr_h264_stream_generator.h"
+#include "media/gpu/omx/omxr_mp4_sample_reader.h"
+#include "media/gpu/omx/omxr_nv12_kernels.h"
+#include "media/gpu/omx/omxr_resource_tracker.h"
+#include "media/gpu/omx/omxr_video_decode_accelerator.h"
+#include "media/video/picture.h"
+#include "ui/gl/gl_bindings.h"
+#include "ui/gl/gl_context.h"
+#include "ui/gl/gl_surface.h"
+#include "ui/gl/gl_surface_egl.h"
+#include "ui/gl/init/gl_factory.h"
+
+namespace media {
+namespace {
+
+const char kInputSwitch[] = "input";
+const char kInstancesSwitch[] = "instances";
+const char kDepthSwitch[] = "depth";
+const char kSoakMinutesSwitch[] = "soak-minutes";
+const char kProbeLimitSwitch[] = "probe-limit-mb";
+const char kConvertSwitch[] = "convert";
+const char kStepBackSwitch[] = "step-back";
+
+// What --convert does with each picture.
+enum class Conversion {
+  NONE,
+  I420,
+  RGBA,
+  DOWNSCALE_2,
+  DOWNSCALE_4,
+};
+
+bool ParseConversion(const std::string& name, Conversion* conversion) {
+  const struct {
+    const char* name;
+    Conversion conversion;
+  } kConversions[] = {
+      {"i420", Conversion::I420},
+      {"rgba", Conversion::RGBA},
+      {"downscale2", Conversion::DOWNSCALE_2},
+      {"downscale4", Conversion::DOWNSCALE_4},
+  };
+  for (const auto& entry : kConversions) {
+    if (name == entry.name) {
+      *conversion = entry.conversion;
+      return true;
+    }
+  }
+  return false;
+}
+
+const int kDefaultDepth = 4;
+const int kDefaultProbeLimitMb = 256;
+const size_t kProbeGranularity = 1024 * 1024;
+
+// Soak cycles decode two GOPs at one of these sizes, picked at random.
+const gfx::Size kSoakSizes[] = {
+    gfx::Size(176, 144),  gfx::Size(320, 240),  gfx::Size(640, 360),
+    gfx::Size(720, 480),  gfx::Size(1280, 720), gfx::Size(1920, 1080),
+};
+const int kSoakGopLength = 15;
+const int kSoakPictures = 2 * kSoakGopLength;
+// The first and last cycles compared for trends, as a fraction of all.
+const size_t kTrendWindowDivisor = 10;
+const size_t kMinTrendWindow = 5;
+
+// The access units of the input, pointing into |data|.
+struct Stream {
+  const uint8_t* data = nullptr;
+  std::vector<OmxrMp4SampleReader::Sample> access_units;
+  size_t max_access_unit_size = 0;
+  // Set for MP4 input.
+  std::vector<uint8_t> avc_configuration_record;
+};
+
+bool LoadStream(const base::MemoryMappedFile& file, Stream* stream) {
+  stream->data = file.data();
+  OmxrMp4SampleReader mp4;
+  if (mp4.Parse(file.data(), file.length())) {
+    stream->access_units = mp4.samples();
+    stream->avc_configuration_record = mp4.avc_configuration_record();
+  } else {
+    std::unique_ptr<OmxrBitstreamFramer> framer =
+        OmxrBitstreamFramer::Create(kCodecH264);
+    std::vector<OmxrBitstreamFramer::Span> spans;
+    if (!framer->Split(file.data(), file.length(), &spans, nullptr)) {
+      LOG(ERROR) << "Input is neither MP4 nor an H.264 Annex-B stream";
+      return false;
+    }
+    for (const auto& span : spans) {
+      if (span.starts_access_unit || stream->access_units.empty())
+        stream->access_units.push_back({span.offset, 0});
+      stream->access_units.back().size += span.size;
+    }
+  }
+  for (const auto& access_unit : stream->access_units) {
+    stream->max_access_unit_size =
+        std::max(stream->max_access_unit_size, access_unit.size);
+  }
+  return !stream->access_units.empty();
+}
+
+// One decoder instance, feeding the whole stream through |depth| shared
+// memory slots and handing pictures straight back.
+class BenchClient : public VideoDecodeAccelerator::Client {
+ public:
+  BenchClient(const Stream& stream, int depth, const base::Closure& done_cb)
+      : stream_(stream),
+        depth_(depth),
+        done_cb_(done_cb),
+        next_access_unit_(0),
+        next_bitstream_id_(0),
+        flushing_(false),
+        resetting_(false),
+        failed_(false),
+        conversion_(Conversion::NONE),
+        conversions_(0),
+        converted_bytes_(0),
+        steps_left_(0),
+        step_target_id_(-1) {}
+
+  ~BenchClient() override { DestroyDecoder(); }
+
+  bool Start(EGLDisplay egl_display,
+             const base::Callback<bool(void)>& make_context_current) {
+    decoder_.reset(
+        new OmxrVideoDecodeAccelerator(egl_display, make_context_current));
+    const std::vector<uint8_t>& record = stream_.avc_configuration_record;
+    if (!record.empty() &&
+        !decoder_->SetAvcConfigurationRecord(record.data(), record.size())) {
+      return false;
+    }
+    if (!decoder_->Initialize(
+            VideoDecodeAccelerator::Config(H264PROFILE_MAIN), this)) {
+      return false;
+    }
+    for (int i = 0; i < depth_; ++i) {
+      auto slot = std::make_unique<base::SharedMemory>();
+      if (!slot->CreateAndMapAnonymous(stream_.max_access_unit_size))
+        return false;
+      free_slots_.push_back(slot.get());
+      slots_.push_back(std::move(slot));
+    }
+    Feed();
+    return true;
+  }
+
+  // VideoDecodeAccelerator::Client implementation.
+  void NotifyInitializationComplete(bool success) override {}
+
+  void ProvidePictureBuffers(uint32_t requested_num_of_buffers,
+                             VideoPixelFormat format,
+                             uint32_t textures_per_buffer,
+                             const gfx::Size& dimensions,
+                             uint32_t texture_target) override {
+    std::vector<PictureBuffer> buffers;
+    for (uint32_t i = 0; i < requested_num_of_buffers; ++i) {
+      PictureBuffer::TextureIds ids(textures_per_buffer);
+      glGenTextures(ids.size(), ids.data());
+      textures_.insert(textures_.end(), ids.begin(), ids.end());
+      buffers.emplace_back(next_picture_buffer_id_++, dimensions, ids, ids,
+                           texture_target, format);
+    }
+    decoder_->AssignPictureBuffers(buffers);
+  }
+
+  void DismissPictureBuffer(int32_t picture_buffer_id) override {}
+
+  void PictureReady(const Picture& picture) override {
+    if (picture.bitstream_buffer_id() == step_target_id_) {
+      step_latencies_.push_back(base::TimeTicks::Now() - step_start_time_);
+      step_target_id_ = -1;
+      base::ThreadTaskRunnerHandle::Get()->PostTask(
+          FROM_HERE,
+          base::BindOnce(&BenchClient::StepBack, base::Unretained(this)));
+    }
+    auto submitted = submit_times_.find(picture.bitstream_buffer_id());
+    if (submitted != submit_times_.end()) {
+      latencies_.push_back(base::TimeTicks::Now() - submitted->second);
+      submit_times_.erase(submitted);
+    }
+    if (conversion_ != Conversion::NONE)
+      Convert(picture.picture_buffer_id());
+    decoder_->ReusePictureBuffer(picture.picture_buffer_id());
+  }
+
+  void NotifyEndOfBitstreamBuffer(int32_t bitstream_buffer_id) override {
+    auto slot = busy_slots_.find(bitstream_buffer_id);
+    if (slot == busy_slots_.end())
+      return;
+    free_slots_.push_back(slot->second);
+    busy_slots_.erase(slot);
+    Feed();
+  }
+
+  void NotifyFlushDone() override {
+    // Step back from the picture before the last one.
+    next_step_id_ = next_bitstream_id_ - 2;
+    StepBack();
+  }
+
+  void NotifyResetDone() override {
+    resetting_ = false;
+    done_cb_.Run();
+  }
+
+  void NotifyError(VideoDecodeAccelerator::Error error) override {
+    LOG(ERROR) << "Decoder error " << error;
+    failed_ = true;
+    done_cb_.Run();
+  }
+
+  // Queues the start of the stream again and resets the decoder with it in
+  // flight.  |done_cb| runs on NotifyResetDone().
+  void ResetWhileDecoding() {
+    next_access_unit_ = 0;
+    Feed();
+    resetting_ = true;
+    decoder_->Reset();
+  }
+
+  // Returns how long Destroy() blocked.
+  base::TimeDelta DestroyDecoder() {
+    base::TimeDelta blocked;
+    if (decoder_) {
+      base::TimeTicks start = base::TimeTicks::Now();
+      decoder_.release()->Destroy();
+      blocked = base::TimeTicks::Now() - start;
+    }
+    if (!textures_.empty())
+      glDeleteTextures(textures_.size(), textures_.data());
+    textures_.clear();
+    return blocked;
+  }
+
+  void set_done_cb(const base::Closure& done_cb) { done_cb_ = done_cb; }
+  void set_conversion(Conversion conversion) { conversion_ = conversion; }
+  void set_step_back(int steps) { steps_left_ = steps; }
+  bool failed() const { return failed_; }
+  const std::vector<base::TimeDelta>& latencies() const { return latencies_; }
+  const OmxrDecoderStats& stats() const { return stats_; }
+  int64_t conversions() const { return conversions_; }
+  int64_t converted_bytes() const { return converted_bytes_; }
+  base::TimeDelta conversion_time() const { return conversion_time_; }
+  const std::vector<base::TimeDelta>& step_latencies() const {
+    return step_latencies_;
+  }
+
+ private:
+  // Steps to the next picture back, or finishes once all steps are done.
+  void StepBack() {
+    if (steps_left_ > 0 && next_step_id_ >= 0) {
+      --steps_left_;
+      step_target_id_ = next_step_id_--;
+      step_start_time_ = base::TimeTicks::Now();
+      if (decoder_->StepToCachedPicture(step_target_id_))
+        return;
+      LOG(ERROR) << "Cannot step to " << step_target_id_;
+      failed_ = true;
+    }
+    stats_ = decoder_->GetStats();
+    done_cb_.Run();
+  }
+
+  void Convert(int32_t picture_buffer_id) {
+    omxr_nv12::Picture src;
+    if (!decoder_->MapPicture(picture_buffer_id, &src)) {
+      LOG(ERROR) << "Cannot map picture " << picture_buffer_id;
+      failed_ = true;
+      return;
+    }
+    int width = src.size.width();
+    int height = src.size.height();
+    scratch_.resize(width * height * 4);
+    uint8_t* dst = scratch_.data();
+
+    base::TimeTicks start = base::TimeTicks::Now();
+    switch (conversion_) {
+      case Conversion::I420:
+        omxr_nv12::ConvertToI420(src, dst, width, dst + width * height,
+                                 width / 2, dst + width * height * 5 / 4,
+                                 width / 2);
+        break;
+      case Conversion::RGBA:
+        omxr_nv12::ConvertToRGBA(src, omxr_nv12::Matrix::BT709,
+                                 omxr_nv12::Range::LIMITED, dst, width * 4);
+        break;
+      case Conversion::DOWNSCALE_2:
+      case Conversion::DOWNSCALE_4: {
+        int factor = conversion_ == Conversion::DOWNSCALE_2 ? 2 : 4;
+        int dst_width = width / factor;
+        omxr_nv12::Downscale(src, factor, dst, dst_width,
+                             dst + dst_width * (height / factor), dst_width);
+        break;
+      }
+      case Conversion::NONE:
+        break;
+    }
+    conversion_time_ += base::TimeTicks::Now() - start;
+    ++conversions_;
+    converted_bytes_ += width * height * 3 / 2;
+  }
+
+  void Feed() {
+    while (!resetting_ && !free_slots_.empty() &&
+           next_access_unit_ < stream_.access_units.size()) {
+      const auto& access_unit = stream_.access_units[next_access_unit_++];
+      base::SharedMemory* slot = free_slots_.back();
+      free_slots_.pop_back();
+      memcpy(slot->memory(), stream_.data + access_unit.offset,
+             access_unit.size);
+
+      int32_t bitstream_id = next_bitstream_id_;
+      next_bitstream_id_ = (next_bitstream_id_ + 1) & 0x3FFFFFFF;
+      busy_slots_[bitstream_id] = slot;
+      submit_times_[bitstream_id] = base::TimeTicks::Now();
+      decoder_->Decode(BitstreamBuffer(
+          bitstream_id, base::SharedMemory::DuplicateHandle(slot->handle()),
+          access_unit.size));
+    }
+    if (!flushing_ && next_access_unit_ == stream_.access_units.size()) {
+      flushing_ = true;
+      decoder_->Flush();
+    }
+  }
+
+  const Stream& stream_;
+  const int depth_;
+  base::Closure done_cb_;
+
+  std::unique_ptr<OmxrVideoDecodeAccelerator> decoder_;
+  std::vector<std::unique_ptr<base::SharedMemory>> slots_;
+  std::vector<base::SharedMemory*> free_slots_;
+  std::map<int32_t, base::SharedMemory*> busy_slots_;
+  std::map<int32_t, base::TimeTicks> submit_times_;
+  std::vector<GLuint> textures_;
+  int32_t next_picture_buffer_id_ = 0;
+  size_t next_access_unit_;
+  int32_t next_bitstream_id_;
+  bool flushing_;
+  bool resetting_;
+  bool failed_;
+
+  std::vector<base::TimeDelta> latencies_;
+  OmxrDecoderStats stats_;
+
+  Conversion conversion_;
+  std::vector<uint8_t> scratch_;
+  int64_t conversions_;
+  int64_t converted_bytes_;
+  base::TimeDelta conversion_time_;
+
+  int steps_left_;
+  int32_t next_step_id_ = -1;
+  int32_t step_target_id_;
+  base::TimeTicks step_start_time_;
+  std::vector<base::TimeDelta> step_latencies_;
+
+  DISALLOW_COPY_AND_ASSIGN(BenchClient);
+};
+
+double PercentileMs(const std::vector<base::TimeDelta>& sorted,
+                    double percentile) {
+  if (sorted.empty())
+    return 0;
+  size_t index = static_cast<size_t>(percentile / 100 * (sorted.size() - 1));
+  return sorted[index].InMillisecondsF();
+}
+
+double Median(std::vector<double> values) {
+  std::sort(values.begin(), values.end());
+  return values.empty() ? 0 : values[values.size() / 2];
+}
+
+bool MakeCurrent(gl::GLContext* context, gl::GLSurface* surface) {
+  return context->MakeCurrent(surface);
+}
+
+// The offscreen context the decoders output into.
+struct GLSetup {
+  scoped_refptr<gl::GLSurface> surface;
+  scoped_refptr<gl::GLContext> context;
+  base::Callback<bool(void)> make_context_current;
+};
+
+bool SetUpGL(GLSetup* gl) {
+  if (!gl::init::InitializeGLOneOff()) {
+    LOG(ERROR) << "Cannot initialize GL";
+    return false;
+  }
+  gl->surface = gl::init::CreateOffscreenGLSurface(gfx::Size());
+  if (gl->surface) {
+    gl->context = gl::init::CreateGLContext(nullptr, gl->surface.get(),
+                                            gl::GLContextAttribs());
+  }
+  if (!gl->context || !gl->context->MakeCurrent(gl->surface.get())) {
+    LOG(ERROR) << "Cannot create an offscreen GL context";
+    return false;
+  }
+  gl->make_context_current =
+      base::Bind(&MakeCurrent, base::RetainedRef(gl->context),
+                 base::RetainedRef(gl->surface));
+  return true;
+}
+
+int RunDecode(const base::FilePath& input,
+              int instances,
+              int depth,
+              Conversion conversion,
+              int step_back,
+              const GLSetup& gl) {
+  std::string extension = base::ToLowerASCII(input.Extension());
+  if (extension == ".h265" || extension == ".hevc" || extension == ".265") {
+    LOG(ERROR) << "The OMX decoder supports H.264 and VP8 only";
+    return 1;
+  }
+
+  base::MemoryMappedFile file;
+  if (!file.Initialize(input)) {
+    LOG(ERROR) << "Cannot map " << input.value();
+    return 1;
+  }
+  Stream stream;
+  if (!LoadStream(file, &stream))
+    return 1;
+
+  base::RunLoop run_loop;
+  int running = instances;
+  base::Closure done_cb = base::BindRepeating(
+      [](int* running, const base::Closure& quit) {
+        if (--*running == 0)
+          quit.Run();
+      },
+      &running, run_loop.QuitClosure());
+
+  std::vector<std::unique_ptr<BenchClient>> clients;
+  for (int i = 0; i < instances; ++i) {
+    clients.push_back(std::make_unique<BenchClient>(stream, depth, done_cb));
+    clients.back()->set_conversion(conversion);
+    clients.back()->set_step_back(step_back);
+    if (!clients.back()->Start(gl::GLSurfaceEGL::GetHardwareDisplay(),
+                               gl.make_context_current)) {
+      LOG(ERROR) << "Cannot start decoder instance " << i;
+      return 1;
+    }
+  }
+  base::TimeTicks start = base::TimeTicks::Now();
+  run_loop.Run();
+  base::TimeDelta elapsed = base::TimeTicks::Now() - start;
+
+  std::vector<base::TimeDelta> latencies;
+  std::vector<base::TimeDelta> step_latencies;
+  size_t peak_carveout = 0;
+  size_t gop_cache_bytes = 0;
+  size_t frame_store_bytes = 0;
+  int64_t conversions = 0;
+  int64_t converted_bytes = 0;
+  base::TimeDelta conversion_time;
+  base::TimeDelta cpu_time;
+  base::TimeDelta vendor_cpu_time;
+  for (const auto& client : clients) {
+    if (client->failed())
+      return 1;
+    latencies.insert(latencies.end(), client->latencies().begin(),
+                     client->latencies().end());
+    step_latencies.insert(step_latencies.end(),
+                          client->step_latencies().begin(),
+                          client->step_latencies().end());
+    peak_carveout += client->stats().peak_carveout_bytes;
+    gop_cache_bytes += client->stats().gop_cache_bytes;
+    frame_store_bytes += client->stats().frame_store_bytes;
+    conversions += client->conversions();
+    converted_bytes += client->converted_bytes();
+    conversion_time += client->conversion_time();
+    cpu_time += client->stats().TotalCpuTime();
+    vendor_cpu_time += client->stats().vendor_cpu_time;
+  }
+  std::sort(latencies.begin(), latencies.end());
+  std::sort(step_latencies.begin(), step_latencies.end());
+  clients.clear();
+
+  double seconds = elapsed.InSecondsF();
+  printf("%s: %zu access units, %d instance(s), depth %d\n",
+         input.value().c_str(), stream.access_units.size(), instances, depth);
+  printf("frames: %zu in %.3f s, %.1f fps (%.1f fps per instance)\n",
+         latencies.size(), seconds, latencies.size() / seconds,
+         latencies.size() / seconds / instances);
+  printf("latency ms: p50 %.2f, p90 %.2f, p99 %.2f, max %.2f\n",
+         PercentileMs(latencies, 50), PercentileMs(latencies, 90),
+         PercentileMs(latencies, 99), PercentileMs(latencies, 100));
+  printf("peak carveout: %zu bytes\n", peak_carveout);
+  if (!step_latencies.empty()) {
+    printf("step back: %zu steps, ms p50 %.2f, p90 %.2f, max %.2f\n",
+           step_latencies.size(), PercentileMs(step_latencies, 50),
+           PercentileMs(step_latencies, 90),
+           PercentileMs(step_latencies, 100));
+    printf("step memory: GOP cache %zu bytes, decoded ring %zu bytes\n",
+           gop_cache_bytes, frame_store_bytes);
+  }
+  if (!cpu_time.is_zero() && !latencies.empty()) {
+    printf("decoder CPU: %.3f ms per frame, %.0f%% in vendor libraries\n",
+           cpu_time.InMillisecondsF() / latencies.size(),
+           100 * vendor_cpu_time.InSecondsF() / cpu_time.InSecondsF());
+  }
+  if (conversions) {
+    printf("conversion (%s): %.2f ms per picture, %.0f MB/s read\n",
+           omxr_nv12::UsesNeon() ? "NEON" : "portable",
+           conversion_time.InMillisecondsF() / conversions,
+           converted_bytes / conversion_time.InSecondsF() / (1024 * 1024));
+  }
+  return 0;
+}
+
+// What one soak cycle measured.
+struct SoakSample {
+  double destroy_ms;
+  // Throughput in macroblocks per second, comparable across sizes.
+  double macroblocks_per_second;
+  double largest_block_mb;
+};
+
+// Runs one open/decode/reset/destroy cycle at a random size.
+bool RunSoakCycle(int depth,
+                  size_t probe_limit,
+                  const GLSetup& gl,
+                  SoakSample* sample) {
+  OmxrH264StreamGenerator::Config config;
+  config.sizes = {kSoakSizes[base::RandInt(0, arraysize(kSoakSizes) - 1)]};
+  config.gop_length = kSoakGopLength;
+  int macroblocks = ((config.sizes[0].width() + 15) / 16) *
+                    ((config.sizes[0].height() + 15) / 16);
+  config.max_intra_macroblocks = macroblocks / 4;
+  config.seed = base::RandUint64() & 0xffffffff;
+  OmxrH264StreamGenerator generator(config);
+
+  std::vector<uint8_t> data;
+  Stream stream;
+  for (int i = 0; i < kSoakPictures; ++i) {
+    size_t offset = data.size();
+    generator.AppendAccessUnit(&data);
+    stream.access_units.push_back({offset, data.size() - offset});
+    stream.max_access_unit_size =
+        std::max(stream.max_access_unit_size, data.size() - offset);
+  }
+  stream.data = data.data();
+
+  base::RunLoop decode_loop;
+  BenchClient client(stream, depth, decode_loop.QuitClosure());
+  base::TimeTicks start = base::TimeTicks::Now();
+  if (!client.Start(gl::GLSurfaceEGL::GetHardwareDisplay(),
+                    gl.make_context_current)) {
+    LOG(ERROR) << "Cannot start decoder at " << config.sizes[0].ToString();
+    return false;
+  }
+  decode_loop.Run();
+  base::TimeDelta elapsed = base::TimeTicks::Now() - start;
+  if (client.failed())
+    return false;
+
+  base::RunLoop reset_loop;
+  client.set_done_cb(reset_loop.QuitClosure());
+  client.ResetWhileDecoding();
+  reset_loop.Run();
+  if (client.failed())
+    return false;
+
+  sample->destroy_ms = client.DestroyDecoder().InMillisecondsF();
+  base::RunLoop().RunUntilIdle();
+
+  OmxrResourceTracker* tracker = OmxrResourceTracker::Get();
+  OmxrResourceTracker::Live live = tracker->GetLive();
+  if (live.carveout_buffers || live.components) {
+    LOG(ERROR) << "Decoder at " << config.sizes[0].ToString() << " leaked "
+               << live.carveout_buffers << " carveout buffers ("
+               << live.carveout_bytes << " bytes) and " << live.components
+               << " components";
+    return false;
+  }
+
+  sample->macroblocks_per_second =
+      client.latencies().size() * macroblocks / elapsed.InSecondsF();
+  sample->largest_block_mb =
+      static_cast<double>(
+          tracker->ProbeLargestCarveoutBlock(probe_limit, kProbeGranularity)) /
+      kProbeGranularity;
+  return true;
+}
+
+// Compares the medians of the first and last cycles.  Returns false if the
+// last ones are worse by more than |tolerance|, a fraction of the first.
+bool CheckTrend(const char* name,
+                const std::vector<SoakSample>& samples,
+                double SoakSample::*field,
+                bool lower_is_better,
+                double tolerance) {
+  size_t window =
+      std::max(kMinTrendWindow, samples.size() / kTrendWindowDivisor);
+  std::vector<double> first, last;
+  for (size_t i = 0; i < window; ++i) {
+    first.push_back(samples[i].*field);
+    last.push_back(samples[samples.size() - 1 - i].*field);
+  }
+  double before = Median(first);
+  double after = Median(last);
+  printf("%s: %.2f at first, %.2f at last\n", name, before, after);
+  bool worse = lower_is_better ? after > before * (1 + tolerance)
+                               : after < before * (1 - tolerance);
+  if (worse)
+    LOG(ERROR) << name << " degraded from " << before << " to " << after;
+  return !worse;
+}
+
+int RunSoak(base::TimeDelta duration,
+            int depth,
+            size_t probe_limit,
+            const GLSetup& gl) {
+  std::vector<SoakSample> samples;
+  base::TimeTicks end = base::TimeTicks::Now() + duration;
+  while (base::TimeTicks::Now() < end) {
+    SoakSample sample;
+    if (!RunSoakCycle(depth, probe_limit, gl, &sample)) {
+      LOG(ERROR) << "Soak failed in cycle " << samples.size();
+      return 1;
+    }
+    samples.push_back(sample);
+    if (samples.size() % 100 == 0) {
+      printf("cycle %zu: destroy %.1f ms, %.0f macroblocks/s, "
+             "largest block %.0f MB\n",
+             samples.size(), sample.destroy_ms, sample.macroblocks_per_second,
+             sample.largest_block_mb);
+      fflush(stdout);
+    }
+  }
+
+  printf("%zu cycles\n", samples.size());
+  if (samples.size() < 2 * kMinTrendWindow) {
+    LOG(ERROR) << "Too few cycles to tell trends";
+    return 1;
+  }
+  bool ok = CheckTrend("destroy ms", samples, &SoakSample::destroy_ms, true,
+                       0.5);
+  ok &= CheckTrend("macroblocks per second", samples,
+                   &SoakSample::macroblocks_per_second, false, 0.1);
+  ok &= CheckTrend("largest carveout block MB", samples,
+                   &SoakSample::largest_block_mb, false, 0.1);
+  return ok ? 0 : 1;
+}
+
+int RunBench() {
+  const base::CommandLine* command_line =
+      base::CommandLine::ForCurrentProcess();
+  base::FilePath input = command_line->GetSwitchValuePath(kInputSwitch);
+  int instances = 1;
+  int depth = kDefaultDepth;
+  int soak_minutes = 0;
+  int probe_limit_mb = kDefaultProbeLimitMb;
+  int step_back = 0;
+  Conversion conversion = Conversion::NONE;
+  auto get_int = [command_line](const char* name, int* value) {
+    return !command_line->HasSwitch(name) ||
+           base::StringToInt(command_line->GetSwitchValueASCII(name), value);
+  };
+  if (!get_int(kInstancesSwitch, &instances) ||
+      !get_int(kDepthSwitch, &depth) ||
+      !get_int(kSoakMinutesSwitch, &soak_minutes) ||
+      !get_int(kProbeLimitSwitch, &probe_limit_mb) ||
+      !get_int(kStepBackSwitch, &step_back) ||
+      (command_line->HasSwitch(kConvertSwitch) &&
+       !ParseConversion(command_line->GetSwitchValueASCII(kConvertSwitch),
+                        &conversion)) ||
+      (input.empty() && soak_minutes <= 0) || instances < 1 || depth < 1 ||
+      probe_limit_mb < 1 || step_back < 0) {
+    LOG(ERROR) << "Usage: omxr_decode_bench --input=<file> [--instances=N] "
+                  "[--depth=K]\n"
+                  "                         "
+                  "[--convert=i420|rgba|downscale2|downscale4]\n"
+                  "                         [--step-back=N]\n"
+                  "       omxr_decode_bench --soak-minutes=M [--depth=K] "
+                  "[--probe-limit-mb=MB]";
+    return 1;
+  }
+
+  std::string enabled_features =
+      command_line->GetSwitchValueASCII(switches::kEnableFeatures);
+  if (step_back > 0)
+    enabled_features += ",OmxrGopCache";
+  base::FeatureList::InitializeInstance(
+      enabled_features,
+      command_line->GetSwitchValueASCII(switches::kDisableFeatures));
+
+  OmxrVideoDecodeAccelerator::PreSandboxInitialization();
+  OmxrVideoDecodeAccelerator::WaitForPreSandboxInitialization();
+
+  GLSetup gl;
+  if (!SetUpGL(&gl))
+    return 1;
+
+  if (soak_minutes > 0) {
+    return RunSoak(base::TimeDelta::FromMinutes(soak_minutes), depth,
+                   probe_limit_mb * kProbeGranularity, gl);
+  }
+  return RunDecode(input, instances, depth, conversion, step_back, gl);
+}
+
+}  // namespace
+}  // namespace media
+
+int main(int argc, char** argv) {
+  base::AtExitManager at_exit;
+  base::CommandLine::Init(argc, argv);
+  logging::LoggingSettings settings;
+  settings.logging_dest = logging::LOG_TO_SYSTEM_DEBUG_LOG;
+  logging::InitLogging(settings);
+
+  base::MessageLoop message_loop;
+  return media::RunBench();
+}
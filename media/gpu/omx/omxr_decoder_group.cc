@@ -0,0 +1,267 @@
+// Copyright (c) 2019 Renesas Electronics Corporation
+// Use of this source code is governed by a BSD-style license that can be
+// found in the LICENSE file.
+
+#include "media/gpu/omx/omxr_decoder_group.h"
+
+#include <string.h>
+
+#include <algorithm>
+#include <limits>
+#include <utility>
+
+#include "base/bind.h"
+#include "base/logging.h"
+#include "base/memory/shared_memory.h"
+#include "media/gpu/omx/omxr_video_decode_accelerator.h"
+
+namespace media {
+
+namespace {
+
+// Ids of the parameter set buffers we make up, above those clients use.
+constexpr int32_t kFirstOwnBitstreamId = 0x40000000;
+
+const uint8_t kStartCode[] = {0, 0, 0, 1};
+
+std::unique_ptr<VideoDecodeAccelerator> CreateOmxrDecoder(
+    EGLDisplay egl_display,
+    const base::Callback<bool(void)>& make_context_current) {
+  return std::unique_ptr<VideoDecodeAccelerator>(
+      new OmxrVideoDecodeAccelerator(egl_display, make_context_current));
+}
+
+}  // namespace
+
+// Client of one decoder, telling the group which decoder is calling.
+class OmxrDecoderGroup::Member : public VideoDecodeAccelerator::Client {
+ public:
+  Member(OmxrDecoderGroup* group,
+         int index,
+         std::unique_ptr<VideoDecodeAccelerator> vda)
+      : group_(group), index_(index), vda_(std::move(vda)) {}
+  ~Member() override = default;
+
+  VideoDecodeAccelerator* vda() { return vda_.get(); }
+
+  // VideoDecodeAccelerator::Client implementation.
+  void NotifyInitializationComplete(bool success) override {
+    group_->OnInitialized(index_, success);
+  }
+  void ProvidePictureBuffers(uint32_t requested_num_of_buffers,
+                             VideoPixelFormat format,
+                             uint32_t textures_per_buffer,
+                             const gfx::Size& dimensions,
+                             uint32_t texture_target) override {
+    group_->OnProvidePictureBuffers(index_, requested_num_of_buffers, format,
+                                    textures_per_buffer, dimensions,
+                                    texture_target);
+  }
+  void DismissPictureBuffer(int32_t picture_buffer_id) override {
+    group_->OnDismissPictureBuffer(picture_buffer_id);
+  }
+  void PictureReady(const Picture& picture) override {
+    group_->delegate_->OnPictureReady(index_, picture);
+  }
+  void NotifyEndOfBitstreamBuffer(int32_t bitstream_buffer_id) override {
+    group_->OnEndOfBitstreamBuffer(bitstream_buffer_id);
+  }
+  void NotifyFlushDone() override { group_->delegate_->OnFlushDone(index_); }
+  void NotifyResetDone() override { group_->OnResetDone(); }
+  void NotifyError(VideoDecodeAccelerator::Error error) override {
+    group_->delegate_->OnError(error);
+  }
+
+ private:
+  OmxrDecoderGroup* const group_;
+  const int index_;
+  std::unique_ptr<VideoDecodeAccelerator> vda_;
+
+  DISALLOW_COPY_AND_ASSIGN(Member);
+};
+
+OmxrDecoderGroup::Input::Input(const BitstreamBuffer& buffer)
+    : buffer(buffer), keyframe(false), has_sps(false) {}
+
+OmxrDecoderGroup::Input::Input(const Input& other) = default;
+
+OmxrDecoderGroup::Input::~Input() = default;
+
+// static
+OmxrDecoderGroup::DecoderFactory OmxrDecoderGroup::HardwareFactory(
+    EGLDisplay egl_display,
+    const base::Callback<bool(void)>& make_context_current) {
+  return base::Bind(&CreateOmxrDecoder, egl_display, make_context_current);
+}
+
+OmxrDecoderGroup::OmxrDecoderGroup(Delegate* delegate)
+    : delegate_(delegate),
+      framer_(OmxrBitstreamFramer::Create(kCodecH264)),
+      pending_initializations_(0),
+      pending_resets_(0),
+      next_own_bitstream_id_(kFirstOwnBitstreamId) {}
+
+OmxrDecoderGroup::~OmxrDecoderGroup() = default;
+
+bool OmxrDecoderGroup::Add(const DecoderFactory& factory,
+                           const VideoDecodeAccelerator::Config& config) {
+  int index = size();
+  members_.push_back(std::make_unique<Member>(this, index, factory.Run()));
+  Member* member = members_.back().get();
+  if (!member->vda() || !member->vda()->Initialize(config, member)) {
+    DLOG(ERROR) << "Failed to initialize decoder " << index;
+    return false;
+  }
+  if (config.is_deferred_initialization_allowed)
+    ++pending_initializations_;
+  return true;
+}
+
+void OmxrDecoderGroup::DestroyDecoders() {
+  // The decoders are destroyed with their members.
+  members_.clear();
+}
+
+VideoDecodeAccelerator* OmxrDecoderGroup::decoder(int index) {
+  return members_[index]->vda();
+}
+
+bool OmxrDecoderGroup::Parse(Input* input) {
+  const BitstreamBuffer& buffer = input->buffer;
+  base::SharedMemory shm(base::SharedMemory::DuplicateHandle(buffer.handle()),
+                         true);
+  if (!shm.Map(buffer.size())) {
+    DLOG(ERROR) << "Failed to map bitstream buffer " << buffer.id();
+    delegate_->OnError(VideoDecodeAccelerator::UNREADABLE_INPUT);
+    return false;
+  }
+
+  std::vector<OmxrBitstreamFramer::Span> spans;
+  std::vector<OmxrBitstreamFramer::ParameterSet> parameter_sets;
+  if (!framer_->Split(static_cast<const uint8_t*>(shm.memory()),
+                      buffer.size(), &spans, &parameter_sets)) {
+    DLOG(ERROR) << "Parsing bitstream failed";
+    delegate_->OnError(VideoDecodeAccelerator::PLATFORM_FAILURE);
+    return false;
+  }
+
+  for (const OmxrBitstreamFramer::ParameterSet& ps : parameter_sets) {
+    if (ps.type == OmxrBitstreamFramer::VPS)
+      continue;
+    input->has_sps |= ps.type == OmxrBitstreamFramer::SPS;
+    std::vector<uint8_t>& saved =
+        ps.type == OmxrBitstreamFramer::SPS ? sps_ : pps_;
+    saved.assign(kStartCode, kStartCode + sizeof(kStartCode));
+    saved.insert(saved.end(), ps.data, ps.data + ps.size);
+  }
+  input->keyframe = std::any_of(
+      spans.begin(), spans.end(),
+      [](const OmxrBitstreamFramer::Span& span) { return span.keyframe; });
+
+  // The decoder that gets this GOP may not have seen the stream's parameter
+  // sets; those in force now go along with it.
+  if (input->keyframe && !input->has_sps) {
+    input->parameter_sets = sps_;
+    input->parameter_sets.insert(input->parameter_sets.end(), pps_.begin(),
+                                 pps_.end());
+  }
+  return true;
+}
+
+void OmxrDecoderGroup::Decode(int index, const Input& input, bool starts_gop) {
+  if (starts_gop && !input.parameter_sets.empty())
+    SubmitParameterSets(index, input.parameter_sets);
+  decoder(index)->Decode(input.buffer);
+}
+
+bool OmxrDecoderGroup::AssignPictureBuffers(
+    const std::vector<PictureBuffer>& buffers) {
+  if (awaiting_pictures_.empty())
+    return false;
+  int index = awaiting_pictures_.front();
+  awaiting_pictures_.pop_front();
+  for (const PictureBuffer& buffer : buffers)
+    picture_decoders_[buffer.id()] = index;
+  decoder(index)->AssignPictureBuffers(buffers);
+  return true;
+}
+
+void OmxrDecoderGroup::ReusePictureBuffer(int32_t picture_buffer_id) {
+  auto it = picture_decoders_.find(picture_buffer_id);
+  // Dismissed meanwhile.
+  if (it == picture_decoders_.end())
+    return;
+  decoder(it->second)->ReusePictureBuffer(picture_buffer_id);
+}
+
+void OmxrDecoderGroup::Reset() {
+  framer_->Reset();
+  pending_resets_ = size();
+  for (const auto& member : members_)
+    member->vda()->Reset();
+}
+
+void OmxrDecoderGroup::OnInitialized(int index, bool success) {
+  if (!pending_initializations_)
+    return;
+  if (!success) {
+    DLOG(ERROR) << "Decoder " << index << " failed to initialize";
+    pending_initializations_ = 0;
+  } else if (--pending_initializations_) {
+    return;
+  }
+  delegate_->OnInitializationComplete(success);
+}
+
+void OmxrDecoderGroup::OnProvidePictureBuffers(
+    int index,
+    uint32_t requested_num_of_buffers,
+    VideoPixelFormat format,
+    uint32_t textures_per_buffer,
+    const gfx::Size& dimensions,
+    uint32_t texture_target) {
+  awaiting_pictures_.push_back(index);
+  delegate_->OnProvidePictureBuffers(index, requested_num_of_buffers, format,
+                                     textures_per_buffer, dimensions,
+                                     texture_target);
+}
+
+void OmxrDecoderGroup::OnDismissPictureBuffer(int32_t picture_buffer_id) {
+  picture_decoders_.erase(picture_buffer_id);
+  delegate_->OnDismissPictureBuffer(picture_buffer_id);
+}
+
+void OmxrDecoderGroup::OnEndOfBitstreamBuffer(int32_t bitstream_buffer_id) {
+  if (own_bitstream_ids_.erase(bitstream_buffer_id))
+    return;
+  delegate_->OnEndOfBitstreamBuffer(bitstream_buffer_id);
+}
+
+void OmxrDecoderGroup::OnResetDone() {
+  DCHECK_GT(pending_resets_, 0);
+  if (--pending_resets_ == 0)
+    delegate_->OnResetDone();
+}
+
+void OmxrDecoderGroup::SubmitParameterSets(
+    int index,
+    const std::vector<uint8_t>& parameter_sets) {
+  base::SharedMemory shm;
+  if (!shm.CreateAndMapAnonymous(parameter_sets.size())) {
+    DLOG(ERROR) << "Failed to allocate a parameter set buffer";
+    delegate_->OnError(VideoDecodeAccelerator::PLATFORM_FAILURE);
+    return;
+  }
+  memcpy(shm.memory(), parameter_sets.data(), parameter_sets.size());
+
+  int32_t bitstream_id = next_own_bitstream_id_;
+  next_own_bitstream_id_ =
+      bitstream_id == std::numeric_limits<int32_t>::max()
+          ? kFirstOwnBitstreamId
+          : bitstream_id + 1;
+  own_bitstream_ids_.insert(bitstream_id);
+  decoder(index)->Decode(
+      BitstreamBuffer(bitstream_id, shm.TakeHandle(), parameter_sets.size()));
+}
+
+}  // namespace media
@@ -0,0 +1,161 @@
+// Copyright (c) 2019 Renesas Electronics Corporation
+// Use of this source code is governed by a BSD-style license that can be
+// found in the LICENSE file.
+
+#ifndef MEDIA_GPU_OMX_OMXR_DECODER_GROUP_H_
+#define MEDIA_GPU_OMX_OMXR_DECODER_GROUP_H_
+
+#include <stddef.h>
+#include <stdint.h>
+
+#include <deque>
+#include <map>
+#include <memory>
+#include <set>
+#include <vector>
+
+#include "base/callback.h"
+#include "base/macros.h"
+#include "media/gpu/media_gpu_export.h"
+#include "media/gpu/omx/omxr_bitstream_framer.h"
+#include "media/video/picture.h"
+#include "media/video/video_decode_accelerator.h"
+#include "ui/gl/gl_bindings.h"
+
+namespace media {
+
+// The decoders behind a VideoDecodeAccelerator that spreads an H.264 stream
+// over several of them, as OmxrParallelGopDecoder and
+// OmxrHybridVideoDecodeAccelerator do.  Owns the decoders and is their
+// client, telling the delegate which decoder is calling.  Keeps what every
+// such decoder needs:
+//  - the parameter sets in force, so that a decoder handed a GOP without its
+//    own gets them in a bitstream buffer of ours, never reported to the
+//    client;
+//  - which decoder each picture buffer belongs to;
+//  - initialization and Reset() completion across all decoders.
+// Annex-B input only.
+class MEDIA_GPU_EXPORT OmxrDecoderGroup {
+ public:
+  using DecoderFactory =
+      base::Callback<std::unique_ptr<VideoDecodeAccelerator>(void)>;
+
+  // Calls of the decoders, with the index of the decoder calling where it
+  // matters.
+  class Delegate {
+   public:
+    // Every decoder initialized, or one failed; deferred initialization only.
+    virtual void OnInitializationComplete(bool success) = 0;
+    virtual void OnProvidePictureBuffers(int index,
+                                         uint32_t requested_num_of_buffers,
+                                         VideoPixelFormat format,
+                                         uint32_t textures_per_buffer,
+                                         const gfx::Size& dimensions,
+                                         uint32_t texture_target) = 0;
+    virtual void OnDismissPictureBuffer(int32_t picture_buffer_id) = 0;
+    virtual void OnPictureReady(int index, const Picture& picture) = 0;
+    // Client buffers only.
+    virtual void OnEndOfBitstreamBuffer(int32_t bitstream_buffer_id) = 0;
+    virtual void OnFlushDone(int index) = 0;
+    // Every decoder is reset.
+    virtual void OnResetDone() = 0;
+    virtual void OnError(VideoDecodeAccelerator::Error error) = 0;
+
+   protected:
+    virtual ~Delegate() {}
+  };
+
+  // A client bitstream buffer, parsed by Parse().
+  struct Input {
+    explicit Input(const BitstreamBuffer& buffer);
+    Input(const Input& other);
+    ~Input();
+
+    BitstreamBuffer buffer;
+    bool keyframe;
+    bool has_sps;
+    // The parameter sets in force, with start codes, if a keyframe does not
+    // bring its own.
+    std::vector<uint8_t> parameter_sets;
+  };
+
+  // OmxrVideoDecodeAccelerators.
+  static DecoderFactory HardwareFactory(
+      EGLDisplay egl_display,
+      const base::Callback<bool(void)>& make_context_current);
+
+  explicit OmxrDecoderGroup(Delegate* delegate);
+  ~OmxrDecoderGroup();
+
+  // Creates a decoder with |factory| and initializes it with |config|.  Its
+  // index is the number of decoders added before.  Returns false on failure.
+  bool Add(const DecoderFactory& factory,
+           const VideoDecodeAccelerator::Config& config);
+  // Destroys the decoders; none calls back after.
+  void DestroyDecoders();
+
+  VideoDecodeAccelerator* decoder(int index);
+  int size() const { return static_cast<int>(members_.size()); }
+
+  // Finds out whether |input| holds a keyframe and which parameter sets go
+  // with it, and keeps those it brings.  Reports an error and returns false
+  // if it cannot be read.
+  bool Parse(Input* input);
+  // The latest SPS, with its start code.
+  const std::vector<uint8_t>& sps() const { return sps_; }
+
+  // Decodes |input| on decoder |index|.  A |starts_gop| input goes after the
+  // parameter sets it needs; the decoder may not have seen them.
+  void Decode(int index, const Input& input, bool starts_gop);
+
+  // Hands |buffers| to the decoder that asked for them first.  Returns false
+  // if none did.
+  bool AssignPictureBuffers(const std::vector<PictureBuffer>& buffers);
+  void ReusePictureBuffer(int32_t picture_buffer_id);
+
+  // Forgets the access unit being parsed and resets every decoder.
+  void Reset();
+
+ private:
+  class Member;
+
+  // Member callbacks.
+  void OnInitialized(int index, bool success);
+  void OnProvidePictureBuffers(int index,
+                               uint32_t requested_num_of_buffers,
+                               VideoPixelFormat format,
+                               uint32_t textures_per_buffer,
+                               const gfx::Size& dimensions,
+                               uint32_t texture_target);
+  void OnDismissPictureBuffer(int32_t picture_buffer_id);
+  void OnEndOfBitstreamBuffer(int32_t bitstream_buffer_id);
+  void OnResetDone();
+
+  // Hands |parameter_sets| to decoder |index| in a bitstream buffer of our
+  // own.
+  void SubmitParameterSets(int index,
+                           const std::vector<uint8_t>& parameter_sets);
+
+  Delegate* const delegate_;
+  std::vector<std::unique_ptr<Member>> members_;
+  std::unique_ptr<OmxrBitstreamFramer> framer_;
+  int pending_initializations_;
+  int pending_resets_;
+
+  // Latest parameter sets, with start codes.
+  std::vector<uint8_t> sps_;
+  std::vector<uint8_t> pps_;
+  // Ids of the parameter set buffers we made up.
+  std::set<int32_t> own_bitstream_ids_;
+  int32_t next_own_bitstream_id_;
+
+  // Decoders waiting for AssignPictureBuffers(), in order of asking.
+  std::deque<int> awaiting_pictures_;
+  std::map<int32_t, int> picture_decoders_;
+
+  DISALLOW_COPY_AND_ASSIGN(OmxrDecoderGroup);
+};
+
+}  // namespace media
+
+#endif  // MEDIA_GPU_OMX_OMXR_DECODER_GROUP_H_
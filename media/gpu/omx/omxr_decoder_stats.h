@@ -0,0 +1,197 @@
+// Copyright (c) 2019 Renesas Electronics Corporation
+// Use of this source code is governed by a BSD-style license that can be
+// found in the LICENSE file.
+
+#ifndef MEDIA_GPU_OMX_OMXR_DECODER_STATS_H_
+#define MEDIA_GPU_OMX_OMXR_DECODER_STATS_H_
+
+#include <stddef.h>
+#include <stdint.h>
+
+#include <algorithm>
+#include <ostream>
+
+#include "base/macros.h"
+#include "base/time/time.h"
+
+namespace media {
+
+// Running counters of an OmxrVideoDecodeAccelerator instance, logged when the
+// decoder is destroyed and available through GetStats() while it lives.
+struct OmxrDecoderStats {
+  // Decoder tasks whose thread CPU time is counted.
+  enum CpuTask {
+    CPU_DECODE,
+    CPU_FILL_BUFFER_DONE,
+    CPU_EMPTY_BUFFER_DONE,
+    CPU_ASSIGN_PICTURE_BUFFERS,
+    CPU_REUSE_PICTURE_BUFFER,
+    CPU_EVENT,
+    // Initialize(), Flush(), Reset(), Destroy() and vendor calls outside the
+    // tasks above.
+    CPU_OTHER,
+    CPU_TASK_MAX,
+  };
+
+  // Time from the arrival of the first byte of an access unit in Decode() to
+  // its picture being handed to the client.
+  int64_t frames_timed = 0;
+  base::TimeDelta total_latency;
+  base::TimeDelta max_latency;
+
+  // Backward steps served from the GOP cache: time from the request to the
+  // picture being handed out, and the memory held for them.
+  int64_t steps = 0;
+  base::TimeDelta total_step_latency;
+  base::TimeDelta max_step_latency;
+  size_t gop_cache_bytes = 0;
+  size_t frame_store_bytes = 0;
+
+  // Pictures of looping clips served from the loop cache instead of being
+  // decoded again, and the carveout holding them.
+  int64_t loop_frames_served = 0;
+  size_t loop_cache_bytes = 0;
+
+  // Carveout held for input and output buffers and the frame caches, now and
+  // at its highest.
+  size_t carveout_bytes = 0;
+  size_t peak_carveout_bytes = 0;
+
+  // Times a live stream fell behind, access units dropped to catch up and
+  // jumps to a later keyframe.
+  int64_t catch_ups = 0;
+  int64_t skipped_access_units = 0;
+  int64_t skipped_to_keyframe = 0;
+
+  // Client notifications delivered in batches, and the batches.
+  int64_t batched_notifications = 0;
+  int64_t notification_batches = 0;
+
+  // Output port reconfigurations: time from the component asking for new
+  // pictures to their being handed to it, and the pictures allocated ahead
+  // of it from the SPS.
+  int64_t resizes = 0;
+  base::TimeDelta total_resize_time;
+  int64_t preallocated_pictures = 0;
+
+  // Automatic idling: times the component was paused for lack of input and
+  // the time it spent so, and the delay resuming it added to the input that
+  // woke it.
+  int64_t idles = 0;
+  base::TimeDelta total_idle_time;
+  int64_t wake_ups = 0;
+  base::TimeDelta total_wake_latency;
+  base::TimeDelta max_wake_latency;
+
+  // Thread CPU time spent in the decoder's tasks, by task, and the part of it
+  // spent in calls into the vendor libraries.
+  base::TimeDelta task_cpu_time[CPU_TASK_MAX];
+  base::TimeDelta vendor_cpu_time;
+
+  void AddLatency(base::TimeDelta latency) {
+    ++frames_timed;
+    total_latency += latency;
+    if (latency > max_latency)
+      max_latency = latency;
+  }
+
+  base::TimeDelta AverageLatency() const {
+    return frames_timed ? total_latency / frames_timed : base::TimeDelta();
+  }
+
+  void AddStep(base::TimeDelta latency) {
+    ++steps;
+    total_step_latency += latency;
+    if (latency > max_step_latency)
+      max_step_latency = latency;
+  }
+
+  base::TimeDelta AverageStepLatency() const {
+    return steps ? total_step_latency / steps : base::TimeDelta();
+  }
+
+  base::TimeDelta AverageResizeTime() const {
+    return resizes ? total_resize_time / resizes : base::TimeDelta();
+  }
+
+  void AddWakeUp(base::TimeDelta latency) {
+    ++wake_ups;
+    total_wake_latency += latency;
+    if (latency > max_wake_latency)
+      max_wake_latency = latency;
+  }
+
+  base::TimeDelta AverageWakeLatency() const {
+    return wake_ups ? total_wake_latency / wake_ups : base::TimeDelta();
+  }
+
+  base::TimeDelta TotalCpuTime() const {
+    base::TimeDelta total;
+    for (base::TimeDelta time : task_cpu_time)
+      total += time;
+    return total;
+  }
+
+  void SetCarveoutBytes(size_t bytes) {
+    carveout_bytes = bytes;
+    peak_carveout_bytes = std::max(peak_carveout_bytes, bytes);
+  }
+};
+
+inline std::ostream& operator<<(std::ostream& os,
+                                const OmxrDecoderStats& stats) {
+  os << "frames: " << stats.frames_timed << ", latency avg "
+     << stats.AverageLatency().InMillisecondsF() << " ms, max "
+     << stats.max_latency.InMillisecondsF() << " ms, peak carveout "
+     << stats.peak_carveout_bytes << " bytes";
+  if (stats.steps) {
+    os << ", steps: " << stats.steps << ", step latency avg "
+       << stats.AverageStepLatency().InMillisecondsF() << " ms, max "
+       << stats.max_step_latency.InMillisecondsF() << " ms, GOP cache "
+       << stats.gop_cache_bytes << " bytes, frame store "
+       << stats.frame_store_bytes << " bytes";
+  }
+  if (stats.loop_frames_served) {
+    os << ", served from loop cache: " << stats.loop_frames_served
+       << ", loop cache " << stats.loop_cache_bytes << " bytes";
+  }
+  if (stats.catch_ups) {
+    os << ", catch-ups: " << stats.catch_ups << ", skipped access units "
+       << stats.skipped_access_units << ", skips to keyframe "
+       << stats.skipped_to_keyframe;
+  }
+  if (stats.notification_batches) {
+    os << ", batched notifications: " << stats.batched_notifications
+       << " in " << stats.notification_batches << " batches";
+  }
+  if (stats.resizes) {
+    os << ", resizes: " << stats.resizes << ", avg "
+       << stats.AverageResizeTime().InMillisecondsF()
+       << " ms, preallocated pictures " << stats.preallocated_pictures;
+  }
+  if (stats.idles) {
+    os << ", idles: " << stats.idles << ", idle "
+       << stats.total_idle_time.InSecondsF() << " s, wake-ups "
+       << stats.wake_ups << ", wake latency avg "
+       << stats.AverageWakeLatency().InMillisecondsF() << " ms, max "
+       << stats.max_wake_latency.InMillisecondsF() << " ms";
+  }
+  if (!stats.TotalCpuTime().is_zero()) {
+    static const char* const kTaskNames[] = {
+        "decode", "fill done", "empty done", "assign",
+        "reuse",  "events",    "other"};
+    static_assert(arraysize(kTaskNames) == OmxrDecoderStats::CPU_TASK_MAX,
+                  "Name every CPU task");
+    os << ", CPU " << stats.TotalCpuTime().InMillisecondsF() << " ms (";
+    for (int task = 0; task < OmxrDecoderStats::CPU_TASK_MAX; ++task) {
+      os << (task ? ", " : "") << kTaskNames[task] << " "
+         << stats.task_cpu_time[task].InMillisecondsF();
+    }
+    os << "), vendor " << stats.vendor_cpu_time.InMillisecondsF() << " ms";
+  }
+  return os;
+}
+
+}  // namespace media
+
+#endif  // MEDIA_GPU_OMX_OMXR_DECODER_STATS_H_
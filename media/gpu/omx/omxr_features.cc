@@ -0,0 +1,75 @@
+// Copyright (c) 2019 Renesas Electronics Corporation
+// Use of this source code is governed by a BSD-style license that can be
+// found in the LICENSE file.
+
+#include "media/gpu/omx/omxr_features.h"
+
+namespace media {
+
+const base::Feature kOmxrSessionMultiplexing{
+    "OmxrSessionMultiplexing", base::FEATURE_DISABLED_BY_DEFAULT};
+const base::FeatureParam<int> kOmxrMaxComponents{
+    &kOmxrSessionMultiplexing, "max_components", 4};
+const base::FeatureParam<int> kOmxrSessionQuantumMs{
+    &kOmxrSessionMultiplexing, "quantum_ms", 500};
+
+const base::Feature kOmxrSliceStreaming{
+    "OmxrSliceStreaming", base::FEATURE_DISABLED_BY_DEFAULT};
+
+const base::Feature kOmxrGopCache{
+    "OmxrGopCache", base::FEATURE_DISABLED_BY_DEFAULT};
+const base::FeatureParam<int> kOmxrGopCacheMaxBytes{
+    &kOmxrGopCache, "max_bytes", 8 * 1024 * 1024};
+const base::FeatureParam<int> kOmxrGopCacheRingFrames{
+    &kOmxrGopCache, "ring_frames", 32};
+
+const base::Feature kOmxrLoopCache{
+    "OmxrLoopCache", base::FEATURE_DISABLED_BY_DEFAULT};
+const base::FeatureParam<int> kOmxrLoopCacheMaxBytes{
+    &kOmxrLoopCache, "max_bytes", 256 * 1024 * 1024};
+
+const base::Feature kOmxrInputTuner{
+    "OmxrInputTuner", base::FEATURE_DISABLED_BY_DEFAULT};
+const base::FeatureParam<int> kOmxrInputTunerMaxBytes{
+    &kOmxrInputTuner, "max_bytes", 8 * 1024 * 1024};
+
+const base::Feature kOmxrHangWatchdog{
+    "OmxrHangWatchdog", base::FEATURE_DISABLED_BY_DEFAULT};
+const base::FeatureParam<int> kOmxrHangWatchdogTimeoutMs{
+    &kOmxrHangWatchdog, "timeout_ms", 3000};
+const base::FeatureParam<int> kOmxrHangWatchdogBackoffMs{
+    &kOmxrHangWatchdog, "backoff_ms", 30000};
+
+const base::Feature kOmxrParallelGopDecoding{
+    "OmxrParallelGopDecoding", base::FEATURE_DISABLED_BY_DEFAULT};
+const base::FeatureParam<int> kOmxrParallelGopLanes{
+    &kOmxrParallelGopDecoding, "lanes", 2};
+const base::FeatureParam<int> kOmxrParallelGopReorderPictures{
+    &kOmxrParallelGopDecoding, "reorder_pictures", 4};
+
+const base::Feature kOmxrLiveCatchUp{
+    "OmxrLiveCatchUp", base::FEATURE_DISABLED_BY_DEFAULT};
+const base::FeatureParam<int> kOmxrLiveCatchUpThresholdMs{
+    &kOmxrLiveCatchUp, "threshold_ms", 500};
+const base::FeatureParam<int> kOmxrLiveCatchUpTargetMs{
+    &kOmxrLiveCatchUp, "target_ms", 100};
+const base::FeatureParam<bool> kOmxrLiveCatchUpSkipToKeyframe{
+    &kOmxrLiveCatchUp, "skip_to_keyframe", false};
+
+const base::Feature kOmxrHybridDecoding{
+    "OmxrHybridDecoding", base::FEATURE_DISABLED_BY_DEFAULT};
+
+const base::Feature kOmxrBatchedNotifications{
+    "OmxrBatchedNotifications", base::FEATURE_DISABLED_BY_DEFAULT};
+const base::FeatureParam<int> kOmxrBatchedNotificationsMaxDelayMs{
+    &kOmxrBatchedNotifications, "max_delay_ms", 2};
+
+const base::Feature kOmxrPredictiveResize{
+    "OmxrPredictiveResize", base::FEATURE_DISABLED_BY_DEFAULT};
+
+const base::Feature kOmxrAutoIdle{
+    "OmxrAutoIdle", base::FEATURE_DISABLED_BY_DEFAULT};
+const base::FeatureParam<int> kOmxrAutoIdleDelayMs{
+    &kOmxrAutoIdle, "delay_ms", 2000};
+
+}  // namespace media
@@ -0,0 +1,108 @@
+// Copyright (c) 2019 Renesas Electronics Corporation
+// Use of this source code is governed by a BSD-style license that can be
+// found in the LICENSE file.
+
+// Runtime switches for optional OMXR decoder behaviour.
+
+#ifndef MEDIA_GPU_OMX_OMXR_FEATURES_H_
+#define MEDIA_GPU_OMX_OMXR_FEATURES_H_
+
+#include "base/feature_list.h"
+#include "base/metrics/field_trial_params.h"
+
+namespace media {
+
+// Share a bounded number of OMX components between decoder sessions, handing
+// a component over to a waiting session at IDR boundaries.
+extern const base::Feature kOmxrSessionMultiplexing;
+// Number of component instances the decode IP can host simultaneously.
+extern const base::FeatureParam<int> kOmxrMaxComponents;
+// Minimum time a session keeps its component before yielding to a waiter.
+extern const base::FeatureParam<int> kOmxrSessionQuantumMs;
+
+// Push H.264 slices into the component as they arrive instead of assembling
+// whole access units first, relying on the EOF-separated stream store unit.
+extern const base::Feature kOmxrSliceStreaming;
+
+// Keep the compressed input of the current and previous GOP plus a ring of
+// decoded pictures so backward steps can be served without a Reset().
+extern const base::Feature kOmxrGopCache;
+// Budget for the cached compressed input.
+extern const base::FeatureParam<int> kOmxrGopCacheMaxBytes;
+// Number of decoded pictures kept in carveout for backward stepping.
+extern const base::FeatureParam<int> kOmxrGopCacheRingFrames;
+
+// Keep the decoded pictures of a short looping clip after its first pass and
+// serve later passes over the same input without decoding them again.
+extern const base::Feature kOmxrLoopCache;
+// Carveout budget for the extra pictures the clip is kept in, allocated with
+// the other pictures.  256 MB holds about 80 1080p pictures, under 3 s at
+// 30 fps; longer clips are decoded on every pass.
+extern const base::FeatureParam<int> kOmxrLoopCacheMaxBytes;
+
+// Adjust the number and size of input buffers to the stream: more buffers
+// when input starves the hardware, fewer when the hardware idles waiting for
+// input anyway.  Changes are applied on Reset() and component re-creation.
+extern const base::Feature kOmxrInputTuner;
+// Carveout budget for all input buffers of one decoder.
+extern const base::FeatureParam<int> kOmxrInputTunerMaxBytes;
+
+// Give up on a component that owes us a state change or buffers and stays
+// silent, instead of waiting for it until the GPU watchdog kills the process.
+// Later sessions are refused for a while so that players fall back to software
+// decoding.
+extern const base::Feature kOmxrHangWatchdog;
+// Silence after which the component is considered hung.
+extern const base::FeatureParam<int> kOmxrHangWatchdogTimeoutMs;
+// How long new sessions are refused after a hang; doubles with every further
+// hang.
+extern const base::FeatureParam<int> kOmxrHangWatchdogBackoffMs;
+
+// Decode the GOPs of H.264 streams concurrently on several components and
+// put the pictures back in stream order (OmxrParallelGopDecoder).  For
+// devices that only decode files offline, e.g. for export or thumbnails: a
+// live stream has no GOPs ahead to work on, and each decoder takes that many
+// components.  Other codecs are decoded as usual.
+extern const base::Feature kOmxrParallelGopDecoding;
+// Components, and so GOPs, per decoder; capped at kOmxrMaxComponents.
+extern const base::FeatureParam<int> kOmxrParallelGopLanes;
+// Pictures each component may decode ahead of the GOP being output.
+extern const base::FeatureParam<int> kOmxrParallelGopReorderPictures;
+
+// Catch up with live streams that fell behind: while the oldest pending input
+// is older than the threshold, drop access units no other picture refers to,
+// until the backlog is under the target again.
+extern const base::Feature kOmxrLiveCatchUp;
+extern const base::FeatureParam<int> kOmxrLiveCatchUpThresholdMs;
+extern const base::FeatureParam<int> kOmxrLiveCatchUpTargetMs;
+// On falling behind, also drop everything before the latest keyframe queued.
+extern const base::FeatureParam<bool> kOmxrLiveCatchUpSkipToKeyframe;
+
+// Decode H.264 GOPs the hardware cannot take, such as a 4K segment in a 1080p
+// stream, in software, and go back to the hardware at the next IDR it can
+// take (OmxrHybridVideoDecodeAccelerator).  Needs a software decoder
+// registered with OmxrHybridVideoDecodeAccelerator::SetSoftwareFactory().
+extern const base::Feature kOmxrHybridDecoding;
+
+// Hand end of bitstream notifications to the client in batches, one task per
+// batch instead of one per bitstream buffer.  Pictures still go out right
+// away.
+extern const base::Feature kOmxrBatchedNotifications;
+// Longest a notification is held back; 0 batches only those one task of the
+// decoder thread produces.
+extern const base::FeatureParam<int> kOmxrBatchedNotificationsMaxDelayMs;
+
+// Allocate the pictures of a new resolution as soon as its SPS is seen, in
+// the background, rather than once the component asks for them.  Until the
+// old pictures are freed the carveout holds both sizes.
+extern const base::Feature kOmxrPredictiveResize;
+
+// Pause the component once no input came for a while and all of it was
+// decoded, and resume it on the next Decode().  Buffers stay allocated.
+extern const base::Feature kOmxrAutoIdle;
+// Time without input after which the component is paused.
+extern const base::FeatureParam<int> kOmxrAutoIdleDelayMs;
+
+}  // namespace media
+
+#endif  // MEDIA_GPU_OMX_OMXR_FEATURES_H_
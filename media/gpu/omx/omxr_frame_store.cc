@@ -0,0 +1,85 @@
+// Copyright (c) 2019 Renesas Electronics Corporation
+// Use of this source code is governed by a BSD-style license that can be
+// found in the LICENSE file.
+
+#include "media/gpu/omx/omxr_frame_store.h"
+
+#include <string.h>
+
+#include <algorithm>
+
+#include "base/logging.h"
+#include "media/gpu/omx/omxr_resource_tracker.h"
+
+namespace media {
+
+OmxrFrameStore::OmxrFrameStore(size_t frame_size, size_t max_frames)
+    : frame_size_(frame_size), max_frames_(std::max<size_t>(max_frames, 1)) {}
+
+OmxrFrameStore::~OmxrFrameStore() {
+  Clear();
+}
+
+bool OmxrFrameStore::Store(int32_t id, const void* src) {
+  auto it = frames_.find(id);
+  if (it == frames_.end()) {
+    Frame frame;
+    if (frames_.size() >= max_frames_) {
+      // Re-use the oldest picture's memory.
+      int32_t oldest = order_.front();
+      order_.pop_front();
+      frame = frames_[oldest];
+      frames_.erase(oldest);
+    } else {
+      frame.virt_addr = AllocateFrame(&frame.mem_id);
+      if (!frame.virt_addr)
+        return false;
+    }
+    it = frames_.insert(std::make_pair(id, frame)).first;
+  } else {
+    order_.remove(id);
+  }
+  order_.push_back(id);
+
+  memcpy(it->second.virt_addr, src, frame_size_);
+  return true;
+}
+
+bool OmxrFrameStore::Contains(int32_t id) const {
+  return frames_.count(id) > 0;
+}
+
+bool OmxrFrameStore::CopyOut(int32_t id, void* dst) const {
+  auto it = frames_.find(id);
+  if (it == frames_.end())
+    return false;
+  memcpy(dst, it->second.virt_addr, frame_size_);
+  return true;
+}
+
+void OmxrFrameStore::Clear() {
+  for (const auto& it : frames_)
+    FreeFrame(it.second.mem_id, it.second.virt_addr);
+  frames_.clear();
+  order_.clear();
+}
+
+void* OmxrFrameStore::AllocateFrame(MMNGR_ID* mem_id) {
+  unsigned int hard_addr;
+  void* virt_addr;
+  int ret = OmxrResourceTracker::Get()->AllocCarveout(mem_id, frame_size_,
+                                                      &hard_addr, &virt_addr);
+  if (ret) {
+    DLOG(ERROR) << "Cannot allocate frame store memory: " << ret;
+    return nullptr;
+  }
+  return virt_addr;
+}
+
+void OmxrFrameStore::FreeFrame(MMNGR_ID mem_id, void* virt_addr) {
+  int ret = OmxrResourceTracker::Get()->FreeCarveout(mem_id);
+  if (ret)
+    DLOG(ERROR) << "Cannot free frame store memory: " << ret;
+}
+
+}  // namespace media
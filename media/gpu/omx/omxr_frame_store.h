@@ -0,0 +1,64 @@
+// Copyright (c) 2019 Renesas Electronics Corporation
+// Use of this source code is governed by a BSD-style license that can be
+// found in the LICENSE file.
+
+#ifndef MEDIA_GPU_OMX_OMXR_FRAME_STORE_H_
+#define MEDIA_GPU_OMX_OMXR_FRAME_STORE_H_
+
+#include <stddef.h>
+#include <stdint.h>
+
+#include <list>
+#include <map>
+
+#include "base/macros.h"
+#include "third_party/mmngr/mmngr_user_public.h"
+
+namespace media {
+
+// A bounded set of decoded pictures copied out of the decoder's output
+// buffers into carveout of their own, keyed by the bitstream buffer id the
+// picture was decoded from.  When full, the least recently stored picture is
+// evicted and its memory re-used.
+class OmxrFrameStore {
+ public:
+  OmxrFrameStore(size_t frame_size, size_t max_frames);
+  virtual ~OmxrFrameStore();
+
+  // Copies |frame_size| bytes from |src|.  Returns false if no carveout could
+  // be allocated for the picture.
+  bool Store(int32_t id, const void* src);
+  bool Contains(int32_t id) const;
+  // Copies the stored picture |id| to |dst|.
+  bool CopyOut(int32_t id, void* dst) const;
+  void Clear();
+
+  size_t frame_size() const { return frame_size_; }
+  size_t size() const { return frames_.size(); }
+  size_t max_frames() const { return max_frames_; }
+  size_t memory_usage() const { return frames_.size() * frame_size_; }
+
+ protected:
+  // Carveout by default.  Subclasses overriding these must Clear() in their
+  // destructor.
+  virtual void* AllocateFrame(MMNGR_ID* mem_id);
+  virtual void FreeFrame(MMNGR_ID mem_id, void* virt_addr);
+
+ private:
+  struct Frame {
+    MMNGR_ID mem_id;
+    void* virt_addr;
+  };
+
+  const size_t frame_size_;
+  const size_t max_frames_;
+  std::map<int32_t, Frame> frames_;
+  // Ids in |frames_|, oldest first.
+  std::list<int32_t> order_;
+
+  DISALLOW_COPY_AND_ASSIGN(OmxrFrameStore);
+};
+
+}  // namespace media
+
+#endif  // MEDIA_GPU_OMX_OMXR_FRAME_STORE_H_
@@ -0,0 +1,106 @@
+// Copyright (c) 2019 Renesas Electronics Corporation
+// Use of this source code is governed by a BSD-style license that can be
+// found in the LICENSE file.
+
+#include "media/gpu/omx/omxr_frame_store.h"
+
+#include <stdlib.h>
+
+#include <vector>
+
+#include "testing/gtest/include/gtest/gtest.h"
+
+namespace media {
+namespace {
+
+const size_t kFrameSize = 64;
+
+// Keeps the frames in heap memory instead of carveout.
+class TestFrameStore : public OmxrFrameStore {
+ public:
+  TestFrameStore(size_t max_frames, int max_allocations)
+      : OmxrFrameStore(kFrameSize, max_frames),
+        max_allocations_(max_allocations) {}
+  ~TestFrameStore() override { Clear(); }
+
+  int allocations() const { return allocations_; }
+  int live() const { return live_; }
+
+ protected:
+  void* AllocateFrame(MMNGR_ID* mem_id) override {
+    if (allocations_ >= max_allocations_)
+      return nullptr;
+    *mem_id = allocations_++;
+    ++live_;
+    return malloc(frame_size());
+  }
+
+  void FreeFrame(MMNGR_ID mem_id, void* virt_addr) override {
+    --live_;
+    free(virt_addr);
+  }
+
+ private:
+  const int max_allocations_;
+  int allocations_ = 0;
+  int live_ = 0;
+};
+
+std::vector<uint8_t> Frame(uint8_t value) {
+  return std::vector<uint8_t>(kFrameSize, value);
+}
+
+TEST(OmxrFrameStoreTest, CopiesFramesOut) {
+  TestFrameStore store(4, 4);
+  std::vector<uint8_t> frame = Frame(7);
+  ASSERT_TRUE(store.Store(10, frame.data()));
+  frame[0] = 8;
+
+  std::vector<uint8_t> out(kFrameSize);
+  EXPECT_TRUE(store.Contains(10));
+  ASSERT_TRUE(store.CopyOut(10, out.data()));
+  EXPECT_EQ(Frame(7), out);
+  EXPECT_FALSE(store.CopyOut(11, out.data()));
+  EXPECT_EQ(kFrameSize, store.memory_usage());
+}
+
+TEST(OmxrFrameStoreTest, EvictsTheOldestAndReusesItsMemory) {
+  TestFrameStore store(2, 2);
+  ASSERT_TRUE(store.Store(1, Frame(1).data()));
+  ASSERT_TRUE(store.Store(2, Frame(2).data()));
+  // Storing 1 again makes 2 the oldest.
+  ASSERT_TRUE(store.Store(1, Frame(3).data()));
+  ASSERT_TRUE(store.Store(3, Frame(4).data()));
+
+  EXPECT_EQ(2, store.allocations());
+  EXPECT_TRUE(store.Contains(1));
+  EXPECT_FALSE(store.Contains(2));
+  EXPECT_TRUE(store.Contains(3));
+
+  std::vector<uint8_t> out(kFrameSize);
+  ASSERT_TRUE(store.CopyOut(1, out.data()));
+  EXPECT_EQ(Frame(3), out);
+}
+
+TEST(OmxrFrameStoreTest, FailsWithoutMemory) {
+  TestFrameStore store(4, 1);
+  EXPECT_TRUE(store.Store(1, Frame(1).data()));
+  EXPECT_FALSE(store.Store(2, Frame(2).data()));
+  EXPECT_FALSE(store.Contains(2));
+  EXPECT_EQ(1u, store.size());
+}
+
+TEST(OmxrFrameStoreTest, ClearFreesEverything) {
+  TestFrameStore store(4, 4);
+  ASSERT_TRUE(store.Store(1, Frame(1).data()));
+  ASSERT_TRUE(store.Store(2, Frame(2).data()));
+  EXPECT_EQ(2, store.live());
+
+  store.Clear();
+  EXPECT_EQ(0, store.live());
+  EXPECT_EQ(0u, store.size());
+  EXPECT_FALSE(store.Contains(1));
+}
+
+}  // namespace
+}  // namespace media
@@ -0,0 +1,82 @@
+// Copyright (c) 2019 Renesas Electronics Corporation
+// Use of this source code is governed by a BSD-style license that can be
+// found in the LICENSE file.
+
+#include "media/gpu/omx/omxr_gop_cache.h"
+
+#include "base/logging.h"
+
+namespace media {
+
+OmxrGopCache::OmxrGopCache(size_t max_bytes)
+    : max_bytes_(max_bytes),
+      current_gop_start_(0),
+      bytes_(0),
+      overflowed_(false) {}
+
+OmxrGopCache::~OmxrGopCache() = default;
+
+void OmxrGopCache::Add(int32_t id,
+                       const uint8_t* data,
+                       size_t size,
+                       bool keyframe) {
+  if (keyframe) {
+    // The GOP before the current one is no longer needed.
+    while (current_gop_start_ > 0)
+      DropFrontGop();
+    current_gop_start_ = buffers_.size();
+    overflowed_ = false;
+  } else if (overflowed_ || buffers_.empty()) {
+    // Without its keyframe a buffer cannot be re-decoded.
+    return;
+  }
+
+  while (bytes_ + size > max_bytes_ && current_gop_start_ > 0)
+    DropFrontGop();
+  if (bytes_ + size > max_bytes_) {
+    VLOG(1) << "GOP exceeds the cache budget of " << max_bytes_ << " bytes";
+    Clear();
+    overflowed_ = true;
+    return;
+  }
+
+  CachedBuffer buffer;
+  buffer.id = id;
+  buffer.keyframe = keyframe;
+  buffer.data.assign(data, data + size);
+  buffers_.push_back(std::move(buffer));
+  bytes_ += size;
+}
+
+bool OmxrGopCache::GetDecodeRange(
+    int32_t id,
+    std::vector<const CachedBuffer*>* buffers) const {
+  buffers->clear();
+  for (const CachedBuffer& buffer : buffers_) {
+    if (buffer.keyframe)
+      buffers->clear();
+    buffers->push_back(&buffer);
+    if (buffer.id == id)
+      return true;
+  }
+  buffers->clear();
+  return false;
+}
+
+void OmxrGopCache::Clear() {
+  buffers_.clear();
+  current_gop_start_ = 0;
+  bytes_ = 0;
+}
+
+void OmxrGopCache::DropFrontGop() {
+  DCHECK(!buffers_.empty());
+  do {
+    bytes_ -= buffers_.front().data.size();
+    buffers_.pop_front();
+    if (current_gop_start_ > 0)
+      --current_gop_start_;
+  } while (!buffers_.empty() && !buffers_.front().keyframe);
+}
+
+}  // namespace media
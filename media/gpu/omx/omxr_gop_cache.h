@@ -0,0 +1,63 @@
+// Copyright (c) 2019 Renesas Electronics Corporation
+// Use of this source code is governed by a BSD-style license that can be
+// found in the LICENSE file.
+
+#ifndef MEDIA_GPU_OMX_OMXR_GOP_CACHE_H_
+#define MEDIA_GPU_OMX_OMXR_GOP_CACHE_H_
+
+#include <stddef.h>
+#include <stdint.h>
+
+#include <deque>
+#include <vector>
+
+#include "base/macros.h"
+#include "media/gpu/media_gpu_export.h"
+
+namespace media {
+
+// Keeps the compressed bitstream buffers of the current and the previous GOP
+// so that any picture in them can be re-decoded starting from its keyframe.
+// Buffers are kept in decode order; a GOP starts at a buffer flagged as
+// keyframe.  When the budget is exceeded the oldest GOP is dropped first; a
+// single GOP that does not fit on its own is not cached at all.
+class MEDIA_GPU_EXPORT OmxrGopCache {
+ public:
+  struct CachedBuffer {
+    int32_t id;
+    bool keyframe;
+    std::vector<uint8_t> data;
+  };
+
+  explicit OmxrGopCache(size_t max_bytes);
+  ~OmxrGopCache();
+
+  void Add(int32_t id, const uint8_t* data, size_t size, bool keyframe);
+
+  // Fills |buffers| with the buffers from the keyframe of the GOP containing
+  // |id| up to and including |id|.  Returns false if |id| is not cached.
+  bool GetDecodeRange(int32_t id,
+                      std::vector<const CachedBuffer*>* buffers) const;
+
+  void Clear();
+
+  size_t memory_usage() const { return bytes_; }
+  size_t size() const { return buffers_.size(); }
+
+ private:
+  void DropFrontGop();
+
+  const size_t max_bytes_;
+  std::deque<CachedBuffer> buffers_;
+  // Index in |buffers_| of the keyframe starting the current GOP.
+  size_t current_gop_start_;
+  size_t bytes_;
+  // The current GOP outgrew the budget; ignore input until the next keyframe.
+  bool overflowed_;
+
+  DISALLOW_COPY_AND_ASSIGN(OmxrGopCache);
+};
+
+}  // namespace media
+
+#endif  // MEDIA_GPU_OMX_OMXR_GOP_CACHE_H_
@@ -0,0 +1,75 @@
+// Copyright (c) 2019 Renesas Electronics Corporation
+// Use of this source code is governed by a BSD-style license that can be
+// found in the LICENSE file.
+
+#include "media/gpu/omx/omxr_gop_cache.h"
+
+#include <vector>
+
+#include "testing/gtest/include/gtest/gtest.h"
+
+namespace media {
+namespace {
+
+const uint8_t kData[64] = {0};
+
+std::vector<int32_t> DecodeRange(const OmxrGopCache& cache, int32_t id) {
+  std::vector<const OmxrGopCache::CachedBuffer*> buffers;
+  std::vector<int32_t> ids;
+  if (cache.GetDecodeRange(id, &buffers)) {
+    for (const auto* buffer : buffers)
+      ids.push_back(buffer->id);
+  }
+  return ids;
+}
+
+TEST(OmxrGopCacheTest, IgnoresBuffersBeforeFirstKeyframe) {
+  OmxrGopCache cache(1024);
+  cache.Add(0, kData, 16, false);
+  EXPECT_EQ(0u, cache.size());
+  cache.Add(1, kData, 16, true);
+  cache.Add(2, kData, 16, false);
+  EXPECT_EQ(std::vector<int32_t>({1, 2}), DecodeRange(cache, 2));
+  EXPECT_TRUE(DecodeRange(cache, 0).empty());
+}
+
+TEST(OmxrGopCacheTest, KeepsCurrentAndPreviousGop) {
+  OmxrGopCache cache(1024);
+  for (int32_t id = 0; id < 9; ++id)
+    cache.Add(id, kData, 16, id % 3 == 0);
+
+  // GOPs start at 0, 3 and 6; only the last two remain.
+  EXPECT_TRUE(DecodeRange(cache, 2).empty());
+  EXPECT_EQ(std::vector<int32_t>({3, 4, 5}), DecodeRange(cache, 5));
+  EXPECT_EQ(std::vector<int32_t>({6, 7}), DecodeRange(cache, 7));
+  EXPECT_EQ(6u * 16, cache.memory_usage());
+}
+
+TEST(OmxrGopCacheTest, DropsPreviousGopWhenOverBudget) {
+  OmxrGopCache cache(64);
+  cache.Add(0, kData, 16, true);
+  cache.Add(1, kData, 16, false);
+  cache.Add(2, kData, 16, true);
+  cache.Add(3, kData, 16, false);
+  cache.Add(4, kData, 16, false);
+
+  EXPECT_TRUE(DecodeRange(cache, 1).empty());
+  EXPECT_EQ(std::vector<int32_t>({2, 3, 4}), DecodeRange(cache, 4));
+  EXPECT_LE(cache.memory_usage(), 64u);
+}
+
+TEST(OmxrGopCacheTest, SkipsGopLargerThanBudget) {
+  OmxrGopCache cache(32);
+  cache.Add(0, kData, 16, true);
+  cache.Add(1, kData, 16, false);
+  cache.Add(2, kData, 16, false);
+  EXPECT_EQ(0u, cache.size());
+  cache.Add(3, kData, 16, false);
+  EXPECT_EQ(0u, cache.size());
+
+  cache.Add(4, kData, 16, true);
+  EXPECT_EQ(std::vector<int32_t>({4}), DecodeRange(cache, 4));
+}
+
+}  // namespace
+}  // namespace media
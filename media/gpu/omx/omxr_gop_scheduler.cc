@@ -0,0 +1,142 @@
+// Copyright (c) 2019 Renesas Electronics Corporation
+// Use of this source code is governed by a BSD-style license that can be
+// found in the LICENSE file.
+
+#include "media/gpu/omx/omxr_gop_scheduler.h"
+
+#include <algorithm>
+
+#include "base/logging.h"
+
+namespace media {
+
+OmxrGopScheduler::Gop::Gop()
+    : lane(-1),
+      submitted_any(false),
+      ended(false),
+      flush_sent(false),
+      done(false) {}
+
+OmxrGopScheduler::Gop::~Gop() = default;
+
+OmxrGopScheduler::OmxrGopScheduler(int lanes, Delegate* delegate)
+    : delegate_(delegate),
+      lane_gops_(lanes, nullptr),
+      flushing_(false),
+      held_pictures_(0) {
+  DCHECK_GT(lanes, 0);
+}
+
+OmxrGopScheduler::~OmxrGopScheduler() = default;
+
+void OmxrGopScheduler::AddInput(int32_t bitstream_id, bool keyframe) {
+  if (keyframe)
+    EndLastGop();
+  if (gops_.empty() || gops_.back()->ended)
+    gops_.push_back(std::make_unique<Gop>());
+  gops_.back()->inputs.push_back(bitstream_id);
+  Schedule();
+}
+
+void OmxrGopScheduler::Flush() {
+  flushing_ = true;
+  EndLastGop();
+  Schedule();
+  MaybeFinishFlush();
+}
+
+bool OmxrGopScheduler::OnLanePicture(int lane, int32_t picture_buffer_id) {
+  Gop* gop = lane_gops_[lane];
+  if (!gop)
+    return false;
+  if (gop == gops_.front().get()) {
+    delegate_->DeliverPicture(picture_buffer_id);
+  } else {
+    gop->pictures.push_back(picture_buffer_id);
+    ++held_pictures_;
+  }
+  return true;
+}
+
+void OmxrGopScheduler::OnLaneFlushDone(int lane) {
+  Gop* gop = lane_gops_[lane];
+  // A flush cut short by Reset().
+  if (!gop)
+    return;
+  DCHECK(gop->flush_sent);
+  gop->done = true;
+  lane_gops_[lane] = nullptr;
+  DeliverHeldPictures();
+  Schedule();
+  MaybeFinishFlush();
+}
+
+void OmxrGopScheduler::Reset(
+    std::vector<int32_t>* dropped_inputs,
+    std::vector<std::pair<int, int32_t>>* held_pictures) {
+  for (const auto& gop : gops_) {
+    dropped_inputs->insert(dropped_inputs->end(), gop->inputs.begin(),
+                           gop->inputs.end());
+    for (int32_t picture_buffer_id : gop->pictures)
+      held_pictures->emplace_back(gop->lane, picture_buffer_id);
+  }
+  gops_.clear();
+  std::fill(lane_gops_.begin(), lane_gops_.end(), nullptr);
+  flushing_ = false;
+  held_pictures_ = 0;
+}
+
+void OmxrGopScheduler::EndLastGop() {
+  if (!gops_.empty())
+    gops_.back()->ended = true;
+}
+
+void OmxrGopScheduler::Schedule() {
+  for (const auto& gop : gops_) {
+    if (gop->done)
+      continue;
+    if (gop->lane < 0) {
+      auto lane = std::find(lane_gops_.begin(), lane_gops_.end(), nullptr);
+      // Later GOPs have to wait as well, or they would overtake this one.
+      if (lane == lane_gops_.end())
+        return;
+      *lane = gop.get();
+      gop->lane = lane - lane_gops_.begin();
+    }
+    while (!gop->inputs.empty()) {
+      int32_t bitstream_id = gop->inputs.front();
+      gop->inputs.pop_front();
+      bool starts_gop = !gop->submitted_any;
+      gop->submitted_any = true;
+      delegate_->SubmitToLane(gop->lane, bitstream_id, starts_gop);
+    }
+    if (gop->ended && !gop->flush_sent) {
+      gop->flush_sent = true;
+      delegate_->FlushLane(gop->lane);
+    }
+  }
+}
+
+void OmxrGopScheduler::DeliverHeldPictures() {
+  while (!gops_.empty()) {
+    Gop* front = gops_.front().get();
+    while (!front->pictures.empty()) {
+      int32_t picture_buffer_id = front->pictures.front();
+      front->pictures.pop_front();
+      --held_pictures_;
+      delegate_->DeliverPicture(picture_buffer_id);
+    }
+    if (!front->done)
+      return;
+    gops_.pop_front();
+  }
+}
+
+void OmxrGopScheduler::MaybeFinishFlush() {
+  if (!flushing_ || !gops_.empty())
+    return;
+  flushing_ = false;
+  delegate_->FlushDone();
+}
+
+}  // namespace media
@@ -0,0 +1,110 @@
+// Copyright (c) 2019 Renesas Electronics Corporation
+// Use of this source code is governed by a BSD-style license that can be
+// found in the LICENSE file.
+
+#ifndef MEDIA_GPU_OMX_OMXR_GOP_SCHEDULER_H_
+#define MEDIA_GPU_OMX_OMXR_GOP_SCHEDULER_H_
+
+#include <stddef.h>
+#include <stdint.h>
+
+#include <deque>
+#include <memory>
+#include <utility>
+#include <vector>
+
+#include "base/macros.h"
+#include "media/gpu/media_gpu_export.h"
+
+namespace media {
+
+// Spreads the GOPs of a stream over a number of decoder lanes and puts their
+// pictures back in stream order.  A GOP starts at every keyframe.  Each lane
+// decodes one GOP at a time and is flushed at its end; GOPs are handed to
+// lanes in stream order as lanes become free.  Pictures of the GOP being
+// output go straight through, those of later GOPs are held back until every
+// GOP before them is done.  Held pictures are still owned by their lane, so
+// the lanes' picture pools bound the reorder memory.
+//
+// Only bitstream and picture buffer ids pass through here; the buffers
+// themselves stay with the caller.
+class MEDIA_GPU_EXPORT OmxrGopScheduler {
+ public:
+  // Must not call back into the scheduler synchronously.
+  class Delegate {
+   public:
+    // Decode |bitstream_id| on |lane|.  |starts_gop| is set for the first
+    // buffer of each GOP handed to a lane.
+    virtual void SubmitToLane(int lane,
+                              int32_t bitstream_id,
+                              bool starts_gop) = 0;
+    // The GOP on |lane| got all its input; flush its pictures out.
+    virtual void FlushLane(int lane) = 0;
+    // |picture_buffer_id| is next in stream order.
+    virtual void DeliverPicture(int32_t picture_buffer_id) = 0;
+    // Everything before the Flush() has been delivered.
+    virtual void FlushDone() = 0;
+
+   protected:
+    virtual ~Delegate() {}
+  };
+
+  OmxrGopScheduler(int lanes, Delegate* delegate);
+  ~OmxrGopScheduler();
+
+  // |bitstream_id| is the next buffer of the stream; a |keyframe| one starts
+  // a new GOP.
+  void AddInput(int32_t bitstream_id, bool keyframe);
+  // Ends the GOP in progress; FlushDone() follows once everything is out.
+  void Flush();
+
+  // |lane| decoded |picture_buffer_id|.  Returns false if the picture
+  // belongs to nothing anymore, having been decoded from input dropped by
+  // Reset(); it should go back to the lane.
+  bool OnLanePicture(int lane, int32_t picture_buffer_id);
+  // The flush requested through FlushLane() is done.
+  void OnLaneFlushDone(int lane);
+
+  // Drops every GOP.  Returns the bitstream ids never handed to a lane and
+  // the held back pictures with their lanes.
+  void Reset(std::vector<int32_t>* dropped_inputs,
+             std::vector<std::pair<int, int32_t>>* held_pictures);
+
+  size_t held_pictures() const { return held_pictures_; }
+
+ private:
+  struct Gop {
+    Gop();
+    ~Gop();
+
+    // Input not handed to a lane yet.
+    std::deque<int32_t> inputs;
+    int lane;
+    bool submitted_any;
+    bool ended;
+    bool flush_sent;
+    bool done;
+    std::deque<int32_t> pictures;
+  };
+
+  void EndLastGop();
+  // Hands GOPs to free lanes and their input to the lanes.
+  void Schedule();
+  // Delivers the held pictures of the GOPs now at the front.
+  void DeliverHeldPictures();
+  void MaybeFinishFlush();
+
+  Delegate* const delegate_;
+  // GOPs in stream order; the front one is being output.
+  std::deque<std::unique_ptr<Gop>> gops_;
+  // The GOP each lane decodes, or null.
+  std::vector<Gop*> lane_gops_;
+  bool flushing_;
+  size_t held_pictures_;
+
+  DISALLOW_COPY_AND_ASSIGN(OmxrGopScheduler);
+};
+
+}  // namespace media
+
+#endif  // MEDIA_GPU_OMX_OMXR_GOP_SCHEDULER_H_
@@ -0,0 +1,134 @@
+// Copyright (c) 2019 Renesas Electronics Corporation
+// Use of this source code is governed by a BSD-style license that can be
+// found in the LICENSE file.
+
+#include <algorithm>
+#include <deque>
+#include <map>
+#include <string>
+#include <vector>
+
+#include "media/gpu/omx/omxr_gop_scheduler.h"
+#include "testing/gtest/include/gtest/gtest.h"
+#include "testing/perf/perf_test.h"
+
+namespace media {
+namespace {
+
+const int kGops = 40;
+const int kGopLength = 30;
+// Pictures a lane component needs, plus those the decoder asks for on top
+// to hold back for reordering.
+const int kComponentPictures = 8;
+const int kReorderPictures = 16;
+
+// A model of decoding, not a measurement: a stream of |kGops| GOPs on
+// |lanes| simulated components, each taking one time unit per picture and
+// able to output only into a free picture.  The consumer returns pictures
+// right away.  No component, memory bandwidth or picture copy is involved,
+// so the speedup is an upper bound on what the hardware can give.  Returns
+// the time taken, and the peak number of held back pictures in |peak_held|.
+int Simulate(int lanes, size_t* peak_held) {
+  struct Lane {
+    std::deque<int32_t> inputs;
+    std::vector<int32_t> free_pictures;
+    bool flush_requested = false;
+    bool decoding = false;
+    int done_at = 0;
+  };
+
+  class Simulation : public OmxrGopScheduler::Delegate {
+   public:
+    explicit Simulation(int lanes) : lanes_(lanes) {
+      for (int i = 0; i < lanes; ++i) {
+        for (int j = 0; j < kComponentPictures + kReorderPictures; ++j) {
+          int32_t picture_buffer_id = i * 1000 + j;
+          lanes_[i].free_pictures.push_back(picture_buffer_id);
+          picture_lanes_[picture_buffer_id] = i;
+        }
+      }
+    }
+
+    void SubmitToLane(int lane, int32_t bitstream_id, bool) override {
+      lanes_[lane].inputs.push_back(bitstream_id);
+    }
+    void FlushLane(int lane) override { lanes_[lane].flush_requested = true; }
+    void DeliverPicture(int32_t picture_buffer_id) override {
+      ++delivered_;
+      lanes_[picture_lanes_[picture_buffer_id]].free_pictures.push_back(
+          picture_buffer_id);
+    }
+    void FlushDone() override { flush_done_ = true; }
+
+    std::vector<Lane> lanes_;
+    std::map<int32_t, int> picture_lanes_;
+    int delivered_ = 0;
+    bool flush_done_ = false;
+  };
+
+  Simulation simulation(lanes);
+  OmxrGopScheduler scheduler(lanes, &simulation);
+  for (int i = 0; i < kGops * kGopLength; ++i)
+    scheduler.AddInput(i, i % kGopLength == 0);
+  scheduler.Flush();
+
+  int now = 0;
+  *peak_held = 0;
+  while (!simulation.flush_done_) {
+    bool flushed = false;
+    for (size_t i = 0; i < simulation.lanes_.size(); ++i) {
+      Lane& lane = simulation.lanes_[i];
+      if (lane.decoding)
+        continue;
+      if (!lane.inputs.empty() && !lane.free_pictures.empty()) {
+        lane.inputs.pop_front();
+        lane.decoding = true;
+        lane.done_at = now + 1;
+      } else if (lane.inputs.empty() && lane.flush_requested) {
+        lane.flush_requested = false;
+        scheduler.OnLaneFlushDone(i);
+        flushed = true;
+      }
+    }
+    if (flushed)
+      continue;
+
+    auto next = std::min_element(
+        simulation.lanes_.begin(), simulation.lanes_.end(),
+        [](const Lane& a, const Lane& b) {
+          return a.decoding && (!b.decoding || a.done_at < b.done_at);
+        });
+    if (next == simulation.lanes_.end() || !next->decoding) {
+      ADD_FAILURE() << "Stalled with " << simulation.delivered_
+                    << " pictures delivered";
+      break;
+    }
+    now = next->done_at;
+    next->decoding = false;
+    int32_t picture_buffer_id = next->free_pictures.back();
+    next->free_pictures.pop_back();
+    scheduler.OnLanePicture(next - simulation.lanes_.begin(),
+                            picture_buffer_id);
+    *peak_held = std::max(*peak_held, scheduler.held_pictures());
+  }
+  EXPECT_EQ(kGops * kGopLength, simulation.delivered_);
+  return now;
+}
+
+TEST(OmxrGopSchedulerPerfTest, ModeledScaling) {
+  size_t peak_held;
+  int serial = Simulate(1, &peak_held);
+  for (int lanes = 1; lanes <= 4; ++lanes) {
+    int elapsed = Simulate(lanes, &peak_held);
+    std::string trace = std::to_string(lanes) + "_lanes";
+    perf_test::PrintResult("omxr_gop_scheduler", "_modeled_speedup", trace,
+                           static_cast<double>(serial) / elapsed, "x", true);
+    perf_test::PrintResult("omxr_gop_scheduler", "_modeled_peak_held", trace,
+                           static_cast<double>(peak_held), "pictures", false);
+    EXPECT_LE(peak_held, static_cast<size_t>(lanes * kReorderPictures +
+                                             lanes * kComponentPictures));
+  }
+}
+
+}  // namespace
+}  // namespace media
@@ -0,0 +1,116 @@
+// Copyright (c) 2019 Renesas Electronics Corporation
+// Use of this source code is governed by a BSD-style license that can be
+// found in the LICENSE file.
+
+#include "media/gpu/omx/omxr_gop_scheduler.h"
+
+#include <utility>
+#include <vector>
+
+#include "testing/gtest/include/gtest/gtest.h"
+
+namespace media {
+namespace {
+
+class OmxrGopSchedulerTest : public testing::Test,
+                             public OmxrGopScheduler::Delegate {
+ protected:
+  OmxrGopSchedulerTest() : scheduler_(2, this) {}
+
+  void SubmitToLane(int lane, int32_t bitstream_id, bool starts_gop) override {
+    submitted_.push_back({lane, bitstream_id});
+    if (starts_gop)
+      gop_starts_.push_back(bitstream_id);
+  }
+  void FlushLane(int lane) override { flushed_.push_back(lane); }
+  void DeliverPicture(int32_t picture_buffer_id) override {
+    delivered_.push_back(picture_buffer_id);
+  }
+  void FlushDone() override { ++flush_done_; }
+
+  OmxrGopScheduler scheduler_;
+  std::vector<std::pair<int, int32_t>> submitted_;
+  std::vector<int32_t> gop_starts_;
+  std::vector<int> flushed_;
+  std::vector<int32_t> delivered_;
+  int flush_done_ = 0;
+};
+
+TEST_F(OmxrGopSchedulerTest, SplitsAtKeyframes) {
+  scheduler_.AddInput(0, true);
+  scheduler_.AddInput(1, false);
+  scheduler_.AddInput(2, true);
+  scheduler_.AddInput(3, false);
+
+  std::vector<std::pair<int, int32_t>> expected = {{0, 0}, {0, 1}, {1, 2},
+                                                   {1, 3}};
+  EXPECT_EQ(expected, submitted_);
+  EXPECT_EQ(std::vector<int32_t>({0, 2}), gop_starts_);
+  // Only the first GOP is known to be complete.
+  EXPECT_EQ(std::vector<int>{0}, flushed_);
+}
+
+TEST_F(OmxrGopSchedulerTest, HoldsPicturesOfLaterGops) {
+  scheduler_.AddInput(0, true);
+  scheduler_.AddInput(1, true);
+  scheduler_.Flush();
+  EXPECT_EQ(std::vector<int>({0, 1}), flushed_);
+
+  // Lane 1 is faster, but its pictures come after lane 0's.
+  EXPECT_TRUE(scheduler_.OnLanePicture(1, 110));
+  scheduler_.OnLaneFlushDone(1);
+  EXPECT_TRUE(delivered_.empty());
+  EXPECT_EQ(1u, scheduler_.held_pictures());
+
+  EXPECT_TRUE(scheduler_.OnLanePicture(0, 100));
+  EXPECT_EQ(std::vector<int32_t>{100}, delivered_);
+  EXPECT_EQ(0, flush_done_);
+  scheduler_.OnLaneFlushDone(0);
+  EXPECT_EQ(std::vector<int32_t>({100, 110}), delivered_);
+  EXPECT_EQ(0u, scheduler_.held_pictures());
+  EXPECT_EQ(1, flush_done_);
+}
+
+TEST_F(OmxrGopSchedulerTest, GopsWaitForAFreeLane) {
+  scheduler_.AddInput(0, true);
+  scheduler_.AddInput(1, true);
+  scheduler_.AddInput(2, true);
+  scheduler_.AddInput(3, false);
+  EXPECT_EQ(2u, submitted_.size());
+
+  scheduler_.OnLanePicture(0, 100);
+  scheduler_.OnLaneFlushDone(0);
+  std::vector<std::pair<int, int32_t>> expected = {{0, 0}, {1, 1}, {0, 2},
+                                                   {0, 3}};
+  EXPECT_EQ(expected, submitted_);
+}
+
+TEST_F(OmxrGopSchedulerTest, FlushWithoutInput) {
+  scheduler_.Flush();
+  EXPECT_EQ(1, flush_done_);
+  EXPECT_TRUE(flushed_.empty());
+}
+
+TEST_F(OmxrGopSchedulerTest, ResetReturnsPendingWork) {
+  scheduler_.AddInput(0, true);
+  scheduler_.AddInput(1, true);
+  scheduler_.AddInput(2, true);
+  scheduler_.OnLanePicture(1, 110);
+
+  std::vector<int32_t> dropped;
+  std::vector<std::pair<int, int32_t>> held;
+  scheduler_.Reset(&dropped, &held);
+  EXPECT_EQ(std::vector<int32_t>{2}, dropped);
+  EXPECT_EQ((std::vector<std::pair<int, int32_t>>{{1, 110}}), held);
+
+  // Output of the dropped GOPs still on its way goes back to the lanes.
+  EXPECT_FALSE(scheduler_.OnLanePicture(0, 100));
+  scheduler_.OnLaneFlushDone(0);
+  EXPECT_TRUE(delivered_.empty());
+
+  scheduler_.AddInput(3, true);
+  EXPECT_EQ(std::make_pair(0, 3), submitted_.back());
+}
+
+}  // namespace
+}  // namespace media
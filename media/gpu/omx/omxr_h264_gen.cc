@@ -0,0 +1,131 @@
+// Copyright (c) 2019 Renesas Electronics Corporation
+// Use of this source code is governed by a BSD-style license that can be
+// found in the LICENSE file.
+
+// Writes a synthetic Annex-B H.264 stream (see OmxrH264StreamGenerator), for
+// feeding worst cases to omxr_decode_bench and the decoder input path.
+//
+//   omxr_h264_gen --output=out.h264 [--pictures=300] [--sizes=1920x1080,...]
+//       [--gops-per-size=1] [--gop=30] [--slices=1] [--intra-mbs=MIN[-MAX]]
+//       [--sei=BYTES] [--no-aud] [--sps-on-size-change-only] [--seed=1]
+
+#include <stdio.h>
+
+#include <string>
+#include <vector>
+
+#include "base/command_line.h"
+#include "base/files/file.h"
+#include "base/files/file_path.h"
+#include "base/logging.h"
+#include "base/strings/string_number_conversions.h"
+#include "base/strings/string_split.h"
+#include "media/gpu/omx/omxr_h264_stream_generator.h"
+
+namespace media {
+namespace {
+
+bool GetIntSwitch(const base::CommandLine& command_line,
+                  const char* name,
+                  int* value) {
+  if (!command_line.HasSwitch(name))
+    return true;
+  return base::StringToInt(command_line.GetSwitchValueASCII(name), value) &&
+         *value >= 0;
+}
+
+bool ParseSizes(const std::string& value, std::vector<gfx::Size>* sizes) {
+  sizes->clear();
+  for (const auto& size : base::SplitString(
+           value, ",", base::TRIM_WHITESPACE, base::SPLIT_WANT_NONEMPTY)) {
+    std::vector<std::string> dimensions = base::SplitString(
+        size, "x", base::TRIM_WHITESPACE, base::SPLIT_WANT_ALL);
+    int width, height;
+    if (dimensions.size() != 2 || !base::StringToInt(dimensions[0], &width) ||
+        !base::StringToInt(dimensions[1], &height) || width < 16 ||
+        height < 16) {
+      return false;
+    }
+    sizes->emplace_back(width, height);
+  }
+  return !sizes->empty();
+}
+
+bool ParseRange(const std::string& value, int* min, int* max) {
+  std::vector<std::string> bounds = base::SplitString(
+      value, "-", base::TRIM_WHITESPACE, base::SPLIT_WANT_ALL);
+  if (bounds.empty() || bounds.size() > 2 ||
+      !base::StringToInt(bounds[0], min) ||
+      !base::StringToInt(bounds.back(), max)) {
+    return false;
+  }
+  return *min >= 0 && *min <= *max;
+}
+
+int RunGenerator() {
+  const base::CommandLine& command_line =
+      *base::CommandLine::ForCurrentProcess();
+  base::FilePath output = command_line.GetSwitchValuePath("output");
+
+  OmxrH264StreamGenerator::Config config;
+  int pictures = 300;
+  int seed = 1;
+  config.access_unit_delimiters = !command_line.HasSwitch("no-aud");
+  config.parameter_sets_every_gop =
+      !command_line.HasSwitch("sps-on-size-change-only");
+  if (output.empty() || !GetIntSwitch(command_line, "pictures", &pictures) ||
+      !GetIntSwitch(command_line, "gops-per-size", &config.gops_per_size) ||
+      !GetIntSwitch(command_line, "gop", &config.gop_length) ||
+      !GetIntSwitch(command_line, "slices", &config.slices_per_picture) ||
+      !GetIntSwitch(command_line, "sei", &config.sei_size) ||
+      !GetIntSwitch(command_line, "seed", &seed) ||
+      (command_line.HasSwitch("sizes") &&
+       !ParseSizes(command_line.GetSwitchValueASCII("sizes"),
+                   &config.sizes)) ||
+      (command_line.HasSwitch("intra-mbs") &&
+       !ParseRange(command_line.GetSwitchValueASCII("intra-mbs"),
+                   &config.min_intra_macroblocks,
+                   &config.max_intra_macroblocks)) ||
+      config.gops_per_size < 1 || config.gop_length < 1 ||
+      config.slices_per_picture < 1) {
+    LOG(ERROR) << "Usage: omxr_h264_gen --output=<file> [--pictures=N] "
+                  "[--sizes=WxH,...] [--gops-per-size=N] [--gop=N] "
+                  "[--slices=N] [--intra-mbs=MIN[-MAX]] [--sei=BYTES] "
+                  "[--no-aud] [--sps-on-size-change-only] [--seed=N]";
+    return 1;
+  }
+  config.seed = seed;
+
+  base::File file(output,
+                  base::File::FLAG_CREATE_ALWAYS | base::File::FLAG_WRITE);
+  if (!file.IsValid()) {
+    LOG(ERROR) << "Cannot create " << output.value();
+    return 1;
+  }
+
+  OmxrH264StreamGenerator generator(config);
+  std::vector<uint8_t> access_unit;
+  size_t total = 0;
+  for (int i = 0; i < pictures; ++i) {
+    access_unit.clear();
+    generator.AppendAccessUnit(&access_unit);
+    int size = static_cast<int>(access_unit.size());
+    if (file.WriteAtCurrentPos(
+            reinterpret_cast<const char*>(access_unit.data()), size) != size) {
+      LOG(ERROR) << "Cannot write " << output.value();
+      return 1;
+    }
+    total += access_unit.size();
+  }
+  printf("%s: %d pictures, %zu bytes\n", output.value().c_str(), pictures,
+         total);
+  return 0;
+}
+
+}  // namespace
+}  // namespace media
+
+int main(int argc, char** argv) {
+  base::CommandLine::Init(argc, argv);
+  return media::RunGenerator();
+}
@@ -0,0 +1,310 @@
+// Copyright (c) 2019 Renesas Electronics Corporation
+// Use of this source code is governed by a BSD-style license that can be
+// found in the LICENSE file.
+
+#include "media/gpu/omx/omxr_h264_stream_generator.h"
+
+#include <algorithm>
+
+#include "base/logging.h"
+
+namespace media {
+
+namespace {
+
+enum NalUnitType {
+  kNalSliceNonIdr = 1,
+  kNalSliceIdr = 5,
+  kNalSei = 6,
+  kNalSps = 7,
+  kNalPps = 8,
+  kNalAud = 9,
+};
+
+// CAVLC mb_type of I_PCM in I and P slices, and slice_type for slices that
+// all share a type.
+const uint32_t kMbTypeIPcm = 25;
+const uint32_t kMbTypeIPcmInP = 5 + kMbTypeIPcm;
+const uint32_t kSliceTypeAllP = 5;
+const uint32_t kSliceTypeAllI = 7;
+
+// 16x16 luma and two 8x8 chroma samples.
+const int kPcmBytes = 384;
+const uint8_t kPcmSample = 0x80;
+// frame_num is coded in log2_max_frame_num_minus4 + 4 bits.
+const uint32_t kLog2MaxFrameNumMinus4 = 4;
+const int kMaxFrameNum = 1 << (kLog2MaxFrameNumMinus4 + 4);
+
+const uint8_t kSeiUuid[16] = {0x6f, 0x6d, 0x78, 0x72, 0x2d, 0x67, 0x65, 0x6e,
+                              0x65, 0x72, 0x61, 0x74, 0x6f, 0x72, 0x00, 0x01};
+
+// Writes an RBSP, most significant bit first.
+class BitWriter {
+ public:
+  BitWriter() : bits_in_last_byte_(8) {}
+
+  void PutBits(uint32_t value, int bits) {
+    while (bits-- > 0) {
+      if (bits_in_last_byte_ == 8) {
+        rbsp_.push_back(0);
+        bits_in_last_byte_ = 0;
+      }
+      if ((value >> bits) & 1)
+        rbsp_.back() |= 0x80 >> bits_in_last_byte_;
+      ++bits_in_last_byte_;
+    }
+  }
+
+  void PutUe(uint32_t value) {
+    int leading_zeros = 0;
+    while ((value + 1) >> (leading_zeros + 1))
+      ++leading_zeros;
+    PutBits(0, leading_zeros);
+    PutBits(value + 1, leading_zeros + 1);
+  }
+
+  void PutSe(int32_t value) {
+    PutUe(value > 0 ? 2 * value - 1 : -2 * value);
+  }
+
+  void AlignWithZeros() { bits_in_last_byte_ = 8; }
+
+  void PutBytes(uint8_t byte, size_t count) {
+    DCHECK_EQ(8, bits_in_last_byte_);
+    rbsp_.insert(rbsp_.end(), count, byte);
+  }
+
+  void PutTrailingBits() {
+    PutBits(1, 1);
+    AlignWithZeros();
+  }
+
+  const std::vector<uint8_t>& rbsp() const { return rbsp_; }
+
+ private:
+  std::vector<uint8_t> rbsp_;
+  int bits_in_last_byte_;
+};
+
+// Appends a NAL unit behind a four byte start code, inserting emulation
+// prevention bytes into |rbsp|.
+void AppendNalUnit(int nal_ref_idc,
+                   NalUnitType type,
+                   const BitWriter& rbsp,
+                   std::vector<uint8_t>* stream) {
+  const uint8_t kStartCode[] = {0, 0, 0, 1};
+  stream->insert(stream->end(), kStartCode, kStartCode + sizeof(kStartCode));
+  stream->push_back(static_cast<uint8_t>((nal_ref_idc << 5) | type));
+  int zeros = 0;
+  for (uint8_t byte : rbsp.rbsp()) {
+    if (zeros == 2 && byte <= 3) {
+      stream->push_back(3);
+      zeros = 0;
+    }
+    stream->push_back(byte);
+    zeros = byte ? 0 : zeros + 1;
+  }
+}
+
+int MacroblocksOf(int pixels) {
+  return (pixels + 15) / 16;
+}
+
+}  // namespace
+
+OmxrH264StreamGenerator::Config::Config() : sizes{gfx::Size(320, 240)} {}
+
+OmxrH264StreamGenerator::Config::Config(const Config& other) = default;
+
+OmxrH264StreamGenerator::Config::~Config() = default;
+
+OmxrH264StreamGenerator::OmxrH264StreamGenerator(const Config& config)
+    : config_(config),
+      picture_count_(0),
+      gop_count_(0),
+      size_index_(0),
+      frame_num_(0),
+      idr_pic_id_(0),
+      random_state_(config.seed ? config.seed : 1) {
+  DCHECK(!config_.sizes.empty());
+  DCHECK_GT(config_.gops_per_size, 0);
+  DCHECK_GT(config_.gop_length, 0);
+  DCHECK_GT(config_.slices_per_picture, 0);
+  DCHECK_LE(config_.min_intra_macroblocks, config_.max_intra_macroblocks);
+}
+
+OmxrH264StreamGenerator::~OmxrH264StreamGenerator() = default;
+
+bool OmxrH264StreamGenerator::AppendAccessUnit(std::vector<uint8_t>* stream) {
+  bool idr = picture_count_ % config_.gop_length == 0;
+  bool size_changed = false;
+  if (idr && picture_count_ > 0 &&
+      ++gop_count_ % config_.gops_per_size == 0 && config_.sizes.size() > 1) {
+    size_index_ = (size_index_ + 1) % config_.sizes.size();
+    size_changed = true;
+  }
+
+  if (config_.access_unit_delimiters) {
+    BitWriter aud;
+    // primary_pic_type: I only, or I and P.
+    aud.PutBits(idr ? 0 : 1, 3);
+    aud.PutTrailingBits();
+    AppendNalUnit(0, kNalAud, aud, stream);
+  }
+
+  if (idr &&
+      (picture_count_ == 0 || size_changed ||
+       config_.parameter_sets_every_gop)) {
+    AppendSps(stream);
+    AppendPps(stream);
+  }
+
+  if (config_.sei_size > 0) {
+    BitWriter sei;
+    // user_data_unregistered.
+    sei.PutBits(5, 8);
+    int payload_size = sizeof(kSeiUuid) + config_.sei_size;
+    for (; payload_size >= 255; payload_size -= 255)
+      sei.PutBits(255, 8);
+    sei.PutBits(payload_size, 8);
+    for (uint8_t byte : kSeiUuid)
+      sei.PutBits(byte, 8);
+    sei.PutBytes(0x5a, config_.sei_size);
+    sei.PutTrailingBits();
+    AppendNalUnit(0, kNalSei, sei, stream);
+  }
+
+  const gfx::Size& size = current_size();
+  int macroblocks = MacroblocksOf(size.width()) * MacroblocksOf(size.height());
+  int intra_macroblocks = macroblocks;
+  if (idr) {
+    frame_num_ = 0;
+  } else {
+    frame_num_ = (frame_num_ + 1) % kMaxFrameNum;
+    int range =
+        config_.max_intra_macroblocks - config_.min_intra_macroblocks + 1;
+    intra_macroblocks = std::min(
+        macroblocks,
+        config_.min_intra_macroblocks + static_cast<int>(NextRandom() % range));
+  }
+
+  int slices = std::min(config_.slices_per_picture, macroblocks);
+  for (int i = 0; i < slices; ++i) {
+    int first = macroblocks * i / slices;
+    int end = macroblocks * (i + 1) / slices;
+    int intra = intra_macroblocks * (i + 1) / slices -
+                intra_macroblocks * i / slices;
+    AppendSlice(idr, first, end - first, std::min(intra, end - first), stream);
+  }
+
+  if (idr)
+    ++idr_pic_id_;
+  ++picture_count_;
+  return idr;
+}
+
+void OmxrH264StreamGenerator::AppendSps(std::vector<uint8_t>* stream) {
+  const gfx::Size& size = current_size();
+  int width_in_mbs = MacroblocksOf(size.width());
+  int height_in_mbs = MacroblocksOf(size.height());
+
+  BitWriter sps;
+  // Constrained Baseline.
+  sps.PutBits(66, 8);
+  sps.PutBits(0xc0, 8);
+  sps.PutBits(width_in_mbs * height_in_mbs <= 8192 ? 40 : 51, 8);
+  sps.PutUe(0);  // seq_parameter_set_id
+  sps.PutUe(kLog2MaxFrameNumMinus4);
+  sps.PutUe(2);  // pic_order_cnt_type: output in decoding order.
+  sps.PutUe(1);  // max_num_ref_frames
+  sps.PutBits(0, 1);  // gaps_in_frame_num_value_allowed_flag
+  sps.PutUe(width_in_mbs - 1);
+  sps.PutUe(height_in_mbs - 1);
+  sps.PutBits(1, 1);  // frame_mbs_only_flag
+  sps.PutBits(1, 1);  // direct_8x8_inference_flag
+  // Cropping is in units of two 4:2:0 luma samples.
+  int crop_right = (width_in_mbs * 16 - size.width()) / 2;
+  int crop_bottom = (height_in_mbs * 16 - size.height()) / 2;
+  sps.PutBits(crop_right || crop_bottom, 1);
+  if (crop_right || crop_bottom) {
+    sps.PutUe(0);
+    sps.PutUe(crop_right);
+    sps.PutUe(0);
+    sps.PutUe(crop_bottom);
+  }
+  sps.PutBits(0, 1);  // vui_parameters_present_flag
+  sps.PutTrailingBits();
+  AppendNalUnit(3, kNalSps, sps, stream);
+}
+
+void OmxrH264StreamGenerator::AppendPps(std::vector<uint8_t>* stream) {
+  BitWriter pps;
+  pps.PutUe(0);  // pic_parameter_set_id
+  pps.PutUe(0);  // seq_parameter_set_id
+  pps.PutBits(0, 1);  // entropy_coding_mode_flag: CAVLC.
+  pps.PutBits(0, 1);  // bottom_field_pic_order_in_frame_present_flag
+  pps.PutUe(0);  // num_slice_groups_minus1
+  pps.PutUe(0);  // num_ref_idx_l0_default_active_minus1
+  pps.PutUe(0);  // num_ref_idx_l1_default_active_minus1
+  pps.PutBits(0, 1);  // weighted_pred_flag
+  pps.PutBits(0, 2);  // weighted_bipred_idc
+  pps.PutSe(0);  // pic_init_qp_minus26
+  pps.PutSe(0);  // pic_init_qs_minus26
+  pps.PutSe(0);  // chroma_qp_index_offset
+  pps.PutBits(1, 1);  // deblocking_filter_control_present_flag
+  pps.PutBits(0, 1);  // constrained_intra_pred_flag
+  pps.PutBits(0, 1);  // redundant_pic_cnt_present_flag
+  pps.PutTrailingBits();
+  AppendNalUnit(3, kNalPps, pps, stream);
+}
+
+void OmxrH264StreamGenerator::AppendSlice(bool idr,
+                                          int first_macroblock,
+                                          int macroblocks,
+                                          int intra_macroblocks,
+                                          std::vector<uint8_t>* stream) {
+  BitWriter slice;
+  slice.PutUe(first_macroblock);
+  slice.PutUe(idr ? kSliceTypeAllI : kSliceTypeAllP);
+  slice.PutUe(0);  // pic_parameter_set_id
+  slice.PutBits(frame_num_, kLog2MaxFrameNumMinus4 + 4);
+  if (idr) {
+    slice.PutUe(idr_pic_id_ % 2);
+  } else {
+    slice.PutBits(0, 1);  // num_ref_idx_active_override_flag
+    slice.PutBits(0, 1);  // ref_pic_list_modification_flag_l0
+  }
+  // dec_ref_pic_marking(): sliding window.
+  if (idr) {
+    slice.PutBits(0, 1);  // no_output_of_prior_pics_flag
+    slice.PutBits(0, 1);  // long_term_reference_flag
+  } else {
+    slice.PutBits(0, 1);  // adaptive_ref_pic_marking_mode_flag
+  }
+  slice.PutSe(0);  // slice_qp_delta
+  slice.PutUe(1);  // disable_deblocking_filter_idc
+
+  // The I_PCM macroblocks come first; the rest of a P slice is skipped.
+  for (int i = 0; i < intra_macroblocks; ++i) {
+    if (!idr)
+      slice.PutUe(0);  // mb_skip_run
+    slice.PutUe(idr ? kMbTypeIPcm : kMbTypeIPcmInP);
+    slice.AlignWithZeros();
+    slice.PutBytes(kPcmSample, kPcmBytes);
+  }
+  if (intra_macroblocks < macroblocks)
+    slice.PutUe(macroblocks - intra_macroblocks);  // mb_skip_run
+  slice.PutTrailingBits();
+  AppendNalUnit(idr ? 3 : 2, idr ? kNalSliceIdr : kNalSliceNonIdr, slice,
+                stream);
+}
+
+uint32_t OmxrH264StreamGenerator::NextRandom() {
+  // xorshift32; reproducible across platforms for a given seed.
+  random_state_ ^= random_state_ << 13;
+  random_state_ ^= random_state_ >> 17;
+  random_state_ ^= random_state_ << 5;
+  return random_state_;
+}
+
+}  // namespace media
@@ -0,0 +1,82 @@
+// Copyright (c) 2019 Renesas Electronics Corporation
+// Use of this source code is governed by a BSD-style license that can be
+// found in the LICENSE file.
+
+#ifndef MEDIA_GPU_OMX_OMXR_H264_STREAM_GENERATOR_H_
+#define MEDIA_GPU_OMX_OMXR_H264_STREAM_GENERATOR_H_
+
+#include <stddef.h>
+#include <stdint.h>
+
+#include <vector>
+
+#include "base/macros.h"
+#include "ui/gfx/geometry/size.h"
+
+namespace media {
+
+// Generates valid Annex-B H.264 (Constrained Baseline, CAVLC) of any shape,
+// for stressing the input path with cases the test clips do not cover: many
+// slices per picture, huge IDRs, tiny P pictures, frequent SPS changes and
+// streams without delimiters.
+//
+// Picture sizes are controlled through the macroblocks coded as I_PCM, which
+// take 384 bytes each; the remaining macroblocks of P pictures are skipped.
+// IDR pictures are all I_PCM.  The decoded pictures are flat grey.
+class OmxrH264StreamGenerator {
+ public:
+  struct Config {
+    Config();
+    Config(const Config& other);
+    ~Config();
+
+    // Picture sizes, switched to in turn every |gops_per_size| GOPs, each
+    // switch bringing a new SPS.
+    std::vector<gfx::Size> sizes;
+    int gops_per_size = 1;
+    int gop_length = 30;
+    int slices_per_picture = 1;
+    // I_PCM macroblocks of each P picture, drawn uniformly from this range
+    // and capped by the picture size.
+    int min_intra_macroblocks = 0;
+    int max_intra_macroblocks = 0;
+    bool access_unit_delimiters = true;
+    // Repeat the SPS and PPS before every IDR, not only on size changes.
+    bool parameter_sets_every_gop = true;
+    // Bytes of user data in an SEI message before every picture; none if 0.
+    int sei_size = 0;
+    uint32_t seed = 1;
+  };
+
+  explicit OmxrH264StreamGenerator(const Config& config);
+  ~OmxrH264StreamGenerator();
+
+  // Appends the next access unit to |stream|.  Returns true if it is an IDR.
+  bool AppendAccessUnit(std::vector<uint8_t>* stream);
+
+  const gfx::Size& current_size() const { return config_.sizes[size_index_]; }
+
+ private:
+  void AppendSps(std::vector<uint8_t>* stream);
+  void AppendPps(std::vector<uint8_t>* stream);
+  void AppendSlice(bool idr,
+                   int first_macroblock,
+                   int macroblocks,
+                   int intra_macroblocks,
+                   std::vector<uint8_t>* stream);
+  uint32_t NextRandom();
+
+  const Config config_;
+  int picture_count_;
+  int gop_count_;
+  size_t size_index_;
+  int frame_num_;
+  int idr_pic_id_;
+  uint32_t random_state_;
+
+  DISALLOW_COPY_AND_ASSIGN(OmxrH264StreamGenerator);
+};
+
+}  // namespace media
+
+#endif  // MEDIA_GPU_OMX_OMXR_H264_STREAM_GENERATOR_H_
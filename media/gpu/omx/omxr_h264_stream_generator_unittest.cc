@@ -0,0 +1,149 @@
+// Copyright (c) 2019 Renesas Electronics Corporation
+// Use of this source code is governed by a BSD-style license that can be
+// found in the LICENSE file.
+
+#include "media/gpu/omx/omxr_h264_stream_generator.h"
+
+#include <memory>
+#include <vector>
+
+#include "media/gpu/omx/omxr_bitstream_framer.h"
+#include "testing/gtest/include/gtest/gtest.h"
+
+namespace media {
+namespace {
+
+struct Generated {
+  std::vector<uint8_t> stream;
+  std::vector<size_t> access_unit_offsets;
+  std::vector<bool> idr;
+};
+
+Generated Generate(const OmxrH264StreamGenerator::Config& config,
+                   int pictures) {
+  OmxrH264StreamGenerator generator(config);
+  Generated generated;
+  for (int i = 0; i < pictures; ++i) {
+    generated.access_unit_offsets.push_back(generated.stream.size());
+    generated.idr.push_back(generator.AppendAccessUnit(&generated.stream));
+  }
+  return generated;
+}
+
+// Checks that the framer finds the access units where they were generated.
+void ExpectFramedAsGenerated(const Generated& generated) {
+  auto framer = OmxrBitstreamFramer::Create(kCodecH264);
+  std::vector<OmxrBitstreamFramer::Span> spans;
+  ASSERT_TRUE(framer->Split(generated.stream.data(), generated.stream.size(),
+                            &spans, nullptr));
+  std::vector<size_t> offsets = {0};
+  std::vector<bool> keyframes = {spans[0].keyframe};
+  for (const auto& span : spans) {
+    if (span.starts_access_unit) {
+      offsets.push_back(span.offset);
+      keyframes.push_back(span.keyframe);
+    }
+  }
+  EXPECT_EQ(generated.access_unit_offsets, offsets);
+  EXPECT_EQ(generated.idr, keyframes);
+}
+
+// Returns whether the NAL unit payloads are free of start code emulation.
+bool HasEmulationPrevention(const std::vector<uint8_t>& stream) {
+  for (size_t i = 0; i + 3 < stream.size(); ++i) {
+    if (stream[i] || stream[i + 1])
+      continue;
+    // Only start codes may have two zero bytes followed by one of 0 to 3.
+    if (stream[i + 2] == 1 || (stream[i + 2] == 0 && stream[i + 3] == 1)) {
+      i += 2;
+      continue;
+    }
+    if (stream[i + 2] <= 2)
+      return false;
+  }
+  return true;
+}
+
+TEST(OmxrH264StreamGeneratorTest, FramedAsGenerated) {
+  OmxrH264StreamGenerator::Config config;
+  config.sizes = {gfx::Size(64, 48)};
+  config.gop_length = 5;
+  config.slices_per_picture = 4;
+  config.min_intra_macroblocks = 1;
+  config.max_intra_macroblocks = 6;
+  config.sei_size = 300;
+  Generated generated = Generate(config, 12);
+  ExpectFramedAsGenerated(generated);
+  EXPECT_TRUE(HasEmulationPrevention(generated.stream));
+}
+
+TEST(OmxrH264StreamGeneratorTest, FramedWithoutDelimiters) {
+  OmxrH264StreamGenerator::Config config;
+  config.sizes = {gfx::Size(48, 32)};
+  config.gop_length = 3;
+  config.slices_per_picture = 2;
+  config.access_unit_delimiters = false;
+  config.parameter_sets_every_gop = false;
+  ExpectFramedAsGenerated(Generate(config, 7));
+}
+
+TEST(OmxrH264StreamGeneratorTest, SizeChangesBringNewParameterSets) {
+  OmxrH264StreamGenerator::Config config;
+  config.sizes = {gfx::Size(64, 48), gfx::Size(30, 18)};
+  config.gop_length = 2;
+  config.parameter_sets_every_gop = false;
+  OmxrH264StreamGenerator generator(config);
+
+  auto framer = OmxrBitstreamFramer::Create(kCodecH264);
+  std::vector<std::vector<uint8_t>> sps;
+  for (int i = 0; i < 6; ++i) {
+    std::vector<uint8_t> access_unit;
+    generator.AppendAccessUnit(&access_unit);
+    EXPECT_EQ(config.sizes[i / 2 % 2], generator.current_size());
+
+    std::vector<OmxrBitstreamFramer::Span> spans;
+    std::vector<OmxrBitstreamFramer::ParameterSet> parameter_sets;
+    ASSERT_TRUE(framer->Split(access_unit.data(), access_unit.size(), &spans,
+                              &parameter_sets));
+    EXPECT_EQ(i % 2 ? 0u : 2u, parameter_sets.size());
+    for (const auto& parameter_set : parameter_sets) {
+      if (parameter_set.type == OmxrBitstreamFramer::SPS) {
+        sps.emplace_back(parameter_set.data,
+                         parameter_set.data + parameter_set.size);
+      }
+    }
+  }
+  ASSERT_EQ(3u, sps.size());
+  EXPECT_NE(sps[0], sps[1]);
+  EXPECT_EQ(sps[0], sps[2]);
+}
+
+TEST(OmxrH264StreamGeneratorTest, IntraMacroblocksSetPictureSize) {
+  OmxrH264StreamGenerator::Config config;
+  config.sizes = {gfx::Size(320, 240)};
+  config.access_unit_delimiters = false;
+  config.min_intra_macroblocks = 10;
+  config.max_intra_macroblocks = 10;
+  OmxrH264StreamGenerator generator(config);
+
+  std::vector<uint8_t> idr;
+  EXPECT_TRUE(generator.AppendAccessUnit(&idr));
+  EXPECT_GT(idr.size(), 300u * 384);
+
+  std::vector<uint8_t> p;
+  EXPECT_FALSE(generator.AppendAccessUnit(&p));
+  EXPECT_GT(p.size(), 10u * 384);
+  EXPECT_LT(p.size(), 11u * 384);
+
+  OmxrH264StreamGenerator::Config skipped = config;
+  skipped.min_intra_macroblocks = skipped.max_intra_macroblocks = 0;
+  OmxrH264StreamGenerator skipping(skipped);
+  idr.clear();
+  skipping.AppendAccessUnit(&idr);
+  p.clear();
+  skipping.AppendAccessUnit(&p);
+  EXPECT_LT(p.size(), 16u);
+}
+
+}  // namespace
+}  // namespace media
@@ -0,0 +1,382 @@
+// Copyright (c) 2019 Renesas Electronics Corporation
+// Use of this source code is governed by a BSD-style license that can be
+// found in the LICENSE file.
+
+#include "media/gpu/omx/omxr_hybrid_video_decode_accelerator.h"
+
+#include <algorithm>
+
+#include "base/bind.h"
+#include "base/logging.h"
+#include "base/no_destructor.h"
+#include "base/optional.h"
+#include "base/threading/thread_task_runner_handle.h"
+#include "media/gpu/omx/omxr_video_decode_accelerator.h"
+#include "media/video/h264_parser.h"
+
+namespace media {
+
+namespace {
+
+const char* PathName(OmxrHybridVideoDecodeAccelerator::Path path) {
+  return path == OmxrHybridVideoDecodeAccelerator::HARDWARE ? "hardware"
+                                                            : "software";
+}
+
+OmxrHybridVideoDecodeAccelerator::Path OtherPath(
+    OmxrHybridVideoDecodeAccelerator::Path path) {
+  return path == OmxrHybridVideoDecodeAccelerator::HARDWARE
+             ? OmxrHybridVideoDecodeAccelerator::SOFTWARE
+             : OmxrHybridVideoDecodeAccelerator::HARDWARE;
+}
+
+OmxrHybridVideoDecodeAccelerator::DecoderFactory* SoftwareFactory() {
+  static base::NoDestructor<OmxrHybridVideoDecodeAccelerator::DecoderFactory>
+      software_factory;
+  return software_factory.get();
+}
+
+}  // namespace
+
+// static
+std::unique_ptr<OmxrHybridVideoDecodeAccelerator>
+OmxrHybridVideoDecodeAccelerator::Create(
+    EGLDisplay egl_display,
+    const base::Callback<bool(void)>& make_context_current,
+    const DecoderFactory& software_factory) {
+  return std::make_unique<OmxrHybridVideoDecodeAccelerator>(
+      OmxrDecoderGroup::HardwareFactory(egl_display, make_context_current),
+      OmxrVideoDecodeAccelerator::GetSupportedProfiles(), software_factory);
+}
+
+// static
+void OmxrHybridVideoDecodeAccelerator::SetSoftwareFactory(
+    const DecoderFactory& software_factory) {
+  *SoftwareFactory() = software_factory;
+}
+
+// static
+const OmxrHybridVideoDecodeAccelerator::DecoderFactory&
+OmxrHybridVideoDecodeAccelerator::GetSoftwareFactory() {
+  return *SoftwareFactory();
+}
+
+OmxrHybridVideoDecodeAccelerator::OmxrHybridVideoDecodeAccelerator(
+    const DecoderFactory& hardware_factory,
+    const SupportedProfiles& hardware_profiles,
+    const DecoderFactory& software_factory)
+    : hardware_factory_(hardware_factory),
+      hardware_profiles_(hardware_profiles),
+      software_factory_(software_factory),
+      decoders_(this),
+      error_notified_(false),
+      active_(HARDWARE),
+      sps_path_(HARDWARE),
+      flushing_{false, false},
+      client_flush_pending_(false),
+      client_flush_sent_(false) {}
+
+OmxrHybridVideoDecodeAccelerator::~OmxrHybridVideoDecodeAccelerator() {
+  DCHECK_CALLED_ON_VALID_THREAD(thread_checker_);
+}
+
+bool OmxrHybridVideoDecodeAccelerator::Initialize(const Config& config,
+                                                  Client* client) {
+  DCHECK_CALLED_ON_VALID_THREAD(thread_checker_);
+  if (config.profile < H264PROFILE_MIN || config.profile > H264PROFILE_MAX) {
+    DLOG(ERROR) << "Hybrid decoding needs H.264, got "
+                << GetProfileName(config.profile);
+    return false;
+  }
+
+  // The hardware path starts on a profile it has, whatever the stream
+  // starts with; the component is the same for all of them.
+  Config hardware_config = config;
+  if (!HardwareSupports(config.profile, gfx::Size())) {
+    auto it = std::find_if(hardware_profiles_.begin(), hardware_profiles_.end(),
+                           [](const SupportedProfile& supported) {
+                             return supported.profile >= H264PROFILE_MIN &&
+                                    supported.profile <= H264PROFILE_MAX;
+                           });
+    if (it == hardware_profiles_.end()) {
+      DLOG(ERROR) << "No hardware H.264 decoding";
+      return false;
+    }
+    hardware_config.profile = it->profile;
+  }
+
+  client_ptr_factory_.reset(new base::WeakPtrFactory<Client>(client));
+  client_ = client_ptr_factory_->GetWeakPtr();
+
+  if (!decoders_.Add(hardware_factory_, hardware_config) ||
+      !decoders_.Add(software_factory_, config)) {
+    DLOG(ERROR) << "Failed to initialize the "
+                << PathName(static_cast<Path>(decoders_.size() - 1))
+                << " decoder";
+    return false;
+  }
+
+  active_ = sps_path_ =
+      HardwareSupports(config.profile, gfx::Size()) ? HARDWARE : SOFTWARE;
+  active_since_ = base::TimeTicks::Now();
+  VLOG(1) << "Hybrid decoding, starting on " << PathName(active_);
+  return true;
+}
+
+void OmxrHybridVideoDecodeAccelerator::Decode(
+    const BitstreamBuffer& bitstream_buffer) {
+  DCHECK_CALLED_ON_VALID_THREAD(thread_checker_);
+  OmxrDecoderGroup::Input parsed(bitstream_buffer);
+  if (!decoders_.Parse(&parsed))
+    return;
+  if (parsed.has_sps)
+    sps_path_ = PathForSps(decoders_.sps());
+
+  Input input(sps_path_, parsed);
+  if (!waiting_inputs_.empty() || !Route(input))
+    waiting_inputs_.push_back(std::move(input));
+}
+
+void OmxrHybridVideoDecodeAccelerator::AssignPictureBuffers(
+    const std::vector<PictureBuffer>& buffers) {
+  DCHECK_CALLED_ON_VALID_THREAD(thread_checker_);
+  if (!decoders_.AssignPictureBuffers(buffers)) {
+    DLOG(ERROR) << "No decoder asked for picture buffers";
+    OnError(INVALID_ARGUMENT);
+  }
+}
+
+void OmxrHybridVideoDecodeAccelerator::ReusePictureBuffer(
+    int32_t picture_buffer_id) {
+  DCHECK_CALLED_ON_VALID_THREAD(thread_checker_);
+  decoders_.ReusePictureBuffer(picture_buffer_id);
+}
+
+void OmxrHybridVideoDecodeAccelerator::Flush() {
+  DCHECK_CALLED_ON_VALID_THREAD(thread_checker_);
+  client_flush_pending_ = true;
+  client_flush_sent_ = false;
+  if (!waiting_inputs_.empty())
+    return;
+  client_flush_sent_ = true;
+  FlushPath(active_);
+}
+
+void OmxrHybridVideoDecodeAccelerator::Reset() {
+  DCHECK_CALLED_ON_VALID_THREAD(thread_checker_);
+  for (Input& input : waiting_inputs_) {
+    input.second.buffer.handle().Close();
+    base::ThreadTaskRunnerHandle::Get()->PostTask(
+        FROM_HERE, base::Bind(&Client::NotifyEndOfBitstreamBuffer, client_,
+                              input.second.buffer.id()));
+  }
+  waiting_inputs_.clear();
+  for (const auto& held : held_pictures_)
+    vda(held.first)->ReusePictureBuffer(held.second.picture_buffer_id());
+  held_pictures_.clear();
+  client_flush_pending_ = false;
+  decoders_.Reset();
+}
+
+void OmxrHybridVideoDecodeAccelerator::Destroy() {
+  DCHECK_CALLED_ON_VALID_THREAD(thread_checker_);
+  Stats stats = GetStats();
+  VLOG(1) << "Hybrid decoding: hardware "
+          << stats.time[HARDWARE].InSecondsF() << " s, "
+          << stats.pictures[HARDWARE] << " pictures; software "
+          << stats.time[SOFTWARE].InSecondsF() << " s, "
+          << stats.pictures[SOFTWARE] << " pictures; " << stats.switches
+          << " switches";
+  client_ptr_factory_.reset();
+  decoders_.DestroyDecoders();
+  for (Input& input : waiting_inputs_)
+    input.second.buffer.handle().Close();
+  delete this;
+}
+
+OmxrHybridVideoDecodeAccelerator::Stats
+OmxrHybridVideoDecodeAccelerator::GetStats() const {
+  Stats stats = stats_;
+  if (!active_since_.is_null())
+    stats.time[active_] += base::TimeTicks::Now() - active_since_;
+  return stats;
+}
+
+OmxrHybridVideoDecodeAccelerator::Path
+OmxrHybridVideoDecodeAccelerator::PathForSps(
+    const std::vector<uint8_t>& sps) const {
+  H264Parser parser;
+  parser.SetStream(sps.data(), sps.size());
+  H264NALU nalu;
+  int sps_id;
+  if (parser.AdvanceToNextNALU(&nalu) != H264Parser::kOk ||
+      parser.ParseSPS(&sps_id) != H264Parser::kOk) {
+    // Whatever the hardware makes of it, software has the better chance.
+    DVLOG(1) << "Unparsable SPS";
+    return SOFTWARE;
+  }
+  const H264SPS* parsed = parser.GetSPS(sps_id);
+  base::Optional<gfx::Rect> visible_rect = parsed->GetVisibleRect();
+  if (!visible_rect)
+    return SOFTWARE;
+  return HardwareSupports(
+             H264Parser::ProfileIDCToVideoCodecProfile(parsed->profile_idc),
+             visible_rect->size())
+             ? HARDWARE
+             : SOFTWARE;
+}
+
+bool OmxrHybridVideoDecodeAccelerator::HardwareSupports(
+    VideoCodecProfile profile,
+    const gfx::Size& visible_size) const {
+  for (const SupportedProfile& supported : hardware_profiles_) {
+    if (supported.profile != profile)
+      continue;
+    // The limits are on the visible size: 1080p is coded as 1920x1088.
+    if (visible_size.IsEmpty() ||
+        (visible_size.width() >= supported.min_resolution.width() &&
+         visible_size.height() >= supported.min_resolution.height() &&
+         visible_size.width() <= supported.max_resolution.width() &&
+         visible_size.height() <= supported.max_resolution.height())) {
+      return true;
+    }
+  }
+  return false;
+}
+
+bool OmxrHybridVideoDecodeAccelerator::Route(const Input& input) {
+  Path path = input.first;
+  bool switching = input.second.keyframe && path != active_;
+  if (switching) {
+    // The path left last time still holds pictures that go before ours.
+    if (flushing_[path])
+      return false;
+    SwitchTo(path);
+  }
+  decoders_.Decode(active_, input.second, switching);
+  return true;
+}
+
+void OmxrHybridVideoDecodeAccelerator::SwitchTo(Path path) {
+  base::TimeTicks now = base::TimeTicks::Now();
+  stats_.time[active_] += now - active_since_;
+  active_since_ = now;
+  ++stats_.switches;
+  VLOG(1) << "Switching from " << PathName(active_) << " to "
+          << PathName(path) << " decoding";
+
+  // Its remaining pictures go out before those of |path|.
+  FlushPath(active_);
+  active_ = path;
+}
+
+void OmxrHybridVideoDecodeAccelerator::FlushPath(Path path) {
+  DCHECK(!flushing_[path]);
+  flushing_[path] = true;
+  vda(path)->Flush();
+}
+
+void OmxrHybridVideoDecodeAccelerator::MaybeNotifyFlushDone() {
+  if (!client_flush_pending_ || !client_flush_sent_ || flushing_[HARDWARE] ||
+      flushing_[SOFTWARE]) {
+    return;
+  }
+  client_flush_pending_ = false;
+  if (client_)
+    client_->NotifyFlushDone();
+}
+
+void OmxrHybridVideoDecodeAccelerator::ReleaseHeldPictures() {
+  while (!held_pictures_.empty()) {
+    Picture picture = held_pictures_.front().second;
+    held_pictures_.pop_front();
+    if (client_)
+      client_->PictureReady(picture);
+  }
+}
+
+void OmxrHybridVideoDecodeAccelerator::OnInitializationComplete(
+    bool success) {
+  if (client_)
+    client_->NotifyInitializationComplete(success);
+}
+
+void OmxrHybridVideoDecodeAccelerator::OnProvidePictureBuffers(
+    int path,
+    uint32_t requested_num_of_buffers,
+    VideoPixelFormat format,
+    uint32_t textures_per_buffer,
+    const gfx::Size& dimensions,
+    uint32_t texture_target) {
+  if (client_) {
+    client_->ProvidePictureBuffers(requested_num_of_buffers, format,
+                                   textures_per_buffer, dimensions,
+                                   texture_target);
+  }
+}
+
+void OmxrHybridVideoDecodeAccelerator::OnDismissPictureBuffer(
+    int32_t picture_buffer_id) {
+  held_pictures_.erase(
+      std::remove_if(held_pictures_.begin(), held_pictures_.end(),
+                     [picture_buffer_id](const std::pair<Path, Picture>& held) {
+                       return held.second.picture_buffer_id() ==
+                              picture_buffer_id;
+                     }),
+      held_pictures_.end());
+  if (client_)
+    client_->DismissPictureBuffer(picture_buffer_id);
+}
+
+void OmxrHybridVideoDecodeAccelerator::OnPictureReady(int index,
+                                                      const Picture& picture) {
+  Path path = static_cast<Path>(index);
+  ++stats_.pictures[path];
+  if (path == active_ && flushing_[OtherPath(path)]) {
+    held_pictures_.emplace_back(path, picture);
+    return;
+  }
+  if (client_)
+    client_->PictureReady(picture);
+}
+
+void OmxrHybridVideoDecodeAccelerator::OnEndOfBitstreamBuffer(
+    int32_t bitstream_buffer_id) {
+  if (client_)
+    client_->NotifyEndOfBitstreamBuffer(bitstream_buffer_id);
+}
+
+void OmxrHybridVideoDecodeAccelerator::OnFlushDone(int index) {
+  Path path = static_cast<Path>(index);
+  // A flush cut short by Reset().
+  if (!flushing_[path])
+    return;
+  flushing_[path] = false;
+  if (path != active_)
+    ReleaseHeldPictures();
+
+  while (!waiting_inputs_.empty() && Route(waiting_inputs_.front()))
+    waiting_inputs_.pop_front();
+  if (client_flush_pending_ && !client_flush_sent_ &&
+      waiting_inputs_.empty()) {
+    client_flush_sent_ = true;
+    FlushPath(active_);
+  }
+  MaybeNotifyFlushDone();
+}
+
+void OmxrHybridVideoDecodeAccelerator::OnResetDone() {
+  flushing_[HARDWARE] = flushing_[SOFTWARE] = false;
+  if (client_)
+    client_->NotifyResetDone();
+}
+
+void OmxrHybridVideoDecodeAccelerator::OnError(Error error) {
+  if (error_notified_)
+    return;
+  error_notified_ = true;
+  if (client_)
+    client_->NotifyError(error);
+}
+
+}  // namespace media
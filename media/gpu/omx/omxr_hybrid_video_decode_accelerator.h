@@ -0,0 +1,159 @@
+// Copyright (c) 2019 Renesas Electronics Corporation
+// Use of this source code is governed by a BSD-style license that can be
+// found in the LICENSE file.
+
+#ifndef MEDIA_GPU_OMX_OMXR_HYBRID_VIDEO_DECODE_ACCELERATOR_H_
+#define MEDIA_GPU_OMX_OMXR_HYBRID_VIDEO_DECODE_ACCELERATOR_H_
+
+#include <stddef.h>
+#include <stdint.h>
+
+#include <deque>
+#include <memory>
+#include <utility>
+#include <vector>
+
+#include "base/callback.h"
+#include "base/macros.h"
+#include "base/memory/weak_ptr.h"
+#include "base/threading/thread_checker.h"
+#include "base/time/time.h"
+#include "media/gpu/media_gpu_export.h"
+#include "media/gpu/omx/omxr_decoder_group.h"
+#include "media/video/picture.h"
+#include "media/video/video_decode_accelerator.h"
+#include "ui/gl/gl_bindings.h"
+
+namespace media {
+
+// H.264 decoding that survives segments the hardware cannot take, such as a
+// 4K advertisement in a 1080p channel or a profile the decode IP lacks.  GOPs
+// whose SPS is beyond the hardware's supported profiles go to a software
+// decoder behind the same VideoDecodeAccelerator interface; the next IDR the
+// hardware can take goes back to OmxrVideoDecodeAccelerator.
+//
+// Both decoders are initialized up front and kept for the whole session, so
+// a switch costs no component creation.  At a switch the decoder left is
+// flushed, and the pictures of the other one are held back until it is done,
+// keeping the output in stream order.  Annex-B input only.
+class MEDIA_GPU_EXPORT OmxrHybridVideoDecodeAccelerator
+    : public VideoDecodeAccelerator,
+      public OmxrDecoderGroup::Delegate {
+ public:
+  using DecoderFactory = OmxrDecoderGroup::DecoderFactory;
+
+  // Decoder indices in the group.
+  enum Path {
+    HARDWARE,
+    SOFTWARE,
+    PATH_MAX,
+  };
+
+  struct Stats {
+    // Time each path was the one taking input, and pictures it delivered.
+    base::TimeDelta time[PATH_MAX];
+    int64_t pictures[PATH_MAX] = {};
+    int switches = 0;
+  };
+
+  // The hardware path is an OmxrVideoDecodeAccelerator.
+  static std::unique_ptr<OmxrHybridVideoDecodeAccelerator> Create(
+      EGLDisplay egl_display,
+      const base::Callback<bool(void)>& make_context_current,
+      const DecoderFactory& software_factory);
+
+  // The software decoders GpuVideoDecodeAcceleratorFactory pairs the
+  // hardware with; the GPU process has none of its own.  Set by the embedder
+  // at startup, on the GPU main thread.  Null until then.
+  static void SetSoftwareFactory(const DecoderFactory& software_factory);
+  static const DecoderFactory& GetSoftwareFactory();
+
+  OmxrHybridVideoDecodeAccelerator(
+      const DecoderFactory& hardware_factory,
+      const SupportedProfiles& hardware_profiles,
+      const DecoderFactory& software_factory);
+  ~OmxrHybridVideoDecodeAccelerator() override;
+
+  // media::VideoDecodeAccelerator implementation.
+  bool Initialize(const Config& config, Client* client) override;
+  void Decode(const BitstreamBuffer& bitstream_buffer) override;
+  void AssignPictureBuffers(const std::vector<PictureBuffer>& buffers) override;
+  void ReusePictureBuffer(int32_t picture_buffer_id) override;
+  void Flush() override;
+  void Reset() override;
+  void Destroy() override;
+
+  // Includes the time since the last switch.
+  Stats GetStats() const;
+
+ private:
+  // Input and the path its GOP goes to.
+  using Input = std::pair<Path, OmxrDecoderGroup::Input>;
+
+  // Returns the path that can decode pictures using |sps|, with its start
+  // code.
+  Path PathForSps(const std::vector<uint8_t>& sps) const;
+  bool HardwareSupports(VideoCodecProfile profile,
+                        const gfx::Size& visible_size) const;
+
+  // Hands |input| to its path, switching paths at keyframes.  Returns false
+  // if the path to switch to is still draining; |input| is then left alone.
+  bool Route(const Input& input);
+  void SwitchTo(Path path);
+  void FlushPath(Path path);
+  void MaybeNotifyFlushDone();
+  void ReleaseHeldPictures();
+
+  // OmxrDecoderGroup::Delegate implementation.  The index of a decoder is
+  // its Path.
+  void OnInitializationComplete(bool success) override;
+  void OnProvidePictureBuffers(int path,
+                               uint32_t requested_num_of_buffers,
+                               VideoPixelFormat format,
+                               uint32_t textures_per_buffer,
+                               const gfx::Size& dimensions,
+                               uint32_t texture_target) override;
+  void OnDismissPictureBuffer(int32_t picture_buffer_id) override;
+  void OnPictureReady(int path, const Picture& picture) override;
+  void OnEndOfBitstreamBuffer(int32_t bitstream_buffer_id) override;
+  void OnFlushDone(int path) override;
+  void OnResetDone() override;
+  void OnError(Error error) override;
+
+  VideoDecodeAccelerator* vda(Path path) { return decoders_.decoder(path); }
+
+  const DecoderFactory hardware_factory_;
+  const SupportedProfiles hardware_profiles_;
+  const DecoderFactory software_factory_;
+  OmxrDecoderGroup decoders_;
+
+  std::unique_ptr<base::WeakPtrFactory<Client>> client_ptr_factory_;
+  base::WeakPtr<Client> client_;
+  bool error_notified_;
+
+  // The path taking input, since when, and the one new GOPs go to as of the
+  // latest SPS.
+  Path active_;
+  base::TimeTicks active_since_;
+  Path sps_path_;
+  Stats stats_;
+
+  // A Flush() is outstanding on the path.
+  bool flushing_[PATH_MAX];
+  // The client's Flush() waits for |waiting_inputs_| before reaching
+  // |active_|.
+  bool client_flush_pending_;
+  bool client_flush_sent_;
+  // Input held until the path it switches to has drained.
+  std::deque<Input> waiting_inputs_;
+  // Pictures of |active_| held until the other path has drained.
+  std::deque<std::pair<Path, Picture>> held_pictures_;
+
+  THREAD_CHECKER(thread_checker_);
+
+  DISALLOW_COPY_AND_ASSIGN(OmxrHybridVideoDecodeAccelerator);
+};
+
+}  // namespace media
+
+#endif  // MEDIA_GPU_OMX_OMXR_HYBRID_VIDEO_DECODE_ACCELERATOR_H_
@@ -0,0 +1,171 @@
+// Copyright (c) 2019 Renesas Electronics Corporation
+// Use of this source code is governed by a BSD-style license that can be
+// found in the LICENSE file.
+
+#include "media/gpu/omx/omxr_hybrid_video_decode_accelerator.h"
+
+#include <string.h>
+
+#include <memory>
+#include <vector>
+
+#include "base/bind.h"
+#include "base/memory/shared_memory.h"
+#include "base/test/scoped_task_environment.h"
+#include "media/gpu/omx/omxr_h264_stream_generator.h"
+#include "media/gpu/omx/omxr_vda_test_util.h"
+#include "testing/gtest/include/gtest/gtest.h"
+
+namespace media {
+namespace {
+
+// Hardware that takes Constrained Baseline up to VGA, keeping the test
+// streams small.
+VideoDecodeAccelerator::SupportedProfiles HardwareProfiles() {
+  VideoDecodeAccelerator::SupportedProfile profile;
+  profile.profile = H264PROFILE_BASELINE;
+  profile.min_resolution = gfx::Size(48, 48);
+  profile.max_resolution = gfx::Size(640, 480);
+  return VideoDecodeAccelerator::SupportedProfiles(1, profile);
+}
+
+std::unique_ptr<VideoDecodeAccelerator> CreateFakeDecoder(
+    OmxrFakeVideoDecodeAccelerator** decoder) {
+  *decoder = new OmxrFakeVideoDecodeAccelerator();
+  return std::unique_ptr<VideoDecodeAccelerator>(*decoder);
+}
+
+class OmxrHybridVideoDecodeAcceleratorTest : public testing::Test {
+ protected:
+  OmxrHybridVideoDecodeAcceleratorTest()
+      : decoder_(new OmxrHybridVideoDecodeAccelerator(
+            base::Bind(&CreateFakeDecoder, &hardware_),
+            HardwareProfiles(),
+            base::Bind(&CreateFakeDecoder, &software_))) {
+    // GOPs of two pictures, alternating between QVGA and 720p.
+    OmxrH264StreamGenerator::Config config;
+    config.sizes = {gfx::Size(320, 240), gfx::Size(1280, 720)};
+    config.gop_length = 2;
+    generator_.reset(new OmxrH264StreamGenerator(config));
+  }
+
+  ~OmxrHybridVideoDecodeAcceleratorTest() override { decoder_->Destroy(); }
+
+  bool Initialize(VideoCodecProfile profile) {
+    return decoder_->Initialize(VideoDecodeAccelerator::Config(profile),
+                                &client_);
+  }
+
+  // Decodes the next |count| access units of the stream, one buffer each.
+  void DecodeAccessUnits(int count) {
+    for (int i = 0; i < count; ++i) {
+      std::vector<uint8_t> access_unit;
+      generator_->AppendAccessUnit(&access_unit);
+      base::SharedMemory shm;
+      ASSERT_TRUE(shm.CreateAndMapAnonymous(access_unit.size()));
+      memcpy(shm.memory(), access_unit.data(), access_unit.size());
+      decoder_->Decode(BitstreamBuffer(next_bitstream_id_++, shm.TakeHandle(),
+                                       access_unit.size()));
+    }
+  }
+
+  base::test::ScopedTaskEnvironment task_environment_;
+  // Owned by |decoder_|.
+  OmxrFakeVideoDecodeAccelerator* hardware_ = nullptr;
+  OmxrFakeVideoDecodeAccelerator* software_ = nullptr;
+  OmxrHybridVideoDecodeAccelerator* decoder_;
+  std::unique_ptr<OmxrH264StreamGenerator> generator_;
+  int32_t next_bitstream_id_ = 0;
+  OmxrRecordingVdaClient client_;
+};
+
+TEST_F(OmxrHybridVideoDecodeAcceleratorTest, RejectsOtherCodecs) {
+  EXPECT_FALSE(Initialize(VP8PROFILE_ANY));
+  EXPECT_EQ(nullptr, hardware_);
+}
+
+TEST_F(OmxrHybridVideoDecodeAcceleratorTest, StartsHardwareOnAProfileItHas) {
+  ASSERT_TRUE(Initialize(H264PROFILE_HIGH));
+  EXPECT_EQ(H264PROFILE_BASELINE, hardware_->profile());
+  EXPECT_EQ(H264PROFILE_HIGH, software_->profile());
+}
+
+TEST_F(OmxrHybridVideoDecodeAcceleratorTest, RoutesGopsBeyondTheHardware) {
+  ASSERT_TRUE(Initialize(H264PROFILE_BASELINE));
+  DecodeAccessUnits(4);
+
+  EXPECT_EQ(std::vector<int32_t>({0, 1}), hardware_->decoded());
+  EXPECT_EQ(std::vector<int32_t>({2, 3}), software_->decoded());
+  // The hardware is flushed at the switch.
+  EXPECT_EQ(1, hardware_->flushes());
+  EXPECT_EQ(1, decoder_->GetStats().switches);
+}
+
+TEST_F(OmxrHybridVideoDecodeAcceleratorTest, KeepsStreamOrderAcrossASwitch) {
+  ASSERT_TRUE(Initialize(H264PROFILE_BASELINE));
+  DecodeAccessUnits(4);
+
+  // Software pictures wait for the hardware to drain.
+  software_->OutputPicture(200, 2);
+  hardware_->OutputPicture(100, 0);
+  hardware_->OutputPicture(101, 1);
+  EXPECT_EQ(std::vector<int32_t>({100, 101}), client_.pictures());
+  hardware_->client()->NotifyFlushDone();
+  EXPECT_EQ(std::vector<int32_t>({100, 101, 200}), client_.pictures());
+
+  software_->OutputPicture(201, 3);
+  EXPECT_EQ(std::vector<int32_t>({100, 101, 200, 201}), client_.pictures());
+  OmxrHybridVideoDecodeAccelerator::Stats stats = decoder_->GetStats();
+  EXPECT_EQ(2, stats.pictures[OmxrHybridVideoDecodeAccelerator::HARDWARE]);
+  EXPECT_EQ(2, stats.pictures[OmxrHybridVideoDecodeAccelerator::SOFTWARE]);
+}
+
+TEST_F(OmxrHybridVideoDecodeAcceleratorTest, WaitsForAPathToDrain) {
+  ASSERT_TRUE(Initialize(H264PROFILE_BASELINE));
+  // QVGA, 720p, QVGA: the switch back comes while the hardware still drains.
+  DecodeAccessUnits(6);
+  EXPECT_EQ(std::vector<int32_t>({0, 1}), hardware_->decoded());
+  decoder_->Flush();
+  EXPECT_EQ(0, software_->flushes());
+
+  hardware_->client()->NotifyFlushDone();
+  EXPECT_EQ(std::vector<int32_t>({0, 1, 4, 5}), hardware_->decoded());
+  EXPECT_EQ(1, software_->flushes());
+  EXPECT_EQ(2, hardware_->flushes());
+
+  // The client's flush is done once both paths are.
+  software_->client()->NotifyFlushDone();
+  EXPECT_EQ(0, client_.flush_done());
+  hardware_->client()->NotifyFlushDone();
+  EXPECT_EQ(1, client_.flush_done());
+  EXPECT_EQ(2, decoder_->GetStats().switches);
+}
+
+TEST_F(OmxrHybridVideoDecodeAcceleratorTest, ResetDropsWaitingInput) {
+  ASSERT_TRUE(Initialize(H264PROFILE_BASELINE));
+  DecodeAccessUnits(6);
+  software_->OutputPicture(200, 2);
+
+  decoder_->Reset();
+  EXPECT_EQ(std::vector<int32_t>({200}), software_->reused());
+  EXPECT_EQ(1, client_.reset_done());
+  task_environment_.RunUntilIdle();
+  EXPECT_EQ(std::vector<int32_t>({4, 5}), client_.ended());
+}
+
+TEST_F(OmxrHybridVideoDecodeAcceleratorTest, PicturesGoToThePathThatAsked) {
+  ASSERT_TRUE(Initialize(H264PROFILE_BASELINE));
+  software_->client()->ProvidePictureBuffers(2, PIXEL_FORMAT_NV12, 1,
+                                            gfx::Size(1280, 720), 0);
+  decoder_->AssignPictureBuffers({PictureBuffer(300, gfx::Size(1280, 720)),
+                                  PictureBuffer(301, gfx::Size(1280, 720))});
+  EXPECT_TRUE(hardware_->assigned().empty());
+  EXPECT_EQ(std::vector<int32_t>({300, 301}), software_->assigned());
+
+  decoder_->ReusePictureBuffer(301);
+  EXPECT_EQ(std::vector<int32_t>({301}), software_->reused());
+  EXPECT_TRUE(hardware_->reused().empty());
+}
+
+}  // namespace
+}  // namespace media
@@ -0,0 +1,120 @@
+// Copyright (c) 2019 Renesas Electronics Corporation
+// Use of this source code is governed by a BSD-style license that can be
+// found in the LICENSE file.
+
+#include "media/gpu/omx/omxr_input_tuner.h"
+
+#include <algorithm>
+
+#include "base/logging.h"
+
+namespace media {
+
+namespace {
+
+// Shortest window a decision is based on.
+constexpr base::TimeDelta kMinWindow = base::TimeDelta::FromSeconds(2);
+constexpr int kMinSubmits = 30;
+// Starved for more than 1/20 of the window: grow.
+constexpr int kStarvedDivisor = 20;
+// Hardware idle for more than 1/5 of the window, never starved: shrink.
+constexpr int kIdleDivisor = 5;
+// Headroom over the largest access unit seen, and buffer size granularity.
+constexpr size_t kSizeHeadroomPercent = 125;
+constexpr size_t kSizeAlignment = 4096;
+
+}  // namespace
+
+OmxrInputTuner::OmxrInputTuner(const Config& minimum, size_t max_bytes)
+    : minimum_(minimum),
+      max_bytes_(max_bytes),
+      submits_(0),
+      peak_in_flight_(0),
+      largest_access_unit_(0) {}
+
+OmxrInputTuner::~OmxrInputTuner() {}
+
+void OmxrInputTuner::OnSubmitted(base::TimeTicks now,
+                                 size_t filled,
+                                 int buffers_at_component) {
+  if (window_start_.is_null())
+    window_start_ = now;
+  ++submits_;
+  if (!idle_since_.is_null()) {
+    idle_time_ += now - idle_since_;
+    idle_since_ = base::TimeTicks();
+  }
+  peak_in_flight_ = std::max(peak_in_flight_, buffers_at_component);
+  largest_access_unit_ = std::max(largest_access_unit_, filled);
+}
+
+void OmxrInputTuner::OnReturned(base::TimeTicks now,
+                                int buffers_at_component) {
+  if (window_start_.is_null())
+    return;
+  if (!starved_since_.is_null()) {
+    starved_time_ += now - starved_since_;
+    starved_since_ = base::TimeTicks();
+  }
+  if (!buffers_at_component && idle_since_.is_null())
+    idle_since_ = now;
+}
+
+void OmxrInputTuner::OnStarved(base::TimeTicks now) {
+  if (!window_start_.is_null() && starved_since_.is_null())
+    starved_since_ = now;
+}
+
+bool OmxrInputTuner::Recommend(base::TimeTicks now,
+                               const Config& current,
+                               Config* next) {
+  base::TimeDelta window = now - window_start_;
+  if (window_start_.is_null() || window < kMinWindow ||
+      submits_ < kMinSubmits) {
+    return false;
+  }
+  if (!starved_since_.is_null())
+    starved_time_ += now - starved_since_;
+  if (!idle_since_.is_null())
+    idle_time_ += now - idle_since_;
+
+  *next = current;
+  if (starved_time_ * kStarvedDivisor > window) {
+    next->count += std::max(1, current.count / 2);
+  } else if (starved_time_.is_zero() && idle_time_ * kIdleDivisor > window) {
+    next->count = std::min(next->count, peak_in_flight_ + 1);
+  }
+  next->count = std::max(next->count, minimum_.count);
+
+  size_t wanted = largest_access_unit_ * kSizeHeadroomPercent / 100;
+  wanted = (wanted + kSizeAlignment - 1) / kSizeAlignment * kSizeAlignment;
+  next->size = std::max(minimum_.size, wanted);
+
+  // Fewer buffers first, then smaller ones, but never below the minimum.
+  if (next->count * next->size > max_bytes_) {
+    next->count = std::max<int>(minimum_.count, max_bytes_ / next->size);
+    if (next->count * next->size > max_bytes_)
+      next->size = std::max(minimum_.size, max_bytes_ / next->count);
+  }
+
+  VLOG(1) << "Input tuner: starved " << starved_time_.InMilliseconds()
+          << " ms, hardware idle " << idle_time_.InMilliseconds() << " ms of "
+          << window.InMilliseconds() << " ms, " << submits_
+          << " access units, peak " << peak_in_flight_
+          << " in flight, largest " << largest_access_unit_ << " bytes";
+  RestartWindow(now);
+  return next->count != current.count || next->size != current.size;
+}
+
+void OmxrInputTuner::RestartWindow(base::TimeTicks now) {
+  window_start_ = now;
+  submits_ = 0;
+  starved_time_ = base::TimeDelta();
+  starved_since_ = base::TimeTicks();
+  idle_time_ = base::TimeDelta();
+  idle_since_ = base::TimeTicks();
+  peak_in_flight_ = 0;
+  largest_access_unit_ = 0;
+}
+
+}  // namespace media
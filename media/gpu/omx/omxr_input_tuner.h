@@ -0,0 +1,71 @@
+// Copyright (c) 2019 Renesas Electronics Corporation
+// Use of this source code is governed by a BSD-style license that can be
+// found in the LICENSE file.
+
+#ifndef MEDIA_GPU_OMX_OMXR_INPUT_TUNER_H_
+#define MEDIA_GPU_OMX_OMXR_INPUT_TUNER_H_
+
+#include <stddef.h>
+
+#include "base/macros.h"
+#include "base/time/time.h"
+#include "media/gpu/media_gpu_export.h"
+
+namespace media {
+
+// Sizes the input port from what the decoder observes.  Two signals are
+// tracked over an observation window:
+//  - starvation: bitstream buffers waiting for a free input buffer, meaning
+//    more input buffers would keep the hardware busier;
+//  - hardware idle: no input buffer at the component while the next access
+//    unit has not been submitted yet, meaning the producer is the bottleneck
+//    and input buffers beyond the peak in flight only waste carveout.
+// Recommend() turns these into a buffer count and size, which the decoder
+// applies at the next safe point (reset or component re-creation).
+class MEDIA_GPU_EXPORT OmxrInputTuner {
+ public:
+  struct Config {
+    int count;
+    size_t size;
+  };
+
+  // |minimum| is what the component asks for by default, |max_bytes| the
+  // carveout budget for all input buffers together.
+  OmxrInputTuner(const Config& minimum, size_t max_bytes);
+  ~OmxrInputTuner();
+
+  // An access unit of |filled| bytes went to the component, which now holds
+  // |buffers_at_component| input buffers.
+  void OnSubmitted(base::TimeTicks now, size_t filled,
+                   int buffers_at_component);
+  // An input buffer came back, leaving |buffers_at_component|.
+  void OnReturned(base::TimeTicks now, int buffers_at_component);
+  // A bitstream buffer had to be queued for lack of a free input buffer.
+  void OnStarved(base::TimeTicks now);
+
+  // Fills |next| and returns true if |current| should be changed.  Returns
+  // false while the window is too short to tell; otherwise the window
+  // restarts.
+  bool Recommend(base::TimeTicks now, const Config& current, Config* next);
+
+ private:
+  void RestartWindow(base::TimeTicks now);
+
+  const Config minimum_;
+  const size_t max_bytes_;
+
+  base::TimeTicks window_start_;
+  int submits_;
+  base::TimeDelta starved_time_;
+  base::TimeTicks starved_since_;
+  base::TimeDelta idle_time_;
+  base::TimeTicks idle_since_;
+  int peak_in_flight_;
+  size_t largest_access_unit_;
+
+  DISALLOW_COPY_AND_ASSIGN(OmxrInputTuner);
+};
+
+}  // namespace media
+
+#endif  // MEDIA_GPU_OMX_OMXR_INPUT_TUNER_H_
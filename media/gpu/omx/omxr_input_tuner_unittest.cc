@@ -0,0 +1,87 @@
+// Copyright (c) 2019 Renesas Electronics Corporation
+// Use of this source code is governed by a BSD-style license that can be
+// found in the LICENSE file.
+
+#include "media/gpu/omx/omxr_input_tuner.h"
+
+#include "testing/gtest/include/gtest/gtest.h"
+
+namespace media {
+namespace {
+
+using Config = OmxrInputTuner::Config;
+
+const Config kMinimum = {2, 64 * 1024};
+const size_t kBudget = 1024 * 1024;
+const base::TimeDelta kFrame = base::TimeDelta::FromMilliseconds(40);
+
+class OmxrInputTunerTest : public testing::Test {
+ protected:
+  OmxrInputTunerTest()
+      : tuner_(kMinimum, kBudget),
+        now_(base::TimeTicks() + base::TimeDelta::FromSeconds(1)) {}
+
+  // Submits |frames| access units of |size| bytes, one per frame interval.
+  // The hardware holds each for |busy| and is idle for the rest; with
+  // |starved| the next access unit waits for a free buffer meanwhile.
+  void Run(int frames, size_t size, base::TimeDelta busy, bool starved) {
+    for (int i = 0; i < frames; ++i) {
+      tuner_.OnSubmitted(now_, size, 1);
+      now_ += busy;
+      if (starved)
+        tuner_.OnStarved(now_ - busy / 2);
+      tuner_.OnReturned(now_, 0);
+      now_ += kFrame - busy;
+    }
+  }
+
+  OmxrInputTuner tuner_;
+  base::TimeTicks now_;
+};
+
+TEST_F(OmxrInputTunerTest, WaitsForAFullWindow) {
+  Run(10, 1000, kFrame / 2, true);
+  Config next;
+  EXPECT_FALSE(tuner_.Recommend(now_, kMinimum, &next));
+}
+
+TEST_F(OmxrInputTunerTest, GrowsCountWhenStarved) {
+  Run(60, 1000, kFrame, true);
+  Config next;
+  ASSERT_TRUE(tuner_.Recommend(now_, Config{4, kMinimum.size}, &next));
+  EXPECT_EQ(6, next.count);
+  EXPECT_EQ(kMinimum.size, next.size);
+}
+
+TEST_F(OmxrInputTunerTest, ShrinksCountWhenHardwareIdles) {
+  Run(60, 1000, kFrame / 4, false);
+  Config next;
+  ASSERT_TRUE(tuner_.Recommend(now_, Config{8, kMinimum.size}, &next));
+  // One buffer in flight at a time, plus one being filled.
+  EXPECT_EQ(kMinimum.count, next.count);
+}
+
+TEST_F(OmxrInputTunerTest, KeepsSteadyConfiguration) {
+  Run(60, 1000, kFrame, false);
+  Config next;
+  EXPECT_FALSE(tuner_.Recommend(now_, Config{4, kMinimum.size}, &next));
+}
+
+TEST_F(OmxrInputTunerTest, SizesBuffersForLargestAccessUnit) {
+  Run(60, 100 * 1000, kFrame, false);
+  Config next;
+  ASSERT_TRUE(tuner_.Recommend(now_, Config{4, kMinimum.size}, &next));
+  EXPECT_EQ(4, next.count);
+  EXPECT_EQ(126976u, next.size);
+}
+
+TEST_F(OmxrInputTunerTest, StaysWithinBudget) {
+  Run(60, 300 * 1000, kFrame, true);
+  Config next;
+  ASSERT_TRUE(tuner_.Recommend(now_, Config{4, kMinimum.size}, &next));
+  EXPECT_LE(next.count * next.size, kBudget);
+  EXPECT_GE(next.count, kMinimum.count);
+}
+
+}  // namespace
+}  // namespace media
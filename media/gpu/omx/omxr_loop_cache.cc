@@ -0,0 +1,167 @@
+// Copyright (c) 2019 Renesas Electronics Corporation
+// Use of this source code is governed by a BSD-style license that can be
+// found in the LICENSE file.
+
+#include "media/gpu/omx/omxr_loop_cache.h"
+
+#include "base/hash.h"
+#include "base/logging.h"
+
+namespace media {
+
+OmxrLoopCache::OmxrLoopCache()
+    : max_pictures_(0), state_(RECORDING), next_position_(0) {}
+
+OmxrLoopCache::~OmxrLoopCache() = default;
+
+void OmxrLoopCache::SetCapacity(size_t max_pictures) {
+  max_pictures_ = max_pictures;
+  // Buffers seen before the first pictures are still part of the pass being
+  // recorded.
+  if (state_ == RECORDING && held_.empty())
+    return;
+  StartRecording();
+}
+
+OmxrLoopCache::Action OmxrLoopCache::OnInput(int32_t bitstream_id,
+                                             const uint8_t* data,
+                                             size_t size,
+                                             int32_t* picture_buffer_id) {
+  uint32_t hash = base::PersistentHash(data, size);
+  switch (state_) {
+    case RECORDED:
+      if (entries_[0].hash != hash || entries_[0].size != size) {
+        VLOG(1) << "New clip, recording again";
+        StartRecording();
+        break;
+      }
+      VLOG(1) << "Serving loop of " << entries_.size() << " buffers";
+      state_ = SERVING;
+      next_position_ = 0;
+    // Fall through.
+    case SERVING:
+      if (next_position_ < entries_.size() &&
+          entries_[next_position_].hash == hash &&
+          entries_[next_position_].size == size) {
+        *picture_buffer_id = entries_[next_position_++].picture_buffer_id;
+        return SERVE;
+      }
+      VLOG(1) << "Input diverged from the loop at buffer " << next_position_;
+      state_ = DIVERGED;
+      return RESYNC;
+    case RECORDING:
+      break;
+    case DIVERGED:
+    case OVER_BUDGET:
+      return DECODE;
+  }
+
+  DCHECK_EQ(state_, RECORDING);
+  positions_[bitstream_id] = entries_.size();
+  entries_.push_back(Entry{hash, size, -1});
+  return DECODE;
+}
+
+void OmxrLoopCache::OnPicture(int32_t bitstream_id,
+                              int32_t picture_buffer_id) {
+  if (state_ != RECORDING)
+    return;
+  auto it = positions_.find(bitstream_id);
+  if (it == positions_.end())
+    return;
+
+  if (held_.size() >= max_pictures_) {
+    VLOG(1) << "Clip exceeds the loop cache room of " << max_pictures_
+            << " pictures";
+    ReleaseAll();
+    entries_.clear();
+    positions_.clear();
+    state_ = OVER_BUDGET;
+    return;
+  }
+  entries_[it->second].picture_buffer_id = picture_buffer_id;
+  held_[picture_buffer_id] = false;
+  positions_.erase(it);
+}
+
+bool OmxrLoopCache::OnPictureReturned(int32_t picture_buffer_id) {
+  auto it = held_.find(picture_buffer_id);
+  if (it == held_.end())
+    return false;
+  it->second = true;
+  return true;
+}
+
+void OmxrLoopCache::OnPictureServed(int32_t picture_buffer_id) {
+  DCHECK(IsAvailable(picture_buffer_id));
+  held_[picture_buffer_id] = false;
+}
+
+bool OmxrLoopCache::IsAvailable(int32_t picture_buffer_id) const {
+  auto it = held_.find(picture_buffer_id);
+  return it != held_.end() && it->second;
+}
+
+void OmxrLoopCache::OnFlushDone() {
+  switch (state_) {
+    case RECORDING:
+      // Nothing to serve a later pass from.
+      if (held_.empty()) {
+        StartRecording();
+        return;
+      }
+      VLOG(1) << "Recorded loop of " << entries_.size() << " buffers, "
+              << held_.size() << " pictures";
+      positions_.clear();
+      state_ = RECORDED;
+      return;
+    case SERVING:
+      state_ = RECORDED;
+      return;
+    case DIVERGED:
+      StartRecording();
+      return;
+    case RECORDED:
+    case OVER_BUDGET:
+      return;
+  }
+}
+
+void OmxrLoopCache::OnReset() {
+  switch (state_) {
+    case RECORDING:
+    case DIVERGED:
+      // Pictures of the cut short pass may never have been output.
+      StartRecording();
+      return;
+    case SERVING:
+      state_ = RECORDED;
+      return;
+    case RECORDED:
+    case OVER_BUDGET:
+      return;
+  }
+}
+
+std::vector<int32_t> OmxrLoopCache::TakeReleasedPictures() {
+  std::vector<int32_t> released;
+  released.swap(released_);
+  return released;
+}
+
+void OmxrLoopCache::StartRecording() {
+  ReleaseAll();
+  entries_.clear();
+  positions_.clear();
+  state_ = RECORDING;
+}
+
+void OmxrLoopCache::ReleaseAll() {
+  for (const auto& picture : held_) {
+    if (picture.second)
+      released_.push_back(picture.first);
+  }
+  held_.clear();
+}
+
+}  // namespace media
@@ -0,0 +1,113 @@
+// Copyright (c) 2019 Renesas Electronics Corporation
+// Use of this source code is governed by a BSD-style license that can be
+// found in the LICENSE file.
+
+#ifndef MEDIA_GPU_OMX_OMXR_LOOP_CACHE_H_
+#define MEDIA_GPU_OMX_OMXR_LOOP_CACHE_H_
+
+#include <stddef.h>
+#include <stdint.h>
+
+#include <map>
+#include <vector>
+
+#include "base/macros.h"
+
+namespace media {
+
+// Remembers the decoded pictures of a short clip so that later passes over
+// the same clip can be served without decoding it again.
+//
+// A pass is the input between two Flush() or Reset() boundaries.  The first
+// pass is recorded: every bitstream buffer is fingerprinted and the picture
+// decoded from it is kept, by picture buffer id, instead of going back to the
+// component.  A pass recorded up to its Flush() completes the recording.
+// Later passes are matched buffer by buffer against the recording; matching
+// buffers are served the kept pictures again.  A clip with more pictures than
+// the cache has room for is not cached.
+//
+// The cache only does the bookkeeping; the decoder owns the pictures.  A kept
+// picture is either out with the client or available to be served.
+class OmxrLoopCache {
+ public:
+  enum Action {
+    DECODE,  // Hand the buffer to the component.
+    SERVE,   // Skip the component; hand out |picture_buffer_id| again, or
+             // nothing if it is -1.
+    RESYNC,  // The input left the loop being served.  The component has not
+             // seen the references of the buffer; decode from the next
+             // keyframe.
+  };
+
+  OmxrLoopCache();
+  ~OmxrLoopCache();
+
+  // Sets how many pictures may be kept, for a new set of pictures.  Drops
+  // the recording unless nothing was kept yet.
+  void SetCapacity(size_t max_pictures);
+
+  Action OnInput(int32_t bitstream_id,
+                 const uint8_t* data,
+                 size_t size,
+                 int32_t* picture_buffer_id);
+  // Offers the picture decoded from |bitstream_id|, on its way to the
+  // client.
+  void OnPicture(int32_t bitstream_id, int32_t picture_buffer_id);
+  // The client is done with |picture_buffer_id|.  Returns true if the cache
+  // keeps it, in which case it must not go back to the component.
+  bool OnPictureReturned(int32_t picture_buffer_id);
+  void OnPictureServed(int32_t picture_buffer_id);
+  bool Holds(int32_t picture_buffer_id) const {
+    return held_.count(picture_buffer_id) > 0;
+  }
+  // Kept and not out with the client.
+  bool IsAvailable(int32_t picture_buffer_id) const;
+
+  // Pass boundaries: all pictures of the pass have been output, or the pass
+  // was cut short.
+  void OnFlushDone();
+  void OnReset();
+
+  // Returns the available pictures let go of since the last call, to go
+  // back to the component.  Those out with the client go back once the
+  // client returns them.
+  std::vector<int32_t> TakeReleasedPictures();
+
+  bool serving() const { return state_ == SERVING; }
+  size_t size() const { return held_.size(); }
+
+ private:
+  enum State {
+    RECORDING,
+    RECORDED,     // The next buffer is the start of a new pass.
+    SERVING,
+    DIVERGED,     // The pass stopped matching; wait for the next boundary.
+    OVER_BUDGET,  // The clip does not fit; given up until new pictures.
+  };
+
+  struct Entry {
+    uint32_t hash;
+    size_t size;
+    int32_t picture_buffer_id;
+  };
+
+  void StartRecording();
+  void ReleaseAll();
+
+  size_t max_pictures_;
+  State state_;
+  std::vector<Entry> entries_;
+  // Position within the pass of the buffers recorded so far.
+  std::map<int32_t, size_t> positions_;
+  // Position of the next buffer of the pass being served.
+  size_t next_position_;
+  // Kept pictures, and whether each is available.
+  std::map<int32_t, bool> held_;
+  std::vector<int32_t> released_;
+
+  DISALLOW_COPY_AND_ASSIGN(OmxrLoopCache);
+};
+
+}  // namespace media
+
+#endif  // MEDIA_GPU_OMX_OMXR_LOOP_CACHE_H_
@@ -0,0 +1,148 @@
+// Copyright (c) 2019 Renesas Electronics Corporation
+// Use of this source code is governed by a BSD-style license that can be
+// found in the LICENSE file.
+
+#include "media/gpu/omx/omxr_loop_cache.h"
+
+#include <vector>
+
+#include "testing/gtest/include/gtest/gtest.h"
+
+namespace media {
+namespace {
+
+class OmxrLoopCacheTest : public testing::Test {
+ protected:
+  OmxrLoopCacheTest() { cache_.SetCapacity(8); }
+
+  // Feeds buffer |value| with the next bitstream id.
+  OmxrLoopCache::Action Input(uint8_t value, int32_t* picture_buffer_id) {
+    *picture_buffer_id = -1;
+    return cache_.OnInput(next_bitstream_id_++, &value, 1, picture_buffer_id);
+  }
+
+  // Records a pass of |count| buffers, picture i decoded into picture buffer
+  // 100 + i and returned by the client.
+  void RecordPass(int count) {
+    int32_t first_id = next_bitstream_id_;
+    int32_t picture_buffer_id;
+    for (int i = 0; i < count; ++i)
+      ASSERT_EQ(OmxrLoopCache::DECODE, Input(i, &picture_buffer_id));
+    for (int i = 0; i < count; ++i) {
+      cache_.OnPicture(first_id + i, 100 + i);
+      EXPECT_TRUE(cache_.OnPictureReturned(100 + i));
+    }
+    cache_.OnFlushDone();
+  }
+
+  OmxrLoopCache cache_;
+  int32_t next_bitstream_id_ = 0;
+};
+
+TEST_F(OmxrLoopCacheTest, ServesKeptPictures) {
+  RecordPass(3);
+  EXPECT_EQ(3u, cache_.size());
+
+  int32_t picture_buffer_id;
+  for (int i = 0; i < 3; ++i) {
+    ASSERT_EQ(OmxrLoopCache::SERVE, Input(i, &picture_buffer_id));
+    EXPECT_EQ(100 + i, picture_buffer_id);
+    EXPECT_TRUE(cache_.IsAvailable(picture_buffer_id));
+    cache_.OnPictureServed(picture_buffer_id);
+    EXPECT_FALSE(cache_.IsAvailable(picture_buffer_id));
+    EXPECT_TRUE(cache_.Holds(picture_buffer_id));
+  }
+  EXPECT_TRUE(cache_.serving());
+  cache_.OnFlushDone();
+
+  // The next pass is served again.
+  ASSERT_EQ(OmxrLoopCache::SERVE, Input(0, &picture_buffer_id));
+  EXPECT_EQ(100, picture_buffer_id);
+  EXPECT_TRUE(cache_.TakeReleasedPictures().empty());
+}
+
+TEST_F(OmxrLoopCacheTest, StopsServingWhenInputDiverges) {
+  RecordPass(3);
+
+  int32_t picture_buffer_id;
+  ASSERT_EQ(OmxrLoopCache::SERVE, Input(0, &picture_buffer_id));
+  cache_.OnPictureServed(picture_buffer_id);
+  EXPECT_EQ(OmxrLoopCache::RESYNC, Input(7, &picture_buffer_id));
+  EXPECT_FALSE(cache_.serving());
+  // Matching buffers of the rest of the pass are decoded, not served.
+  EXPECT_EQ(OmxrLoopCache::DECODE, Input(2, &picture_buffer_id));
+
+  // The next boundary lets go of the pictures; the one still with the
+  // client is not available to go back to the component yet.
+  cache_.OnFlushDone();
+  EXPECT_EQ(std::vector<int32_t>({101, 102}), cache_.TakeReleasedPictures());
+  EXPECT_FALSE(cache_.OnPictureReturned(100));
+  EXPECT_EQ(0u, cache_.size());
+}
+
+TEST_F(OmxrLoopCacheTest, RecordsANewClip) {
+  RecordPass(2);
+
+  int32_t picture_buffer_id;
+  EXPECT_EQ(OmxrLoopCache::DECODE, Input(9, &picture_buffer_id));
+  EXPECT_EQ(std::vector<int32_t>({100, 101}), cache_.TakeReleasedPictures());
+  cache_.OnPicture(next_bitstream_id_ - 1, 200);
+  EXPECT_TRUE(cache_.OnPictureReturned(200));
+  cache_.OnFlushDone();
+
+  ASSERT_EQ(OmxrLoopCache::SERVE, Input(9, &picture_buffer_id));
+  EXPECT_EQ(200, picture_buffer_id);
+}
+
+TEST_F(OmxrLoopCacheTest, GivesUpOnClipsThatDoNotFit) {
+  cache_.SetCapacity(2);
+  int32_t picture_buffer_id;
+  for (int i = 0; i < 3; ++i)
+    ASSERT_EQ(OmxrLoopCache::DECODE, Input(i, &picture_buffer_id));
+  cache_.OnPicture(0, 100);
+  EXPECT_TRUE(cache_.OnPictureReturned(100));
+  cache_.OnPicture(1, 101);
+  cache_.OnPicture(2, 102);
+  // Only the picture the client returned can go back to the component now.
+  EXPECT_EQ(std::vector<int32_t>({100}), cache_.TakeReleasedPictures());
+  EXPECT_FALSE(cache_.OnPictureReturned(101));
+  EXPECT_FALSE(cache_.OnPictureReturned(102));
+  cache_.OnFlushDone();
+  EXPECT_EQ(0u, cache_.size());
+  EXPECT_EQ(OmxrLoopCache::DECODE, Input(0, &picture_buffer_id));
+
+  // New pictures give the clip another chance.
+  cache_.SetCapacity(8);
+  RecordPass(3);
+  EXPECT_EQ(OmxrLoopCache::SERVE, Input(0, &picture_buffer_id));
+}
+
+TEST_F(OmxrLoopCacheTest, ResetDropsAPartialRecording) {
+  int32_t picture_buffer_id;
+  ASSERT_EQ(OmxrLoopCache::DECODE, Input(0, &picture_buffer_id));
+  cache_.OnPicture(0, 100);
+  cache_.OnReset();
+  EXPECT_FALSE(cache_.Holds(100));
+  EXPECT_TRUE(cache_.TakeReleasedPictures().empty());
+
+  // A reset while serving keeps the recording.
+  RecordPass(2);
+  ASSERT_EQ(OmxrLoopCache::SERVE, Input(0, &picture_buffer_id));
+  cache_.OnReset();
+  ASSERT_EQ(OmxrLoopCache::SERVE, Input(0, &picture_buffer_id));
+  EXPECT_EQ(100, picture_buffer_id);
+}
+
+TEST_F(OmxrLoopCacheTest, KeepsBuffersSeenBeforeThePictures) {
+  OmxrLoopCache cache;
+  int32_t picture_buffer_id;
+  ASSERT_EQ(OmxrLoopCache::DECODE,
+            cache.OnInput(5, reinterpret_cast<const uint8_t*>("a"), 1,
+                          &picture_buffer_id));
+  cache.SetCapacity(4);
+  cache.OnPicture(5, 100);
+  EXPECT_TRUE(cache.Holds(100));
+}
+
+}  // namespace
+}  // namespace media
@@ -0,0 +1,214 @@
+// Copyright (c) 2019 Renesas Electronics Corporation
+// Use of this source code is governed by a BSD-style license that can be
+// found in the LICENSE file.
+
+#include "media/gpu/omx/omxr_mp4_sample_reader.h"
+
+#include <utility>
+
+#include "base/big_endian.h"
+#include "base/logging.h"
+
+namespace media {
+
+namespace {
+
+constexpr uint32_t Fourcc(const char (&type)[5]) {
+  return (static_cast<uint32_t>(type[0]) << 24) |
+         (static_cast<uint32_t>(type[1]) << 16) |
+         (static_cast<uint32_t>(type[2]) << 8) | static_cast<uint32_t>(type[3]);
+}
+
+// Bytes of a VisualSampleEntry before its child boxes.
+constexpr size_t kVisualSampleEntrySize = 78;
+
+struct Box {
+  uint32_t type;
+  const uint8_t* payload;
+  size_t size;
+};
+
+bool NextBox(base::BigEndianReader* reader, Box* box) {
+  uint32_t size32;
+  if (!reader->ReadU32(&size32) || !reader->ReadU32(&box->type))
+    return false;
+  uint64_t size = size32;
+  size_t header_size = 8;
+  if (size32 == 1) {
+    if (!reader->ReadU64(&size))
+      return false;
+    header_size = 16;
+  } else if (size32 == 0) {
+    size = header_size + reader->remaining();
+  }
+  if (size < header_size || size - header_size > reader->remaining())
+    return false;
+  box->payload = reinterpret_cast<const uint8_t*>(reader->ptr());
+  box->size = size - header_size;
+  return reader->Skip(box->size);
+}
+
+bool FindBox(const uint8_t* data, size_t size, uint32_t type, Box* box) {
+  base::BigEndianReader reader(reinterpret_cast<const char*>(data), size);
+  while (NextBox(&reader, box)) {
+    if (box->type == type)
+      return true;
+  }
+  return false;
+}
+
+// Reader positioned after the version and flags of a full box.
+base::BigEndianReader FullBoxReader(const Box& box) {
+  base::BigEndianReader reader(reinterpret_cast<const char*>(box.payload),
+                               box.size);
+  reader.Skip(4);
+  return reader;
+}
+
+}  // namespace
+
+OmxrMp4SampleReader::OmxrMp4SampleReader() = default;
+
+OmxrMp4SampleReader::~OmxrMp4SampleReader() = default;
+
+bool OmxrMp4SampleReader::Parse(const uint8_t* data, size_t size) {
+  Box moov;
+  if (!FindBox(data, size, Fourcc("moov"), &moov)) {
+    DLOG(ERROR) << "No moov box";
+    return false;
+  }
+  base::BigEndianReader reader(reinterpret_cast<const char*>(moov.payload),
+                               moov.size);
+  Box trak;
+  while (NextBox(&reader, &trak)) {
+    if (trak.type == Fourcc("trak") &&
+        ParseTrack(trak.payload, trak.size, size)) {
+      return true;
+    }
+  }
+  DLOG(ERROR) << "No H.264 video track";
+  return false;
+}
+
+bool OmxrMp4SampleReader::ParseTrack(const uint8_t* data,
+                                     size_t size,
+                                     size_t file_size) {
+  Box mdia, hdlr, minf, stbl, stsd;
+  if (!FindBox(data, size, Fourcc("mdia"), &mdia) ||
+      !FindBox(mdia.payload, mdia.size, Fourcc("hdlr"), &hdlr) ||
+      !FindBox(mdia.payload, mdia.size, Fourcc("minf"), &minf) ||
+      !FindBox(minf.payload, minf.size, Fourcc("stbl"), &stbl) ||
+      !FindBox(stbl.payload, stbl.size, Fourcc("stsd"), &stsd)) {
+    return false;
+  }
+
+  base::BigEndianReader hdlr_reader = FullBoxReader(hdlr);
+  uint32_t handler_type;
+  if (!hdlr_reader.Skip(4) || !hdlr_reader.ReadU32(&handler_type) ||
+      handler_type != Fourcc("vide")) {
+    return false;
+  }
+
+  base::BigEndianReader stsd_reader = FullBoxReader(stsd);
+  Box entry, avcc;
+  if (!stsd_reader.Skip(4) || !NextBox(&stsd_reader, &entry) ||
+      (entry.type != Fourcc("avc1") && entry.type != Fourcc("avc3")) ||
+      entry.size < kVisualSampleEntrySize ||
+      !FindBox(entry.payload + kVisualSampleEntrySize,
+               entry.size - kVisualSampleEntrySize, Fourcc("avcC"), &avcc)) {
+    return false;
+  }
+
+  Box stsz, stsc, stco;
+  bool co64 = false;
+  if (!FindBox(stbl.payload, stbl.size, Fourcc("stsz"), &stsz) ||
+      !FindBox(stbl.payload, stbl.size, Fourcc("stsc"), &stsc)) {
+    return false;
+  }
+  if (!FindBox(stbl.payload, stbl.size, Fourcc("stco"), &stco)) {
+    if (!FindBox(stbl.payload, stbl.size, Fourcc("co64"), &stco))
+      return false;
+    co64 = true;
+  }
+
+  // Sample sizes.
+  base::BigEndianReader stsz_reader = FullBoxReader(stsz);
+  uint32_t fixed_size, sample_count;
+  if (!stsz_reader.ReadU32(&fixed_size) || !stsz_reader.ReadU32(&sample_count))
+    return false;
+  std::vector<uint32_t> sizes;
+  if (fixed_size) {
+    if (sample_count > file_size / fixed_size)
+      return false;
+    sizes.assign(sample_count, fixed_size);
+  } else {
+    if (sample_count > stsz_reader.remaining() / 4)
+      return false;
+    sizes.resize(sample_count);
+    for (uint32_t& sample_size : sizes)
+      stsz_reader.ReadU32(&sample_size);
+  }
+
+  // Chunk offsets.
+  base::BigEndianReader stco_reader = FullBoxReader(stco);
+  uint32_t chunk_count;
+  if (!stco_reader.ReadU32(&chunk_count) ||
+      chunk_count > stco_reader.remaining() / (co64 ? 8 : 4)) {
+    return false;
+  }
+  std::vector<uint64_t> chunk_offsets(chunk_count);
+  for (uint64_t& offset : chunk_offsets) {
+    if (co64) {
+      stco_reader.ReadU64(&offset);
+    } else {
+      uint32_t offset32;
+      stco_reader.ReadU32(&offset32);
+      offset = offset32;
+    }
+  }
+
+  // Runs of chunks with the same number of samples.
+  base::BigEndianReader stsc_reader = FullBoxReader(stsc);
+  uint32_t run_count;
+  if (!stsc_reader.ReadU32(&run_count) ||
+      run_count > stsc_reader.remaining() / 12) {
+    return false;
+  }
+  std::vector<std::pair<uint32_t, uint32_t>> runs(run_count);
+  for (auto& run : runs) {
+    stsc_reader.ReadU32(&run.first);
+    stsc_reader.ReadU32(&run.second);
+    stsc_reader.Skip(4);
+  }
+
+  std::vector<Sample> samples;
+  samples.reserve(sizes.size());
+  for (size_t i = 0; i < runs.size(); ++i) {
+    uint32_t first_chunk = runs[i].first;
+    uint32_t end_chunk =
+        i + 1 < runs.size() ? runs[i + 1].first : chunk_count + 1;
+    if (first_chunk == 0 || first_chunk > end_chunk ||
+        end_chunk > chunk_count + 1) {
+      return false;
+    }
+    for (uint32_t chunk = first_chunk; chunk < end_chunk; ++chunk) {
+      uint64_t offset = chunk_offsets[chunk - 1];
+      for (uint32_t j = 0; j < runs[i].second && samples.size() < sizes.size();
+           ++j) {
+        uint32_t sample_size = sizes[samples.size()];
+        if (offset > file_size || sample_size > file_size - offset)
+          return false;
+        samples.push_back(Sample{static_cast<size_t>(offset), sample_size});
+        offset += sample_size;
+      }
+    }
+  }
+  if (samples.size() != sizes.size())
+    return false;
+
+  avc_configuration_record_.assign(avcc.payload, avcc.payload + avcc.size);
+  samples_ = std::move(samples);
+  return true;
+}
+
+}  // namespace media
@@ -0,0 +1,51 @@
+// Copyright (c) 2019 Renesas Electronics Corporation
+// Use of this source code is governed by a BSD-style license that can be
+// found in the LICENSE file.
+
+#ifndef MEDIA_GPU_OMX_OMXR_MP4_SAMPLE_READER_H_
+#define MEDIA_GPU_OMX_OMXR_MP4_SAMPLE_READER_H_
+
+#include <stddef.h>
+#include <stdint.h>
+
+#include <vector>
+
+#include "base/macros.h"
+
+namespace media {
+
+// Finds the samples of the first H.264 video track of an MP4 file held in
+// memory, by walking its sample table.  Just enough for the decode benchmark
+// to feed a file without a demuxer; fragmented files are not supported.
+class OmxrMp4SampleReader {
+ public:
+  struct Sample {
+    size_t offset;
+    size_t size;
+  };
+
+  OmxrMp4SampleReader();
+  ~OmxrMp4SampleReader();
+
+  // Returns false if |data| has no H.264 video track, or it is malformed.
+  bool Parse(const uint8_t* data, size_t size);
+
+  // The AVCDecoderConfigurationRecord (avcC box payload) of the track.
+  const std::vector<uint8_t>& avc_configuration_record() const {
+    return avc_configuration_record_;
+  }
+  // Samples in decode order; each holds length-prefixed NAL units.
+  const std::vector<Sample>& samples() const { return samples_; }
+
+ private:
+  bool ParseTrack(const uint8_t* data, size_t size, size_t file_size);
+
+  std::vector<uint8_t> avc_configuration_record_;
+  std::vector<Sample> samples_;
+
+  DISALLOW_COPY_AND_ASSIGN(OmxrMp4SampleReader);
+};
+
+}  // namespace media
+
+#endif  // MEDIA_GPU_OMX_OMXR_MP4_SAMPLE_READER_H_
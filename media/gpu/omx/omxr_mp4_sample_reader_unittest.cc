@@ -0,0 +1,110 @@
+// Copyright (c) 2019 Renesas Electronics Corporation
+// Use of this source code is governed by a BSD-style license that can be
+// found in the LICENSE file.
+
+#include "media/gpu/omx/omxr_mp4_sample_reader.h"
+
+#include <string>
+#include <vector>
+
+#include "testing/gtest/include/gtest/gtest.h"
+
+namespace media {
+namespace {
+
+using Bytes = std::vector<uint8_t>;
+
+void AppendU32(Bytes* bytes, uint32_t value) {
+  for (int shift = 24; shift >= 0; shift -= 8)
+    bytes->push_back(static_cast<uint8_t>(value >> shift));
+}
+
+Bytes MakeBox(const std::string& type, const Bytes& payload) {
+  Bytes box;
+  AppendU32(&box, static_cast<uint32_t>(8 + payload.size()));
+  box.insert(box.end(), type.begin(), type.end());
+  box.insert(box.end(), payload.begin(), payload.end());
+  return box;
+}
+
+Bytes MakeFullBox(const std::string& type, const std::vector<uint32_t>& words) {
+  Bytes payload;
+  AppendU32(&payload, 0);
+  for (uint32_t word : words)
+    AppendU32(&payload, word);
+  return MakeBox(type, payload);
+}
+
+Bytes Concat(const std::vector<Bytes>& parts) {
+  Bytes bytes;
+  for (const Bytes& part : parts)
+    bytes.insert(bytes.end(), part.begin(), part.end());
+  return bytes;
+}
+
+const Bytes kAvcC = {0x01, 0x42, 0xc0, 0x1e, 0xff, 0xe0, 0x00};
+
+// An MP4 file whose mdat holds |mdat|, with one track of |handler| samples
+// sized |sizes| in two chunks: the first two samples, then the rest.
+Bytes MakeFile(const std::string& handler,
+               const Bytes& mdat,
+               const std::vector<uint32_t>& sizes) {
+  Bytes ftyp = MakeBox("ftyp", Bytes(8, 0));
+  uint32_t first_chunk = static_cast<uint32_t>(ftyp.size() + 8);
+  uint32_t second_chunk = first_chunk + sizes[0] + sizes[1];
+
+  Bytes hdlr_payload(4, 0);
+  AppendU32(&hdlr_payload, 0);
+  hdlr_payload.insert(hdlr_payload.end(), handler.begin(), handler.end());
+  hdlr_payload.resize(hdlr_payload.size() + 13, 0);
+
+  Bytes avc1_payload(78, 0);
+  Bytes avcc = MakeBox("avcC", kAvcC);
+  avc1_payload.insert(avc1_payload.end(), avcc.begin(), avcc.end());
+  Bytes stsd = MakeBox("stsd", Concat({Bytes(4, 0), {0, 0, 0, 1},
+                                       MakeBox("avc1", avc1_payload)}));
+
+  std::vector<uint32_t> stsz_words = {0, static_cast<uint32_t>(sizes.size())};
+  stsz_words.insert(stsz_words.end(), sizes.begin(), sizes.end());
+  Bytes stbl = MakeBox(
+      "stbl",
+      Concat({stsd, MakeFullBox("stsz", stsz_words),
+              MakeFullBox("stsc", {2, 1, 2, 1, 2, 3, 1}),
+              MakeFullBox("stco", {2, first_chunk, second_chunk})}));
+  Bytes mdia = MakeBox("mdia", Concat({MakeBox("hdlr", hdlr_payload),
+                                       MakeBox("minf", stbl)}));
+  Bytes moov = MakeBox("moov", MakeBox("trak", mdia));
+  return Concat({ftyp, MakeBox("mdat", mdat), moov});
+}
+
+TEST(OmxrMp4SampleReaderTest, ReadsSampleTable) {
+  Bytes file = MakeFile("vide", Bytes(10, 0xab), {1, 2, 3, 4});
+  OmxrMp4SampleReader reader;
+  ASSERT_TRUE(reader.Parse(file.data(), file.size()));
+  EXPECT_EQ(kAvcC, reader.avc_configuration_record());
+  ASSERT_EQ(4u, reader.samples().size());
+  const size_t kMdat = 16 + 8;
+  EXPECT_EQ(kMdat, reader.samples()[0].offset);
+  EXPECT_EQ(kMdat + 1, reader.samples()[1].offset);
+  EXPECT_EQ(kMdat + 3, reader.samples()[2].offset);
+  EXPECT_EQ(kMdat + 6, reader.samples()[3].offset);
+  EXPECT_EQ(4u, reader.samples()[3].size);
+}
+
+TEST(OmxrMp4SampleReaderTest, IgnoresOtherTracks) {
+  Bytes file = MakeFile("soun", Bytes(10, 0xab), {1, 2, 3, 4});
+  OmxrMp4SampleReader reader;
+  EXPECT_FALSE(reader.Parse(file.data(), file.size()));
+}
+
+TEST(OmxrMp4SampleReaderTest, RejectsSamplesPastEndOfFile) {
+  Bytes file = MakeFile("vide", Bytes(10, 0xab), {1, 2, 3, 1000});
+  OmxrMp4SampleReader reader;
+  EXPECT_FALSE(reader.Parse(file.data(), file.size()));
+
+  file.resize(file.size() / 2);
+  EXPECT_FALSE(reader.Parse(file.data(), file.size()));
+}
+
+}  // namespace
+}  // namespace media
@@ -0,0 +1,72 @@
+// Copyright (c) 2019 Renesas Electronics Corporation
+// Use of this source code is governed by a BSD-style license that can be
+// found in the LICENSE file.
+
+#include "media/gpu/omx/omxr_notification_batcher.h"
+
+#include <utility>
+
+#include "base/bind.h"
+#include "base/location.h"
+#include "base/trace_event/trace_event.h"
+
+namespace media {
+
+OmxrNotificationBatcher::OmxrNotificationBatcher(
+    scoped_refptr<base::SingleThreadTaskRunner> task_runner,
+    base::TimeDelta max_delay,
+    const DeliveredCB& delivered_cb)
+    : task_runner_(std::move(task_runner)),
+      max_delay_(max_delay),
+      delivered_cb_(delivered_cb),
+      delivering_(false),
+      delivery_factory_(this),
+      weak_factory_(this) {}
+
+OmxrNotificationBatcher::~OmxrNotificationBatcher() {
+  DCHECK_CALLED_ON_VALID_THREAD(thread_checker_);
+}
+
+void OmxrNotificationBatcher::Add(base::OnceClosure notification) {
+  DCHECK_CALLED_ON_VALID_THREAD(thread_checker_);
+  bool schedule = pending_.empty() && !delivering_;
+  pending_.push_back(std::move(notification));
+  if (!schedule)
+    return;
+  task_runner_->PostDelayedTask(
+      FROM_HERE,
+      base::BindOnce(&OmxrNotificationBatcher::Deliver,
+                     delivery_factory_.GetWeakPtr()),
+      max_delay_);
+}
+
+void OmxrNotificationBatcher::Deliver() {
+  DCHECK_CALLED_ON_VALID_THREAD(thread_checker_);
+  delivery_factory_.InvalidateWeakPtrs();
+  if (delivering_ || pending_.empty())
+    return;
+
+  TRACE_EVENT1("media,gpu", "OmxrNotificationBatcher::Deliver", "Pending",
+               pending_.size());
+  // A notification may make the client destroy the decoder, and us with it.
+  base::WeakPtr<OmxrNotificationBatcher> self = weak_factory_.GetWeakPtr();
+  delivering_ = true;
+  size_t delivered = 0;
+  while (!pending_.empty()) {
+    base::OnceClosure notification = std::move(pending_.front());
+    pending_.pop_front();
+    std::move(notification).Run();
+    if (!self)
+      return;
+    ++delivered;
+  }
+  delivering_ = false;
+  if (delivered_cb_)
+    delivered_cb_.Run(delivered);
+}
+
+base::WeakPtr<OmxrNotificationBatcher> OmxrNotificationBatcher::GetWeakPtr() {
+  return weak_factory_.GetWeakPtr();
+}
+
+}  // namespace media
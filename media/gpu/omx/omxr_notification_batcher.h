@@ -0,0 +1,73 @@
+// Copyright (c) 2019 Renesas Electronics Corporation
+// Use of this source code is governed by a BSD-style license that can be
+// found in the LICENSE file.
+
+#ifndef MEDIA_GPU_OMX_OMXR_NOTIFICATION_BATCHER_H_
+#define MEDIA_GPU_OMX_OMXR_NOTIFICATION_BATCHER_H_
+
+#include <stddef.h>
+
+#include <deque>
+
+#include "base/callback.h"
+#include "base/macros.h"
+#include "base/memory/scoped_refptr.h"
+#include "base/memory/weak_ptr.h"
+#include "base/single_thread_task_runner.h"
+#include "base/threading/thread_checker.h"
+#include "base/time/time.h"
+#include "media/gpu/media_gpu_export.h"
+
+namespace media {
+
+// Coalesces the decoder's end of bitstream notifications into one task per
+// batch, instead of one per consumed bitstream buffer.
+// The first notification of a batch schedules its delivery |max_delay| later,
+// so none is held back longer than that; with a zero delay a batch holds what
+// one task of the decoder thread produced.  Notifications run in the order
+// they were added.
+//
+// A notification the client must not see before the queued ones, such as
+// flush or reset completion, an error or a dismissed picture, is sent after
+// Deliver().
+class MEDIA_GPU_EXPORT OmxrNotificationBatcher {
+ public:
+  // Called after a delivery with the number of notifications it ran.
+  using DeliveredCB = base::RepeatingCallback<void(size_t)>;
+
+  OmxrNotificationBatcher(
+      scoped_refptr<base::SingleThreadTaskRunner> task_runner,
+      base::TimeDelta max_delay,
+      const DeliveredCB& delivered_cb);
+  ~OmxrNotificationBatcher();
+
+  void Add(base::OnceClosure notification);
+  // Runs the queued notifications now.  Notifications added meanwhile, by a
+  // client calling back into the decoder, are part of the same delivery;
+  // a Deliver() from within one returns right away.
+  void Deliver();
+
+  size_t pending() const { return pending_.size(); }
+
+  base::WeakPtr<OmxrNotificationBatcher> GetWeakPtr();
+
+ private:
+  const scoped_refptr<base::SingleThreadTaskRunner> task_runner_;
+  const base::TimeDelta max_delay_;
+  const DeliveredCB delivered_cb_;
+
+  std::deque<base::OnceClosure> pending_;
+  bool delivering_;
+
+  THREAD_CHECKER(thread_checker_);
+
+  // Invalidated by Deliver(), cancelling the scheduled delivery.
+  base::WeakPtrFactory<OmxrNotificationBatcher> delivery_factory_;
+  base::WeakPtrFactory<OmxrNotificationBatcher> weak_factory_;
+
+  DISALLOW_COPY_AND_ASSIGN(OmxrNotificationBatcher);
+};
+
+}  // namespace media
+
+#endif  // MEDIA_GPU_OMX_OMXR_NOTIFICATION_BATCHER_H_
@@ -0,0 +1,245 @@
+// Copyright (c) 2019 Renesas Electronics Corporation
+// Use of this source code is governed by a BSD-style license that can be
+// found in the LICENSE file.
+
+#include <algorithm>
+#include <memory>
+#include <string>
+
+#include "base/bind.h"
+#include "base/memory/weak_ptr.h"
+#include "base/test/scoped_task_environment.h"
+#include "base/threading/thread_task_runner_handle.h"
+#include "base/time/time.h"
+#include "media/gpu/omx/omxr_notification_batcher.h"
+#include "media/video/picture.h"
+#include "media/video/video_decode_accelerator.h"
+#include "testing/gtest/include/gtest/gtest.h"
+#include "testing/perf/perf_test.h"
+
+namespace media {
+namespace {
+
+const int kFrames = 1200;
+
+struct Scenario {
+  const char* name;
+  // Inputs arrive |burst| at a time, every |burst| frame periods.
+  int burst;
+  // The picture of an input is ready this long after the input, or after the
+  // previous picture if that is later.
+  base::TimeDelta picture_delay;
+  base::TimeDelta picture_interval;
+};
+
+const Scenario kScenarios[] = {
+    // Live playback at 60 fps.
+    {"live", 1, base::TimeDelta::FromMilliseconds(15),
+     base::TimeDelta::FromMilliseconds(3)},
+    // A second of input at once, as on preroll after a seek or catching up.
+    {"burst", 60, base::TimeDelta::FromMilliseconds(10),
+     base::TimeDelta::FromMilliseconds(3)},
+};
+
+enum Mode {
+  // Every notification a direct call from the decoder task that produced it;
+  // the floor for tasks and latency.
+  SYNCHRONOUS,
+  // What the decoder does without a batcher: end of bitstream notifications
+  // posted one task each.
+  POSTED,
+  // End of bitstream notifications through an OmxrNotificationBatcher.
+  BATCHED,
+};
+
+// Counts the calls the decoder makes on its client, and how late the end of
+// bitstream notifications arrive.
+class CountingClient : public VideoDecodeAccelerator::Client {
+ public:
+  explicit CountingClient(base::test::ScopedTaskEnvironment* task_environment)
+      : task_environment_(task_environment) {}
+
+  // The end of bitstream notification for |bitstream_buffer_id| is sent.
+  void ExpectEndOfBitstreamBuffer(int32_t bitstream_buffer_id) {
+    sent_[bitstream_buffer_id % kFrames] = task_environment_->NowTicks();
+  }
+
+  // VideoDecodeAccelerator::Client implementation.
+  void NotifyInitializationComplete(bool success) override {}
+  void ProvidePictureBuffers(uint32_t requested_num_of_buffers,
+                             VideoPixelFormat format,
+                             uint32_t textures_per_buffer,
+                             const gfx::Size& dimensions,
+                             uint32_t texture_target) override {}
+  void DismissPictureBuffer(int32_t picture_buffer_id) override {}
+  void PictureReady(const Picture& picture) override { ++calls_; }
+  void NotifyEndOfBitstreamBuffer(int32_t bitstream_buffer_id) override {
+    ++calls_;
+    max_added_latency_ =
+        std::max(max_added_latency_, task_environment_->NowTicks() -
+                                         sent_[bitstream_buffer_id % kFrames]);
+  }
+  void NotifyFlushDone() override {}
+  void NotifyResetDone() override {}
+  void NotifyError(VideoDecodeAccelerator::Error error) override {}
+
+  int calls() const { return calls_; }
+  base::TimeDelta max_added_latency() const { return max_added_latency_; }
+
+ private:
+  base::test::ScopedTaskEnvironment* const task_environment_;
+  base::TimeTicks sent_[kFrames];
+  int calls_ = 0;
+  base::TimeDelta max_added_latency_;
+};
+
+// Plays the decoder side of OmxrVideoDecodeAccelerator on the mock clock:
+// each input's end of bitstream notification when Decode() consumes it, its
+// picture when the component outputs it.  Pictures always go straight to the
+// client, as the decoder does.  A task is one the client's notifications
+// caused: one per posted notification, one per batch.
+class Simulation {
+ public:
+  Simulation(base::test::ScopedTaskEnvironment* task_environment,
+             const Scenario& scenario,
+             Mode mode,
+             base::TimeDelta max_delay)
+      : task_environment_(task_environment),
+        scenario_(scenario),
+        mode_(mode),
+        client_(task_environment),
+        weak_client_factory_(&client_) {
+    if (mode_ == BATCHED) {
+      batcher_.reset(new OmxrNotificationBatcher(
+          base::ThreadTaskRunnerHandle::Get(), max_delay,
+          base::BindRepeating(&Simulation::OnDelivered,
+                              base::Unretained(this))));
+    }
+  }
+
+  void Run() {
+    const base::TimeDelta kFramePeriod =
+        base::TimeDelta::FromMicroseconds(16667);
+    base::TimeTicks start = task_environment_->NowTicks();
+    base::TimeTicks picture_time = start;
+    for (int i = 0; i < kFrames; ++i) {
+      base::TimeTicks input_time =
+          start + kFramePeriod * (i - i % scenario_.burst);
+      picture_time = std::max(picture_time + scenario_.picture_interval,
+                              input_time + scenario_.picture_delay);
+      base::ThreadTaskRunnerHandle::Get()->PostDelayedTask(
+          FROM_HERE,
+          base::BindOnce(&Simulation::EndOfBitstreamBuffer,
+                         base::Unretained(this), i),
+          input_time - start);
+      base::ThreadTaskRunnerHandle::Get()->PostDelayedTask(
+          FROM_HERE,
+          base::BindOnce(&Simulation::PictureReady, base::Unretained(this),
+                         i),
+          picture_time - start);
+    }
+    if (!base::ThreadTicks::IsSupported()) {
+      task_environment_->FastForwardUntilNoTasksRemain();
+      return;
+    }
+    base::ThreadTicks cpu_start = base::ThreadTicks::Now();
+    task_environment_->FastForwardUntilNoTasksRemain();
+    cpu_time_ = base::ThreadTicks::Now() - cpu_start;
+  }
+
+  const CountingClient& client() const { return client_; }
+  int tasks() const { return tasks_; }
+  base::TimeDelta cpu_time() const { return cpu_time_; }
+
+ private:
+  void EndOfBitstreamBuffer(int32_t id) {
+    client_.ExpectEndOfBitstreamBuffer(id);
+    base::WeakPtr<VideoDecodeAccelerator::Client> client =
+        weak_client_factory_.GetWeakPtr();
+    switch (mode_) {
+      case SYNCHRONOUS:
+        client->NotifyEndOfBitstreamBuffer(id);
+        return;
+      case POSTED:
+        ++tasks_;
+        base::ThreadTaskRunnerHandle::Get()->PostTask(
+            FROM_HERE,
+            base::BindOnce(
+                &VideoDecodeAccelerator::Client::NotifyEndOfBitstreamBuffer,
+                client, id));
+        return;
+      case BATCHED:
+        batcher_->Add(base::BindOnce(
+            &VideoDecodeAccelerator::Client::NotifyEndOfBitstreamBuffer,
+            client, id));
+        return;
+    }
+  }
+
+  void PictureReady(int32_t id) {
+    client_.PictureReady(
+        Picture(id % 8, id, gfx::Rect(320, 240), gfx::ColorSpace(), false));
+  }
+
+  void OnDelivered(size_t count) { ++tasks_; }
+
+  base::test::ScopedTaskEnvironment* const task_environment_;
+  const Scenario scenario_;
+  const Mode mode_;
+  CountingClient client_;
+  base::WeakPtrFactory<VideoDecodeAccelerator::Client> weak_client_factory_;
+  std::unique_ptr<OmxrNotificationBatcher> batcher_;
+  int tasks_ = 0;
+  base::TimeDelta cpu_time_;
+};
+
+TEST(OmxrNotificationBatcherPerfTest, ClientCallsPerFrame) {
+  const struct {
+    const char* name;
+    Mode mode;
+    int max_delay_ms;
+  } kModes[] = {
+      {"synchronous", SYNCHRONOUS, 0},
+      {"posted", POSTED, 0},
+      {"batched_0ms", BATCHED, 0},
+      {"batched_2ms", BATCHED, 2},
+      {"batched_8ms", BATCHED, 8},
+  };
+
+  for (const Scenario& scenario : kScenarios) {
+    for (const auto& mode : kModes) {
+      base::test::ScopedTaskEnvironment task_environment(
+          base::test::ScopedTaskEnvironment::MainThreadType::MOCK_TIME);
+      base::TimeDelta max_delay =
+          base::TimeDelta::FromMilliseconds(mode.max_delay_ms);
+      Simulation simulation(&task_environment, scenario, mode.mode,
+                            max_delay);
+      simulation.Run();
+      // Batching saves tasks, not calls: the client still sees every
+      // notification, in as many calls as without it.
+      EXPECT_EQ(2 * kFrames, simulation.client().calls());
+      EXPECT_LE(simulation.client().max_added_latency(), max_delay);
+
+      std::string trace = std::string(scenario.name) + "_" + mode.name;
+      perf_test::PrintResult(
+          "omxr_notification_batcher", "_client_calls_per_frame", trace,
+          static_cast<double>(simulation.client().calls()) / kFrames,
+          "calls", true);
+      perf_test::PrintResult(
+          "omxr_notification_batcher", "_tasks_per_frame", trace,
+          static_cast<double>(simulation.tasks()) / kFrames, "tasks", true);
+      if (base::ThreadTicks::IsSupported()) {
+        perf_test::PrintResult(
+            "omxr_notification_batcher", "_cpu_per_frame", trace,
+            simulation.cpu_time().InMicrosecondsF() / kFrames, "us", true);
+      }
+      perf_test::PrintResult(
+          "omxr_notification_batcher", "_max_added_latency", trace,
+          simulation.client().max_added_latency().InMillisecondsF(), "ms",
+          true);
+    }
+  }
+}
+
+}  // namespace
+}  // namespace media
@@ -0,0 +1,79 @@
+// Copyright (c) 2019 Renesas Electronics Corporation
+// Use of this source code is governed by a BSD-style license that can be
+// found in the LICENSE file.
+
+#include "media/gpu/omx/omxr_notification_batcher.h"
+
+#include <utility>
+#include <vector>
+
+#include "base/bind.h"
+#include "base/test/scoped_task_environment.h"
+#include "base/threading/thread_task_runner_handle.h"
+#include "testing/gtest/include/gtest/gtest.h"
+
+namespace media {
+namespace {
+
+class OmxrNotificationBatcherTest : public testing::Test {
+ protected:
+  OmxrNotificationBatcherTest()
+      : task_environment_(
+            base::test::ScopedTaskEnvironment::MainThreadType::MOCK_TIME),
+        batcher_(base::ThreadTaskRunnerHandle::Get(),
+                 base::TimeDelta::FromMilliseconds(2),
+                 base::BindRepeating(&OmxrNotificationBatcherTest::OnDelivered,
+                                     base::Unretained(this))) {}
+
+  base::OnceClosure Notification(int id) {
+    return base::BindOnce(
+        [](std::vector<int>* delivered, int id) { delivered->push_back(id); },
+        &delivered_, id);
+  }
+
+  void OnDelivered(size_t count) { batches_.push_back(count); }
+
+  base::test::ScopedTaskEnvironment task_environment_;
+  OmxrNotificationBatcher batcher_;
+  std::vector<int> delivered_;
+  std::vector<size_t> batches_;
+};
+
+TEST_F(OmxrNotificationBatcherTest, DeliversWithinMaxDelay) {
+  batcher_.Add(Notification(1));
+  task_environment_.FastForwardBy(base::TimeDelta::FromMilliseconds(1));
+  batcher_.Add(Notification(2));
+  EXPECT_TRUE(delivered_.empty());
+
+  // Two milliseconds after the first of the batch, not of the last.
+  task_environment_.FastForwardBy(base::TimeDelta::FromMilliseconds(1));
+  EXPECT_EQ(std::vector<int>({1, 2}), delivered_);
+  EXPECT_EQ(std::vector<size_t>({2}), batches_);
+
+  batcher_.Add(Notification(3));
+  task_environment_.FastForwardUntilNoTasksRemain();
+  EXPECT_EQ(std::vector<int>({1, 2, 3}), delivered_);
+  EXPECT_EQ(std::vector<size_t>({2, 1}), batches_);
+}
+
+TEST_F(OmxrNotificationBatcherTest, DeliverRunsQueuedInOrder) {
+  batcher_.Add(Notification(1));
+  // A notification that makes the client call back into the decoder.
+  batcher_.Add(base::BindOnce(
+      [](OmxrNotificationBatcher* batcher, base::OnceClosure notification) {
+        batcher->Add(std::move(notification));
+        batcher->Deliver();
+      },
+      &batcher_, Notification(3)));
+  batcher_.Add(Notification(2));
+  batcher_.Deliver();
+  EXPECT_EQ(std::vector<int>({1, 2, 3}), delivered_);
+  EXPECT_EQ(0u, batcher_.pending());
+
+  // The scheduled delivery is gone with the batch.
+  task_environment_.FastForwardUntilNoTasksRemain();
+  EXPECT_EQ(std::vector<size_t>({4}), batches_);
+}
+
+}  // namespace
+}  // namespace media
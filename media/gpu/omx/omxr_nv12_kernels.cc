@@ -0,0 +1,432 @@
+// Copyright (c) 2019 Renesas Electronics Corporation
+// Use of this source code is governed by a BSD-style license that can be
+// found in the LICENSE file.
+
+#include "media/gpu/omx/omxr_nv12_kernels.h"
+
+#include <string.h>
+
+#include <algorithm>
+
+#include "base/logging.h"
+#include "build/build_config.h"
+
+#if defined(ARCH_CPU_ARM_FAMILY) && \
+    (defined(__ARM_NEON__) || defined(__ARM_NEON))
+#define OMXR_NV12_NEON 1
+#include <arm_neon.h>
+#endif
+
+namespace media {
+namespace omxr_nv12 {
+
+namespace {
+
+bool g_portable = false;
+
+// YUV to RGB in fixed point: the luma factor in Q7, applied to luma less
+// |y_offset| and halved, the chroma factors in Q6.  The intermediate values
+// stay within 16 bits, so that NEON can do without widening to 32.
+struct Coefficients {
+  uint8_t y_offset;
+  uint8_t y;
+  int16_t rv;
+  int16_t gu;
+  int16_t gv;
+  int16_t bu;
+};
+
+const Coefficients& GetCoefficients(Matrix matrix, Range range) {
+  static const Coefficients kCoefficients[2][2] = {
+      // BT.601, limited and full range.
+      {{16, 149, 102, 25, 52, 129}, {0, 128, 90, 22, 46, 113}},
+      // BT.709.
+      {{16, 149, 115, 14, 34, 135}, {0, 128, 101, 12, 30, 119}},
+  };
+  return kCoefficients[matrix == Matrix::BT709][range == Range::FULL];
+}
+
+uint8_t Clamp(int value) {
+  return static_cast<uint8_t>(std::min(std::max(value, 0), 255));
+}
+
+// Portable row kernels, from |begin| to |end| of the row in output samples.
+
+void SplitUVRow(const uint8_t* uv,
+                uint8_t* u,
+                uint8_t* v,
+                int begin,
+                int end) {
+  for (int i = begin; i < end; ++i) {
+    u[i] = uv[2 * i];
+    v[i] = uv[2 * i + 1];
+  }
+}
+
+// Converts a luma row |y| and its chroma row |uv|.
+void RgbaRow(const uint8_t* y,
+             const uint8_t* uv,
+             uint8_t* rgba,
+             int begin,
+             int end,
+             const Coefficients& c) {
+  for (int x = begin; x < end; ++x) {
+    int luma = (std::max(y[x] - c.y_offset, 0) * c.y + 1) >> 1;
+    int u = uv[x & ~1] - 128;
+    int v = uv[x | 1] - 128;
+    uint8_t* pixel = rgba + 4 * x;
+    pixel[0] = Clamp((luma + c.rv * v + 32) >> 6);
+    pixel[1] = Clamp((luma - c.gu * u - c.gv * v + 32) >> 6);
+    pixel[2] = Clamp((luma + c.bu * u + 32) >> 6);
+    pixel[3] = 255;
+  }
+}
+
+// Averages |factor| x |factor| blocks of the |factor| rows in |rows|, whose
+// samples are |step| bytes apart and |width| long.  Blocks reaching past
+// |width| repeat the last sample.
+void BoxRow(const uint8_t* const* rows,
+            int factor,
+            int step,
+            int width,
+            uint8_t* dst,
+            int begin,
+            int end) {
+  int area = factor * factor;
+  for (int i = begin; i < end; ++i) {
+    int sum = 0;
+    for (int row = 0; row < factor; ++row) {
+      for (int col = 0; col < factor; ++col)
+        sum += rows[row][std::min(i * factor + col, width - 1) * step];
+    }
+    dst[i * step] = static_cast<uint8_t>((sum + area / 2) / area);
+  }
+}
+
+// The checksum runs four 32-bit lanes, each over every fourth little-endian
+// word of a row, so that NEON can mix a 16 byte load at once.
+const uint32_t kChecksumPrime = 0x9e3779b1;
+
+uint32_t MixWord(uint32_t lane, uint32_t word) {
+  lane = (lane ^ word) * kChecksumPrime;
+  return lane ^ (lane >> 15);
+}
+
+// Mixes bytes |begin| to |end| of |row| into |lanes|; the bytes after the last
+// 16 go into the first lane one by one.
+void ChecksumRow(const uint8_t* row, int begin, int end, uint32_t* lanes) {
+  int i = begin;
+  for (; i + 16 <= end; i += 16) {
+    for (int lane = 0; lane < 4; ++lane) {
+      const uint8_t* word = row + i + 4 * lane;
+      lanes[lane] =
+          MixWord(lanes[lane], word[0] | word[1] << 8 | word[2] << 16 |
+                                   static_cast<uint32_t>(word[3]) << 24);
+    }
+  }
+  for (; i < end; ++i)
+    lanes[0] = MixWord(lanes[0], row[i]);
+}
+
+#if defined(OMXR_NV12_NEON)
+
+// NEON row kernels.  Each handles what fits its vector width and returns
+// where the portable one takes over.
+
+int SplitUVRowNeon(const uint8_t* uv, uint8_t* u, uint8_t* v, int end) {
+  int i = 0;
+  for (; i + 16 <= end; i += 16) {
+    uint8x16x2_t samples = vld2q_u8(uv + 2 * i);
+    vst1q_u8(u + i, samples.val[0]);
+    vst1q_u8(v + i, samples.val[1]);
+  }
+  return i;
+}
+
+// Converts two luma rows sharing the chroma row |uv|; |y1| may be null for
+// the last row of an odd height.
+int RgbaRowPairNeon(const uint8_t* y0,
+                    const uint8_t* y1,
+                    const uint8_t* uv,
+                    uint8_t* rgba0,
+                    uint8_t* rgba1,
+                    int end,
+                    const Coefficients& c) {
+  const uint8x16_t y_offset = vdupq_n_u8(c.y_offset);
+  const uint8x8_t y_factor = vdup_n_u8(c.y);
+  const int16x8_t chroma_offset = vdupq_n_s16(128);
+  int x = 0;
+  for (; x + 16 <= end; x += 16) {
+    // Chroma for 16 pixels, computed once for both rows.
+    uint8x8x2_t chroma = vld2_u8(uv + x);
+    int16x8_t u = vsubq_s16(vreinterpretq_s16_u16(vmovl_u8(chroma.val[0])),
+                            chroma_offset);
+    int16x8_t v = vsubq_s16(vreinterpretq_s16_u16(vmovl_u8(chroma.val[1])),
+                            chroma_offset);
+    int16x8_t r = vmulq_n_s16(v, c.rv);
+    int16x8_t g = vmlaq_n_s16(vmulq_n_s16(u, c.gu), v, c.gv);
+    int16x8_t b = vmulq_n_s16(u, c.bu);
+    int16x8x2_t r2 = vzipq_s16(r, r);
+    int16x8x2_t g2 = vzipq_s16(g, g);
+    int16x8x2_t b2 = vzipq_s16(b, b);
+
+    const uint8_t* rows[] = {y0, y1};
+    uint8_t* outs[] = {rgba0, rgba1};
+    for (int row = 0; row < 2 && rows[row]; ++row) {
+      uint8x16_t y = vqsubq_u8(vld1q_u8(rows[row] + x), y_offset);
+      int16x8_t lo = vreinterpretq_s16_u16(
+          vrshrq_n_u16(vmull_u8(vget_low_u8(y), y_factor), 1));
+      int16x8_t hi = vreinterpretq_s16_u16(
+          vrshrq_n_u16(vmull_u8(vget_high_u8(y), y_factor), 1));
+      uint8x16x4_t pixels;
+      pixels.val[0] =
+          vcombine_u8(vqrshrun_n_s16(vqaddq_s16(lo, r2.val[0]), 6),
+                      vqrshrun_n_s16(vqaddq_s16(hi, r2.val[1]), 6));
+      pixels.val[1] =
+          vcombine_u8(vqrshrun_n_s16(vqsubq_s16(lo, g2.val[0]), 6),
+                      vqrshrun_n_s16(vqsubq_s16(hi, g2.val[1]), 6));
+      pixels.val[2] =
+          vcombine_u8(vqrshrun_n_s16(vqaddq_s16(lo, b2.val[0]), 6),
+                      vqrshrun_n_s16(vqaddq_s16(hi, b2.val[1]), 6));
+      pixels.val[3] = vdupq_n_u8(255);
+      vst4q_u8(outs[row] + 4 * x, pixels);
+    }
+  }
+  return x;
+}
+
+int BoxLumaRowNeon(const uint8_t* const* rows,
+                   int factor,
+                   uint8_t* dst,
+                   int end) {
+  int i = 0;
+  if (factor == 2) {
+    for (; i + 16 <= end; i += 16) {
+      const uint8_t* r0 = rows[0] + 2 * i;
+      const uint8_t* r1 = rows[1] + 2 * i;
+      uint16x8_t lo =
+          vaddq_u16(vpaddlq_u8(vld1q_u8(r0)), vpaddlq_u8(vld1q_u8(r1)));
+      uint16x8_t hi = vaddq_u16(vpaddlq_u8(vld1q_u8(r0 + 16)),
+                                vpaddlq_u8(vld1q_u8(r1 + 16)));
+      vst1q_u8(dst + i, vcombine_u8(vrshrn_n_u16(lo, 2),
+                                    vrshrn_n_u16(hi, 2)));
+    }
+    return i;
+  }
+  for (; i + 8 <= end; i += 8) {
+    uint16x8_t lo = vdupq_n_u16(0);
+    uint16x8_t hi = vdupq_n_u16(0);
+    for (int row = 0; row < 4; ++row) {
+      const uint8_t* src = rows[row] + 4 * i;
+      lo = vpadalq_u8(lo, vld1q_u8(src));
+      hi = vpadalq_u8(hi, vld1q_u8(src + 16));
+    }
+    uint16x8_t sums =
+        vcombine_u16(vpadd_u16(vget_low_u16(lo), vget_high_u16(lo)),
+                     vpadd_u16(vget_low_u16(hi), vget_high_u16(hi)));
+    vst1_u8(dst + i, vrshrn_n_u16(sums, 4));
+  }
+  return i;
+}
+
+// |end| counts chroma samples, each a U and a V byte.
+int BoxChromaRowNeon(const uint8_t* const* rows,
+                     int factor,
+                     uint8_t* dst,
+                     int end) {
+  int i = 0;
+  if (factor == 2) {
+    for (; i + 8 <= end; i += 8) {
+      uint8x16x2_t s0 = vld2q_u8(rows[0] + 4 * i);
+      uint8x16x2_t s1 = vld2q_u8(rows[1] + 4 * i);
+      uint8x8x2_t out;
+      out.val[0] = vrshrn_n_u16(
+          vaddq_u16(vpaddlq_u8(s0.val[0]), vpaddlq_u8(s1.val[0])), 2);
+      out.val[1] = vrshrn_n_u16(
+          vaddq_u16(vpaddlq_u8(s0.val[1]), vpaddlq_u8(s1.val[1])), 2);
+      vst2_u8(dst + 2 * i, out);
+    }
+    return i;
+  }
+  for (; i + 4 <= end; i += 4) {
+    uint16x8_t u = vdupq_n_u16(0);
+    uint16x8_t v = vdupq_n_u16(0);
+    for (int row = 0; row < 4; ++row) {
+      uint8x16x2_t samples = vld2q_u8(rows[row] + 8 * i);
+      u = vpadalq_u8(u, samples.val[0]);
+      v = vpadalq_u8(v, samples.val[1]);
+    }
+    uint16x4x2_t uv =
+        vzip_u16(vpadd_u16(vget_low_u16(u), vget_high_u16(u)),
+                 vpadd_u16(vget_low_u16(v), vget_high_u16(v)));
+    vst1_u8(dst + 2 * i,
+            vrshrn_n_u16(vcombine_u16(uv.val[0], uv.val[1]), 4));
+  }
+  return i;
+}
+
+int ChecksumRowNeon(const uint8_t* row, int end, uint32_t* lanes) {
+  const uint32x4_t prime = vdupq_n_u32(kChecksumPrime);
+  uint32x4_t state = vld1q_u32(lanes);
+  int i = 0;
+  for (; i + 16 <= end; i += 16) {
+    state = vmulq_u32(
+        veorq_u32(state, vreinterpretq_u32_u8(vld1q_u8(row + i))), prime);
+    state = veorq_u32(state, vshrq_n_u32(state, 15));
+  }
+  vst1q_u32(lanes, state);
+  return i;
+}
+
+#endif  // defined(OMXR_NV12_NEON)
+
+}  // namespace
+
+void ConvertToI420(const Picture& src,
+                   uint8_t* dst_y,
+                   int dst_y_stride,
+                   uint8_t* dst_u,
+                   int dst_u_stride,
+                   uint8_t* dst_v,
+                   int dst_v_stride) {
+  const int width = src.size.width();
+  const int height = src.size.height();
+  for (int row = 0; row < height; ++row) {
+    memcpy(dst_y + row * dst_y_stride, src.y + row * src.y_stride, width);
+  }
+
+  const int chroma_width = (width + 1) / 2;
+  const int chroma_height = (height + 1) / 2;
+  for (int row = 0; row < chroma_height; ++row) {
+    const uint8_t* uv = src.uv + row * src.uv_stride;
+    uint8_t* u = dst_u + row * dst_u_stride;
+    uint8_t* v = dst_v + row * dst_v_stride;
+    int done = 0;
+#if defined(OMXR_NV12_NEON)
+    if (UsesNeon())
+      done = SplitUVRowNeon(uv, u, v, chroma_width);
+#endif
+    SplitUVRow(uv, u, v, done, chroma_width);
+  }
+}
+
+void ConvertToRGBA(const Picture& src,
+                   Matrix matrix,
+                   Range range,
+                   uint8_t* dst_rgba,
+                   int dst_stride) {
+  const Coefficients& c = GetCoefficients(matrix, range);
+  const int width = src.size.width();
+  const int height = src.size.height();
+  // Two rows at a time, reading their chroma row once.
+  for (int row = 0; row < height; row += 2) {
+    const uint8_t* uv = src.uv + (row / 2) * src.uv_stride;
+    const uint8_t* y0 = src.y + row * src.y_stride;
+    const uint8_t* y1 = row + 1 < height ? y0 + src.y_stride : nullptr;
+    uint8_t* rgba0 = dst_rgba + row * dst_stride;
+    uint8_t* rgba1 = rgba0 + dst_stride;
+    int done = 0;
+#if defined(OMXR_NV12_NEON)
+    if (UsesNeon())
+      done = RgbaRowPairNeon(y0, y1, uv, rgba0, rgba1, width, c);
+#endif
+    RgbaRow(y0, uv, rgba0, done, width, c);
+    if (y1)
+      RgbaRow(y1, uv, rgba1, done, width, c);
+  }
+}
+
+void Downscale(const Picture& src,
+               int factor,
+               uint8_t* dst_y,
+               int dst_y_stride,
+               uint8_t* dst_uv,
+               int dst_uv_stride) {
+  DCHECK(factor == 2 || factor == 4) << factor;
+  const int dst_width = src.size.width() / factor;
+  const int dst_height = src.size.height() / factor;
+
+  for (int row = 0; row < dst_height; ++row) {
+    const uint8_t* rows[4];
+    for (int i = 0; i < factor; ++i)
+      rows[i] = src.y + (row * factor + i) * src.y_stride;
+    uint8_t* dst = dst_y + row * dst_y_stride;
+    int done = 0;
+#if defined(OMXR_NV12_NEON)
+    if (UsesNeon())
+      done = BoxLumaRowNeon(rows, factor, dst, dst_width);
+#endif
+    BoxRow(rows, factor, 1, src.size.width(), dst, done, dst_width);
+  }
+
+  const int src_chroma_width = (src.size.width() + 1) / 2;
+  const int src_chroma_height = (src.size.height() + 1) / 2;
+  const int dst_chroma_width = (dst_width + 1) / 2;
+  const int dst_chroma_height = (dst_height + 1) / 2;
+  for (int row = 0; row < dst_chroma_height; ++row) {
+    const uint8_t* rows[4];
+    for (int i = 0; i < factor; ++i) {
+      rows[i] = src.uv + std::min(row * factor + i, src_chroma_height - 1) *
+                             src.uv_stride;
+    }
+    uint8_t* dst = dst_uv + row * dst_uv_stride;
+    int done = 0;
+#if defined(OMXR_NV12_NEON)
+    // Only whole blocks; those at the right edge may be cut short.
+    if (UsesNeon()) {
+      done = BoxChromaRowNeon(rows, factor, dst,
+                              std::min(dst_chroma_width,
+                                       src_chroma_width / factor));
+    }
+#endif
+    for (int plane = 0; plane < 2; ++plane) {
+      const uint8_t* plane_rows[4];
+      for (int i = 0; i < factor; ++i)
+        plane_rows[i] = rows[i] + plane;
+      BoxRow(plane_rows, factor, 2, src_chroma_width, dst + plane, done,
+             dst_chroma_width);
+    }
+  }
+}
+
+uint64_t Checksum(const Picture& src) {
+  const int width = src.size.width();
+  const int height = src.size.height();
+  uint32_t lanes[4] = {1, 2, 3, 4};
+  auto checksum_rows = [&lanes](const uint8_t* data, int stride, int bytes,
+                                int rows) {
+    for (int row = 0; row < rows; ++row) {
+      const uint8_t* samples = data + row * stride;
+      int done = 0;
+#if defined(OMXR_NV12_NEON)
+      if (UsesNeon())
+        done = ChecksumRowNeon(samples, bytes, lanes);
+#endif
+      ChecksumRow(samples, done, bytes, lanes);
+    }
+  };
+  checksum_rows(src.y, src.y_stride, width, height);
+  checksum_rows(src.uv, src.uv_stride, (width + 1) / 2 * 2, (height + 1) / 2);
+
+  uint64_t checksum = static_cast<uint64_t>(width) << 32 | height;
+  for (uint32_t lane : lanes) {
+    checksum = (checksum ^ lane) * 0x100000001b3ull;
+    checksum ^= checksum >> 29;
+  }
+  return checksum;
+}
+
+bool UsesNeon() {
+#if defined(OMXR_NV12_NEON)
+  return !g_portable;
+#else
+  return false;
+#endif
+}
+
+void SetPortableForTesting(bool portable) {
+  g_portable = portable;
+}
+
+}  // namespace omxr_nv12
+}  // namespace media
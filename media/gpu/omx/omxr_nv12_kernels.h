@@ -0,0 +1,85 @@
+// Copyright (c) 2019 Renesas Electronics Corporation
+// Use of this source code is governed by a BSD-style license that can be
+// found in the LICENSE file.
+
+#ifndef MEDIA_GPU_OMX_OMXR_NV12_KERNELS_H_
+#define MEDIA_GPU_OMX_OMXR_NV12_KERNELS_H_
+
+#include <stdint.h>
+
+#include "media/gpu/media_gpu_export.h"
+#include "ui/gfx/geometry/size.h"
+
+namespace media {
+
+// Conversions of decoded NV12 pictures for consumers on the CPU, such as
+// software compositing, canvas readback or analysis, without going through
+// GL.  NEON on ARM, portable C elsewhere; both give the same bytes.
+//
+// The source is usually a picture in carveout as OmxrVideoDecodeAccelerator
+// maps it, which may be uncached.  The kernels read it in one sequential
+// pass of wide loads, each byte once (a chroma row serves both of its luma
+// rows), and never read back what they write.
+namespace omxr_nv12 {
+
+// An NV12 picture: |size| luma samples, then interleaved U and V samples of
+// each 2x2 block.
+struct Picture {
+  const uint8_t* y = nullptr;
+  int y_stride = 0;
+  const uint8_t* uv = nullptr;
+  int uv_stride = 0;
+  gfx::Size size;
+};
+
+enum class Matrix {
+  BT601,
+  BT709,
+};
+
+enum class Range {
+  // Luma in [16, 235], chroma in [16, 240].
+  LIMITED,
+  FULL,
+};
+
+// Splits the chroma into planar U and V.
+MEDIA_GPU_EXPORT void ConvertToI420(const Picture& src,
+                                    uint8_t* dst_y,
+                                    int dst_y_stride,
+                                    uint8_t* dst_u,
+                                    int dst_u_stride,
+                                    uint8_t* dst_v,
+                                    int dst_v_stride);
+
+// Writes R, G, B and an opaque A byte per pixel.  Luma below the limited
+// range is taken as black.
+MEDIA_GPU_EXPORT void ConvertToRGBA(const Picture& src,
+                                    Matrix matrix,
+                                    Range range,
+                                    uint8_t* dst_rgba,
+                                    int dst_stride);
+
+// Box filters |src| by |factor|, 2 or 4, into an NV12 picture of
+// src.size / |factor|, rounded down.
+MEDIA_GPU_EXPORT void Downscale(const Picture& src,
+                                int factor,
+                                uint8_t* dst_y,
+                                int dst_y_stride,
+                                uint8_t* dst_uv,
+                                int dst_uv_stride);
+
+// A checksum of the samples of |src|, not of its padding, for comparing
+// decoded pictures with golden values.  Fast rather than cryptographic.
+MEDIA_GPU_EXPORT uint64_t Checksum(const Picture& src);
+
+// Whether the kernels above use NEON.
+MEDIA_GPU_EXPORT bool UsesNeon();
+// Makes the kernels use portable C even where NEON is available, to compare
+// both.
+MEDIA_GPU_EXPORT void SetPortableForTesting(bool portable);
+
+}  // namespace omxr_nv12
+}  // namespace media
+
+#endif  // MEDIA_GPU_OMX_OMXR_NV12_KERNELS_H_
@@ -0,0 +1,121 @@
+// Copyright (c) 2019 Renesas Electronics Corporation
+// Use of this source code is governed by a BSD-style license that can be
+// found in the LICENSE file.
+
+#include <stdint.h>
+
+#include <string>
+#include <vector>
+
+#include "base/callback.h"
+#include "base/time/time.h"
+#include "media/gpu/omx/omxr_nv12_kernels.h"
+#include "testing/gtest/include/gtest/gtest.h"
+#include "testing/perf/perf_test.h"
+
+namespace media {
+namespace omxr_nv12 {
+namespace {
+
+const int kWidth = 1920;
+const int kHeight = 1080;
+// Like the decoder's output, rows are padded to its stride alignment.
+const int kStride = 2048;
+const int kRuns = 60;
+
+// Runs every kernel on a 1080p picture in heap memory, with NEON and with
+// portable C.  This compares the kernels; omxr_decode_bench --convert
+// measures them on real, uncached carveout.
+class OmxrNV12KernelsPerfTest : public testing::Test {
+ protected:
+  OmxrNV12KernelsPerfTest()
+      : y_(kStride * kHeight),
+        uv_(kStride * kHeight / 2),
+        dst_(kWidth * kHeight * 4) {
+    uint32_t seed = 1;
+    for (auto* plane : {&y_, &uv_}) {
+      for (uint8_t& sample : *plane) {
+        seed = seed * 1103515245 + 12345;
+        sample = seed >> 16;
+      }
+    }
+    src_.y = y_.data();
+    src_.y_stride = kStride;
+    src_.uv = uv_.data();
+    src_.uv_stride = kStride;
+    src_.size = gfx::Size(kWidth, kHeight);
+  }
+
+  void Measure(const std::string& kernel, const base::Closure& run) {
+    for (bool portable : {false, true}) {
+      SetPortableForTesting(portable);
+      if (!portable && !UsesNeon())
+        continue;
+      run.Run();
+      base::TimeTicks start = base::TimeTicks::Now();
+      for (int i = 0; i < kRuns; ++i)
+        run.Run();
+      base::TimeDelta elapsed = base::TimeTicks::Now() - start;
+
+      std::string trace = kernel + (portable ? "_portable" : "_neon");
+      perf_test::PrintResult("omxr_nv12_kernels", "_frames_per_second", trace,
+                             kRuns / elapsed.InSecondsF(), "fps", true);
+      perf_test::PrintResult(
+          "omxr_nv12_kernels", "_read", trace,
+          kRuns * kWidth * kHeight * 3 / 2 / elapsed.InSecondsF() /
+              (1024 * 1024),
+          "MB/s", true);
+    }
+    SetPortableForTesting(false);
+  }
+
+  std::vector<uint8_t> y_;
+  std::vector<uint8_t> uv_;
+  std::vector<uint8_t> dst_;
+  Picture src_;
+};
+
+TEST_F(OmxrNV12KernelsPerfTest, ConvertToI420) {
+  uint8_t* dst = dst_.data();
+  Measure("i420", base::Bind(
+                      [](const Picture& src, uint8_t* dst) {
+                        ConvertToI420(src, dst, kWidth, dst + kWidth * kHeight,
+                                      kWidth / 2,
+                                      dst + kWidth * kHeight * 5 / 4,
+                                      kWidth / 2);
+                      },
+                      src_, dst));
+}
+
+TEST_F(OmxrNV12KernelsPerfTest, ConvertToRGBA) {
+  uint8_t* dst = dst_.data();
+  Measure("rgba", base::Bind(
+                      [](const Picture& src, uint8_t* dst) {
+                        ConvertToRGBA(src, Matrix::BT601, Range::LIMITED, dst,
+                                      kWidth * 4);
+                      },
+                      src_, dst));
+}
+
+TEST_F(OmxrNV12KernelsPerfTest, Downscale) {
+  uint8_t* dst = dst_.data();
+  for (int factor : {2, 4}) {
+    Measure("downscale" + std::to_string(factor),
+            base::Bind(
+                [](const Picture& src, int factor, uint8_t* dst) {
+                  int width = kWidth / factor;
+                  Downscale(src, factor, dst, width,
+                            dst + width * (kHeight / factor), width);
+                },
+                src_, factor, dst));
+  }
+}
+
+TEST_F(OmxrNV12KernelsPerfTest, Checksum) {
+  Measure("checksum",
+          base::Bind([](const Picture& src) { Checksum(src); }, src_));
+}
+
+}  // namespace
+}  // namespace omxr_nv12
+}  // namespace media
@@ -0,0 +1,203 @@
+// Copyright (c) 2019 Renesas Electronics Corporation
+// Use of this source code is governed by a BSD-style license that can be
+// found in the LICENSE file.
+
+#include "media/gpu/omx/omxr_nv12_kernels.h"
+
+#include <stdint.h>
+
+#include <algorithm>
+#include <vector>
+
+#include "testing/gtest/include/gtest/gtest.h"
+
+namespace media {
+namespace omxr_nv12 {
+namespace {
+
+// An NV12 picture in memory of its own, with padded rows like carveout.
+struct TestPicture {
+  TestPicture(int width, int height)
+      : stride(width + 24), y(stride * height), uv(stride * ((height + 1) / 2)) {
+    picture.y = y.data();
+    picture.y_stride = stride;
+    picture.uv = uv.data();
+    picture.uv_stride = stride;
+    picture.size = gfx::Size(width, height);
+  }
+
+  void Fill(uint8_t luma, uint8_t u, uint8_t v) {
+    std::fill(y.begin(), y.end(), luma);
+    for (size_t i = 0; i + 1 < uv.size(); i += 2) {
+      uv[i] = u;
+      uv[i + 1] = v;
+    }
+  }
+
+  void FillPseudoRandom() {
+    uint32_t seed = 1;
+    for (auto* plane : {&y, &uv}) {
+      for (uint8_t& sample : *plane) {
+        seed = seed * 1103515245 + 12345;
+        sample = seed >> 16;
+      }
+    }
+  }
+
+  int stride;
+  std::vector<uint8_t> y;
+  std::vector<uint8_t> uv;
+  Picture picture;
+};
+
+std::vector<uint8_t> ToRGBA(const Picture& picture,
+                            Matrix matrix,
+                            Range range) {
+  std::vector<uint8_t> rgba(picture.size.GetArea() * 4);
+  ConvertToRGBA(picture, matrix, range, rgba.data(),
+                picture.size.width() * 4);
+  return rgba;
+}
+
+TEST(OmxrNV12KernelsTest, ConvertToRGBAReferenceColors) {
+  const struct {
+    Matrix matrix;
+    Range range;
+    uint8_t y, u, v;
+    uint8_t r, g, b;
+  } kColors[] = {
+      {Matrix::BT601, Range::LIMITED, 16, 128, 128, 0, 0, 0},
+      {Matrix::BT601, Range::LIMITED, 235, 128, 128, 255, 255, 255},
+      {Matrix::BT601, Range::LIMITED, 81, 90, 240, 255, 0, 0},
+      {Matrix::BT601, Range::FULL, 0, 128, 128, 0, 0, 0},
+      {Matrix::BT601, Range::FULL, 255, 128, 128, 255, 255, 255},
+      {Matrix::BT709, Range::LIMITED, 63, 102, 240, 255, 0, 0},
+      {Matrix::BT709, Range::LIMITED, 173, 42, 26, 0, 255, 0},
+      {Matrix::BT709, Range::FULL, 18, 255, 116, 0, 0, 255},
+  };
+  for (const auto& color : kColors) {
+    TestPicture picture(34, 6);
+    picture.Fill(color.y, color.u, color.v);
+    std::vector<uint8_t> rgba =
+        ToRGBA(picture.picture, color.matrix, color.range);
+    for (size_t i = 0; i < rgba.size(); i += 4) {
+      EXPECT_NEAR(color.r, rgba[i], 2) << i;
+      EXPECT_NEAR(color.g, rgba[i + 1], 2) << i;
+      EXPECT_NEAR(color.b, rgba[i + 2], 2) << i;
+      EXPECT_EQ(255, rgba[i + 3]) << i;
+    }
+  }
+}
+
+TEST(OmxrNV12KernelsTest, ConvertToI420SplitsChroma) {
+  TestPicture picture(37, 9);
+  picture.FillPseudoRandom();
+  const int chroma_width = 19;
+  const int chroma_height = 5;
+  std::vector<uint8_t> y(37 * 9), u(chroma_width * chroma_height),
+      v(chroma_width * chroma_height);
+  ConvertToI420(picture.picture, y.data(), 37, u.data(), chroma_width,
+                v.data(), chroma_width);
+  for (int row = 0; row < 9; ++row) {
+    for (int col = 0; col < 37; ++col)
+      ASSERT_EQ(picture.y[row * picture.stride + col], y[row * 37 + col]);
+  }
+  for (int row = 0; row < chroma_height; ++row) {
+    for (int col = 0; col < chroma_width; ++col) {
+      const uint8_t* uv = &picture.uv[row * picture.stride + 2 * col];
+      ASSERT_EQ(uv[0], u[row * chroma_width + col]);
+      ASSERT_EQ(uv[1], v[row * chroma_width + col]);
+    }
+  }
+}
+
+TEST(OmxrNV12KernelsTest, DownscaleAveragesBlocks) {
+  TestPicture picture(8, 8);
+  picture.Fill(0, 100, 200);
+  for (int row = 0; row < 8; ++row) {
+    for (int col = 0; col < 8; ++col)
+      picture.y[row * picture.stride + col] = row * 8 + col;
+  }
+
+  std::vector<uint8_t> y(4 * 4), uv(4 * 2);
+  Downscale(picture.picture, 2, y.data(), 4, uv.data(), 4);
+  // (0 + 1 + 8 + 9) / 4, rounded.
+  EXPECT_EQ(5, y[0]);
+  EXPECT_EQ(59, y[15]);
+  EXPECT_EQ(std::vector<uint8_t>({100, 200, 100, 200, 100, 200, 100, 200}),
+            uv);
+
+  Downscale(picture.picture, 4, y.data(), 2, uv.data(), 2);
+  EXPECT_EQ(14, y[0]);
+  EXPECT_EQ(50, y[3]);
+  EXPECT_EQ(100, uv[0]);
+  EXPECT_EQ(200, uv[1]);
+}
+
+TEST(OmxrNV12KernelsTest, ChecksumCoversSamplesOnly) {
+  TestPicture picture(37, 9);
+  picture.FillPseudoRandom();
+  uint64_t checksum = Checksum(picture.picture);
+
+  // The same samples with other padding.
+  TestPicture narrow(37, 9);
+  narrow.stride = 40;
+  narrow.picture.y_stride = narrow.picture.uv_stride = 40;
+  for (int row = 0; row < 9; ++row) {
+    std::copy_n(&picture.y[row * picture.stride], 37, &narrow.y[row * 40]);
+    if (row < 5)
+      std::copy_n(&picture.uv[row * picture.stride], 38, &narrow.uv[row * 40]);
+  }
+  EXPECT_EQ(checksum, Checksum(narrow.picture));
+
+  picture.y[8 * picture.stride + 36] ^= 1;
+  EXPECT_NE(checksum, Checksum(picture.picture));
+  picture.y[8 * picture.stride + 36] ^= 1;
+  picture.uv[4 * picture.stride + 37] ^= 1;
+  EXPECT_NE(checksum, Checksum(picture.picture));
+  picture.uv[4 * picture.stride + 37] ^= 1;
+  picture.picture.size = gfx::Size(36, 9);
+  EXPECT_NE(checksum, Checksum(picture.picture));
+}
+
+// NEON must give the same bytes as the portable kernels, including at the
+// edges that the vectors do not cover.
+TEST(OmxrNV12KernelsTest, NeonMatchesPortable) {
+  TestPicture picture(1922, 67);
+  picture.FillPseudoRandom();
+  const Picture& src = picture.picture;
+
+  std::vector<std::vector<uint8_t>> outputs[2];
+  uint64_t checksums[2];
+  for (int portable = 0; portable < 2; ++portable) {
+    SetPortableForTesting(portable);
+    checksums[portable] = Checksum(src);
+    outputs[portable].push_back(ToRGBA(src, Matrix::BT601, Range::LIMITED));
+    outputs[portable].push_back(ToRGBA(src, Matrix::BT709, Range::FULL));
+
+    std::vector<uint8_t> i420(1922 * 67 + 2 * 961 * 34);
+    ConvertToI420(src, i420.data(), 1922, i420.data() + 1922 * 67, 961,
+                  i420.data() + 1922 * 67 + 961 * 34, 961);
+    outputs[portable].push_back(i420);
+
+    for (int factor : {2, 4}) {
+      int width = 1922 / factor;
+      int height = 67 / factor;
+      int chroma_stride = (width + 1) / 2 * 2;
+      std::vector<uint8_t> scaled(width * height +
+                                  chroma_stride * ((height + 1) / 2));
+      Downscale(src, factor, scaled.data(), width,
+                scaled.data() + width * height, chroma_stride);
+      outputs[portable].push_back(scaled);
+    }
+  }
+  SetPortableForTesting(false);
+
+  for (size_t i = 0; i < outputs[0].size(); ++i)
+    EXPECT_EQ(outputs[1][i], outputs[0][i]) << "Output " << i;
+  EXPECT_EQ(checksums[1], checksums[0]);
+}
+
+}  // namespace
+}  // namespace omxr_nv12
+}  // namespace media
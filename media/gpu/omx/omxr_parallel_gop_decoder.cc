@@ -0,0 +1,208 @@
+// Copyright (c) 2019 Renesas Electronics Corporation
+// Use of this source code is governed by a BSD-style license that can be
+// found in the LICENSE file.
+
+#include "media/gpu/omx/omxr_parallel_gop_decoder.h"
+
+#include <algorithm>
+#include <utility>
+
+#include "base/bind.h"
+#include "base/logging.h"
+#include "base/threading/thread_task_runner_handle.h"
+#include "media/gpu/omx/omxr_features.h"
+
+namespace media {
+
+// static
+std::unique_ptr<OmxrParallelGopDecoder> OmxrParallelGopDecoder::Create(
+    EGLDisplay egl_display,
+    const base::Callback<bool(void)>& make_context_current,
+    int lanes,
+    int reorder_pictures) {
+  lanes = std::max(1, std::min(lanes, kOmxrMaxComponents.Get()));
+  return std::make_unique<OmxrParallelGopDecoder>(
+      lanes, reorder_pictures,
+      OmxrDecoderGroup::HardwareFactory(egl_display, make_context_current));
+}
+
+OmxrParallelGopDecoder::OmxrParallelGopDecoder(
+    int lanes,
+    int reorder_pictures,
+    const LaneFactory& lane_factory)
+    : lane_count_(lanes),
+      reorder_pictures_(reorder_pictures),
+      lane_factory_(lane_factory),
+      lanes_(this),
+      scheduler_(lanes, this),
+      error_notified_(false) {}
+
+OmxrParallelGopDecoder::~OmxrParallelGopDecoder() {
+  DCHECK_CALLED_ON_VALID_THREAD(thread_checker_);
+}
+
+bool OmxrParallelGopDecoder::Initialize(const Config& config, Client* client) {
+  DCHECK_CALLED_ON_VALID_THREAD(thread_checker_);
+  if (config.profile < H264PROFILE_MIN || config.profile > H264PROFILE_MAX) {
+    DLOG(ERROR) << "Parallel GOP decoding needs H.264, got "
+                << GetProfileName(config.profile);
+    return false;
+  }
+
+  client_ptr_factory_.reset(new base::WeakPtrFactory<Client>(client));
+  client_ = client_ptr_factory_->GetWeakPtr();
+
+  for (int i = 0; i < lane_count_; ++i) {
+    if (!lanes_.Add(lane_factory_, config))
+      return false;
+  }
+  VLOG(1) << "Parallel GOP decoding on " << lane_count_ << " lanes";
+  return true;
+}
+
+void OmxrParallelGopDecoder::Decode(const BitstreamBuffer& bitstream_buffer) {
+  DCHECK_CALLED_ON_VALID_THREAD(thread_checker_);
+  OmxrDecoderGroup::Input input(bitstream_buffer);
+  if (!lanes_.Parse(&input))
+    return;
+  inputs_.emplace(bitstream_buffer.id(), input);
+  scheduler_.AddInput(bitstream_buffer.id(), input.keyframe);
+}
+
+void OmxrParallelGopDecoder::AssignPictureBuffers(
+    const std::vector<PictureBuffer>& buffers) {
+  DCHECK_CALLED_ON_VALID_THREAD(thread_checker_);
+  if (!lanes_.AssignPictureBuffers(buffers)) {
+    DLOG(ERROR) << "No lane asked for picture buffers";
+    OnError(INVALID_ARGUMENT);
+  }
+}
+
+void OmxrParallelGopDecoder::ReusePictureBuffer(int32_t picture_buffer_id) {
+  DCHECK_CALLED_ON_VALID_THREAD(thread_checker_);
+  lanes_.ReusePictureBuffer(picture_buffer_id);
+}
+
+void OmxrParallelGopDecoder::Flush() {
+  DCHECK_CALLED_ON_VALID_THREAD(thread_checker_);
+  scheduler_.Flush();
+}
+
+void OmxrParallelGopDecoder::Reset() {
+  DCHECK_CALLED_ON_VALID_THREAD(thread_checker_);
+  std::vector<int32_t> dropped_inputs;
+  std::vector<std::pair<int, int32_t>> held_pictures;
+  scheduler_.Reset(&dropped_inputs, &held_pictures);
+
+  for (int32_t bitstream_id : dropped_inputs) {
+    auto it = inputs_.find(bitstream_id);
+    it->second.buffer.handle().Close();
+    inputs_.erase(it);
+    base::ThreadTaskRunnerHandle::Get()->PostTask(
+        FROM_HERE,
+        base::Bind(&Client::NotifyEndOfBitstreamBuffer, client_, bitstream_id));
+  }
+  for (const auto& held : held_pictures) {
+    lane_pictures_.erase(held.second);
+    lanes_.decoder(held.first)->ReusePictureBuffer(held.second);
+  }
+  lanes_.Reset();
+}
+
+void OmxrParallelGopDecoder::Destroy() {
+  DCHECK_CALLED_ON_VALID_THREAD(thread_checker_);
+  client_ptr_factory_.reset();
+  lanes_.DestroyDecoders();
+  for (auto& input : inputs_)
+    input.second.buffer.handle().Close();
+  delete this;
+}
+
+void OmxrParallelGopDecoder::SubmitToLane(int lane,
+                                          int32_t bitstream_id,
+                                          bool starts_gop) {
+  auto it = inputs_.find(bitstream_id);
+  DCHECK(it != inputs_.end());
+  lanes_.Decode(lane, it->second, starts_gop);
+  inputs_.erase(it);
+}
+
+void OmxrParallelGopDecoder::FlushLane(int lane) {
+  lanes_.decoder(lane)->Flush();
+}
+
+void OmxrParallelGopDecoder::DeliverPicture(int32_t picture_buffer_id) {
+  auto it = lane_pictures_.find(picture_buffer_id);
+  DCHECK(it != lane_pictures_.end());
+  Picture picture = it->second;
+  lane_pictures_.erase(it);
+  if (client_)
+    client_->PictureReady(picture);
+}
+
+void OmxrParallelGopDecoder::FlushDone() {
+  // May come right from Flush().
+  base::ThreadTaskRunnerHandle::Get()->PostTask(
+      FROM_HERE, base::Bind(&Client::NotifyFlushDone, client_));
+}
+
+void OmxrParallelGopDecoder::OnInitializationComplete(bool success) {
+  if (client_)
+    client_->NotifyInitializationComplete(success);
+}
+
+void OmxrParallelGopDecoder::OnProvidePictureBuffers(
+    int lane,
+    uint32_t requested_num_of_buffers,
+    VideoPixelFormat format,
+    uint32_t textures_per_buffer,
+    const gfx::Size& dimensions,
+    uint32_t texture_target) {
+  if (client_) {
+    client_->ProvidePictureBuffers(requested_num_of_buffers + reorder_pictures_,
+                                   format, textures_per_buffer, dimensions,
+                                   texture_target);
+  }
+}
+
+void OmxrParallelGopDecoder::OnDismissPictureBuffer(
+    int32_t picture_buffer_id) {
+  lane_pictures_.erase(picture_buffer_id);
+  if (client_)
+    client_->DismissPictureBuffer(picture_buffer_id);
+}
+
+void OmxrParallelGopDecoder::OnPictureReady(int lane,
+                                            const Picture& picture) {
+  int32_t picture_buffer_id = picture.picture_buffer_id();
+  lane_pictures_.emplace(picture_buffer_id, picture);
+  if (!scheduler_.OnLanePicture(lane, picture_buffer_id)) {
+    lane_pictures_.erase(picture_buffer_id);
+    lanes_.decoder(lane)->ReusePictureBuffer(picture_buffer_id);
+  }
+}
+
+void OmxrParallelGopDecoder::OnEndOfBitstreamBuffer(
+    int32_t bitstream_buffer_id) {
+  if (client_)
+    client_->NotifyEndOfBitstreamBuffer(bitstream_buffer_id);
+}
+
+void OmxrParallelGopDecoder::OnFlushDone(int lane) {
+  scheduler_.OnLaneFlushDone(lane);
+}
+
+void OmxrParallelGopDecoder::OnResetDone() {
+  if (client_)
+    client_->NotifyResetDone();
+}
+
+void OmxrParallelGopDecoder::OnError(Error error) {
+  if (error_notified_)
+    return;
+  error_notified_ = true;
+  if (client_)
+    client_->NotifyError(error);
+}
+
+}  // namespace media
@@ -0,0 +1,110 @@
+// Copyright (c) 2019 Renesas Electronics Corporation
+// Use of this source code is governed by a BSD-style license that can be
+// found in the LICENSE file.
+
+#ifndef MEDIA_GPU_OMX_OMXR_PARALLEL_GOP_DECODER_H_
+#define MEDIA_GPU_OMX_OMXR_PARALLEL_GOP_DECODER_H_
+
+#include <stdint.h>
+
+#include <map>
+#include <memory>
+#include <vector>
+
+#include "base/callback.h"
+#include "base/macros.h"
+#include "base/memory/weak_ptr.h"
+#include "base/threading/thread_checker.h"
+#include "media/gpu/media_gpu_export.h"
+#include "media/gpu/omx/omxr_decoder_group.h"
+#include "media/gpu/omx/omxr_gop_scheduler.h"
+#include "media/video/picture.h"
+#include "media/video/video_decode_accelerator.h"
+#include "ui/gl/gl_bindings.h"
+
+namespace media {
+
+// Offline decoding faster than real time: the GOPs of an H.264 stream are
+// decoded concurrently on a number of lane decoders, one component each, and
+// their pictures put back in stream order (see OmxrGopScheduler).  For files
+// and archives only; a live stream has no GOPs ahead to work on.
+//
+// Each lane asks our client for |reorder_pictures| more pictures than it
+// needs itself, so that it can run that far ahead of the GOP being output.
+// GOPs not starting with their own parameter sets get the latest ones seen
+// in the stream.  Annex-B input only.
+class MEDIA_GPU_EXPORT OmxrParallelGopDecoder
+    : public VideoDecodeAccelerator,
+      public OmxrGopScheduler::Delegate,
+      public OmxrDecoderGroup::Delegate {
+ public:
+  using LaneFactory = OmxrDecoderGroup::DecoderFactory;
+
+  // Lanes are OmxrVideoDecodeAccelerators, at most as many as the decode IP
+  // hosts components (kOmxrMaxComponents).
+  static std::unique_ptr<OmxrParallelGopDecoder> Create(
+      EGLDisplay egl_display,
+      const base::Callback<bool(void)>& make_context_current,
+      int lanes,
+      int reorder_pictures);
+
+  OmxrParallelGopDecoder(int lanes,
+                         int reorder_pictures,
+                         const LaneFactory& lane_factory);
+  ~OmxrParallelGopDecoder() override;
+
+  // media::VideoDecodeAccelerator implementation.
+  bool Initialize(const Config& config, Client* client) override;
+  void Decode(const BitstreamBuffer& bitstream_buffer) override;
+  void AssignPictureBuffers(const std::vector<PictureBuffer>& buffers) override;
+  void ReusePictureBuffer(int32_t picture_buffer_id) override;
+  void Flush() override;
+  void Reset() override;
+  void Destroy() override;
+
+ private:
+  // OmxrGopScheduler::Delegate implementation.
+  void SubmitToLane(int lane, int32_t bitstream_id, bool starts_gop) override;
+  void FlushLane(int lane) override;
+  void DeliverPicture(int32_t picture_buffer_id) override;
+  void FlushDone() override;
+
+  // OmxrDecoderGroup::Delegate implementation.  Lanes are the decoders of
+  // |lanes_|.
+  void OnInitializationComplete(bool success) override;
+  void OnProvidePictureBuffers(int lane,
+                               uint32_t requested_num_of_buffers,
+                               VideoPixelFormat format,
+                               uint32_t textures_per_buffer,
+                               const gfx::Size& dimensions,
+                               uint32_t texture_target) override;
+  void OnDismissPictureBuffer(int32_t picture_buffer_id) override;
+  void OnPictureReady(int lane, const Picture& picture) override;
+  void OnEndOfBitstreamBuffer(int32_t bitstream_buffer_id) override;
+  void OnFlushDone(int lane) override;
+  void OnResetDone() override;
+  void OnError(Error error) override;
+
+  const int lane_count_;
+  const int reorder_pictures_;
+  const LaneFactory lane_factory_;
+  OmxrDecoderGroup lanes_;
+  OmxrGopScheduler scheduler_;
+
+  std::unique_ptr<base::WeakPtrFactory<Client>> client_ptr_factory_;
+  base::WeakPtr<Client> client_;
+  bool error_notified_;
+
+  // Input waiting for its lane.
+  std::map<int32_t, OmxrDecoderGroup::Input> inputs_;
+  // Decoded pictures not delivered yet.
+  std::map<int32_t, Picture> lane_pictures_;
+
+  THREAD_CHECKER(thread_checker_);
+
+  DISALLOW_COPY_AND_ASSIGN(OmxrParallelGopDecoder);
+};
+
+}  // namespace media
+
+#endif  // MEDIA_GPU_OMX_OMXR_PARALLEL_GOP_DECODER_H_
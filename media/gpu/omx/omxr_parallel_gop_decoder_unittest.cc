@@ -0,0 +1,160 @@
+// Copyright (c) 2019 Renesas Electronics Corporation
+// Use of this source code is governed by a BSD-style license that can be
+// found in the LICENSE file.
+
+#include "media/gpu/omx/omxr_parallel_gop_decoder.h"
+
+#include <string.h>
+
+#include <memory>
+#include <vector>
+
+#include "base/bind.h"
+#include "base/memory/shared_memory.h"
+#include "base/test/scoped_task_environment.h"
+#include "media/gpu/omx/omxr_h264_stream_generator.h"
+#include "media/gpu/omx/omxr_vda_test_util.h"
+#include "testing/gtest/include/gtest/gtest.h"
+
+namespace media {
+namespace {
+
+const int kLanes = 2;
+const int kReorderPictures = 2;
+const int32_t kFirstOwnBitstreamId = 0x40000000;
+
+class OmxrParallelGopDecoderTest : public testing::Test {
+ protected:
+  OmxrParallelGopDecoderTest()
+      : decoder_(new OmxrParallelGopDecoder(
+            kLanes,
+            kReorderPictures,
+            base::Bind(&OmxrParallelGopDecoderTest::CreateLane,
+                       base::Unretained(this)))) {
+    OmxrH264StreamGenerator::Config config;
+    config.gop_length = 3;
+    // Only the first GOP brings parameter sets.
+    config.parameter_sets_every_gop = false;
+    generator_.reset(new OmxrH264StreamGenerator(config));
+  }
+
+  ~OmxrParallelGopDecoderTest() override { decoder_->Destroy(); }
+
+  std::unique_ptr<VideoDecodeAccelerator> CreateLane() {
+    lanes_.push_back(new OmxrFakeVideoDecodeAccelerator());
+    return std::unique_ptr<VideoDecodeAccelerator>(lanes_.back());
+  }
+
+  bool Initialize(VideoCodecProfile profile) {
+    return decoder_->Initialize(VideoDecodeAccelerator::Config(profile),
+                                &client_);
+  }
+
+  // Decodes the next |count| access units of the stream, one buffer each.
+  void DecodeAccessUnits(int count) {
+    for (int i = 0; i < count; ++i) {
+      std::vector<uint8_t> access_unit;
+      generator_->AppendAccessUnit(&access_unit);
+      base::SharedMemory shm;
+      ASSERT_TRUE(shm.CreateAndMapAnonymous(access_unit.size()));
+      memcpy(shm.memory(), access_unit.data(), access_unit.size());
+      decoder_->Decode(BitstreamBuffer(next_bitstream_id_++, shm.TakeHandle(),
+                                       access_unit.size()));
+    }
+  }
+
+  base::test::ScopedTaskEnvironment task_environment_;
+  VideoDecodeAccelerator* decoder_;
+  std::unique_ptr<OmxrH264StreamGenerator> generator_;
+  // Owned by their lanes in |decoder_|.
+  std::vector<OmxrFakeVideoDecodeAccelerator*> lanes_;
+  int32_t next_bitstream_id_ = 0;
+  OmxrRecordingVdaClient client_;
+};
+
+TEST_F(OmxrParallelGopDecoderTest, RejectsOtherCodecs) {
+  EXPECT_FALSE(Initialize(VP8PROFILE_ANY));
+  EXPECT_TRUE(lanes_.empty());
+}
+
+TEST_F(OmxrParallelGopDecoderTest, SpreadsGopsOverLanes) {
+  ASSERT_TRUE(Initialize(H264PROFILE_MAIN));
+  ASSERT_EQ(static_cast<size_t>(kLanes), lanes_.size());
+  DecodeAccessUnits(6);
+
+  EXPECT_EQ(std::vector<int32_t>({0, 1, 2}), lanes_[0]->decoded());
+  // The second GOP brings no parameter sets of its own; its lane gets those
+  // of the first in a buffer ahead of it.
+  ASSERT_EQ(4u, lanes_[1]->decoded().size());
+  int32_t own_id = lanes_[1]->decoded()[0];
+  EXPECT_GE(own_id, kFirstOwnBitstreamId);
+  EXPECT_EQ(std::vector<int32_t>({own_id, 3, 4, 5}), lanes_[1]->decoded());
+  const std::vector<uint8_t>& parameter_sets = lanes_[1]->decoded_data()[0];
+  ASSERT_GE(parameter_sets.size(), 5u);
+  EXPECT_EQ(0x67, parameter_sets[4]);
+
+  // Only the client's buffers are handed back to it.
+  lanes_[1]->client()->NotifyEndOfBitstreamBuffer(own_id);
+  lanes_[1]->client()->NotifyEndOfBitstreamBuffer(3);
+  EXPECT_EQ(std::vector<int32_t>({3}), client_.ended());
+}
+
+TEST_F(OmxrParallelGopDecoderTest, DeliversPicturesInStreamOrder) {
+  ASSERT_TRUE(Initialize(H264PROFILE_MAIN));
+  DecodeAccessUnits(6);
+  decoder_->Flush();
+  EXPECT_EQ(1, lanes_[0]->flushes());
+  EXPECT_EQ(1, lanes_[1]->flushes());
+
+  // The second lane is ahead; its pictures wait for the first GOP.
+  lanes_[1]->OutputPicture(110, 3);
+  lanes_[0]->OutputPicture(100, 0);
+  lanes_[0]->OutputPicture(101, 1);
+  EXPECT_EQ(std::vector<int32_t>({100, 101}), client_.pictures());
+  lanes_[0]->OutputPicture(102, 2);
+  lanes_[0]->client()->NotifyFlushDone();
+  EXPECT_EQ(std::vector<int32_t>({100, 101, 102, 110}), client_.pictures());
+
+  lanes_[1]->OutputPicture(111, 4);
+  lanes_[1]->OutputPicture(112, 5);
+  lanes_[1]->client()->NotifyFlushDone();
+  task_environment_.RunUntilIdle();
+  EXPECT_EQ(std::vector<int32_t>({100, 101, 102, 110, 111, 112}),
+            client_.pictures());
+  EXPECT_EQ(1, client_.flush_done());
+}
+
+TEST_F(OmxrParallelGopDecoderTest, PicturesGoToTheLaneThatAsked) {
+  ASSERT_TRUE(Initialize(H264PROFILE_MAIN));
+  lanes_[1]->client()->ProvidePictureBuffers(4, PIXEL_FORMAT_NV12, 1,
+                                             gfx::Size(320, 240), 0);
+  EXPECT_EQ(std::vector<uint32_t>({4 + kReorderPictures}),
+            client_.requested_pictures());
+
+  std::vector<PictureBuffer> buffers;
+  for (int32_t id = 200; id < 206; ++id)
+    buffers.push_back(PictureBuffer(id, gfx::Size(320, 240)));
+  decoder_->AssignPictureBuffers(buffers);
+  EXPECT_TRUE(lanes_[0]->assigned().empty());
+  EXPECT_EQ(6u, lanes_[1]->assigned().size());
+
+  decoder_->ReusePictureBuffer(201);
+  EXPECT_EQ(std::vector<int32_t>({201}), lanes_[1]->reused());
+}
+
+TEST_F(OmxrParallelGopDecoderTest, ResetGivesBackHeldPictures) {
+  ASSERT_TRUE(Initialize(H264PROFILE_MAIN));
+  // Three GOPs; the third waits for a lane.
+  DecodeAccessUnits(9);
+  lanes_[1]->OutputPicture(110, 3);
+  EXPECT_TRUE(client_.pictures().empty());
+
+  decoder_->Reset();
+  EXPECT_EQ(std::vector<int32_t>({110}), lanes_[1]->reused());
+  EXPECT_EQ(1, client_.reset_done());
+  task_environment_.RunUntilIdle();
+  EXPECT_EQ(std::vector<int32_t>({6, 7, 8}), client_.ended());
+}
+
+}  // namespace
+}  // namespace media
@@ -0,0 +1,161 @@
+// Copyright (c) 2019 Renesas Electronics Corporation
+// Use of this source code is governed by a BSD-style license that can be
+// found in the LICENSE file.
+
+#include "media/gpu/omx/omxr_picture_preallocator.h"
+
+#include "base/bind.h"
+#include "base/location.h"
+#include "base/logging.h"
+#include "base/task_runner_util.h"
+#include "base/threading/thread.h"
+#include "base/trace_event/trace_event.h"
+#include "media/gpu/omx/omxr_resource_tracker.h"
+
+#include "media/gpu/omx/omx_stubs.h"
+
+namespace media {
+
+namespace {
+
+// Padding beyond this is not taken as an alignment rule of the component.
+constexpr int kMaxAlignment = 256;
+
+int LargestPowerOfTwoDividing(int value) {
+  int alignment = 1;
+  while (alignment < kMaxAlignment && value % (alignment * 2) == 0)
+    alignment *= 2;
+  return alignment;
+}
+
+size_t AlignUp(size_t value, size_t alignment) {
+  return (value + alignment - 1) / alignment * alignment;
+}
+
+// Shared by all decoders; the allocations are short and rare.  Null if the
+// thread cannot be started.
+scoped_refptr<base::SingleThreadTaskRunner> AllocationTaskRunner() {
+  static base::Thread* const thread = [] {
+    base::Thread* thread = new base::Thread("OmxrPreallocator");
+    if (!thread->Start()) {
+      delete thread;
+      return static_cast<base::Thread*>(nullptr);
+    }
+    return thread;
+  }();
+  return thread ? thread->task_runner() : nullptr;
+}
+
+}  // namespace
+
+// static
+size_t OmxrPicturePreallocator::PredictAllocSize(const gfx::Size& coded_size,
+                                                 const Geometry& known,
+                                                 size_t page_size) {
+  if (known.stride <= 0 || known.slice_height <= 0 || coded_size.IsEmpty())
+    return 0;
+  size_t stride =
+      AlignUp(coded_size.width(), LargestPowerOfTwoDividing(known.stride));
+  size_t slice_height = AlignUp(coded_size.height(),
+                                LargestPowerOfTwoDividing(known.slice_height));
+  // Whatever the component adds behind the planes, it adds again.
+  size_t known_planes =
+      static_cast<size_t>(known.stride) * known.slice_height * 3 / 2;
+  size_t extra =
+      known.alloc_size > known_planes ? known.alloc_size - known_planes : 0;
+  return AlignUp(stride * slice_height * 3 / 2 + extra, page_size);
+}
+
+OmxrPicturePreallocator::OmxrPicturePreallocator()
+    : generation_(0), size_(0), weak_factory_(this) {}
+
+OmxrPicturePreallocator::~OmxrPicturePreallocator() {
+  DCHECK_CALLED_ON_VALID_THREAD(thread_checker_);
+  Clear();
+}
+
+void OmxrPicturePreallocator::Prepare(size_t size, int count) {
+  DCHECK_CALLED_ON_VALID_THREAD(thread_checker_);
+  if (size == size_)
+    return;
+  Clear();
+  scoped_refptr<base::SingleThreadTaskRunner> task_runner =
+      AllocationTaskRunner();
+  if (!task_runner || !size)
+    return;
+
+  DVLOG(1) << "Preparing " << count << " pictures of " << size << " bytes";
+  size_ = size;
+  // One block per task, so that the first ones are ready before the last.
+  for (int i = 0; i < count; ++i) {
+    base::PostTaskAndReplyWithResult(
+        task_runner.get(), FROM_HERE,
+        base::BindOnce(&OmxrPicturePreallocator::AllocateBlock, size),
+        base::BindOnce(&OmxrPicturePreallocator::OnBlockAllocated,
+                       weak_factory_.GetWeakPtr(), generation_));
+  }
+}
+
+bool OmxrPicturePreallocator::Take(size_t size, Block* block) {
+  DCHECK_CALLED_ON_VALID_THREAD(thread_checker_);
+  for (auto it = ready_.begin(); it != ready_.end(); ++it) {
+    if (it->size >= size) {
+      *block = *it;
+      ready_.erase(it);
+      return true;
+    }
+  }
+  return false;
+}
+
+void OmxrPicturePreallocator::Clear() {
+  DCHECK_CALLED_ON_VALID_THREAD(thread_checker_);
+  ++generation_;
+  size_ = 0;
+  for (const Block& block : ready_)
+    FreeBlock(block);
+  ready_.clear();
+}
+
+// static
+OmxrPicturePreallocator::Block OmxrPicturePreallocator::AllocateBlock(
+    size_t size) {
+  TRACE_EVENT1("media,gpu", "OmxrPicturePreallocator::AllocateBlock", "Size",
+               size);
+  Block block = {};
+  if (OmxrResourceTracker::Get()->AllocCarveout(
+          &block.mem_id, size, &block.hard_addr, &block.virt_addr)) {
+    DVLOG(1) << "Cannot allocate a picture of " << size << " bytes";
+    return block;
+  }
+  if (mmngr_export_start_in_user_ext(&block.dmabuf_id, size, block.hard_addr,
+                                     &block.dmabuf_fd, NULL)) {
+    DVLOG(1) << "Cannot export a picture of " << size << " bytes";
+    OmxrResourceTracker::Get()->FreeCarveout(block.mem_id);
+    return block;
+  }
+  block.size = size;
+  return block;
+}
+
+// static
+void OmxrPicturePreallocator::FreeBlock(const Block& block) {
+  mmngr_export_end_in_user_ext(block.dmabuf_id);
+  OmxrResourceTracker::Get()->FreeCarveout(block.mem_id);
+}
+
+// static
+void OmxrPicturePreallocator::OnBlockAllocated(
+    base::WeakPtr<OmxrPicturePreallocator> self,
+    int generation,
+    const Block& block) {
+  if (!block.size)
+    return;
+  if (!self || generation != self->generation_) {
+    FreeBlock(block);
+    return;
+  }
+  self->ready_.push_back(block);
+}
+
+}  // namespace media
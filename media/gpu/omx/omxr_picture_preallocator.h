@@ -0,0 +1,90 @@
+// Copyright (c) 2019 Renesas Electronics Corporation
+// Use of this source code is governed by a BSD-style license that can be
+// found in the LICENSE file.
+
+#ifndef MEDIA_GPU_OMX_OMXR_PICTURE_PREALLOCATOR_H_
+#define MEDIA_GPU_OMX_OMXR_PICTURE_PREALLOCATOR_H_
+
+#include <stddef.h>
+#include <stdint.h>
+
+#include <vector>
+
+#include "base/macros.h"
+#include "base/memory/weak_ptr.h"
+#include "base/threading/thread_checker.h"
+#include "media/gpu/media_gpu_export.h"
+#include "third_party/mmngr/mmngr_user_public.h"
+#include "ui/gfx/geometry/size.h"
+
+namespace media {
+
+// Allocates the carveout of output pictures and exports it as dmabufs on a
+// background thread, ahead of the resolution change that needs them.  The
+// decoder learns the new size from the SPS long before the component asks
+// for pictures of it, which is only once the old ones have drained; with
+// the blocks ready by then, the pictures only need their EGLImages.
+class MEDIA_GPU_EXPORT OmxrPicturePreallocator {
+ public:
+  // Carveout for one picture, exported as a dmabuf.
+  struct Block {
+    size_t size;
+    MMNGR_ID mem_id;
+    uint32_t hard_addr;
+    void* virt_addr;
+    int dmabuf_id;
+    int dmabuf_fd;
+  };
+
+  // How the component laid out the pictures it asked for last.
+  struct Geometry {
+    int stride;
+    int slice_height;
+    // Carveout per picture, rounded up to pages.
+    size_t alloc_size;
+  };
+
+  // Predicts the carveout per picture the component will ask for at
+  // |coded_size|, assuming it pads rows and the slice height as it did for
+  // |known|.  Errs on the large side, as a larger block serves too.  Returns
+  // 0 if |known| is empty.
+  static size_t PredictAllocSize(const gfx::Size& coded_size,
+                                 const Geometry& known,
+                                 size_t page_size);
+
+  OmxrPicturePreallocator();
+  // Frees the ready blocks; those still being allocated are freed as they
+  // come in.
+  ~OmxrPicturePreallocator();
+
+  // Starts allocating |count| blocks of |size| bytes, dropping any blocks of
+  // another size.  Does nothing if blocks of |size| are on their way already.
+  void Prepare(size_t size, int count);
+  // Hands out a ready block of at least |size| bytes, if there is one.  The
+  // caller frees it like any other picture's carveout.
+  bool Take(size_t size, Block* block);
+  // Frees the ready blocks and those still being allocated.
+  void Clear();
+
+ private:
+  static Block AllocateBlock(size_t size);
+  static void FreeBlock(const Block& block);
+  static void OnBlockAllocated(base::WeakPtr<OmxrPicturePreallocator> self,
+                               int generation,
+                               const Block& block);
+
+  // Bumped by Clear(), so that blocks allocated before are not kept.
+  int generation_;
+  size_t size_;
+  std::vector<Block> ready_;
+
+  THREAD_CHECKER(thread_checker_);
+
+  base::WeakPtrFactory<OmxrPicturePreallocator> weak_factory_;
+
+  DISALLOW_COPY_AND_ASSIGN(OmxrPicturePreallocator);
+};
+
+}  // namespace media
+
+#endif  // MEDIA_GPU_OMX_OMXR_PICTURE_PREALLOCATOR_H_
@@ -0,0 +1,54 @@
+// Copyright (c) 2019 Renesas Electronics Corporation
+// Use of this source code is governed by a BSD-style license that can be
+// found in the LICENSE file.
+
+#include "media/gpu/omx/omxr_picture_preallocator.h"
+
+#include "testing/gtest/include/gtest/gtest.h"
+
+namespace media {
+namespace {
+
+using Geometry = OmxrPicturePreallocator::Geometry;
+
+const size_t kPageSize = 4096;
+
+size_t PageAlign(size_t size) {
+  return (size + kPageSize - 1) / kPageSize * kPageSize;
+}
+
+TEST(OmxrPicturePreallocatorTest, PredictsTheKnownSizeAgain) {
+  const Geometry known = {1920, 1088, PageAlign(1920 * 1088 * 3 / 2)};
+  EXPECT_EQ(known.alloc_size, OmxrPicturePreallocator::PredictAllocSize(
+                                  gfx::Size(1920, 1088), known, kPageSize));
+}
+
+TEST(OmxrPicturePreallocatorTest, AssumesTheLargestAlignmentSeen) {
+  // A stride of 1920 is 128-aligned and a slice height of 1088 64-aligned.
+  const Geometry known = {1920, 1088, PageAlign(1920 * 1088 * 3 / 2)};
+  size_t predicted = OmxrPicturePreallocator::PredictAllocSize(
+      gfx::Size(720, 480), known, kPageSize);
+  EXPECT_EQ(PageAlign(768 * 512 * 3 / 2), predicted);
+  EXPECT_GE(predicted, PageAlign(720 * 480 * 3 / 2));
+
+  // Padding to 2048 is not taken as a rule.
+  const Geometry padded = {2048, 1088, PageAlign(2048 * 1088 * 3 / 2)};
+  EXPECT_EQ(PageAlign(768 * 512 * 3 / 2),
+            OmxrPicturePreallocator::PredictAllocSize(gfx::Size(720, 480),
+                                                      padded, kPageSize));
+}
+
+TEST(OmxrPicturePreallocatorTest, KeepsSpaceBehindThePlanes) {
+  const Geometry known = {1024, 768, 1024 * 768 * 3 / 2 + 8192};
+  EXPECT_EQ(2048u * 1536 * 3 / 2 + 8192,
+            OmxrPicturePreallocator::PredictAllocSize(gfx::Size(2048, 1536),
+                                                      known, kPageSize));
+}
+
+TEST(OmxrPicturePreallocatorTest, NeedsAKnownGeometry) {
+  EXPECT_EQ(0u, OmxrPicturePreallocator::PredictAllocSize(
+                    gfx::Size(1920, 1088), Geometry{0, 0, 0}, kPageSize));
+}
+
+}  // namespace
+}  // namespace media
@@ -0,0 +1,110 @@
+// Copyright (c) 2019 Renesas Electronics Corporation
+// Use of this source code is governed by a BSD-style license that can be
+// found in the LICENSE file.
+
+#include "media/gpu/omx/omxr_resource_tracker.h"
+
+#include "base/logging.h"
+#include "base/no_destructor.h"
+#include "media/gpu/omx/omx_stubs.h"
+
+namespace media {
+
+// static
+OmxrResourceTracker* OmxrResourceTracker::Get() {
+  static base::NoDestructor<OmxrResourceTracker> tracker;
+  return tracker.get();
+}
+
+OmxrResourceTracker::OmxrResourceTracker()
+    : carveout_bytes_(0), components_(0) {}
+
+OmxrResourceTracker::~OmxrResourceTracker() = default;
+
+int OmxrResourceTracker::AllocCarveout(MMNGR_ID* id,
+                                       size_t size,
+                                       unsigned int* hard_addr,
+                                       void** virt_addr) {
+  int ret = mmngr_alloc_in_user_ext(id, size, hard_addr, virt_addr,
+                                    MMNGR_PA_SUPPORT, NULL);
+  if (ret)
+    return ret;
+  base::AutoLock auto_lock(lock_);
+  carveout_[*id] = size;
+  carveout_bytes_ += size;
+  return ret;
+}
+
+int OmxrResourceTracker::FreeCarveout(MMNGR_ID id) {
+  int ret = mmngr_free_in_user_ext(id);
+  if (ret)
+    return ret;
+  base::AutoLock auto_lock(lock_);
+  auto it = carveout_.find(id);
+  DCHECK(it != carveout_.end());
+  if (it != carveout_.end()) {
+    carveout_bytes_ -= it->second;
+    carveout_.erase(it);
+  }
+  return ret;
+}
+
+void OmxrResourceTracker::ComponentCreated() {
+  base::AutoLock auto_lock(lock_);
+  ++components_;
+}
+
+void OmxrResourceTracker::ComponentFreed() {
+  base::AutoLock auto_lock(lock_);
+  DCHECK_GT(components_, 0);
+  --components_;
+}
+
+OmxrResourceTracker::Live OmxrResourceTracker::GetLive() const {
+  base::AutoLock auto_lock(lock_);
+  Live live;
+  live.carveout_buffers = static_cast<int>(carveout_.size());
+  live.carveout_bytes = carveout_bytes_;
+  live.components = components_;
+  return live;
+}
+
+void OmxrResourceTracker::AddCpuUsage(const std::string& stream_class,
+                                      base::TimeDelta task_time,
+                                      base::TimeDelta vendor_time) {
+  base::AutoLock auto_lock(lock_);
+  CpuUsage& usage = cpu_usage_[stream_class];
+  usage.task_time += task_time;
+  usage.vendor_time += vendor_time;
+}
+
+std::map<std::string, OmxrResourceTracker::CpuUsage>
+OmxrResourceTracker::GetCpuUsage() const {
+  base::AutoLock auto_lock(lock_);
+  return cpu_usage_;
+}
+
+size_t OmxrResourceTracker::ProbeLargestCarveoutBlock(size_t limit,
+                                                      size_t granularity) {
+  DCHECK_GT(granularity, 0u);
+  // Binary search in units of |granularity| for the largest size that can be
+  // allocated; each try is freed right away.
+  size_t low = 0;
+  size_t high = limit / granularity;
+  while (low < high) {
+    size_t mid = low + (high - low + 1) / 2;
+    MMNGR_ID id;
+    unsigned int hard_addr;
+    void* virt_addr;
+    if (!mmngr_alloc_in_user_ext(&id, mid * granularity, &hard_addr,
+                                 &virt_addr, MMNGR_PA_SUPPORT, NULL)) {
+      mmngr_free_in_user_ext(id);
+      low = mid;
+    } else {
+      high = mid - 1;
+    }
+  }
+  return low * granularity;
+}
+
+}  // namespace media
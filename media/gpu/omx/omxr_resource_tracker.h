@@ -0,0 +1,83 @@
+// Copyright (c) 2019 Renesas Electronics Corporation
+// Use of this source code is governed by a BSD-style license that can be
+// found in the LICENSE file.
+
+#ifndef MEDIA_GPU_OMX_OMXR_RESOURCE_TRACKER_H_
+#define MEDIA_GPU_OMX_OMXR_RESOURCE_TRACKER_H_
+
+#include <stddef.h>
+
+#include <map>
+#include <string>
+
+#include "base/macros.h"
+#include "base/synchronization/lock.h"
+#include "base/time/time.h"
+#include "media/gpu/media_gpu_export.h"
+#include "third_party/mmngr/mmngr_user_public.h"
+
+namespace media {
+
+// Process-wide count of the carveout buffers and OMX components held by the
+// decoders, so that soak tests can tell when a torn down decoder left any
+// behind.  Carveout goes through AllocCarveout() and FreeCarveout() instead
+// of MMNGR directly.  Also sums up the CPU time of the decoders by the kind of
+// stream they decode, for capacity planning.  Safe to use from any thread.
+class MEDIA_GPU_EXPORT OmxrResourceTracker {
+ public:
+  struct Live {
+    int carveout_buffers = 0;
+    size_t carveout_bytes = 0;
+    int components = 0;
+  };
+
+  // Thread CPU time of decoder tasks and the vendor calls within them.
+  struct CpuUsage {
+    base::TimeDelta task_time;
+    base::TimeDelta vendor_time;
+  };
+
+  static OmxrResourceTracker* Get();
+
+  OmxrResourceTracker();
+  ~OmxrResourceTracker();
+
+  // mmngr_alloc_in_user_ext() and mmngr_free_in_user_ext(), with the same
+  // return values.
+  int AllocCarveout(MMNGR_ID* id,
+                    size_t size,
+                    unsigned int* hard_addr,
+                    void** virt_addr);
+  int FreeCarveout(MMNGR_ID id);
+
+  // To be called around OMX_GetHandle() and a successful OMX_FreeHandle().
+  void ComponentCreated();
+  void ComponentFreed();
+
+  Live GetLive() const;
+
+  // |stream_class| names the codec and coded size, e.g. "h264 1920x1088".
+  // Decoders add their time when the coded size changes and when they are
+  // destroyed, not per task.
+  void AddCpuUsage(const std::string& stream_class,
+                   base::TimeDelta task_time,
+                   base::TimeDelta vendor_time);
+  std::map<std::string, CpuUsage> GetCpuUsage() const;
+
+  // Returns the largest carveout block up to |limit| that can be allocated
+  // right now, to within |granularity|.  Shrinks as the carveout fragments.
+  size_t ProbeLargestCarveoutBlock(size_t limit, size_t granularity);
+
+ private:
+  mutable base::Lock lock_;
+  std::map<MMNGR_ID, size_t> carveout_;
+  size_t carveout_bytes_;
+  int components_;
+  std::map<std::string, CpuUsage> cpu_usage_;
+
+  DISALLOW_COPY_AND_ASSIGN(OmxrResourceTracker);
+};
+
+}  // namespace media
+
+#endif  // MEDIA_GPU_OMX_OMXR_RESOURCE_TRACKER_H_
@@ -0,0 +1,34 @@
+// Copyright (c) 2019 Renesas Electronics Corporation
+// Use of this source code is governed by a BSD-style license that can be
+// found in the LICENSE file.
+
+#include "media/gpu/omx/omxr_resource_tracker.h"
+
+#include "testing/gtest/include/gtest/gtest.h"
+
+namespace media {
+namespace {
+
+base::TimeDelta Ms(int ms) {
+  return base::TimeDelta::FromMilliseconds(ms);
+}
+
+TEST(OmxrResourceTrackerTest, SumsCpuUsageByStreamClass) {
+  OmxrResourceTracker tracker;
+  EXPECT_TRUE(tracker.GetCpuUsage().empty());
+
+  tracker.AddCpuUsage("h264 1920x1088", Ms(30), Ms(10));
+  tracker.AddCpuUsage("h264 1280x720", Ms(5), Ms(1));
+  tracker.AddCpuUsage("h264 1920x1088", Ms(20), Ms(4));
+
+  std::map<std::string, OmxrResourceTracker::CpuUsage> usage =
+      tracker.GetCpuUsage();
+  ASSERT_EQ(2u, usage.size());
+  EXPECT_EQ(Ms(50), usage["h264 1920x1088"].task_time);
+  EXPECT_EQ(Ms(14), usage["h264 1920x1088"].vendor_time);
+  EXPECT_EQ(Ms(5), usage["h264 1280x720"].task_time);
+  EXPECT_EQ(Ms(1), usage["h264 1280x720"].vendor_time);
+}
+
+}  // namespace
+}  // namespace media
@@ -0,0 +1,146 @@
+// Copyright (c) 2019 Renesas Electronics Corporation
+// Use of this source code is governed by a BSD-style license that can be
+// found in the LICENSE file.
+
+#include "media/gpu/omx/omxr_session_multiplexer.h"
+
+#include <algorithm>
+
+#include "base/logging.h"
+#include "base/no_destructor.h"
+#include "base/threading/thread_task_runner_handle.h"
+#include "base/trace_event/trace_event.h"
+#include "media/gpu/omx/omxr_features.h"
+
+namespace media {
+
+// Aggregate throughput is averaged and logged over periods of this length.
+enum { kStatsPeriodMs = 5000 };
+
+// static
+OmxrSessionMultiplexer* OmxrSessionMultiplexer::Get() {
+  static base::NoDestructor<OmxrSessionMultiplexer> multiplexer(
+      kOmxrMaxComponents.Get(),
+      base::TimeDelta::FromMilliseconds(kOmxrSessionQuantumMs.Get()));
+  return multiplexer.get();
+}
+
+OmxrSessionMultiplexer::OmxrSessionMultiplexer(int max_components,
+                                               base::TimeDelta quantum)
+    : max_components_(std::max(max_components, 1)),
+      quantum_(quantum),
+      next_session_id_(1),
+      active_components_(0),
+      switches_(0),
+      period_start_(base::TimeTicks::Now()),
+      period_frames_(0) {}
+
+OmxrSessionMultiplexer::~OmxrSessionMultiplexer() = default;
+
+OmxrSessionMultiplexer::SessionId OmxrSessionMultiplexer::RegisterSession() {
+  base::AutoLock auto_lock(lock_);
+  SessionId id = next_session_id_++;
+  sessions_[id] = Session();
+  VLOG(1) << "Registered multiplexed session " << id << ", "
+          << sessions_.size() << " sessions on " << max_components_
+          << " components";
+  return id;
+}
+
+void OmxrSessionMultiplexer::UnregisterSession(SessionId id) {
+  base::AutoLock auto_lock(lock_);
+  auto it = sessions_.find(id);
+  if (it == sessions_.end())
+    return;
+  waiters_.erase(std::remove(waiters_.begin(), waiters_.end(), id),
+                 waiters_.end());
+  ReleaseComponentLocked(&it->second);
+  sessions_.erase(it);
+  GrantWaitersLocked();
+}
+
+bool OmxrSessionMultiplexer::AcquireComponent(SessionId id,
+                                              const base::Closure& granted_cb) {
+  base::AutoLock auto_lock(lock_);
+  auto it = sessions_.find(id);
+  DCHECK(it != sessions_.end());
+  Session& session = it->second;
+  DCHECK(!session.holds_component);
+
+  if (waiters_.empty() && active_components_ < max_components_) {
+    session.holds_component = true;
+    session.acquired_at = base::TimeTicks::Now();
+    ++active_components_;
+    return true;
+  }
+
+  session.waiting_task_runner = base::ThreadTaskRunnerHandle::Get();
+  session.granted_cb = granted_cb;
+  waiters_.push_back(id);
+  VLOG(1) << "Session " << id << " waiting for a component, "
+          << waiters_.size() << " waiters";
+  return false;
+}
+
+void OmxrSessionMultiplexer::ReleaseComponent(SessionId id) {
+  base::AutoLock auto_lock(lock_);
+  auto it = sessions_.find(id);
+  DCHECK(it != sessions_.end());
+  ReleaseComponentLocked(&it->second);
+  GrantWaitersLocked();
+}
+
+bool OmxrSessionMultiplexer::ShouldYield(SessionId id) const {
+  base::AutoLock auto_lock(lock_);
+  if (waiters_.empty())
+    return false;
+  auto it = sessions_.find(id);
+  if (it == sessions_.end() || !it->second.holds_component)
+    return false;
+  return base::TimeTicks::Now() - it->second.acquired_at >= quantum_;
+}
+
+void OmxrSessionMultiplexer::RecordFrameDecoded(SessionId id) {
+  base::AutoLock auto_lock(lock_);
+  ++period_frames_;
+
+  base::TimeTicks now = base::TimeTicks::Now();
+  base::TimeDelta elapsed = now - period_start_;
+  if (elapsed < base::TimeDelta::FromMilliseconds(kStatsPeriodMs))
+    return;
+  double frames_per_second = period_frames_ / elapsed.InSecondsF();
+  period_frames_ = 0;
+  period_start_ = now;
+  TRACE_COUNTER2("media,gpu", "OmxrSessionMultiplexer",
+                 "Frames per second", frames_per_second,
+                 "Waiting sessions", waiters_.size());
+  VLOG(1) << "Multiplexed decode: " << frames_per_second << " fps over "
+          << sessions_.size() << " sessions, " << switches_ << " switches";
+}
+
+void OmxrSessionMultiplexer::GrantWaitersLocked() {
+  lock_.AssertAcquired();
+  while (!waiters_.empty() && active_components_ < max_components_) {
+    SessionId id = waiters_.front();
+    waiters_.pop_front();
+    Session& session = sessions_[id];
+    session.holds_component = true;
+    session.acquired_at = base::TimeTicks::Now();
+    ++active_components_;
+    ++switches_;
+    session.waiting_task_runner->PostTask(FROM_HERE, session.granted_cb);
+    session.waiting_task_runner = nullptr;
+    session.granted_cb.Reset();
+  }
+}
+
+void OmxrSessionMultiplexer::ReleaseComponentLocked(Session* session) {
+  lock_.AssertAcquired();
+  if (!session->holds_component)
+    return;
+  session->holds_component = false;
+  --active_components_;
+  DCHECK_GE(active_components_, 0);
+}
+
+}  // namespace media
@@ -0,0 +1,86 @@
+// Copyright (c) 2019 Renesas Electronics Corporation
+// Use of this source code is governed by a BSD-style license that can be
+// found in the LICENSE file.
+
+#ifndef MEDIA_GPU_OMX_OMXR_SESSION_MULTIPLEXER_H_
+#define MEDIA_GPU_OMX_OMXR_SESSION_MULTIPLEXER_H_
+
+#include <stdint.h>
+
+#include <deque>
+#include <map>
+
+#include "base/callback.h"
+#include "base/macros.h"
+#include "base/memory/scoped_refptr.h"
+#include "base/single_thread_task_runner.h"
+#include "base/synchronization/lock.h"
+#include "base/time/time.h"
+
+namespace media {
+
+// Arbitrates a fixed number of OMX component slots between any number of
+// logical decoder sessions.  A session holds a slot while it owns a live
+// OMX_HANDLETYPE; when more sessions exist than slots, the remaining ones wait
+// in FIFO order and the holders are asked (via ShouldYield()) to hand their
+// component back at the next IDR boundary once their quantum has expired.
+//
+// The multiplexer only does the bookkeeping; saving and restoring per-session
+// decode state around a switch is up to the session itself.  It is safe to use
+// from any thread.
+class OmxrSessionMultiplexer {
+ public:
+  typedef int32_t SessionId;
+
+  static OmxrSessionMultiplexer* Get();
+
+  OmxrSessionMultiplexer(int max_components, base::TimeDelta quantum);
+  ~OmxrSessionMultiplexer();
+
+  SessionId RegisterSession();
+  // Releases the session's slot (if any) and forgets about it.
+  void UnregisterSession(SessionId id);
+
+  // Returns true if a slot was granted immediately.  Otherwise the session is
+  // queued and |granted_cb| is posted to the calling thread once it owns a
+  // slot.
+  bool AcquireComponent(SessionId id, const base::Closure& granted_cb);
+  void ReleaseComponent(SessionId id);
+
+  // True if |id| holds a slot, has had it for at least one quantum, and some
+  // other session is waiting for one.
+  bool ShouldYield(SessionId id) const;
+
+  // Feeds the aggregate output rate traced and logged once per period.
+  void RecordFrameDecoded(SessionId id);
+
+ private:
+  struct Session {
+    bool holds_component = false;
+    base::TimeTicks acquired_at;
+    scoped_refptr<base::SingleThreadTaskRunner> waiting_task_runner;
+    base::Closure granted_cb;
+  };
+
+  void GrantWaitersLocked();
+  void ReleaseComponentLocked(Session* session);
+
+  const int max_components_;
+  const base::TimeDelta quantum_;
+
+  mutable base::Lock lock_;
+  SessionId next_session_id_;
+  int active_components_;
+  std::map<SessionId, Session> sessions_;
+  std::deque<SessionId> waiters_;
+
+  int64_t switches_;
+  base::TimeTicks period_start_;
+  int64_t period_frames_;
+
+  DISALLOW_COPY_AND_ASSIGN(OmxrSessionMultiplexer);
+};
+
+}  // namespace media
+
+#endif  // MEDIA_GPU_OMX_OMXR_SESSION_MULTIPLEXER_H_
@@ -0,0 +1,101 @@
+// Copyright (c) 2019 Renesas Electronics Corporation
+// Use of this source code is governed by a BSD-style license that can be
+// found in the LICENSE file.
+
+#include "media/gpu/omx/omxr_session_multiplexer.h"
+
+#include <vector>
+
+#include "base/bind.h"
+#include "base/run_loop.h"
+#include "base/test/scoped_task_environment.h"
+#include "testing/gtest/include/gtest/gtest.h"
+
+namespace media {
+namespace {
+
+using SessionId = OmxrSessionMultiplexer::SessionId;
+
+class OmxrSessionMultiplexerTest : public testing::Test {
+ protected:
+  base::Closure Granted(SessionId id) {
+    return base::Bind(
+        [](std::vector<SessionId>* granted, SessionId id) {
+          granted->push_back(id);
+        },
+        &granted_, id);
+  }
+
+  base::test::ScopedTaskEnvironment task_environment_;
+  std::vector<SessionId> granted_;
+};
+
+TEST_F(OmxrSessionMultiplexerTest, GrantsWaitersInOrder) {
+  OmxrSessionMultiplexer multiplexer(1, base::TimeDelta());
+  SessionId first = multiplexer.RegisterSession();
+  SessionId second = multiplexer.RegisterSession();
+  SessionId third = multiplexer.RegisterSession();
+
+  EXPECT_TRUE(multiplexer.AcquireComponent(first, Granted(first)));
+  EXPECT_FALSE(multiplexer.AcquireComponent(second, Granted(second)));
+  EXPECT_FALSE(multiplexer.AcquireComponent(third, Granted(third)));
+
+  multiplexer.ReleaseComponent(first);
+  base::RunLoop().RunUntilIdle();
+  EXPECT_EQ(std::vector<SessionId>({second}), granted_);
+
+  // A session giving its component back queues behind the waiting ones.
+  EXPECT_FALSE(multiplexer.AcquireComponent(first, Granted(first)));
+  multiplexer.ReleaseComponent(second);
+  base::RunLoop().RunUntilIdle();
+  EXPECT_EQ(std::vector<SessionId>({second, third}), granted_);
+}
+
+TEST_F(OmxrSessionMultiplexerTest, YieldsOnlyToWaiters) {
+  OmxrSessionMultiplexer multiplexer(1, base::TimeDelta());
+  SessionId first = multiplexer.RegisterSession();
+  SessionId second = multiplexer.RegisterSession();
+
+  EXPECT_TRUE(multiplexer.AcquireComponent(first, Granted(first)));
+  EXPECT_FALSE(multiplexer.ShouldYield(first));
+
+  EXPECT_FALSE(multiplexer.AcquireComponent(second, Granted(second)));
+  EXPECT_TRUE(multiplexer.ShouldYield(first));
+  // Waiting sessions hold nothing to yield.
+  EXPECT_FALSE(multiplexer.ShouldYield(second));
+}
+
+TEST_F(OmxrSessionMultiplexerTest, KeepsComponentForAQuantum) {
+  OmxrSessionMultiplexer multiplexer(1, base::TimeDelta::FromHours(1));
+  SessionId first = multiplexer.RegisterSession();
+  SessionId second = multiplexer.RegisterSession();
+
+  EXPECT_TRUE(multiplexer.AcquireComponent(first, Granted(first)));
+  EXPECT_FALSE(multiplexer.AcquireComponent(second, Granted(second)));
+  EXPECT_FALSE(multiplexer.ShouldYield(first));
+}
+
+TEST_F(OmxrSessionMultiplexerTest, UnregisterReleasesAndDequeues) {
+  OmxrSessionMultiplexer multiplexer(2, base::TimeDelta());
+  SessionId first = multiplexer.RegisterSession();
+  SessionId second = multiplexer.RegisterSession();
+  SessionId third = multiplexer.RegisterSession();
+  SessionId fourth = multiplexer.RegisterSession();
+
+  EXPECT_TRUE(multiplexer.AcquireComponent(first, Granted(first)));
+  EXPECT_TRUE(multiplexer.AcquireComponent(second, Granted(second)));
+  EXPECT_FALSE(multiplexer.AcquireComponent(third, Granted(third)));
+  EXPECT_FALSE(multiplexer.AcquireComponent(fourth, Granted(fourth)));
+
+  multiplexer.UnregisterSession(third);
+  multiplexer.UnregisterSession(first);
+  base::RunLoop().RunUntilIdle();
+  EXPECT_EQ(std::vector<SessionId>({fourth}), granted_);
+
+  // Both components are taken again.
+  SessionId fifth = multiplexer.RegisterSession();
+  EXPECT_FALSE(multiplexer.AcquireComponent(fifth, Granted(fifth)));
+}
+
+}  // namespace
+}  // namespace media
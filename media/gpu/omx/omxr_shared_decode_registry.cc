@@ -0,0 +1,178 @@
+// Copyright (c) 2019 Renesas Electronics Corporation
+// Use of this source code is governed by a BSD-style license that can be
+// found in the LICENSE file.
+
+#include "media/gpu/omx/omxr_shared_decode_registry.h"
+
+#include <algorithm>
+#include <utility>
+
+#include "base/logging.h"
+#include "base/no_destructor.h"
+
+namespace media {
+
+OmxrSharedDecodeRegistry::Reference::Reference()
+    : publisher(nullptr), picture_id(-1), count(0) {}
+
+OmxrSharedDecodeRegistry::Reference::Reference(Reference&& other) = default;
+
+OmxrSharedDecodeRegistry::Reference::~Reference() = default;
+
+OmxrSharedDecodeRegistry::Session::Session() : leader(nullptr) {}
+
+OmxrSharedDecodeRegistry::Session::~Session() = default;
+
+// static
+OmxrSharedDecodeRegistry* OmxrSharedDecodeRegistry::Get() {
+  static base::NoDestructor<OmxrSharedDecodeRegistry> registry;
+  return registry.get();
+}
+
+OmxrSharedDecodeRegistry::OmxrSharedDecodeRegistry() : next_reference_id_(0) {
+  DETACH_FROM_THREAD(thread_checker_);
+}
+
+OmxrSharedDecodeRegistry::~OmxrSharedDecodeRegistry() = default;
+
+bool OmxrSharedDecodeRegistry::Join(const std::string& key, Member* member) {
+  DCHECK_CALLED_ON_VALID_THREAD(thread_checker_);
+  Session& session = sessions_[key];
+  if (!session.leader) {
+    session.leader = member;
+    VLOG(1) << "Leading shared stream " << key;
+    return true;
+  }
+  session.followers.push_back(member);
+  VLOG(1) << "Following shared stream " << key << ", "
+          << session.followers.size() << " followers";
+  return false;
+}
+
+void OmxrSharedDecodeRegistry::Leave(const std::string& key, Member* member) {
+  DCHECK_CALLED_ON_VALID_THREAD(thread_checker_);
+  auto it = sessions_.find(key);
+  if (it == sessions_.end())
+    return;
+  Session& session = it->second;
+
+  if (session.leader != member) {
+    session.followers.erase(std::remove(session.followers.begin(),
+                                        session.followers.end(), member),
+                            session.followers.end());
+    return;
+  }
+
+  // References on our pictures stay with the followers until they release
+  // them; the memory is freed then, see FreeWhenReleased().
+  session.leader = nullptr;
+  if (session.followers.empty()) {
+    EraseSession(it);
+    return;
+  }
+
+  std::vector<Member*> followers = session.followers;
+  for (Member* follower : followers)
+    follower->OnLeaderGone();
+
+  Member* promoted = session.followers.front();
+  session.followers.erase(session.followers.begin());
+  session.leader = promoted;
+  VLOG(1) << "Promoting a follower to lead shared stream " << key;
+  promoted->OnPromoted();
+}
+
+bool OmxrSharedDecodeRegistry::HasFollowers(const std::string& key) const {
+  DCHECK_CALLED_ON_VALID_THREAD(thread_checker_);
+  auto it = sessions_.find(key);
+  return it != sessions_.end() && !it->second.followers.empty();
+}
+
+void OmxrSharedDecodeRegistry::Publish(const std::string& key,
+                                       const SharedPicture& picture) {
+  DCHECK_CALLED_ON_VALID_THREAD(thread_checker_);
+  auto it = sessions_.find(key);
+  if (it == sessions_.end() || it->second.followers.empty())
+    return;
+
+  // Followers may release their reference right away, or leave.
+  std::vector<Member*> followers = it->second.followers;
+  SharedPicture published = picture;
+  published.reference_id = next_reference_id_++;
+  Reference& ref = it->second.refs[published.reference_id];
+  ref.publisher = it->second.leader;
+  ref.picture_id = picture.picture_id;
+  ref.count = followers.size();
+  for (Member* follower : followers)
+    follower->OnSharedPicture(published);
+}
+
+void OmxrSharedDecodeRegistry::Release(const std::string& key,
+                                       int32_t reference_id) {
+  DCHECK_CALLED_ON_VALID_THREAD(thread_checker_);
+  auto it = sessions_.find(key);
+  if (it == sessions_.end())
+    return;
+  Session& session = it->second;
+  auto ref = session.refs.find(reference_id);
+  if (ref == session.refs.end())
+    return;
+  if (--ref->second.count > 0)
+    return;
+  Reference released = std::move(ref->second);
+  session.refs.erase(ref);
+  if (released.free_memory)
+    std::move(released.free_memory).Run();
+  else if (session.leader && session.leader == released.publisher)
+    session.leader->OnSharedPictureReleased(released.picture_id);
+}
+
+int OmxrSharedDecodeRegistry::RefCount(const std::string& key,
+                                       int32_t picture_id) const {
+  DCHECK_CALLED_ON_VALID_THREAD(thread_checker_);
+  auto it = sessions_.find(key);
+  if (it == sessions_.end())
+    return 0;
+  int count = 0;
+  for (const auto& ref : it->second.refs) {
+    if (ref.second.publisher == it->second.leader &&
+        ref.second.picture_id == picture_id && !ref.second.free_memory) {
+      count += ref.second.count;
+    }
+  }
+  return count;
+}
+
+void OmxrSharedDecodeRegistry::FreeWhenReleased(
+    const Member* publisher,
+    int32_t picture_id,
+    base::OnceClosure free_memory) {
+  DCHECK_CALLED_ON_VALID_THREAD(thread_checker_);
+  for (auto& session : sessions_) {
+    for (auto& ref : session.second.refs) {
+      if (ref.second.publisher == publisher &&
+          ref.second.picture_id == picture_id && !ref.second.free_memory) {
+        VLOG(1) << "Keeping picture " << picture_id << " until "
+                << ref.second.count << " followers release it";
+        ref.second.free_memory = std::move(free_memory);
+        return;
+      }
+    }
+  }
+  std::move(free_memory).Run();
+}
+
+void OmxrSharedDecodeRegistry::EraseSession(
+    std::map<std::string, Session>::iterator it) {
+  // Members release their references before they leave, so this is only a
+  // safety net.
+  std::map<int32_t, Reference> refs;
+  refs.swap(it->second.refs);
+  sessions_.erase(it);
+  for (auto& ref : refs) {
+    if (ref.second.free_memory)
+      std::move(ref.second.free_memory).Run();
+  }
+}
+
+}  // namespace media
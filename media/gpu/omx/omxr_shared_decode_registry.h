@@ -0,0 +1,125 @@
+// Copyright (c) 2019 Renesas Electronics Corporation
+// Use of this source code is governed by a BSD-style license that can be
+// found in the LICENSE file.
+
+#ifndef MEDIA_GPU_OMX_OMXR_SHARED_DECODE_REGISTRY_H_
+#define MEDIA_GPU_OMX_OMXR_SHARED_DECODE_REGISTRY_H_
+
+#include <stdint.h>
+
+#include <map>
+#include <string>
+#include <vector>
+
+#include "base/callback.h"
+#include "base/macros.h"
+#include "base/threading/thread_checker.h"
+#include "media/gpu/media_gpu_export.h"
+#include "ui/gfx/geometry/size.h"
+
+namespace media {
+
+// Lets decoders of the same stream share one hardware decode.  The first
+// decoder to join a stream key leads: it decodes and publishes its pictures.
+// Every later one follows: it decodes nothing and shows the leader's pictures
+// instead, each holding a reference that keeps the leader from handing the
+// picture back to the component.  When the leader leaves, the oldest follower
+// is promoted and starts decoding itself.
+//
+// A referenced picture outlives the leader's use of it: memory the leader
+// frees while followers still show the picture (a resize, teardown, or the
+// leader leaving) is only freed once the last reference is released.
+//
+// The registry only does the bookkeeping and fan-out; matching pictures to
+// bitstream buffers and binding them is up to the members.  All members live
+// on the GPU child thread.
+class MEDIA_GPU_EXPORT OmxrSharedDecodeRegistry {
+ public:
+  struct SharedPicture {
+    // The leader's picture buffer id.
+    int32_t picture_id;
+    // Hash of the bitstream buffer the picture was decoded from.
+    uint32_t input_hash;
+    // EGLImageKHR of the leader's picture.
+    void* egl_image;
+    gfx::Size size;
+    // Set by Publish(); followers release the picture by it.
+    int32_t reference_id;
+  };
+
+  class Member {
+   public:
+    // Follower: |picture| was published, and one reference to it taken on
+    // our behalf; drop it with Release(), |picture.reference_id|.
+    virtual void OnSharedPicture(const SharedPicture& picture) = 0;
+    // Leader: the last reference to |picture_id| was released.
+    virtual void OnSharedPictureReleased(int32_t picture_id) = 0;
+    // Follower: the leader left.  No more pictures come from it, but the
+    // references held stay valid and must still be released.
+    virtual void OnLeaderGone() = 0;
+    // Follower: we lead from now on.
+    virtual void OnPromoted() = 0;
+
+   protected:
+    virtual ~Member() {}
+  };
+
+  static OmxrSharedDecodeRegistry* Get();
+
+  OmxrSharedDecodeRegistry();
+  ~OmxrSharedDecodeRegistry();
+
+  // Returns true if |member| leads |key|, false if it follows.
+  bool Join(const std::string& key, Member* member);
+  void Leave(const std::string& key, Member* member);
+
+  bool HasFollowers(const std::string& key) const;
+  // Hands |picture| to every follower of |key|.
+  void Publish(const std::string& key, const SharedPicture& picture);
+  // Drops a reference taken by Publish().
+  void Release(const std::string& key, int32_t reference_id);
+  // Number of follower references held on the current leader's |picture_id|.
+  int RefCount(const std::string& key, int32_t picture_id) const;
+  // |publisher| is freeing its picture |picture_id|: runs |free_memory| once
+  // no follower references the picture any more, right away if none does.
+  // Also works once |publisher| left.
+  void FreeWhenReleased(const Member* publisher,
+                        int32_t picture_id,
+                        base::OnceClosure free_memory);
+
+ private:
+  struct Reference {
+    Reference();
+    Reference(Reference&& other);
+    ~Reference();
+
+    const Member* publisher;
+    int32_t picture_id;
+    int count;
+    // Set once the publisher freed the picture; it is no longer told about
+    // the release then.
+    base::OnceClosure free_memory;
+  };
+
+  struct Session {
+    Session();
+    ~Session();
+
+    Member* leader;
+    std::vector<Member*> followers;
+    // By reference id.
+    std::map<int32_t, Reference> refs;
+  };
+
+  void EraseSession(std::map<std::string, Session>::iterator it);
+
+  THREAD_CHECKER(thread_checker_);
+  std::map<std::string, Session> sessions_;
+  int32_t next_reference_id_;
+
+  DISALLOW_COPY_AND_ASSIGN(OmxrSharedDecodeRegistry);
+};
+
+}  // namespace media
+
+#endif  // MEDIA_GPU_OMX_OMXR_SHARED_DECODE_REGISTRY_H_
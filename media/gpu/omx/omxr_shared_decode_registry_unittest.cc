@@ -0,0 +1,215 @@
+// Copyright (c) 2019 Renesas Electronics Corporation
+// Use of this source code is governed by a BSD-style license that can be
+// found in the LICENSE file.
+
+#include "media/gpu/omx/omxr_shared_decode_registry.h"
+
+#include <vector>
+
+#include "base/bind.h"
+#include "testing/gtest/include/gtest/gtest.h"
+
+namespace media {
+namespace {
+
+using SharedPicture = OmxrSharedDecodeRegistry::SharedPicture;
+
+const char kKey[] = "camera-1";
+
+class FakeMember : public OmxrSharedDecodeRegistry::Member {
+ public:
+  // |release_right_away| drops every published picture immediately, like a
+  // follower without a free texture.
+  FakeMember(OmxrSharedDecodeRegistry* registry, bool release_right_away)
+      : registry_(registry), release_right_away_(release_right_away) {}
+
+  void OnSharedPicture(const SharedPicture& picture) override {
+    received.push_back(picture.picture_id);
+    if (release_right_away_)
+      registry_->Release(kKey, picture.reference_id);
+    else
+      references.push_back(picture.reference_id);
+  }
+  void OnSharedPictureReleased(int32_t picture_id) override {
+    released.push_back(picture_id);
+  }
+  void OnLeaderGone() override { ++leader_gone; }
+  void OnPromoted() override { promoted = true; }
+
+  // Releases the oldest reference we hold.
+  void ReleaseOldest() {
+    ASSERT_FALSE(references.empty());
+    registry_->Release(kKey, references.front());
+    references.erase(references.begin());
+  }
+
+  std::vector<int32_t> received;
+  std::vector<int32_t> references;
+  std::vector<int32_t> released;
+  int leader_gone = 0;
+  bool promoted = false;
+
+ private:
+  OmxrSharedDecodeRegistry* const registry_;
+  const bool release_right_away_;
+};
+
+SharedPicture Picture(int32_t id) {
+  return SharedPicture{id, 0x1234, nullptr, gfx::Size(320, 240), -1};
+}
+
+void CountCall(int* calls) {
+  ++*calls;
+}
+
+TEST(OmxrSharedDecodeRegistryTest, FirstMemberLeads) {
+  OmxrSharedDecodeRegistry registry;
+  FakeMember leader(&registry, false);
+  FakeMember follower(&registry, false);
+  EXPECT_TRUE(registry.Join(kKey, &leader));
+  EXPECT_FALSE(registry.HasFollowers(kKey));
+  EXPECT_FALSE(registry.Join(kKey, &follower));
+  EXPECT_TRUE(registry.HasFollowers(kKey));
+
+  // Other keys are independent.
+  FakeMember other(&registry, false);
+  EXPECT_TRUE(registry.Join("camera-2", &other));
+}
+
+TEST(OmxrSharedDecodeRegistryTest, PictureReleasedAfterAllFollowers) {
+  OmxrSharedDecodeRegistry registry;
+  FakeMember leader(&registry, false);
+  FakeMember first(&registry, false);
+  FakeMember second(&registry, false);
+  registry.Join(kKey, &leader);
+  registry.Join(kKey, &first);
+  registry.Join(kKey, &second);
+
+  registry.Publish(kKey, Picture(7));
+  EXPECT_EQ(std::vector<int32_t>{7}, first.received);
+  EXPECT_EQ(std::vector<int32_t>{7}, second.received);
+  EXPECT_EQ(2, registry.RefCount(kKey, 7));
+
+  first.ReleaseOldest();
+  EXPECT_TRUE(leader.released.empty());
+  second.ReleaseOldest();
+  EXPECT_EQ(std::vector<int32_t>{7}, leader.released);
+  EXPECT_EQ(0, registry.RefCount(kKey, 7));
+}
+
+TEST(OmxrSharedDecodeRegistryTest, ReleaseFromWithinPublish) {
+  OmxrSharedDecodeRegistry registry;
+  FakeMember leader(&registry, false);
+  FakeMember follower(&registry, true);
+  registry.Join(kKey, &leader);
+  registry.Join(kKey, &follower);
+
+  registry.Publish(kKey, Picture(3));
+  EXPECT_EQ(std::vector<int32_t>{3}, leader.released);
+  EXPECT_EQ(0, registry.RefCount(kKey, 3));
+}
+
+TEST(OmxrSharedDecodeRegistryTest, NothingPublishedWithoutFollowers) {
+  OmxrSharedDecodeRegistry registry;
+  FakeMember leader(&registry, false);
+  registry.Join(kKey, &leader);
+  registry.Publish(kKey, Picture(1));
+  EXPECT_EQ(0, registry.RefCount(kKey, 1));
+}
+
+TEST(OmxrSharedDecodeRegistryTest, OldestFollowerPromoted) {
+  OmxrSharedDecodeRegistry registry;
+  FakeMember leader(&registry, false);
+  FakeMember first(&registry, false);
+  FakeMember second(&registry, false);
+  registry.Join(kKey, &leader);
+  registry.Join(kKey, &first);
+  registry.Join(kKey, &second);
+  registry.Publish(kKey, Picture(5));
+
+  registry.Leave(kKey, &leader);
+  EXPECT_EQ(1, first.leader_gone);
+  EXPECT_EQ(1, second.leader_gone);
+  EXPECT_TRUE(first.promoted);
+  EXPECT_FALSE(second.promoted);
+  // The old leader's pictures do not hold up the new leader's.
+  EXPECT_EQ(0, registry.RefCount(kKey, 5));
+
+  // The promoted member now publishes to the rest.
+  registry.Publish(kKey, Picture(5));
+  EXPECT_EQ(std::vector<int32_t>({5, 5}), second.received);
+  EXPECT_EQ(1, registry.RefCount(kKey, 5));
+  // Releasing the old leader's picture does not return the new one's.
+  second.ReleaseOldest();
+  EXPECT_TRUE(first.released.empty());
+  second.ReleaseOldest();
+  EXPECT_EQ(std::vector<int32_t>{5}, first.released);
+}
+
+TEST(OmxrSharedDecodeRegistryTest, MemoryFreedAfterLastRelease) {
+  OmxrSharedDecodeRegistry registry;
+  FakeMember leader(&registry, false);
+  FakeMember first(&registry, false);
+  FakeMember second(&registry, false);
+  registry.Join(kKey, &leader);
+  registry.Join(kKey, &first);
+  registry.Join(kKey, &second);
+  registry.Publish(kKey, Picture(4));
+
+  // The leader frees the picture, e.g. on a resize, while both show it.
+  int frees = 0;
+  registry.FreeWhenReleased(&leader, 4, base::BindOnce(&CountCall, &frees));
+  EXPECT_EQ(0, frees);
+  // A new picture with the same id is not held up by the old one.
+  EXPECT_EQ(0, registry.RefCount(kKey, 4));
+  registry.Publish(kKey, Picture(4));
+  EXPECT_EQ(2, registry.RefCount(kKey, 4));
+
+  first.ReleaseOldest();
+  EXPECT_EQ(0, frees);
+  second.ReleaseOldest();
+  EXPECT_EQ(1, frees);
+  // The freed picture is not handed back to the leader.
+  EXPECT_TRUE(leader.released.empty());
+
+  // Pictures nobody references are freed right away.
+  registry.FreeWhenReleased(&leader, 8, base::BindOnce(&CountCall, &frees));
+  EXPECT_EQ(2, frees);
+}
+
+TEST(OmxrSharedDecodeRegistryTest, MemoryOutlivesLeader) {
+  OmxrSharedDecodeRegistry registry;
+  FakeMember leader(&registry, false);
+  FakeMember follower(&registry, false);
+  registry.Join(kKey, &leader);
+  registry.Join(kKey, &follower);
+  registry.Publish(kKey, Picture(2));
+
+  // The leader leaves, then frees its pictures.
+  registry.Leave(kKey, &leader);
+  EXPECT_TRUE(follower.promoted);
+  int frees = 0;
+  registry.FreeWhenReleased(&leader, 2, base::BindOnce(&CountCall, &frees));
+  EXPECT_EQ(0, frees);
+
+  follower.ReleaseOldest();
+  EXPECT_EQ(1, frees);
+  EXPECT_TRUE(follower.released.empty());
+}
+
+TEST(OmxrSharedDecodeRegistryTest, FollowerLeaving) {
+  OmxrSharedDecodeRegistry registry;
+  FakeMember leader(&registry, false);
+  FakeMember follower(&registry, false);
+  registry.Join(kKey, &leader);
+  registry.Join(kKey, &follower);
+  registry.Leave(kKey, &follower);
+  EXPECT_FALSE(registry.HasFollowers(kKey));
+
+  // The last member leaving ends the session; the next one leads again.
+  registry.Leave(kKey, &leader);
+  EXPECT_TRUE(registry.Join(kKey, &follower));
+}
+
+}  // namespace
+}  // namespace media
@@ -0,0 +1,182 @@
+// Copyright (c) 2019 Renesas Electronics Corporation
+// Use of this source code is governed by a BSD-style license that can be
+// found in the LICENSE file.
+
+#include "media/gpu/omx/omxr_tuning_profile.h"
+
+#include <memory>
+
+#include "base/files/file_util.h"
+#include "base/json/json_reader.h"
+#include "base/logging.h"
+#include "base/no_destructor.h"
+#include "base/stl_util.h"
+#include "base/strings/string_split.h"
+#include "base/values.h"
+
+namespace media {
+
+namespace {
+
+const base::FilePath::CharType kTuningDirectory[] =
+    FILE_PATH_LITERAL("/etc/omxr/tuning");
+const base::FilePath::CharType kDeviceTreeCompatible[] =
+    FILE_PATH_LITERAL("/proc/device-tree/compatible");
+const char kDefaultProfile[] = "default";
+
+// level_idc values of the H.264 levels the component can be set up for.
+const int kLevels[] = {10, 11, 12, 13, 20, 21, 22, 30,
+                       31, 32, 40, 41, 42, 50, 51};
+
+OmxrTuningProfile* GetMutable() {
+  static base::NoDestructor<OmxrTuningProfile> profile;
+  return profile.get();
+}
+
+}  // namespace
+
+OmxrTuningProfile::OmxrTuningProfile()
+    : omx_library(FILE_PATH_LITERAL("/usr/lib/libomxr_core.so")),
+      mmngr_library(FILE_PATH_LITERAL("/usr/lib/libmmngr.so.1")),
+      mmngrbuf_library(FILE_PATH_LITERAL("/usr/lib/libmmngrbuf.so.1")) {}
+
+OmxrTuningProfile::OmxrTuningProfile(const OmxrTuningProfile& other) = default;
+
+OmxrTuningProfile::~OmxrTuningProfile() = default;
+
+// static
+void OmxrTuningProfile::Load() {
+  std::string compatible;
+  base::ReadFileToString(base::FilePath(kDeviceTreeCompatible), &compatible);
+  // The property is a list of NUL terminated strings.
+  base::FilePath path = FindFile(
+      base::FilePath(kTuningDirectory),
+      base::SplitString(compatible, base::StringPiece("\0", 1),
+                        base::TRIM_WHITESPACE, base::SPLIT_WANT_NONEMPTY));
+  if (path.empty()) {
+    VLOG(1) << "No OMX tuning profile, using built-in values";
+    return;
+  }
+
+  std::string json;
+  OmxrTuningProfile profile;
+  if (!base::ReadFileToString(path, &json) || !Parse(json, &profile)) {
+    LOG(WARNING) << "Ignoring invalid OMX tuning profile " << path.value();
+    return;
+  }
+  profile.source = path;
+  VLOG(1) << "OMX tuning profile " << path.value();
+  *GetMutable() = profile;
+}
+
+// static
+const OmxrTuningProfile& OmxrTuningProfile::Get() {
+  return *GetMutable();
+}
+
+// static
+bool OmxrTuningProfile::Parse(const std::string& json,
+                              OmxrTuningProfile* profile) {
+  std::unique_ptr<base::Value> value = base::JSONReader::Read(json);
+  if (!value || !value->is_dict()) {
+    DLOG(ERROR) << "Tuning profile is not a JSON object";
+    return false;
+  }
+
+  OmxrTuningProfile parsed = *profile;
+  int max_decode_width = parsed.max_decode_size.width();
+  int max_decode_height = parsed.max_decode_size.height();
+  int max_resolution_width = parsed.max_resolution.width();
+  int max_resolution_height = parsed.max_resolution.height();
+  const struct {
+    const char* key;
+    int* value;
+    int min;
+    int max;
+  } kIntegers[] = {
+      {"num_picture_buffers", &parsed.num_picture_buffers, 4, 32},
+      {"sync_poll_delay_ms", &parsed.sync_poll_delay_ms, 1, 100},
+      {"max_decode_width", &max_decode_width, 128, 8192},
+      {"max_decode_height", &max_decode_height, 96, 8192},
+      {"max_resolution_width", &max_resolution_width, 128, 8192},
+      {"max_resolution_height", &max_resolution_height, 96, 8192},
+      {"max_level", &parsed.max_level, kLevels[0],
+       kLevels[base::size(kLevels) - 1]},
+      {"input_buffer_count", &parsed.input_buffer_count, 0, 64},
+      {"input_buffer_size", &parsed.input_buffer_size, 0, 64 * 1024 * 1024},
+  };
+  for (const auto& integer : kIntegers) {
+    const base::Value* found = value->FindKey(integer.key);
+    if (!found)
+      continue;
+    if (!found->is_int() || found->GetInt() < integer.min ||
+        found->GetInt() > integer.max) {
+      DLOG(ERROR) << "Tuning profile: invalid " << integer.key;
+      return false;
+    }
+    *integer.value = found->GetInt();
+  }
+  if (!base::ContainsValue(kLevels, parsed.max_level)) {
+    DLOG(ERROR) << "Tuning profile: unknown level " << parsed.max_level;
+    return false;
+  }
+  parsed.max_decode_size.SetSize(max_decode_width, max_decode_height);
+  parsed.max_resolution.SetSize(max_resolution_width, max_resolution_height);
+  if (max_resolution_width > max_decode_width ||
+      max_resolution_height > max_decode_height) {
+    DLOG(ERROR) << "Tuning profile: max_resolution exceeds max_decode_size";
+    return false;
+  }
+
+  const base::Value* reorder = value->FindKey("reorder");
+  if (reorder) {
+    if (!reorder->is_bool()) {
+      DLOG(ERROR) << "Tuning profile: invalid reorder";
+      return false;
+    }
+    parsed.reorder = reorder->GetBool();
+  }
+
+  const struct {
+    const char* key;
+    base::FilePath* value;
+  } kLibraries[] = {
+      {"omx_library", &parsed.omx_library},
+      {"mmngr_library", &parsed.mmngr_library},
+      {"mmngrbuf_library", &parsed.mmngrbuf_library},
+  };
+  for (const auto& library : kLibraries) {
+    const base::Value* found = value->FindKey(library.key);
+    if (!found)
+      continue;
+    if (!found->is_string() ||
+        !base::FilePath(found->GetString()).IsAbsolute()) {
+      DLOG(ERROR) << "Tuning profile: " << library.key
+                  << " must be an absolute path";
+      return false;
+    }
+    *library.value = base::FilePath(found->GetString());
+  }
+
+  *profile = parsed;
+  return true;
+}
+
+// static
+base::FilePath OmxrTuningProfile::FindFile(
+    const base::FilePath& directory,
+    const std::vector<std::string>& compatible) {
+  std::vector<std::string> names = compatible;
+  names.push_back(kDefaultProfile);
+  for (const std::string& name : names) {
+    // Board ids are like "renesas,r8a7795"; none leads out of |directory|.
+    if (name.find('/') != std::string::npos)
+      continue;
+    base::FilePath path = directory.Append(name + ".json");
+    if (base::PathExists(path))
+      return path;
+  }
+  return base::FilePath();
+}
+
+}  // namespace media
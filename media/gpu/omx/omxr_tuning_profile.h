@@ -0,0 +1,74 @@
+// Copyright (c) 2019 Renesas Electronics Corporation
+// Use of this source code is governed by a BSD-style license that can be
+// found in the LICENSE file.
+
+#ifndef MEDIA_GPU_OMX_OMXR_TUNING_PROFILE_H_
+#define MEDIA_GPU_OMX_OMXR_TUNING_PROFILE_H_
+
+#include <string>
+#include <vector>
+
+#include "base/files/file_path.h"
+#include "media/gpu/media_gpu_export.h"
+#include "ui/gfx/geometry/size.h"
+
+namespace media {
+
+// Board specific values of the decoder's performance knobs, so that each SoC
+// and memory layout can be tuned without rebuilding.  A JSON object with any
+// of the member names below as keys, sizes as "<name>_width" and
+// "<name>_height":
+//
+//   {"num_picture_buffers": 6, "input_buffer_count": 4, "max_level": 51}
+//
+// The file is looked up in /etc/omxr/tuning by the entries of the device
+// tree's "compatible" property, most specific first (e.g.
+// "renesas,h3ulcb.json", then "renesas,r8a7795.json"), then as
+// "default.json".  Without any, the built-in values below apply.
+struct MEDIA_GPU_EXPORT OmxrTuningProfile {
+  OmxrTuningProfile();
+  OmxrTuningProfile(const OmxrTuningProfile& other);
+  ~OmxrTuningProfile();
+
+  // Reads the profile of this board.  Called by PreSandboxInitialization(),
+  // while the files can still be opened.
+  static void Load();
+  // The profile read by Load(), or the built-in one.  Decoders take a copy
+  // when they are created.
+  static const OmxrTuningProfile& Get();
+
+  // Overrides the values in |profile| with those in |json|.  Returns false,
+  // leaving |profile| alone, if |json| is malformed or has values out of
+  // range.
+  static bool Parse(const std::string& json, OmxrTuningProfile* profile);
+  // Returns the file in |directory| for a board with the |compatible|
+  // entries, or an empty path if there is none.
+  static base::FilePath FindFile(const base::FilePath& directory,
+                                 const std::vector<std::string>& compatible);
+
+  // Picture buffers asked of the client, on top of the spare ones.
+  int num_picture_buffers = 8;
+  // Delay between polls of a returned picture's sync fence.
+  int sync_poll_delay_ms = 5;
+  // Largest coded size and H.264 level_idc the component is set up for.
+  gfx::Size max_decode_size = gfx::Size(1920, 1088);
+  // Largest visible size advertised to clients, within |max_decode_size|.
+  gfx::Size max_resolution = gfx::Size(1920, 1080);
+  int max_level = 50;
+  // Input port buffers; 0 keeps what the component asks for.
+  int input_buffer_count = 0;
+  int input_buffer_size = 0;
+  // Let the component put pictures in display order.
+  bool reorder = false;
+  // The vendor libraries.
+  base::FilePath omx_library;
+  base::FilePath mmngr_library;
+  base::FilePath mmngrbuf_library;
+
+  // Where the values came from; empty for the built-in ones.
+  base::FilePath source;
+};
+
+}  // namespace media
+
+#endif  // MEDIA_GPU_OMX_OMXR_TUNING_PROFILE_H_
@@ -0,0 +1,82 @@
+// Copyright (c) 2019 Renesas Electronics Corporation
+// Use of this source code is governed by a BSD-style license that can be
+// found in the LICENSE file.
+
+#include "media/gpu/omx/omxr_tuning_profile.h"
+
+#include "base/files/file_util.h"
+#include "base/files/scoped_temp_dir.h"
+#include "testing/gtest/include/gtest/gtest.h"
+
+namespace media {
+namespace {
+
+TEST(OmxrTuningProfileTest, ParseOverridesGivenKeys) {
+  OmxrTuningProfile profile;
+  ASSERT_TRUE(OmxrTuningProfile::Parse(
+      R"({"num_picture_buffers": 6, "max_decode_width": 3840,
+          "max_decode_height": 2176, "max_resolution_width": 3840,
+          "max_resolution_height": 2160, "max_level": 51, "reorder": true,
+          "omx_library": "/opt/omx/libomxr_core.so"})",
+      &profile));
+  EXPECT_EQ(6, profile.num_picture_buffers);
+  EXPECT_EQ(gfx::Size(3840, 2176), profile.max_decode_size);
+  EXPECT_EQ(gfx::Size(3840, 2160), profile.max_resolution);
+  EXPECT_EQ(51, profile.max_level);
+  EXPECT_TRUE(profile.reorder);
+  EXPECT_EQ("/opt/omx/libomxr_core.so", profile.omx_library.value());
+
+  OmxrTuningProfile defaults;
+  EXPECT_EQ(defaults.sync_poll_delay_ms, profile.sync_poll_delay_ms);
+  EXPECT_EQ(defaults.input_buffer_count, profile.input_buffer_count);
+  EXPECT_EQ(defaults.mmngr_library, profile.mmngr_library);
+}
+
+TEST(OmxrTuningProfileTest, AdvertisesVisibleSizeByDefault) {
+  // 1080p is coded as 1920x1088, but offered to clients as 1920x1080.
+  OmxrTuningProfile profile;
+  EXPECT_EQ(gfx::Size(1920, 1088), profile.max_decode_size);
+  EXPECT_EQ(gfx::Size(1920, 1080), profile.max_resolution);
+}
+
+TEST(OmxrTuningProfileTest, ParseRejectsInvalidValues) {
+  const char* const kInvalid[] = {
+      "[]",
+      "{\"num_picture_buffers\": 2}",
+      "{\"num_picture_buffers\": \"8\"}",
+      "{\"max_level\": 33}",
+      "{\"max_resolution_width\": 3840}",
+      "{\"reorder\": 1}",
+      "{\"omx_library\": \"libomxr_core.so\"}",
+      "{\"input_buffer_count\": 4,",
+  };
+  for (const char* json : kInvalid) {
+    OmxrTuningProfile profile;
+    profile.num_picture_buffers = 10;
+    EXPECT_FALSE(OmxrTuningProfile::Parse(json, &profile)) << json;
+    EXPECT_EQ(10, profile.num_picture_buffers);
+  }
+}
+
+TEST(OmxrTuningProfileTest, FindFileMostSpecificFirst) {
+  base::ScopedTempDir dir;
+  ASSERT_TRUE(dir.CreateUniqueTempDir());
+  std::vector<std::string> compatible = {"renesas,h3ulcb", "renesas,r8a7795"};
+  EXPECT_TRUE(OmxrTuningProfile::FindFile(dir.GetPath(), compatible).empty());
+
+  const char kJson[] = "{}";
+  base::FilePath fallback = dir.GetPath().Append("default.json");
+  ASSERT_TRUE(base::WriteFile(fallback, kJson, sizeof(kJson) - 1));
+  EXPECT_EQ(fallback, OmxrTuningProfile::FindFile(dir.GetPath(), compatible));
+
+  base::FilePath soc = dir.GetPath().Append("renesas,r8a7795.json");
+  ASSERT_TRUE(base::WriteFile(soc, kJson, sizeof(kJson) - 1));
+  EXPECT_EQ(soc, OmxrTuningProfile::FindFile(dir.GetPath(), compatible));
+
+  base::FilePath board = dir.GetPath().Append("renesas,h3ulcb.json");
+  ASSERT_TRUE(base::WriteFile(board, kJson, sizeof(kJson) - 1));
+  EXPECT_EQ(board, OmxrTuningProfile::FindFile(dir.GetPath(), compatible));
+}
+
+}  // namespace
+}  // namespace media
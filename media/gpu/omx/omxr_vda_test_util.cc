@@ -0,0 +1,102 @@
+// Copyright (c) 2019 Renesas Electronics Corporation
+// Use of this source code is governed by a BSD-style license that can be
+// found in the LICENSE file.
+
+#include "media/gpu/omx/omxr_vda_test_util.h"
+
+#include "base/memory/shared_memory.h"
+#include "testing/gtest/include/gtest/gtest.h"
+#include "ui/gfx/color_space.h"
+#include "ui/gfx/geometry/rect.h"
+
+namespace media {
+
+OmxrFakeVideoDecodeAccelerator::OmxrFakeVideoDecodeAccelerator() = default;
+
+OmxrFakeVideoDecodeAccelerator::~OmxrFakeVideoDecodeAccelerator() = default;
+
+bool OmxrFakeVideoDecodeAccelerator::Initialize(const Config& config,
+                                                Client* client) {
+  profile_ = config.profile;
+  client_ = client;
+  return true;
+}
+
+void OmxrFakeVideoDecodeAccelerator::Decode(
+    const BitstreamBuffer& bitstream_buffer) {
+  base::SharedMemory shm(bitstream_buffer.handle(), true);
+  ASSERT_TRUE(shm.Map(bitstream_buffer.size()));
+  const uint8_t* data = static_cast<const uint8_t*>(shm.memory());
+  decoded_.push_back(bitstream_buffer.id());
+  decoded_data_.emplace_back(data, data + bitstream_buffer.size());
+}
+
+void OmxrFakeVideoDecodeAccelerator::AssignPictureBuffers(
+    const std::vector<PictureBuffer>& buffers) {
+  for (const PictureBuffer& buffer : buffers)
+    assigned_.push_back(buffer.id());
+}
+
+void OmxrFakeVideoDecodeAccelerator::ReusePictureBuffer(
+    int32_t picture_buffer_id) {
+  reused_.push_back(picture_buffer_id);
+}
+
+void OmxrFakeVideoDecodeAccelerator::Flush() {
+  ++flushes_;
+}
+
+void OmxrFakeVideoDecodeAccelerator::Reset() {
+  client_->NotifyResetDone();
+}
+
+void OmxrFakeVideoDecodeAccelerator::Destroy() {
+  delete this;
+}
+
+void OmxrFakeVideoDecodeAccelerator::OutputPicture(int32_t picture_buffer_id,
+                                                   int32_t bitstream_id) {
+  client_->PictureReady(Picture(picture_buffer_id, bitstream_id,
+                                gfx::Rect(320, 240), gfx::ColorSpace(),
+                                false));
+}
+
+OmxrRecordingVdaClient::OmxrRecordingVdaClient() = default;
+
+OmxrRecordingVdaClient::~OmxrRecordingVdaClient() = default;
+
+void OmxrRecordingVdaClient::NotifyInitializationComplete(bool success) {}
+
+void OmxrRecordingVdaClient::ProvidePictureBuffers(
+    uint32_t requested_num_of_buffers,
+    VideoPixelFormat format,
+    uint32_t textures_per_buffer,
+    const gfx::Size& dimensions,
+    uint32_t texture_target) {
+  requested_pictures_.push_back(requested_num_of_buffers);
+}
+
+void OmxrRecordingVdaClient::DismissPictureBuffer(int32_t picture_buffer_id) {}
+
+void OmxrRecordingVdaClient::PictureReady(const Picture& picture) {
+  pictures_.push_back(picture.picture_buffer_id());
+}
+
+void OmxrRecordingVdaClient::NotifyEndOfBitstreamBuffer(
+    int32_t bitstream_buffer_id) {
+  ended_.push_back(bitstream_buffer_id);
+}
+
+void OmxrRecordingVdaClient::NotifyFlushDone() {
+  ++flush_done_;
+}
+
+void OmxrRecordingVdaClient::NotifyResetDone() {
+  ++reset_done_;
+}
+
+void OmxrRecordingVdaClient::NotifyError(VideoDecodeAccelerator::Error error) {
+  ADD_FAILURE() << "Unexpected error " << error;
+}
+
+}  // namespace media
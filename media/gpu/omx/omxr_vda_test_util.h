@@ -0,0 +1,101 @@
+// Copyright (c) 2019 Renesas Electronics Corporation
+// Use of this source code is governed by a BSD-style license that can be
+// found in the LICENSE file.
+
+#ifndef MEDIA_GPU_OMX_OMXR_VDA_TEST_UTIL_H_
+#define MEDIA_GPU_OMX_OMXR_VDA_TEST_UTIL_H_
+
+#include <stdint.h>
+
+#include <vector>
+
+#include "base/macros.h"
+#include "media/video/picture.h"
+#include "media/video/video_decode_accelerator.h"
+
+namespace media {
+
+// Stands in for a decoder wrapped by the parallel or hybrid decoder,
+// recording what it is asked to do.  Tests play its outputs through
+// client().
+class OmxrFakeVideoDecodeAccelerator : public VideoDecodeAccelerator {
+ public:
+  OmxrFakeVideoDecodeAccelerator();
+  ~OmxrFakeVideoDecodeAccelerator() override;
+
+  // VideoDecodeAccelerator implementation.
+  bool Initialize(const Config& config, Client* client) override;
+  void Decode(const BitstreamBuffer& bitstream_buffer) override;
+  void AssignPictureBuffers(const std::vector<PictureBuffer>& buffers) override;
+  void ReusePictureBuffer(int32_t picture_buffer_id) override;
+  void Flush() override;
+  void Reset() override;
+  void Destroy() override;
+
+  // Outputs |picture_buffer_id| as decoded from |bitstream_id|.
+  void OutputPicture(int32_t picture_buffer_id, int32_t bitstream_id);
+
+  Client* client() { return client_; }
+  VideoCodecProfile profile() const { return profile_; }
+  const std::vector<int32_t>& decoded() const { return decoded_; }
+  const std::vector<std::vector<uint8_t>>& decoded_data() const {
+    return decoded_data_;
+  }
+  const std::vector<int32_t>& assigned() const { return assigned_; }
+  const std::vector<int32_t>& reused() const { return reused_; }
+  int flushes() const { return flushes_; }
+
+ private:
+  Client* client_ = nullptr;
+  VideoCodecProfile profile_ = VIDEO_CODEC_PROFILE_UNKNOWN;
+  std::vector<int32_t> decoded_;
+  std::vector<std::vector<uint8_t>> decoded_data_;
+  std::vector<int32_t> assigned_;
+  std::vector<int32_t> reused_;
+  int flushes_ = 0;
+
+  DISALLOW_COPY_AND_ASSIGN(OmxrFakeVideoDecodeAccelerator);
+};
+
+// A VideoDecodeAccelerator::Client that records what the decoder under test
+// tells it; any error is a test failure.
+class OmxrRecordingVdaClient : public VideoDecodeAccelerator::Client {
+ public:
+  OmxrRecordingVdaClient();
+  ~OmxrRecordingVdaClient() override;
+
+  // VideoDecodeAccelerator::Client implementation.
+  void NotifyInitializationComplete(bool success) override;
+  void ProvidePictureBuffers(uint32_t requested_num_of_buffers,
+                             VideoPixelFormat format,
+                             uint32_t textures_per_buffer,
+                             const gfx::Size& dimensions,
+                             uint32_t texture_target) override;
+  void DismissPictureBuffer(int32_t picture_buffer_id) override;
+  void PictureReady(const Picture& picture) override;
+  void NotifyEndOfBitstreamBuffer(int32_t bitstream_buffer_id) override;
+  void NotifyFlushDone() override;
+  void NotifyResetDone() override;
+  void NotifyError(VideoDecodeAccelerator::Error error) override;
+
+  const std::vector<uint32_t>& requested_pictures() const {
+    return requested_pictures_;
+  }
+  const std::vector<int32_t>& pictures() const { return pictures_; }
+  const std::vector<int32_t>& ended() const { return ended_; }
+  int flush_done() const { return flush_done_; }
+  int reset_done() const { return reset_done_; }
+
+ private:
+  std::vector<uint32_t> requested_pictures_;
+  std::vector<int32_t> pictures_;
+  std::vector<int32_t> ended_;
+  int flush_done_ = 0;
+  int reset_done_ = 0;
+
+  DISALLOW_COPY_AND_ASSIGN(OmxrRecordingVdaClient);
+};
+
+}  // namespace media
+
+#endif  // MEDIA_GPU_OMX_OMXR_VDA_TEST_UTIL_H_
@@ -0,0 +1,649 @@
+// Copyright (c) 2019 Renesas Electronics Corporation
+// Use of this source code is governed by a BSD-style license that can be
+// found in the LICENSE file.
+
+// Microbenchmarks of the vendor libraries alone, through the same generated
+// stubs as the decoder, to compare BSP releases of libomxr_core.so,
+// libmmngr.so.1 and libmmngrbuf.so.1:
+//
+//   omxr_vendor_bench [--iterations=N] [--role=video_decoder.avc]
+//                     [--omx-library=PATH] [--mmngr-library=PATH]
+//                     [--mmngrbuf-library=PATH] [--output=results.json]
+//
+// Each iteration takes a component through its whole life: OMX_GetHandle,
+// Loaded to Idle while allocating the input buffers, Idle to Executing,
+// EmptyThisBuffer round trips, enabling the output port with carveout
+// through OMX_UseBuffer and disabling it again, back to Loaded and
+// OMX_FreeHandle.  Carveout allocation is timed by size, and dmabuf export
+// and import on a picture sized block.  The decoder does not import dmabufs,
+// so the import functions are not in the stubs; they are timed when the
+// MMNGRBUF library has them.
+//
+// The results, min, median, 95th percentile and max of each operation in
+// microseconds, are written as JSON to --output or stdout.
+
+#include <stddef.h>
+#include <stdint.h>
+#include <stdio.h>
+#include <string.h>
+#include <unistd.h>
+
+#include <algorithm>
+#include <map>
+#include <string>
+#include <vector>
+
+#include "base/at_exit.h"
+#include "base/command_line.h"
+#include "base/files/file_path.h"
+#include "base/files/file_util.h"
+#include "base/json/json_writer.h"
+#include "base/logging.h"
+#include "base/macros.h"
+#include "base/scoped_native_library.h"
+#include "base/strings/string_number_conversions.h"
+#include "base/synchronization/waitable_event.h"
+#include "base/time/time.h"
+#include "base/values.h"
+#include "third_party/mmngr/mmngr_buf_user_public.h"
+#include "third_party/mmngr/mmngr_user_public.h"
+#include "third_party/openmax/il/OMX_Component.h"
+#include "third_party/openmax/il/OMX_Core.h"
+
+#include "media/gpu/omx/omx_stubs.h"
+
+using media_gpu_omx::InitializeStubs;
+using media_gpu_omx::kModuleMmngr;
+using media_gpu_omx::kModuleMmngrbuf;
+using media_gpu_omx::kModuleOmx;
+using media_gpu_omx::StubPathMap;
+
+namespace media {
+namespace {
+
+const char kIterationsSwitch[] = "iterations";
+const char kRoleSwitch[] = "role";
+const char kOmxLibrarySwitch[] = "omx-library";
+const char kMmngrLibrarySwitch[] = "mmngr-library";
+const char kMmngrbufLibrarySwitch[] = "mmngrbuf-library";
+const char kOutputSwitch[] = "output";
+
+const int kDefaultIterations = 20;
+// EmptyThisBuffer round trips per iteration.
+const int kRoundTrips = 50;
+// Carveout sizes to allocate, in KB.
+const int kCarveoutSizesKb[] = {64, 1024, 4096, 16384};
+// A 1080p NV12 picture, for dmabuf export and import.
+const size_t kPictureBytes = 1920 * 1088 * 3 / 2;
+// How long the component gets for a command or a buffer.
+const int kTimeoutMs = 2000;
+
+template <typename T>
+void InitParam(T* param) {
+  memset(param, 0, sizeof(T));
+  param->nVersion.nVersion = 0x00000101;
+  param->nSize = sizeof(T);
+}
+
+// The dmabuf import functions of the MMNGRBUF library, null if it has none.
+struct DmabufImport {
+  decltype(&mmngr_import_start_in_user_ext) start = nullptr;
+  decltype(&mmngr_import_end_in_user_ext) end = nullptr;
+};
+
+size_t PageAlign(size_t size) {
+  size_t page_size = getpagesize();
+  return (size + page_size - 1) & ~(page_size - 1);
+}
+
+// Samples of each timed operation, by name.
+class Timings {
+ public:
+  Timings() = default;
+
+  void Add(const std::string& name, base::TimeDelta elapsed) {
+    samples_[name].push_back(elapsed);
+  }
+
+  // Times |operation|, which returns false on failure, as |name|.
+  template <typename Operation>
+  bool Time(const std::string& name, Operation operation) {
+    base::TimeTicks start = base::TimeTicks::Now();
+    if (!operation())
+      return false;
+    Add(name, base::TimeTicks::Now() - start);
+    return true;
+  }
+
+  base::Value ToValue() const {
+    base::Value results(base::Value::Type::DICTIONARY);
+    for (const auto& entry : samples_) {
+      std::vector<base::TimeDelta> sorted = entry.second;
+      std::sort(sorted.begin(), sorted.end());
+      auto percentile = [&sorted](size_t percent) {
+        return sorted[std::min(sorted.size() - 1,
+                               sorted.size() * percent / 100)]
+            .InMicrosecondsF();
+      };
+      base::Value result(base::Value::Type::DICTIONARY);
+      result.SetKey("count", base::Value(static_cast<int>(sorted.size())));
+      result.SetKey("min_us", base::Value(sorted.front().InMicrosecondsF()));
+      result.SetKey("median_us", base::Value(percentile(50)));
+      result.SetKey("p95_us", base::Value(percentile(95)));
+      result.SetKey("max_us", base::Value(sorted.back().InMicrosecondsF()));
+      results.SetKey(entry.first, std::move(result));
+    }
+    return results;
+  }
+
+ private:
+  std::map<std::string, std::vector<base::TimeDelta>> samples_;
+
+  DISALLOW_COPY_AND_ASSIGN(Timings);
+};
+
+// A component and the events it reports on its own threads.
+class Component {
+ public:
+  Component()
+      : handle_(nullptr),
+        command_done_(base::WaitableEvent::ResetPolicy::AUTOMATIC,
+                      base::WaitableEvent::InitialState::NOT_SIGNALED),
+        buffer_done_(base::WaitableEvent::ResetPolicy::AUTOMATIC,
+                     base::WaitableEvent::InitialState::NOT_SIGNALED),
+        error_(OMX_ErrorNone) {}
+
+  ~Component() {
+    if (handle_)
+      Unload();
+  }
+
+  bool GetHandle(char* name) {
+    OMX_CALLBACKTYPE callbacks = {&Component::EventHandler,
+                                  &Component::EmptyBufferDone,
+                                  &Component::FillBufferDone};
+    OMX_ERRORTYPE result = OMX_GetHandle(&handle_, name, this, &callbacks);
+    if (result != OMX_ErrorNone) {
+      LOG(ERROR) << "OMX_GetHandle(" << name << ") failed: " << result;
+      handle_ = nullptr;
+      return false;
+    }
+    return true;
+  }
+
+  bool FreeHandle() {
+    OMX_ERRORTYPE result = OMX_FreeHandle(handle_);
+    handle_ = nullptr;
+    if (result != OMX_ErrorNone) {
+      LOG(ERROR) << "OMX_FreeHandle() failed: " << result;
+      return false;
+    }
+    return true;
+  }
+
+  bool SendCommand(OMX_COMMANDTYPE command, OMX_U32 param) {
+    OMX_ERRORTYPE result = OMX_SendCommand(handle_, command, param, nullptr);
+    if (result != OMX_ErrorNone) {
+      LOG(ERROR) << "OMX_SendCommand(" << command << ", " << param
+                 << ") failed: " << result;
+      return false;
+    }
+    return true;
+  }
+
+  // Waits for the command sent last to complete.
+  bool WaitForCommand() {
+    if (!command_done_.TimedWait(
+            base::TimeDelta::FromMilliseconds(kTimeoutMs))) {
+      LOG(ERROR) << "Command timed out";
+      return false;
+    }
+    if (error_ != OMX_ErrorNone) {
+      LOG(ERROR) << "Command failed: " << error_;
+      return false;
+    }
+    return true;
+  }
+
+  bool WaitForEmptyBufferDone() {
+    if (!buffer_done_.TimedWait(
+            base::TimeDelta::FromMilliseconds(kTimeoutMs))) {
+      LOG(ERROR) << "EmptyBufferDone timed out";
+      return false;
+    }
+    return true;
+  }
+
+  bool AllocateBuffer(OMX_U32 port, OMX_U32 size) {
+    OMX_BUFFERHEADERTYPE* buffer = nullptr;
+    if (OMX_AllocateBuffer(handle_, &buffer, port, nullptr, size) !=
+        OMX_ErrorNone) {
+      LOG(ERROR) << "OMX_AllocateBuffer() failed";
+      return false;
+    }
+    buffers_[port].push_back(buffer);
+    return true;
+  }
+
+  bool UseBuffer(OMX_U32 port, OMX_U32 size, OMX_U8* data) {
+    OMX_BUFFERHEADERTYPE* buffer = nullptr;
+    if (OMX_UseBuffer(handle_, &buffer, port, nullptr, size, data) !=
+        OMX_ErrorNone) {
+      LOG(ERROR) << "OMX_UseBuffer() failed";
+      return false;
+    }
+    buffers_[port].push_back(buffer);
+    return true;
+  }
+
+  // Frees the buffers of |port|.  Those the component does not let go of
+  // stay in buffers().
+  bool FreeBuffers(OMX_U32 port) {
+    std::vector<OMX_BUFFERHEADERTYPE*>& buffers = buffers_[port];
+    while (!buffers.empty()) {
+      if (OMX_FreeBuffer(handle_, port, buffers.back()) != OMX_ErrorNone) {
+        LOG(ERROR) << "OMX_FreeBuffer() failed";
+        return false;
+      }
+      buffers.pop_back();
+    }
+    return true;
+  }
+
+  const std::vector<OMX_BUFFERHEADERTYPE*>& buffers(OMX_U32 port) {
+    return buffers_[port];
+  }
+
+  bool GetPortDefinition(OMX_U32 port, OMX_PARAM_PORTDEFINITIONTYPE* def) {
+    InitParam(def);
+    def->nPortIndex = port;
+    OMX_ERRORTYPE result =
+        OMX_GetParameter(handle_, OMX_IndexParamPortDefinition, def);
+    if (result != OMX_ErrorNone) {
+      LOG(ERROR) << "GetParameter(OMX_IndexParamPortDefinition) failed: "
+                 << result;
+      return false;
+    }
+    return true;
+  }
+
+  OMX_HANDLETYPE handle() const { return handle_; }
+
+ private:
+  // Takes the component back to Loaded from wherever an iteration failed,
+  // freeing its buffers on the way, and frees its handle.  Freeing it in
+  // another state is undefined, so a component that does not get back is
+  // leaked.
+  void Unload() {
+    OMX_STATETYPE state = OMX_StateInvalid;
+    OMX_GetState(handle_, &state);
+    if ((state == OMX_StateExecuting || state == OMX_StatePause) &&
+        SendCommand(OMX_CommandStateSet, OMX_StateIdle) && WaitForCommand()) {
+      state = OMX_StateIdle;
+    }
+    bool freed = true;
+    if (state == OMX_StateIdle &&
+        SendCommand(OMX_CommandStateSet, OMX_StateLoaded)) {
+      for (auto& port : buffers_)
+        freed &= FreeBuffers(port.first);
+      if (WaitForCommand())
+        state = OMX_StateLoaded;
+    } else if (state == OMX_StateLoaded) {
+      // Failed on the way to Idle.
+      for (auto& port : buffers_)
+        freed &= FreeBuffers(port.first);
+    }
+    if (state != OMX_StateLoaded || !freed) {
+      LOG(ERROR) << "Leaking the component in state " << state;
+      return;
+    }
+    OMX_FreeHandle(handle_);
+  }
+
+  static OMX_ERRORTYPE EventHandler(OMX_HANDLETYPE component,
+                                    OMX_PTR app_data,
+                                    OMX_EVENTTYPE event,
+                                    OMX_U32 data1,
+                                    OMX_U32 data2,
+                                    OMX_PTR event_data) {
+    Component* self = static_cast<Component*>(app_data);
+    if (event == OMX_EventError) {
+      self->error_ = static_cast<OMX_ERRORTYPE>(data1);
+      self->command_done_.Signal();
+    } else if (event == OMX_EventCmdComplete) {
+      self->error_ = OMX_ErrorNone;
+      self->command_done_.Signal();
+    }
+    return OMX_ErrorNone;
+  }
+
+  static OMX_ERRORTYPE EmptyBufferDone(OMX_HANDLETYPE component,
+                                       OMX_PTR app_data,
+                                       OMX_BUFFERHEADERTYPE* buffer) {
+    static_cast<Component*>(app_data)->buffer_done_.Signal();
+    return OMX_ErrorNone;
+  }
+
+  static OMX_ERRORTYPE FillBufferDone(OMX_HANDLETYPE component,
+                                      OMX_PTR app_data,
+                                      OMX_BUFFERHEADERTYPE* buffer) {
+    return OMX_ErrorNone;
+  }
+
+  OMX_HANDLETYPE handle_;
+  std::map<OMX_U32, std::vector<OMX_BUFFERHEADERTYPE*>> buffers_;
+  base::WaitableEvent command_done_;
+  base::WaitableEvent buffer_done_;
+  // Written on the component's thread before |command_done_| is signaled.
+  OMX_ERRORTYPE error_;
+
+  DISALLOW_COPY_AND_ASSIGN(Component);
+};
+
+// Times a command whose completion needs |between|, e.g. buffers allocated
+// or freed, which is timed along with it.
+template <typename Between>
+bool TimeCommand(Timings* timings,
+                 const std::string& name,
+                 Component* component,
+                 OMX_COMMANDTYPE command,
+                 OMX_U32 param,
+                 Between between) {
+  return timings->Time(name, [&]() {
+    return component->SendCommand(command, param) && between() &&
+           component->WaitForCommand();
+  });
+}
+
+bool TimeCommand(Timings* timings,
+                 const std::string& name,
+                 Component* component,
+                 OMX_COMMANDTYPE command,
+                 OMX_U32 param) {
+  return TimeCommand(timings, name, component, command, param,
+                     []() { return true; });
+}
+
+// One life of a component; see the file comment.
+bool RunComponentIteration(char* name, Timings* timings) {
+  Component component;
+  if (!timings->Time("get_handle", [&]() { return component.GetHandle(name); }))
+    return false;
+
+  OMX_PORT_PARAM_TYPE ports;
+  InitParam(&ports);
+  if (OMX_GetParameter(component.handle(), OMX_IndexParamVideoInit, &ports) !=
+          OMX_ErrorNone ||
+      ports.nPorts != 2) {
+    LOG(ERROR) << "Unexpected ports";
+    return false;
+  }
+  const OMX_U32 input_port = ports.nStartPortNumber;
+  const OMX_U32 output_port = input_port + 1;
+  OMX_PARAM_PORTDEFINITIONTYPE input_def, output_def;
+  if (!component.GetPortDefinition(input_port, &input_def) ||
+      !component.GetPortDefinition(output_port, &output_def)) {
+    return false;
+  }
+
+  // The output port is enabled in Executing below, as after a resolution
+  // change.
+  if (!component.SendCommand(OMX_CommandPortDisable, output_port) ||
+      !component.WaitForCommand()) {
+    return false;
+  }
+
+  auto allocate_inputs = [&]() {
+    for (OMX_U32 i = 0; i < input_def.nBufferCountActual; ++i) {
+      if (!timings->Time("allocate_buffer", [&]() {
+            return component.AllocateBuffer(input_port, input_def.nBufferSize);
+          })) {
+        return false;
+      }
+    }
+    return true;
+  };
+  if (!TimeCommand(timings, "loaded_to_idle", &component,
+                   OMX_CommandStateSet, OMX_StateIdle, allocate_inputs) ||
+      !TimeCommand(timings, "idle_to_executing", &component,
+                   OMX_CommandStateSet, OMX_StateExecuting)) {
+    return false;
+  }
+
+  // Empty buffers make the component hand them straight back, so this
+  // measures the library's buffer passing and callback delivery rather than
+  // decoding; omxr_decode_bench measures that.
+  const std::vector<OMX_BUFFERHEADERTYPE*>& inputs =
+      component.buffers(input_port);
+  for (int i = 0; i < kRoundTrips; ++i) {
+    OMX_BUFFERHEADERTYPE* buffer = inputs[i % inputs.size()];
+    buffer->nFilledLen = 0;
+    buffer->nOffset = 0;
+    buffer->nFlags = 0;
+    if (!timings->Time("empty_buffer_round_trip", [&]() {
+          return OMX_EmptyThisBuffer(component.handle(), buffer) ==
+                     OMX_ErrorNone &&
+                 component.WaitForEmptyBufferDone();
+        })) {
+      LOG(ERROR) << "EmptyThisBuffer round trip failed";
+      return false;
+    }
+  }
+
+  // Output buffers in carveout, as the decoder gives them.
+  const size_t output_size = PageAlign(output_def.nBufferSize);
+  std::vector<MMNGR_ID> carveout;
+  auto use_outputs = [&]() {
+    for (OMX_U32 i = 0; i < output_def.nBufferCountActual; ++i) {
+      MMNGR_ID id;
+      unsigned int hard_addr;
+      void* virt_addr;
+      if (mmngr_alloc_in_user_ext(&id, output_size, &hard_addr, &virt_addr,
+                                  MMNGR_PA_SUPPORT, nullptr)) {
+        LOG(ERROR) << "Cannot allocate " << output_size << " bytes";
+        return false;
+      }
+      carveout.push_back(id);
+      if (!timings->Time("use_buffer", [&]() {
+            return component.UseBuffer(output_port, output_def.nBufferSize,
+                                       reinterpret_cast<OMX_U8*>(hard_addr));
+          })) {
+        return false;
+      }
+    }
+    return true;
+  };
+  bool ok =
+      TimeCommand(timings, "port_enable", &component, OMX_CommandPortEnable,
+                  output_port, use_outputs) &&
+      TimeCommand(timings, "port_disable", &component, OMX_CommandPortDisable,
+                  output_port,
+                  [&]() { return component.FreeBuffers(output_port); });
+  // After a failure the component may still have output buffers in the
+  // carveout; it goes only once they are freed.
+  if (!ok && !component.FreeBuffers(output_port)) {
+    LOG(ERROR) << "Leaking the output carveout";
+    return false;
+  }
+  for (MMNGR_ID id : carveout)
+    mmngr_free_in_user_ext(id);
+  if (!ok)
+    return false;
+
+  return TimeCommand(timings, "executing_to_idle", &component,
+                     OMX_CommandStateSet, OMX_StateIdle) &&
+         TimeCommand(timings, "idle_to_loaded", &component,
+                     OMX_CommandStateSet, OMX_StateLoaded,
+                     [&]() { return component.FreeBuffers(input_port); }) &&
+         timings->Time("free_handle", [&]() { return component.FreeHandle(); });
+}
+
+bool RunCarveoutIteration(const DmabufImport& import, Timings* timings) {
+  for (int size_kb : kCarveoutSizesKb) {
+    MMNGR_ID id;
+    unsigned int hard_addr;
+    void* virt_addr;
+    std::string suffix = "_" + base::IntToString(size_kb) + "kb";
+    if (!timings->Time("mmngr_alloc" + suffix, [&]() {
+          return !mmngr_alloc_in_user_ext(&id, size_kb * 1024, &hard_addr,
+                                          &virt_addr, MMNGR_PA_SUPPORT,
+                                          nullptr);
+        })) {
+      LOG(ERROR) << "Cannot allocate " << size_kb << " KB";
+      return false;
+    }
+    if (!timings->Time("mmngr_free" + suffix,
+                       [&]() { return !mmngr_free_in_user_ext(id); })) {
+      LOG(ERROR) << "Cannot free " << size_kb << " KB";
+      return false;
+    }
+  }
+
+  const size_t size = PageAlign(kPictureBytes);
+  MMNGR_ID id;
+  unsigned int hard_addr;
+  void* virt_addr;
+  if (mmngr_alloc_in_user_ext(&id, size, &hard_addr, &virt_addr,
+                              MMNGR_PA_SUPPORT, nullptr)) {
+    LOG(ERROR) << "Cannot allocate " << size << " bytes";
+    return false;
+  }
+  int export_id;
+  int fd;
+  int import_id;
+  size_t imported_size;
+  unsigned int imported_addr;
+  bool ok =
+      timings->Time("dmabuf_export", [&]() {
+        return !mmngr_export_start_in_user_ext(&export_id, size, hard_addr,
+                                               &fd, nullptr);
+      }) &&
+      (!import.start ||
+       (timings->Time("dmabuf_import", [&]() {
+          return !import.start(&import_id, &imported_size, &imported_addr, fd,
+                               nullptr);
+        }) &&
+        timings->Time("dmabuf_import_end",
+                      [&]() { return !import.end(import_id); }))) &&
+      timings->Time("dmabuf_export_end", [&]() {
+        return !mmngr_export_end_in_user_ext(export_id);
+      });
+  mmngr_free_in_user_ext(id);
+  if (!ok)
+    LOG(ERROR) << "dmabuf export or import failed";
+  return ok;
+}
+
+int RunBench() {
+  const base::CommandLine* command_line =
+      base::CommandLine::ForCurrentProcess();
+  int iterations = kDefaultIterations;
+  if (command_line->HasSwitch(kIterationsSwitch) &&
+      (!base::StringToInt(
+           command_line->GetSwitchValueASCII(kIterationsSwitch), &iterations) ||
+       iterations < 1)) {
+    LOG(ERROR) << "Usage: omxr_vendor_bench [--iterations=N] "
+                  "[--role=ROLE] [--omx-library=PATH]\n"
+                  "                         [--mmngr-library=PATH] "
+                  "[--mmngrbuf-library=PATH] [--output=FILE]";
+    return 1;
+  }
+  std::string role = command_line->HasSwitch(kRoleSwitch)
+                         ? command_line->GetSwitchValueASCII(kRoleSwitch)
+                         : "video_decoder.avc";
+  auto get_path = [command_line](const char* name, const char* fallback) {
+    return command_line->HasSwitch(name)
+               ? command_line->GetSwitchValuePath(name)
+               : base::FilePath(fallback);
+  };
+  // The defaults of OmxrTuningProfile.
+  base::FilePath omx_library =
+      get_path(kOmxLibrarySwitch, "/usr/lib/libomxr_core.so");
+  base::FilePath mmngr_library =
+      get_path(kMmngrLibrarySwitch, "/usr/lib/libmmngr.so.1");
+  base::FilePath mmngrbuf_library =
+      get_path(kMmngrbufLibrarySwitch, "/usr/lib/libmmngrbuf.so.1");
+
+  StubPathMap paths;
+  paths[kModuleOmx].push_back(omx_library.value());
+  paths[kModuleMmngr].push_back(mmngr_library.value());
+  paths[kModuleMmngrbuf].push_back(mmngrbuf_library.value());
+  if (!InitializeStubs(paths)) {
+    LOG(ERROR) << "Cannot load the vendor libraries";
+    return 1;
+  }
+  base::ScopedNativeLibrary mmngrbuf(mmngrbuf_library);
+  DmabufImport import;
+  import.start = reinterpret_cast<decltype(import.start)>(
+      mmngrbuf.GetFunctionPointer("mmngr_import_start_in_user_ext"));
+  import.end = reinterpret_cast<decltype(import.end)>(
+      mmngrbuf.GetFunctionPointer("mmngr_import_end_in_user_ext"));
+  if (!import.start || !import.end) {
+    LOG(WARNING) << "No dmabuf import in " << mmngrbuf_library.value();
+    import = DmabufImport();
+  }
+
+  Timings timings;
+  if (!timings.Time("omx_init", []() { return OMX_Init() == OMX_ErrorNone; })) {
+    LOG(ERROR) << "OMX_Init() failed";
+    return 1;
+  }
+  char component_name[OMX_MAX_STRINGNAME_SIZE];
+  char* names = component_name;
+  OMX_U32 num_components = 1;
+  if (OMX_GetComponentsOfRole(const_cast<OMX_STRING>(role.c_str()),
+                              &num_components,
+                              reinterpret_cast<OMX_U8**>(&names)) !=
+          OMX_ErrorNone ||
+      num_components < 1) {
+    LOG(ERROR) << "No component for " << role;
+    return 1;
+  }
+
+  bool ok = true;
+  for (int i = 0; i < iterations && ok; ++i)
+    ok = RunComponentIteration(component_name, &timings) &&
+         RunCarveoutIteration(import, &timings);
+  OMX_Deinit();
+  if (!ok)
+    return 1;
+
+  base::Value libraries(base::Value::Type::DICTIONARY);
+  libraries.SetKey("omx", base::Value(omx_library.value()));
+  libraries.SetKey("mmngr", base::Value(mmngr_library.value()));
+  libraries.SetKey("mmngrbuf", base::Value(mmngrbuf_library.value()));
+  base::Value report(base::Value::Type::DICTIONARY);
+  report.SetKey("role", base::Value(role));
+  report.SetKey("component", base::Value(component_name));
+  report.SetKey("iterations", base::Value(iterations));
+  report.SetKey("libraries", std::move(libraries));
+  report.SetKey("results", timings.ToValue());
+
+  std::string json;
+  base::JSONWriter::WriteWithOptions(
+      report, base::JSONWriter::OPTIONS_PRETTY_PRINT, &json);
+  if (!command_line->HasSwitch(kOutputSwitch)) {
+    fputs(json.c_str(), stdout);
+    return 0;
+  }
+  base::FilePath output = command_line->GetSwitchValuePath(kOutputSwitch);
+  if (base::WriteFile(output, json.data(), json.size()) !=
+      static_cast<int>(json.size())) {
+    LOG(ERROR) << "Cannot write " << output.value();
+    return 1;
+  }
+  return 0;
+}
+
+}  // namespace
+}  // namespace media
+
+int main(int argc, char** argv) {
+  base::AtExitManager at_exit;
+  base::CommandLine::Init(argc, argv);
+  logging::LoggingSettings settings;
+  settings.logging_dest = logging::LOG_TO_SYSTEM_DEBUG_LOG;
+  logging::InitLogging(settings);
+
+  return media::RunBench();
+}
@@ -3,17 +3,32 @@
 // found in the LICENSE file.
 #include "media/gpu/omx/omxr_video_decode_accelerator.h"
 
+#include <algorithm>
+
 #include <libdrm/drm_fourcc.h>
 #include "base/bind.h"
+#include "base/hash.h"
 #include "base/logging.h"
+#include "base/macros.h"
+#include "base/metrics/histogram_macros.h"
 #include "base/no_destructor.h"
+#include "base/optional.h"
 #include "base/stl_util.h"
 #include "base/strings/string_util.h"
+#include "base/threading/platform_thread.h"
 #include "base/threading/thread_task_runner_handle.h"
 #include "base/trace_event/trace_event.h"
 #include "media/base/bitstream_buffer.h"
+#include "media/gpu/omx/omxr_features.h"
+#include "media/gpu/omx/omxr_resource_tracker.h"
+#include "media/gpu/omx/omxr_tuning_profile.h"
+#include "media/video/h264_bit_reader.h"
+#include "media/video/h264_parser.h"
 #include "media/video/picture.h"
+#include "third_party/openmax/il/OMXR_Extension_h264d.h"
 #include "third_party/openmax/il/OMXR_Extension_vdcmn.h"
+#include "third_party/openmax/il/OMX_IndexExt.h"
+#include "third_party/openmax/il/OMX_VideoExt.h"
 #include "ui/gl/egl_util.h"
 
 #include "media/gpu/omx/omx_stubs.h"
@@ -28,23 +43,55 @@ using media_gpu_omx::kModuleMmngrbuf;
 using media_gpu_omx::InitializeStubs;
 using media_gpu_omx::StubPathMap;
 
-static const base::FilePath::CharType kOMXLib[] =
-    FILE_PATH_LITERAL("/usr/lib/libomxr_core.so");
+namespace media {
 
-static const base::FilePath::CharType kMMNGRLib[] =
-    FILE_PATH_LITERAL("/usr/lib/libmmngr.so.1");
+// Upper bound on access units waiting for their picture to be timed; entries
+// for pictures the component never outputs are dropped beyond this.
+enum { kMaxTimedAccessUnits = 64 };
+
+// Components given up on as hung, and when the last one was.  The vendor
+// library is not trusted with new sessions for kOmxrHangWatchdogBackoffMs
+// after a hang, doubled for every further hang up to kMaxHangBackoffDoublings
+// times: a library that hangs once tends to hang again, and each hung
+// component keeps its buffers.
+static int g_hung_components = 0;
+static base::TimeTicks g_last_component_hang;
+enum { kMaxHangBackoffDoublings = 6 };
+
+static void NoteComponentHung() {
+  ++g_hung_components;
+  g_last_component_hang = base::TimeTicks::Now();
+}
 
-static const base::FilePath::CharType kMMNGRBufLib[] =
-    FILE_PATH_LITERAL("/usr/lib/libmmngrbuf.so.1");
+// Time left before new sessions are let through again.
+static base::TimeDelta HangBackoffRemaining() {
+  if (!g_hung_components)
+    return base::TimeDelta();
+  int doublings = std::min<int>(g_hung_components - 1,
+                                kMaxHangBackoffDoublings);
+  base::TimeDelta backoff =
+      base::TimeDelta::FromMilliseconds(kOmxrHangWatchdogBackoffMs.Get()) *
+      (1 << doublings);
+  return g_last_component_hang + backoff - base::TimeTicks::Now();
+}
 
-namespace media {
+// Pictures published by the leader of a shared stream that a follower keeps
+// while waiting for the matching bitstream buffer or a free texture, and for
+// how long at most.
+enum { kMaxSharedPendingPictures = 2 };
+enum { kSharedPendingTimeoutMs = 200 };
+
+// How long a follower's Flush() waits for the leader's pictures of the
+// bitstream buffers queued before it.
+enum { kSharedFlushTimeoutMs = 1000 };
 
-enum { kNumPictureBuffers = 8 };
+// Pictures kept away from the component in GOP cache mode, to copy cached
+// pictures into.
+enum { kNumSparePictures = 2 };
 
-// Delay between polling for texture sync status. 5ms feels like a good
-// compromise, allowing some decoding ahead (up to 3 frames/vsync) to compensate
-// for more difficult frames.
-enum { kSyncPollDelayMs = 5 };
+// Bitstream id of the marker that pushes out the last access unit of a
+// replayed GOP.
+enum { kEndOfReplayId = -3 };
 
 OmxrVideoDecodeAccelerator::BitstreamBufferRef::BitstreamBufferRef(
     const media::BitstreamBuffer &buf,
@@ -54,14 +101,32 @@ OmxrVideoDecodeAccelerator::BitstreamBufferRef::BitstreamBufferRef(
       client(cl) {
   id = buf.id();
   size = buf.size();
+  arrival_time = base::TimeTicks::Now();
   shm = std::make_unique<base::SharedMemory> (buf.handle(), true);
   shm->Map(size);
   memory = shm->memory();
 }
 
+OmxrVideoDecodeAccelerator::BitstreamBufferRef::BitstreamBufferRef(
+    int32_t replay_id,
+    const uint8_t* data,
+    size_t data_size)
+    : id(replay_id),
+      size(data_size),
+      arrival_time(base::TimeTicks::Now()),
+      replayed(true) {
+  replay_data.assign(data, data + data_size);
+  memory = replay_data.data();
+}
+
 OmxrVideoDecodeAccelerator::BitstreamBufferRef::~BitstreamBufferRef() {
-    if (id < 0)
+    if (id < 0 || replayed)
         return;
+    if (batcher) {
+      batcher->Add(base::BindOnce(
+          &Client::NotifyEndOfBitstreamBuffer, client, id));
+      return;
+    }
     task_runner->PostTask(FROM_HERE, base::Bind(
      &Client::NotifyEndOfBitstreamBuffer, client, id));
 }
@@ -76,8 +141,19 @@ OmxrVideoDecodeAccelerator::OutputPicture::OutputPicture(
     omx_buffer_header(obuffer),
     egl_image(eimage), mmngr_buf(mbuf),
     at_component(false),
+    at_client(false),
     allocated(false) {}
 
+// static
+void OmxrVideoDecodeAccelerator::OutputPicture::FreePictureMemory(
+    EGLDisplay egl_display,
+    EGLImageKHR egl_image,
+    const MmngrBuffer& mmngr_buf) {
+  mmngr_export_end_in_user_ext(mmngr_buf.dmabuf_id);
+  OmxrResourceTracker::Get()->FreeCarveout(mmngr_buf.mem_id);
+  eglDestroyImageKHR(egl_display, egl_image);
+}
+
 OMX_ERRORTYPE OmxrVideoDecodeAccelerator::OutputPicture::FreeOMXHandle() {
   OMX_BUFFERHEADERTYPE* obuffer = omx_buffer_header;
   if (!obuffer)
@@ -93,10 +169,15 @@ OmxrVideoDecodeAccelerator::OutputPicture::~OutputPicture() {
 
     FreeOMXHandle();
 
-    mmngr_export_end_in_user_ext(mmngr_buf.dmabuf_id);
-    mmngr_free_in_user_ext(mmngr_buf.mem_id);
-    eglDestroyImageKHR(decoder.egl_display_, egl_image);
+    // Followers of a shared stream may still show the picture; its memory
+    // goes once they are done with it.
+    OmxrSharedDecodeRegistry::Get()->FreeWhenReleased(
+        &decoder, picture_buffer.id(),
+        base::BindOnce(&FreePictureMemory, decoder.egl_display_, egl_image,
+                       mmngr_buf));
 
+    if (decoder.notification_batcher_)
+      decoder.notification_batcher_->Deliver();
     if (decoder.client_)
       decoder.client_->DismissPictureBuffer(picture_buffer.id());
 }
@@ -120,16 +201,87 @@ OmxrVideoDecodeAccelerator::OutputPicture::~OutputPicture() {
       log << ", OMX result: 0x" << std::hex << omx_result,              \
       error, ret_val)
 
+// Evaluates |call|, a call into the vendor OMX or MMNGR libraries, counting its
+// CPU time in |stats_|.
+#define VENDOR_CALL(call) VendorCall([&]() { return call; })
+
+// Runs the OMX probing, i.e. the construction of the OmxrProfileManager.
+class OmxrVideoDecodeAccelerator::OmxrProfileManager::ProbeThread
+    : public base::PlatformThread::Delegate {
+ public:
+  static ProbeThread* Get() {
+    static base::NoDestructor<ProbeThread> probe_thread;
+    return probe_thread.get();
+  }
+
+  void Start() {
+    base::AutoLock auto_lock(lock_);
+    if (started_)
+      return;
+    started_ = true;
+    if (!base::PlatformThread::Create(0, this, &handle_)) {
+      DLOG(ERROR) << "Cannot start OMX probe thread, probing synchronously";
+      Instance();
+    }
+  }
+
+  void Wait() {
+    base::AutoLock auto_lock(lock_);
+    if (handle_.is_null())
+      return;
+    TRACE_EVENT0("media,gpu", "OmxrProfileManager::WaitForProbe");
+    base::TimeTicks start = base::TimeTicks::Now();
+    base::PlatformThread::Join(handle_);
+    handle_ = base::PlatformThreadHandle();
+    base::TimeDelta waited = base::TimeTicks::Now() - start;
+    UMA_HISTOGRAM_TIMES("Media.OmxrProbe.WaitTime", waited);
+    VLOG(1) << "Waited " << waited.InMilliseconds() << " ms for OMX probing";
+  }
+
+ private:
+  // base::PlatformThread::Delegate implementation.
+  void ThreadMain() override {
+    base::PlatformThread::SetName("OmxrProbe");
+    TRACE_EVENT0("media,gpu", "OmxrProfileManager::Probe");
+    base::TimeTicks start = base::TimeTicks::Now();
+    Instance();
+    VLOG(1) << "OMX probing took "
+            << (base::TimeTicks::Now() - start).InMilliseconds() << " ms";
+  }
+
+  base::Lock lock_;
+  bool started_ = false;
+  base::PlatformThreadHandle handle_;
+};
+
+// static
 const OmxrVideoDecodeAccelerator::OmxrProfileManager &OmxrVideoDecodeAccelerator::OmxrProfileManager::Get() {
+    WaitForProbe();
+    return Instance();
+}
+
+// static
+void OmxrVideoDecodeAccelerator::OmxrProfileManager::StartProbe() {
+    ProbeThread::Get()->Start();
+}
+
+// static
+void OmxrVideoDecodeAccelerator::OmxrProfileManager::WaitForProbe() {
+    ProbeThread::Get()->Wait();
+}
+
+// static
+const OmxrVideoDecodeAccelerator::OmxrProfileManager &OmxrVideoDecodeAccelerator::OmxrProfileManager::Instance() {
     static const base::NoDestructor<OmxrProfileManager> profile_manager;
     return *profile_manager;
 }
 
 void OmxrVideoDecodeAccelerator::OmxrProfileManager::InitOMXLibs() {
+    const OmxrTuningProfile& tuning = OmxrTuningProfile::Get();
     StubPathMap paths;
-    paths[kModuleOmx].push_back(kOMXLib);
-    paths[kModuleMmngr].push_back(kMMNGRLib);
-    paths[kModuleMmngrbuf].push_back(kMMNGRBufLib);
+    paths[kModuleOmx].push_back(tuning.omx_library.value());
+    paths[kModuleMmngr].push_back(tuning.mmngr_library.value());
+    paths[kModuleMmngrbuf].push_back(tuning.mmngrbuf_library.value());
     InitializeStubs(paths);
 }
 
@@ -188,6 +340,7 @@ OmxrVideoDecodeAccelerator::OmxrVideoDecodeAccelerator(
     const base::Callback<bool(void)>& make_context_current)
     : child_task_runner_(base::ThreadTaskRunnerHandle::Get()),
       component_handle_(NULL),
+      tuning_(OmxrTuningProfile::Get()),
       weak_this_factory_(this),
       init_begun_(false),
       init_done_cond_(&init_lock_),
@@ -197,14 +350,49 @@ OmxrVideoDecodeAccelerator::OmxrVideoDecodeAccelerator(
       input_buffer_size_(0),
       input_port_(0),
       input_buffers_at_component_(0),
+      input_config_{0, 0},
+      pending_input_config_{0, 0},
       first_input_buffer_sent_(false),
-      previous_frame_has_data_(false),
       output_port_(0),
       output_buffers_at_component_(0),
+      slice_streaming_(false),
+      slice_au_open_(false),
+      slice_au_id_(-1),
+      picture_alloc_size_(0),
+      refill_target_id_(-1),
+      stepping_(false),
+      loop_cache_max_bytes_(0),
       reset_pending_(false),
       egl_display_(egl_display),
       make_context_current_(make_context_current),
-      codec_(UNKNOWN) {
+      context_generation_(0),
+      output_stride_(0),
+      output_slice_height_(0),
+      codec_(UNKNOWN),
+      codec_info_{UNKNOWN, nullptr, nullptr},
+      deferred_init_allowed_(false),
+      mux_session_id_(0),
+      resuming_from_park_(false),
+      parking_drained_(false),
+      parking_reset_pending_(false),
+      flush_pending_(false),
+      avcc_length_size_(0),
+      avcc_native_(false),
+      restore_parameter_sets_(false),
+      shared_follower_(false),
+      shared_flush_pending_(false),
+      shared_flush_inputs_(0),
+      shared_timer_armed_(false),
+      promoted_from_follower_(false),
+      wait_for_keyframe_(false),
+      watchdog_armed_(false),
+      component_hung_(false),
+      idle_timer_armed_(false),
+      catch_up_skip_to_keyframe_(false),
+      catching_up_(false),
+      dropping_au_(false),
+      skip_to_keyframe_(false),
+      cpu_task_depth_(0) {
   weak_this_ = weak_this_factory_.GetWeakPtr();
 }
 
@@ -214,6 +402,9 @@ OmxrVideoDecodeAccelerator::~OmxrVideoDecodeAccelerator() {
   DCHECK_EQ(0, input_buffers_at_component_);
   DCHECK_EQ(0, output_buffers_at_component_);
   DCHECK(pictures_.empty());
+  if (mux_session_id_)
+    OmxrSessionMultiplexer::Get()->UnregisterSession(mux_session_id_);
+  LeaveSharedStream();
 }
 
 // This is to initialize the OMX data structures to default values.
@@ -224,6 +415,54 @@ static void InitParam(T* param) {
   param->nSize = sizeof(T);
 }
 
+// Maps an H.264 level_idc, as checked by OmxrTuningProfile, to OMX.
+static OMX_VIDEO_AVCLEVELTYPE ToOmxAvcLevel(int level_idc) {
+  static const struct {
+    int level_idc;
+    OMX_VIDEO_AVCLEVELTYPE level;
+  } kLevels[] = {
+      {10, OMX_VIDEO_AVCLevel1},  {11, OMX_VIDEO_AVCLevel11},
+      {12, OMX_VIDEO_AVCLevel12}, {13, OMX_VIDEO_AVCLevel13},
+      {20, OMX_VIDEO_AVCLevel2},  {21, OMX_VIDEO_AVCLevel21},
+      {22, OMX_VIDEO_AVCLevel22}, {30, OMX_VIDEO_AVCLevel3},
+      {31, OMX_VIDEO_AVCLevel31}, {32, OMX_VIDEO_AVCLevel32},
+      {40, OMX_VIDEO_AVCLevel4},  {41, OMX_VIDEO_AVCLevel41},
+      {42, OMX_VIDEO_AVCLevel42}, {50, OMX_VIDEO_AVCLevel5},
+      {51, OMX_VIDEO_AVCLevel51},
+  };
+  for (const auto& level : kLevels) {
+    if (level.level_idc == level_idc)
+      return level.level;
+  }
+  NOTREACHED() << "Unknown level " << level_idc;
+  return OMX_VIDEO_AVCLevel5;
+}
+
+// Returns the id an H.264 SPS or PPS declares, or -1 if it cannot be read.
+static int ReadParameterSetId(const OmxrBitstreamFramer::ParameterSet& ps) {
+  H264BitReader reader;
+  if (ps.size < 2 || !reader.Initialize(ps.data + 1, ps.size - 1))
+    return -1;
+  int bits;
+  // profile_idc, the constraint flags and level_idc come first in an SPS.
+  if (ps.type == OmxrBitstreamFramer::SPS && !reader.ReadBits(24, &bits))
+    return -1;
+  // The id is coded ue(v); PPS ids go up to 255.
+  int leading_zeros = 0;
+  for (;;) {
+    if (!reader.ReadBits(1, &bits))
+      return -1;
+    if (bits)
+      break;
+    if (++leading_zeros > 8)
+      return -1;
+  }
+  int suffix = 0;
+  if (leading_zeros && !reader.ReadBits(leading_zeros, &suffix))
+    return -1;
+  return (1 << leading_zeros) - 1 + suffix;
+}
+
 VideoDecodeAccelerator::SupportedProfiles
 OmxrVideoDecodeAccelerator::GetSupportedProfiles() {
     VideoDecodeAccelerator::SupportedProfiles profiles;
@@ -232,7 +471,7 @@ OmxrVideoDecodeAccelerator::GetSupportedProfiles() {
 
     for (const auto& profile : supported_profiles) {
         const auto kMinSize = gfx::Size(130,98);
-        const auto kMaxSize = gfx::Size(1920,1080);
+        const auto kMaxSize = OmxrTuningProfile::Get().max_resolution;
         VideoDecodeAccelerator::SupportedProfile supp_profile;
         supp_profile.profile = profile;
         supp_profile.min_resolution = kMinSize;
@@ -246,6 +485,7 @@ OmxrVideoDecodeAccelerator::GetSupportedProfiles() {
 bool OmxrVideoDecodeAccelerator::Initialize(const Config& config, Client* client) {
   auto profile = config.profile;
   DCHECK(child_task_runner_->BelongsToCurrentThread());
+  CpuTaskScope cpu_scope(this, OmxrDecoderStats::CPU_OTHER);
   CodecInfo cinfo;
 
   page_size_ = sysconf(_SC_PAGESIZE);
@@ -254,15 +494,58 @@ bool OmxrVideoDecodeAccelerator::Initialize(const Config& config, Client* client
         "Cannot get valid system page size",
         PLATFORM_FAILURE, false);
 
+  base::TimeDelta hang_backoff = HangBackoffRemaining();
+  RETURN_ON_FAILURE(hang_backoff <= base::TimeDelta(),
+                    "OMX components hung: " << g_hung_components
+                        << ", not starting another for "
+                        << hang_backoff.InSeconds() << " s",
+                    PLATFORM_FAILURE, false);
+
   cinfo = OmxrProfileManager::Get().getCodecForProfile(profile);
 
   RETURN_ON_FAILURE(cinfo.codec != UNKNOWN, "Unsupported profile: " << profile,
                       INVALID_ARGUMENT, false);
 
   codec_ = cinfo.codec;
+  codec_info_ = cinfo;
+  cpu_stream_class_ = codec_ == H264 ? "h264" : "vp8";
 
-  if (codec_ == H264)
-    h264_parser_.reset(new H264Parser);
+  framer_ = OmxrBitstreamFramer::Create(codec_ == H264 ? kCodecH264
+                                                       : kCodecVP8);
+  if (avcc_length_size_) {
+    RETURN_ON_FAILURE(codec_ == H264, "AVCC input requires H.264",
+                      INVALID_ARGUMENT, false);
+    framer_ = OmxrBitstreamFramer::CreateAvcc(avcc_length_size_);
+    // avc1 samples do not carry the parameter sets from the record.
+    restore_parameter_sets_ = true;
+  }
+  slice_streaming_ = codec_ == H264 &&
+      base::FeatureList::IsEnabled(kOmxrSliceStreaming);
+  if (base::FeatureList::IsEnabled(kOmxrGopCache))
+    gop_cache_.reset(new OmxrGopCache(kOmxrGopCacheMaxBytes.Get()));
+  if (base::FeatureList::IsEnabled(kOmxrLoopCache)) {
+    loop_cache_.reset(new OmxrLoopCache());
+    loop_cache_max_bytes_ = kOmxrLoopCacheMaxBytes.Get();
+  }
+  if (codec_ == H264 && base::FeatureList::IsEnabled(kOmxrPredictiveResize))
+    preallocator_.reset(new OmxrPicturePreallocator());
+  if (base::FeatureList::IsEnabled(kOmxrHangWatchdog)) {
+    hang_timeout_ =
+        base::TimeDelta::FromMilliseconds(kOmxrHangWatchdogTimeoutMs.Get());
+  }
+  if (base::FeatureList::IsEnabled(kOmxrAutoIdle)) {
+    idle_delay_ =
+        base::TimeDelta::FromMilliseconds(kOmxrAutoIdleDelayMs.Get());
+  }
+  // Dropped input would leave holes in the caches and in followers' streams.
+  if (base::FeatureList::IsEnabled(kOmxrLiveCatchUp) && !gop_cache_ &&
+      !loop_cache_ && shared_key_.empty()) {
+    catch_up_threshold_ =
+        base::TimeDelta::FromMilliseconds(kOmxrLiveCatchUpThresholdMs.Get());
+    catch_up_target_ =
+        base::TimeDelta::FromMilliseconds(kOmxrLiveCatchUpTargetMs.Get());
+    catch_up_skip_to_keyframe_ = kOmxrLiveCatchUpSkipToKeyframe.Get();
+  }
 
   // Make sure that we have a context we can use for EGL image binding.
   RETURN_ON_FAILURE(make_context_current_.Run(),
@@ -277,6 +560,15 @@ bool OmxrVideoDecodeAccelerator::Initialize(const Config& config, Client* client
     decode_task_runner_ = child_task_runner_;
     decode_client_ = client_;
   }
+  if (base::FeatureList::IsEnabled(kOmxrBatchedNotifications)) {
+    notification_batcher_.reset(new OmxrNotificationBatcher(
+        decode_task_runner_,
+        base::TimeDelta::FromMilliseconds(
+            kOmxrBatchedNotificationsMaxDelayMs.Get()),
+        base::BindRepeating(
+            &OmxrVideoDecodeAccelerator::OnNotificationsDelivered,
+            base::Unretained(this))));
+  }
 
   if (!config.supported_output_formats.empty() &&
       !base::ContainsValue(config.supported_output_formats,
@@ -288,27 +580,43 @@ bool OmxrVideoDecodeAccelerator::Initialize(const Config& config, Client* client
                     PLATFORM_FAILURE,
                     false);
 
-  if (!CreateComponent(cinfo))  // Does its own RETURN_ON_FAILURE dances.
-    return false;
-  if (!DecoderSpecificInitialization())  // Does its own RETURN_ON_FAILURE dances.
-    return false;
-
   deferred_init_allowed_ = config.is_deferred_initialization_allowed;
 
   VLOGF(1) << "Deferred initialization " << (deferred_init_allowed_ ? "allowed" : "not allowed");
 
-  DCHECK_EQ(current_state_change_, NO_TRANSITION);
-  current_state_change_ = INITIALIZING;
-  BeginTransitionToState(OMX_StateIdle);
+  input_buffer_offset_ = 0;
 
-  if (!AllocateInputBuffers())  // Does its own RETURN_ON_FAILURE dances.
-    return false;
-  if (!AllocateFakeOutputBuffers())  // Does its own RETURN_ON_FAILURE dances.
-    return false;
+  if (!shared_key_.empty() &&
+      !OmxrSharedDecodeRegistry::Get()->Join(shared_key_, this)) {
+    // Another decoder decodes this stream; we only show its pictures.
+    shared_follower_ = true;
+    init_begun_ = true;
+    if (deferred_init_allowed_) {
+      child_task_runner_->PostTask(FROM_HERE, base::Bind(
+          &Client::NotifyInitializationComplete, client_, true));
+    }
+    return true;
+  }
 
-  init_begun_ = true;
-  input_buffer_offset_ = 0;
+  // Resuming a parked session re-runs initialization asynchronously, so
+  // multiplexing is only possible with deferred initialization.  A shared
+  // stream keeps its component, which its followers' pictures live in.
+  if (deferred_init_allowed_ && shared_key_.empty() &&
+      base::FeatureList::IsEnabled(kOmxrSessionMultiplexing)) {
+    mux_session_id_ = OmxrSessionMultiplexer::Get()->RegisterSession();
+    if (!OmxrSessionMultiplexer::Get()->AcquireComponent(
+            mux_session_id_,
+            base::Bind(&OmxrVideoDecodeAccelerator::OnComponentGranted,
+                       weak_this_))) {
+      VLOGF(1) << "Waiting for a component to become available";
+      current_state_change_ = INITIALIZING;
+      init_begun_ = true;
+      return true;
+    }
+  }
 
+  if (!InitializeComponent())  // Does its own RETURN_ON_FAILURE dances.
+    return false;
 
   if (deferred_init_allowed_)
     return true;
@@ -317,14 +625,62 @@ bool OmxrVideoDecodeAccelerator::Initialize(const Config& config, Client* client
   /* TODO(dhobsong): timeout */
 
   base::AutoLock auto_lock_(init_lock_);
+  base::TimeTicks deadline = base::TimeTicks::Now() + hang_timeout_;
   while (current_state_change_ == INITIALIZING) {
-    init_done_cond_.Wait();
+    if (hang_timeout_.is_zero()) {
+      init_done_cond_.Wait();
+      continue;
+    }
+    base::TimeDelta remaining = deadline - base::TimeTicks::Now();
+    if (remaining <= base::TimeDelta()) {
+      LOG(ERROR) << "OMX component did not reach Executing in time";
+      component_hung_ = true;
+      NoteComponentHung();
+      return false;
+    }
+    init_done_cond_.TimedWait(remaining);
   }
   VLOGF(1) << "Sync Initialization complete";
   return true;
 
 }
 
+bool OmxrVideoDecodeAccelerator::InitializeComponent() {
+  DCHECK(child_task_runner_->BelongsToCurrentThread());
+  if (!CreateComponent(codec_info_))  // Does its own RETURN_ON_FAILURE dances.
+    return false;
+  if (!hang_timeout_.is_zero() && !watchdog_armed_) {
+    watchdog_armed_ = true;
+    NoteComponentProgress();
+    child_task_runner_->PostDelayedTask(FROM_HERE, base::Bind(
+        &OmxrVideoDecodeAccelerator::CheckComponentProgress, weak_this_),
+        hang_timeout_ / 4);
+  }
+  if (!DecoderSpecificInitialization())  // Does its own RETURN_ON_FAILURE dances.
+    return false;
+
+  current_state_change_ = INITIALIZING;
+  BeginTransitionToState(OMX_StateIdle);
+
+  if (!AllocateInputBuffers())  // Does its own RETURN_ON_FAILURE dances.
+    return false;
+  if (!AllocateFakeOutputBuffers())  // Does its own RETURN_ON_FAILURE dances.
+    return false;
+
+  init_begun_ = true;
+  return true;
+}
+
+void OmxrVideoDecodeAccelerator::OnComponentGranted() {
+  DCHECK(child_task_runner_->BelongsToCurrentThread());
+  VLOGF(1) << "Component granted to session " << mux_session_id_;
+  if (current_state_change_ != PARKED &&
+      current_state_change_ != INITIALIZING)
+    return;
+  // Failures are reported through StopOnError(); |init_begun_| is already set.
+  InitializeComponent();
+}
+
 bool OmxrVideoDecodeAccelerator::CreateComponent(const struct CodecInfo &cinfo) {
   DCHECK(child_task_runner_->BelongsToCurrentThread());
   OMX_ERRORTYPE result;
@@ -335,21 +691,21 @@ bool OmxrVideoDecodeAccelerator::CreateComponent(const struct CodecInfo &cinfo)
   };
 
   // Get the handle to the component.
-  result = OMX_GetHandle(
-      &component_handle_, cinfo.component,
-      this, &omx_accelerator_callbacks);
+  result = VENDOR_CALL(OMX_GetHandle(&component_handle_, cinfo.component, this,
+                                     &omx_accelerator_callbacks));
 
   RETURN_ON_OMX_FAILURE(result,
                         "Failed to OMX_GetHandle on: " << cinfo.component,
                         PLATFORM_FAILURE, false);
+  OmxrResourceTracker::Get()->ComponentCreated();
   client_state_ = OMX_StateLoaded;
 
   // Get the port information. This will obtain information about the number of
   // ports and index of the first port.
   OMX_PORT_PARAM_TYPE port_param;
   InitParam(&port_param);
-  result = OMX_GetParameter(component_handle_, OMX_IndexParamVideoInit,
-                            &port_param);
+  result = VENDOR_CALL(OMX_GetParameter(
+      component_handle_, OMX_IndexParamVideoInit, &port_param));
   RETURN_ON_FAILURE(result == OMX_ErrorNone && port_param.nPorts == 2,
                     "Failed to get Port Param: " << result << ", "
                     << port_param.nPorts,
@@ -365,9 +721,8 @@ bool OmxrVideoDecodeAccelerator::CreateComponent(const struct CodecInfo &cinfo)
                 cinfo.role,
                 OMX_MAX_STRINGNAME_SIZE);
 
-  result = OMX_SetParameter(component_handle_,
-                            OMX_IndexParamStandardComponentRole,
-                            &role_type);
+  result = VENDOR_CALL(OMX_SetParameter(
+      component_handle_, OMX_IndexParamStandardComponentRole, &role_type));
   RETURN_ON_OMX_FAILURE(result, "Failed to Set Role",
                         PLATFORM_FAILURE, false);
 
@@ -375,9 +730,8 @@ bool OmxrVideoDecodeAccelerator::CreateComponent(const struct CodecInfo &cinfo)
   OMX_PARAM_PORTDEFINITIONTYPE port_format;
   InitParam(&port_format);
   port_format.nPortIndex = input_port_;
-  result = OMX_GetParameter(component_handle_,
-                            OMX_IndexParamPortDefinition,
-                            &port_format);
+  result = VENDOR_CALL(OMX_GetParameter(
+      component_handle_, OMX_IndexParamPortDefinition, &port_format));
   RETURN_ON_OMX_FAILURE(result,
                         "GetParameter(OMX_IndexParamPortDefinition) failed",
                         PLATFORM_FAILURE, false);
@@ -386,13 +740,42 @@ bool OmxrVideoDecodeAccelerator::CreateComponent(const struct CodecInfo &cinfo)
 
   input_buffer_count_ = port_format.nBufferCountActual;
   input_buffer_size_ = port_format.nBufferSize;
+  // The board's profile overrides the component's defaults, until the input
+  // tuner has something better.
+  if (tuning_.input_buffer_count && !(input_tuner_ && input_config_.count)) {
+    OmxrInputTuner::Config tuned = {
+        std::max(tuning_.input_buffer_count,
+                 static_cast<int>(port_format.nBufferCountMin)),
+        tuning_.input_buffer_size
+            ? static_cast<size_t>(tuning_.input_buffer_size)
+            : input_buffer_size_};
+    if (!SetInputPortBuffers(tuned))
+      return false;
+  }
+
+  if (base::FeatureList::IsEnabled(kOmxrInputTuner)) {
+    if (!input_tuner_) {
+      // One buffer more than the component needs is being filled by us.
+      OmxrInputTuner::Config minimum = {
+          static_cast<int>(port_format.nBufferCountMin) + 1,
+          port_format.nBufferSize};
+      input_tuner_.reset(
+          new OmxrInputTuner(minimum, kOmxrInputTunerMaxBytes.Get()));
+    } else if (input_config_.count) {
+      // A component re-created after parking starts out with what the
+      // previous one was tuned to, updated with the latest observations.
+      OmxrInputTuner::Config next = input_config_;
+      input_tuner_->Recommend(base::TimeTicks::Now(), input_config_, &next);
+      if (!SetInputPortBuffers(next))
+        return false;
+    }
+  }
 
   // Verify output port conforms to our expectations.
   InitParam(&port_format);
   port_format.nPortIndex = output_port_;
-  result = OMX_GetParameter(component_handle_,
-                            OMX_IndexParamPortDefinition,
-                            &port_format);
+  result = VENDOR_CALL(OMX_GetParameter(
+      component_handle_, OMX_IndexParamPortDefinition, &port_format));
   RETURN_ON_OMX_FAILURE(result,
                         "GetParameter(OMX_IndexParamPortDefinition) failed",
                         PLATFORM_FAILURE, false);
@@ -400,7 +783,7 @@ bool OmxrVideoDecodeAccelerator::CreateComponent(const struct CodecInfo &cinfo)
                     PLATFORM_FAILURE, false);
 
   // Set output port parameters.
-  port_format.nBufferCountActual = kNumPictureBuffers;
+  port_format.nBufferCountActual = tuning_.num_picture_buffers;
   port_format.format.video.eColorFormat = OMX_COLOR_FormatYUV420SemiPlanar;
 
   // Force an OMX_EventPortSettingsChanged event to be sent once we know the
@@ -414,9 +797,8 @@ bool OmxrVideoDecodeAccelerator::CreateComponent(const struct CodecInfo &cinfo)
   port_format.nBufferSize = port_format.format.video.nStride *
         port_format.format.video.nSliceHeight * 3 / 2;
   output_buffer_size_ = port_format.nBufferSize;
-  result = OMX_SetParameter(component_handle_,
-                            OMX_IndexParamPortDefinition,
-                            &port_format);
+  result = VENDOR_CALL(OMX_SetParameter(
+      component_handle_, OMX_IndexParamPortDefinition, &port_format));
   RETURN_ON_OMX_FAILURE(result,
                         "SetParameter(OMX_IndexParamPortDefinition) failed",
                         PLATFORM_FAILURE, false);
@@ -428,18 +810,20 @@ bool OmxrVideoDecodeAccelerator::DecoderSpecificInitialization() {
   InitParam(&param_reorder);
 
   param_reorder.nPortIndex = output_port_;
-  param_reorder.bReorder = OMX_FALSE;
+  param_reorder.bReorder = tuning_.reorder ? OMX_TRUE : OMX_FALSE;
 
-  OMX_ERRORTYPE result = OMX_SetParameter(component_handle_,
-                            static_cast<OMX_INDEXTYPE> (OMXR_MC_IndexParamVideoReorder),
-                            &param_reorder);
+  OMX_ERRORTYPE result = VENDOR_CALL(OMX_SetParameter(
+      component_handle_,
+      static_cast<OMX_INDEXTYPE>(OMXR_MC_IndexParamVideoReorder),
+      &param_reorder));
 
   RETURN_ON_OMX_FAILURE(result,
                         "SetParameter(OMXR_MC_IndexParamVideoReorder) failed",
                         PLATFORM_FAILURE, false);
 
   // Set up timestamps to be returned in decode order (i.e. don't adjust
-  // values to make them come out in ascneding order)
+  // values to make them come out in ascneding order).  They carry bitstream
+  // buffer ids, so this is not up to the tuning profile.
 
   OMXR_MC_VIDEO_PARAM_TIME_STAMP_MODETYPE param_ts;
   InitParam(&param_ts);
@@ -447,15 +831,16 @@ bool OmxrVideoDecodeAccelerator::DecoderSpecificInitialization() {
   param_ts.nPortIndex = output_port_;
   param_ts.eTimeStampMode = OMXR_MC_VIDEO_TimeStampModeDecodeOrder;
 
-  result = OMX_SetParameter(component_handle_,
-                            static_cast<OMX_INDEXTYPE> (OMXR_MC_IndexParamVideoTimeStampMode),
-                            &param_ts);
+  result = VENDOR_CALL(OMX_SetParameter(
+      component_handle_,
+      static_cast<OMX_INDEXTYPE>(OMXR_MC_IndexParamVideoTimeStampMode),
+      &param_ts));
 
   RETURN_ON_OMX_FAILURE(result,
                         "SetParameter(OMXR_MC_IndexParamVideoTimeStampMode) failed",
                         PLATFORM_FAILURE, false);
 
-  // Enable dynamic video resizing up to FHD resolution
+  // Enable dynamic video resizing up to the board's maximum resolution
 
   OMXR_MC_VIDEO_PARAM_DYNAMIC_PORT_RECONF_IN_DECODINGTYPE param_dynamic;
   InitParam(&param_dynamic);
@@ -463,9 +848,10 @@ bool OmxrVideoDecodeAccelerator::DecoderSpecificInitialization() {
   param_dynamic.nPortIndex = output_port_;
   param_dynamic.bEnable = OMX_TRUE;
 
-  result = OMX_SetParameter(component_handle_,
-                            static_cast<OMX_INDEXTYPE> (OMXR_MC_IndexParamVideoDynamicPortReconfInDecoding),
-                            &param_dynamic);
+  result = VENDOR_CALL(OMX_SetParameter(
+      component_handle_,
+      static_cast<OMX_INDEXTYPE>(OMXR_MC_IndexParamVideoDynamicPortReconfInDecoding),
+      &param_dynamic));
 
   RETURN_ON_OMX_FAILURE(result,
                         "SetParameter(OMXR_MC_IndexParamVideoDynamicPortReconfInDecoding) failed",
@@ -475,17 +861,58 @@ bool OmxrVideoDecodeAccelerator::DecoderSpecificInitialization() {
   InitParam(&param_maxdecode);
 
   param_maxdecode.nPortIndex = output_port_;
-  param_maxdecode.nMaxDecodedWidth = 1920;
-  param_maxdecode.nMaxDecodedHeight = 1088;
-  param_maxdecode.eMaxLevel = OMX_VIDEO_AVCLevel5;
+  param_maxdecode.nMaxDecodedWidth = tuning_.max_decode_size.width();
+  param_maxdecode.nMaxDecodedHeight = tuning_.max_decode_size.height();
+  param_maxdecode.eMaxLevel = ToOmxAvcLevel(tuning_.max_level);
   param_maxdecode.bForceEnable = OMX_TRUE;
 
-  result = OMX_SetParameter(component_handle_,
-                            static_cast<OMX_INDEXTYPE> (OMXR_MC_IndexParamVideoMaximumDecodeCapability),
-                            &param_maxdecode);
+  result = VENDOR_CALL(OMX_SetParameter(
+      component_handle_,
+      static_cast<OMX_INDEXTYPE>(OMXR_MC_IndexParamVideoMaximumDecodeCapability),
+      &param_maxdecode));
   RETURN_ON_OMX_FAILURE(result,
                         "SetParameter(OMXR_MC_IndexParamVideoMaximumDecodeCapability) failed",
                         PLATFORM_FAILURE, false);
+
+  if (avcc_length_size_) {
+    OMX_NALSTREAMFORMATTYPE param_nal_format;
+    InitParam(&param_nal_format);
+
+    param_nal_format.nPortIndex = input_port_;
+    param_nal_format.eNaluFormat =
+        avcc_length_size_ == 1 ? OMX_NaluFormatOneByteInterleaveLength :
+        avcc_length_size_ == 2 ? OMX_NaluFormatTwoByteInterleaveLength :
+                                 OMX_NaluFormatFourByteInterleaveLength;
+
+    result = VENDOR_CALL(OMX_SetParameter(
+        component_handle_,
+        static_cast<OMX_INDEXTYPE>(OMX_IndexParamNalStreamFormatSelect),
+        &param_nal_format));
+    // Not fatal: we convert to start codes while copying instead.
+    avcc_native_ = result == OMX_ErrorNone;
+    VLOGF(1) << "AVCC input " << (avcc_native_ ? "passed through" :
+                                                 "converted to Annex-B");
+  }
+
+  if (!slice_streaming_)
+    return true;
+
+  // Slices are submitted in separate buffers; only ENDOFFRAME delimits an
+  // access unit.
+
+  OMXR_MC_VIDEO_PARAM_STREAM_STORE_UNITTYPE param_store_unit;
+  InitParam(&param_store_unit);
+
+  param_store_unit.nPortIndex = input_port_;
+  param_store_unit.eStoreUnit = OMXR_MC_VIDEO_StoreUnitEofSeparated;
+
+  result = VENDOR_CALL(OMX_SetParameter(
+      component_handle_,
+      static_cast<OMX_INDEXTYPE>(OMXR_MC_IndexParamVideoStreamStoreUnit),
+      &param_store_unit));
+  RETURN_ON_OMX_FAILURE(result,
+                        "SetParameter(OMXR_MC_IndexParamVideoStreamStoreUnit) failed",
+                        PLATFORM_FAILURE, false);
   return true;
 }
 
@@ -495,28 +922,51 @@ void OmxrVideoDecodeAccelerator::Decode(
                "Buffer id", bitstream_buffer.id(),
                "Component input buffers", input_buffers_at_component_ + 1);
   DCHECK(child_task_runner_->BelongsToCurrentThread());
+  CpuTaskScope cpu_scope(this, OmxrDecoderStats::CPU_DECODE);
 
   VLOGF(2) << "buffer id:" << bitstream_buffer.id();
 
   auto buffer = std::make_unique<BitstreamBufferRef>(bitstream_buffer, decode_task_runner_, decode_client_);
+  if (notification_batcher_)
+    buffer->batcher = notification_batcher_->GetWeakPtr();
   RETURN_ON_FAILURE(buffer->memory != NULL || buffer->id < 0,
                     "Failed to map bistream buffer memory", UNREADABLE_INPUT,);
 
+  last_decode_time_ = base::TimeTicks::Now();
+  ArmIdleTimer();
   DecodeBuffer(std::move(buffer));
 }
 
 void OmxrVideoDecodeAccelerator::DecodeBuffer(std::unique_ptr<struct BitstreamBufferRef> input_buffer) {
+  CpuTaskScope cpu_scope(this, OmxrDecoderStats::CPU_DECODE);
+  if (shared_follower_) {
+    FollowSharedInput(std::move(input_buffer));
+    return;
+  }
+
+  if (IsIdling()) {
+    queued_bitstream_buffers_.push_back(std::move(input_buffer));
+    WakeFromIdle();
+    return;
+  }
   if (current_state_change_ == RESETTING ||
       current_state_change_ == INITIALIZING ||
+      current_state_change_ == PARKED ||
+      (current_state_change_ == PARKING && input_buffer->id != -1) ||
       !queued_bitstream_buffers_.empty() ||
       free_input_buffers_.empty()) {
+    if (input_tuner_ && free_input_buffers_.empty() &&
+        current_state_change_ == NO_TRANSITION) {
+      input_tuner_->OnStarved(base::TimeTicks::Now());
+    }
     queued_bitstream_buffers_.push_back(std::move(input_buffer));
     return;
   }
 
   RETURN_ON_FAILURE((current_state_change_ == NO_TRANSITION ||
                      current_state_change_ == RESIZING ||
-                     current_state_change_ == FLUSHING) &&
+                     current_state_change_ == FLUSHING ||
+                     current_state_change_ == PARKING) &&
                     (client_state_ == OMX_StateIdle ||
                      client_state_ == OMX_StateExecuting),
                     "Call to Decode() during invalid state or transition: "
@@ -528,17 +978,8 @@ void OmxrVideoDecodeAccelerator::DecodeBuffer(std::unique_ptr<struct BitstreamBu
   if (input_buffer->id == -1) {
     // Cook up an empty buffer w/ EOS set and feed it to OMX.
     if (input_buffer_offset_) {
-      first_input_buffer_sent_ = true;
-      VLOGF(2) << "decoding buffer :" << (int) omx_buffer->nTimeStamp;
-      // Give this buffer to OMX.
-      free_input_buffers_.pop();
-      OMX_ERRORTYPE result = OMX_EmptyThisBuffer(component_handle_, omx_buffer);
-      RETURN_ON_OMX_FAILURE(result, "OMX_EmptyThisBuffer() failed",
-                        PLATFORM_FAILURE,);
-
-      input_buffer_size_ = 0;
-      input_buffer_offset_ = 0;
-      input_buffers_at_component_++;
+      if (!SubmitAccumulatedInput())
+        return;
       if (free_input_buffers_.empty()) {
         VLOGF(2) << "No more buffers available, returning bistream buffer to queue";
         queued_bitstream_buffers_.push_back(std::move(input_buffer));
@@ -550,9 +991,15 @@ void OmxrVideoDecodeAccelerator::DecodeBuffer(std::unique_ptr<struct BitstreamBu
     omx_buffer->nFilledLen = 0;
     omx_buffer->nAllocLen = omx_buffer->nFilledLen;
     omx_buffer->nFlags = OMX_BUFFERFLAG_EOS;
+    // A streamed access unit still in flight ends here.
+    if (slice_au_open_) {
+      omx_buffer->nFlags |= OMX_BUFFERFLAG_ENDOFFRAME;
+      slice_au_open_ = false;
+    }
     omx_buffer->nTimeStamp = -2;
     free_input_buffers_.pop();
-    OMX_ERRORTYPE result = OMX_EmptyThisBuffer(component_handle_, omx_buffer);
+    OMX_ERRORTYPE result =
+        VENDOR_CALL(OMX_EmptyThisBuffer(component_handle_, omx_buffer));
     RETURN_ON_OMX_FAILURE(result, "OMX_EmptyThisBuffer() failed",
                           PLATFORM_FAILURE,);
     input_buffer_offset_ = 0;
@@ -560,94 +1007,805 @@ void OmxrVideoDecodeAccelerator::DecodeBuffer(std::unique_ptr<struct BitstreamBu
     return;
   }
 
-  // Setup |omx_buffer|.
+  if (input_buffer->id == kEndOfReplayId) {
+    // Nothing follows to tell us the last access unit is complete.
+    if (input_buffer_offset_)
+      SubmitAccumulatedInput();
+    else if (slice_au_open_)
+      CloseStreamedAccessUnit();
+    return;
+  }
 
-  DCHECK(!omx_buffer->pAppPrivate);
+  const uint8_t* data = static_cast<const uint8_t*>(input_buffer->memory);
+
+  // Buffers coming back from |queued_bitstream_buffers_| resume at the span
+  // they stopped at.
+  if (!input_buffer->framed) {
+    UpdateCatchUp(*input_buffer);
+    OmxrLoopCache::Action loop_action = OmxrLoopCache::DECODE;
+    int32_t loop_picture_id = -1;
+    if (loop_cache_ && !input_buffer->replayed) {
+      loop_action = loop_cache_->OnInput(input_buffer->id, data,
+                                         input_buffer->size, &loop_picture_id);
+      ReturnLoopCachePictures();
+    }
+    if (loop_action == OmxrLoopCache::SERVE) {
+      if (loop_picture_id >= 0) {
+        pending_serves_.push_back(PendingServe{
+            nullptr, loop_picture_id, input_buffer->id,
+            input_buffer->arrival_time, false});
+        ServeCachedPictures();
+      }
+      // |input_buffer| returns to the client without reaching the component.
+      return;
+    }
+    // The component never saw the served buffers this one refers to.
+    if (loop_action == OmxrLoopCache::RESYNC)
+      wait_for_keyframe_ = true;
+
+    std::vector<OmxrBitstreamFramer::ParameterSet> parameter_sets;
+    RETURN_ON_FAILURE(
+        framer_->Split(data, input_buffer->size, &input_buffer->spans,
+                       mux_session_id_ || preallocator_ ? &parameter_sets
+                                                        : nullptr),
+        "Parsing bitstream failed", PLATFORM_FAILURE,);
+    input_buffer->framed = true;
+    PredictResize(parameter_sets);
+    SaveParameterSets(parameter_sets);
+
+    if (wait_for_keyframe_) {
+      if (std::none_of(input_buffer->spans.begin(), input_buffer->spans.end(),
+                       [](const OmxrBitstreamFramer::Span& span) {
+                         return span.keyframe;
+                       })) {
+        return;
+      }
+      wait_for_keyframe_ = false;
+    }
+    if (!shared_key_.empty() && !input_buffer->replayed)
+      RememberSharedInput(*input_buffer);
+  }
 
+  while (input_buffer->next_span < input_buffer->spans.size()) {
+    const OmxrBitstreamFramer::Span& span =
+        input_buffer->spans[input_buffer->next_span];
+    bool au_pending = input_buffer_offset_ || slice_au_open_;
+
+    // IDR boundaries are the only points where another session can take
+    // over the component without us having to carry reference frames along.
+    if (span.starts_access_unit && span.keyframe &&
+        (au_pending || first_input_buffer_sent_) &&
+        mux_session_id_ && current_state_change_ == NO_TRANSITION &&
+        OmxrSessionMultiplexer::Get()->ShouldYield(mux_session_id_)) {
+      BeginParking(std::move(input_buffer));
+      return;
+    }
 
-  OMX_U8 *data = static_cast<OMX_U8*>(input_buffer->memory);
+    if (ShouldSkipSpan(*input_buffer, span)) {
+      // The access unit in progress is complete.
+      if (span.starts_access_unit && input_buffer_offset_ &&
+          !SubmitAccumulatedInput()) {
+        return;
+      }
+      ++input_buffer->next_span;
+      continue;
+    }
 
-  bool send_frame = false;
-  int size = input_buffer->size;
-  if (codec_ == H264) {
-    h264_parser_->SetStream(data, size);
+    if (slice_streaming_) {
+      // Closing the access unit in flight takes a buffer of its own.
+      size_t needed = span.starts_access_unit && slice_au_open_ ? 2 : 1;
+      if (free_input_buffers_.size() < needed) {
+        VLOGF(2) << "No more buffers available, returning bistream buffer to queue";
+        if (input_tuner_)
+          input_tuner_->OnStarved(base::TimeTicks::Now());
+        queued_bitstream_buffers_.push_back(std::move(input_buffer));
+        return;
+      }
+      if (!StreamSlice(*input_buffer, span))
+        return;
+      input_buffer->keyframe |= span.keyframe;
+      ++input_buffer->next_span;
+      continue;
+    }
 
-    bool has_data = false;
-    bool new_frame = false;
-    H264Parser::Result res;
-    H264NALU nal;
-    while ((res = h264_parser_->AdvanceToNextNALU(&nal)) != H264Parser::kEOStream) {
+    if (span.starts_access_unit && input_buffer_offset_ &&
+        !SubmitAccumulatedInput()) {
+      return;
+    }
+    if (free_input_buffers_.empty()) {
+      VLOGF(2) << "No more buffers available, returning bistream buffer to queue";
+      if (input_tuner_)
+        input_tuner_->OnStarved(base::TimeTicks::Now());
+      queued_bitstream_buffers_.push_back(std::move(input_buffer));
+      return;
+    }
 
-      RETURN_ON_FAILURE(res == H264Parser::kOk, "Parsing H264 stream failed",
-                          PLATFORM_FAILURE,);
+    omx_buffer = free_input_buffers_.front();
+    DCHECK(!omx_buffer->pAppPrivate);
 
-      switch (nal.nal_unit_type) {
-         case H264NALU::kNonIDRSlice:
-         case H264NALU::kIDRSlice:
-            //check if first-mb-in-slice is 0 (i.e. first NAL in picture)
-            if (nal.size > 1 && nal.data[1] & 0x80) {
-                DCHECK_EQ(has_data, false);
-                new_frame = true;
-            }
-            has_data = true;
-            break;
-         case H264NALU::kAUD:
-         case H264NALU::kEOSeq:
-         case H264NALU::kEOStream:
-         case H264NALU::kSEIMessage:
-         case H264NALU::kSPS:
-         case H264NALU::kPPS:
-              new_frame = true;
-              break;
-         default:
-            LOG(WARNING) << "Got an unrecognized NAL unit: " << nal.nal_unit_type;
-      };
+    // Abuse the header's nTimeStamp field to propagate the bitstream buffer ID
+    // to the output buffer's nTimeStamp field, so we can report it back to the
+    // client in PictureReady().
+    omx_buffer->nTimeStamp = input_buffer->id;
 
+    size_t written = 0;
+    if (input_buffer_offset_ == 0) {
+      au_arrival_time_ = input_buffer->arrival_time;
+      RETURN_ON_FAILURE(RestoreParameterSets(omx_buffer->pBuffer,
+                                             input_config_.size, &written),
+                        "Parameter sets exceed the input buffer size",
+                        PLATFORM_FAILURE,);
+      input_buffer_offset_ += written;
     }
 
-    send_frame = new_frame && previous_frame_has_data_;
-    previous_frame_has_data_ = has_data;
+    RETURN_ON_FAILURE(
+        CopyToInputBuffer(omx_buffer->pBuffer + input_buffer_offset_,
+                          input_config_.size - input_buffer_offset_,
+                          data + span.offset, span.size, &written),
+        "Access unit exceeds the input buffer size " << input_config_.size,
+        PLATFORM_FAILURE,);
+    input_buffer_offset_ += written;
+
+    omx_buffer->nFlags = OMX_BUFFERFLAG_ENDOFFRAME;
+    omx_buffer->nFilledLen = input_buffer_offset_;
+    omx_buffer->nAllocLen = omx_buffer->nFilledLen;
+
+    input_buffer->keyframe |= span.keyframe;
+    ++input_buffer->next_span;
+
+    if (span.ends_access_unit && !SubmitAccumulatedInput())
+      return;
   }
 
-  if (send_frame && omx_buffer->nFilledLen) {
-      first_input_buffer_sent_ = true;
-      VLOGF(2) << "decoding buffer :" << (int) omx_buffer->nTimeStamp;
-      // Give this buffer to OMX.
-      free_input_buffers_.pop();
-      OMX_ERRORTYPE result = OMX_EmptyThisBuffer(component_handle_, omx_buffer);
-      RETURN_ON_OMX_FAILURE(result, "OMX_EmptyThisBuffer() failed",
-                        PLATFORM_FAILURE,);
+  if (gop_cache_ && !input_buffer->replayed) {
+    gop_cache_->Add(input_buffer->id, data, input_buffer->size,
+                    input_buffer->keyframe);
+    stats_.gop_cache_bytes = gop_cache_->memory_usage();
+  }
 
-      input_buffer_size_ = 0;
-      input_buffer_offset_ = 0;
-      input_buffers_at_component_++;
+  //processed |input_buffer|s go out of scope here and return to client.
+}
 
-      if (free_input_buffers_.empty()) {
-        VLOGF(2) << "No more buffers available, returning bistream buffer to queue";
-        queued_bitstream_buffers_.push_back(std::move(input_buffer));
-        return;
-      }
-      omx_buffer = free_input_buffers_.front();
+void OmxrVideoDecodeAccelerator::SaveParameterSets(
+    const std::vector<OmxrBitstreamFramer::ParameterSet>& parameter_sets) {
+  for (const OmxrBitstreamFramer::ParameterSet& ps : parameter_sets) {
+    if (ps.type == OmxrBitstreamFramer::VPS)
+      continue;
+    // Streams may switch between several sets; keep each id's latest one.
+    std::map<int, std::vector<uint8_t>>& saved =
+        ps.type == OmxrBitstreamFramer::SPS ? saved_sps_ : saved_pps_;
+    saved[ReadParameterSetId(ps)].assign(ps.data, ps.data + ps.size);
   }
+}
+
+bool OmxrVideoDecodeAccelerator::SetAvcConfigurationRecord(const uint8_t* data,
+                                                           size_t size) {
+  DCHECK(child_task_runner_->BelongsToCurrentThread());
+  DCHECK(!init_begun_);
+  int length_size;
+  std::vector<OmxrBitstreamFramer::ParameterSet> parameter_sets;
+  if (!OmxrBitstreamFramer::ParseAvcConfigurationRecord(
+          data, size, &length_size, &parameter_sets)) {
+    DLOG(ERROR) << "Invalid AVCDecoderConfigurationRecord";
+    return false;
+  }
+  avcc_length_size_ = length_size;
+  SaveParameterSets(parameter_sets);
+  return true;
+}
+
+bool OmxrVideoDecodeAccelerator::SubmitAccumulatedInput() {
+  OMX_BUFFERHEADERTYPE* omx_buffer = free_input_buffers_.front();
+  first_input_buffer_sent_ = true;
+  VLOGF(2) << "decoding buffer :" << (int) omx_buffer->nTimeStamp;
+  // Give this buffer to OMX.
+  free_input_buffers_.pop();
+  OMX_ERRORTYPE result =
+      VENDOR_CALL(OMX_EmptyThisBuffer(component_handle_, omx_buffer));
+  RETURN_ON_OMX_FAILURE(result, "OMX_EmptyThisBuffer() failed",
+                        PLATFORM_FAILURE, false);
+  NoteAccessUnitSubmitted(omx_buffer->nTimeStamp, au_arrival_time_);
+
+  input_buffer_size_ = 0;
+  input_buffer_offset_ = 0;
+  input_buffers_at_component_++;
+  if (input_tuner_) {
+    input_tuner_->OnSubmitted(base::TimeTicks::Now(), omx_buffer->nFilledLen,
+                              input_buffers_at_component_);
+  }
+  return true;
+}
+
+bool OmxrVideoDecodeAccelerator::RestoreParameterSets(OMX_U8* dst,
+                                                      size_t capacity,
+                                                      size_t* written) {
+  *written = 0;
+  // A re-created component has not seen the stream's parameter sets yet.
+  if (!restore_parameter_sets_)
+    return true;
+  restore_parameter_sets_ = false;
+  size_t offset = 0;
+  for (const auto* saved : {&saved_sps_, &saved_pps_}) {
+    for (const auto& ps : *saved) {
+      if (offset + NalPrefixSize() + ps.second.size() > capacity)
+        return false;
+      offset += WriteNalPrefix(dst + offset, ps.second.size());
+      memcpy(dst + offset, ps.second.data(), ps.second.size());
+      offset += ps.second.size();
+    }
+  }
+  *written = offset;
+  return true;
+}
+
+size_t OmxrVideoDecodeAccelerator::NalPrefixSize() const {
+  return avcc_native_ ? avcc_length_size_ : 4;
+}
+
+size_t OmxrVideoDecodeAccelerator::WriteNalPrefix(OMX_U8* dst,
+                                                  size_t nal_size) const {
+  if (!avcc_native_) {
+    static const uint8_t kStartCode[] = {0, 0, 0, 1};
+    memcpy(dst, kStartCode, sizeof(kStartCode));
+    return sizeof(kStartCode);
+  }
+  for (int i = 0; i < avcc_length_size_; ++i)
+    dst[i] = nal_size >> (8 * (avcc_length_size_ - 1 - i));
+  return avcc_length_size_;
+}
+
+bool OmxrVideoDecodeAccelerator::CopyToInputBuffer(OMX_U8* dst,
+                                                   size_t capacity,
+                                                   const uint8_t* src,
+                                                   size_t size,
+                                                   size_t* written) const {
+  *written = 0;
+  if (!avcc_length_size_ || avcc_native_) {
+    if (size > capacity)
+      return false;
+    memcpy(dst, src, size);
+    *written = size;
+    return true;
+  }
+  // The framer has already checked the length fields and cut spans at NAL
+  // unit boundaries.  One and two byte length fields grow into start codes.
+  size_t offset = 0;
+  size_t pos = 0;
+  while (pos < size) {
+    size_t nal_size = 0;
+    for (int i = 0; i < avcc_length_size_; ++i)
+      nal_size = (nal_size << 8) | src[pos + i];
+    pos += avcc_length_size_;
+    if (offset + NalPrefixSize() + nal_size > capacity)
+      return false;
+    offset += WriteNalPrefix(dst + offset, nal_size);
+    memcpy(dst + offset, src + pos, nal_size);
+    offset += nal_size;
+    pos += nal_size;
+  }
+  *written = offset;
+  return true;
+}
+
+void OmxrVideoDecodeAccelerator::PredictResize(
+    const std::vector<OmxrBitstreamFramer::ParameterSet>& parameter_sets) {
+  if (!preallocator_)
+    return;
+  for (const OmxrBitstreamFramer::ParameterSet& ps : parameter_sets) {
+    if (ps.type != OmxrBitstreamFramer::SPS)
+      continue;
+    // Most streams repeat the same SPS at every IDR.
+    auto saved = saved_sps_.find(ReadParameterSetId(ps));
+    if (saved != saved_sps_.end() && ps.size == saved->second.size() &&
+        std::equal(ps.data, ps.data + ps.size, saved->second.begin())) {
+      continue;
+    }
+    static const uint8_t kStartCode[] = {0, 0, 0, 1};
+    std::vector<uint8_t> nal(kStartCode, kStartCode + sizeof(kStartCode));
+    nal.insert(nal.end(), ps.data, ps.data + ps.size);
+    H264Parser parser;
+    parser.SetStream(nal.data(), nal.size());
+    H264NALU nalu;
+    int sps_id;
+    if (parser.AdvanceToNextNALU(&nalu) != H264Parser::kOk ||
+        parser.ParseSPS(&sps_id) != H264Parser::kOk) {
+      continue;
+    }
+    base::Optional<gfx::Size> coded_size =
+        parser.GetSPS(sps_id)->GetCodedSize();
+    if (!coded_size || *coded_size == sps_coded_size_)
+      continue;
+    sps_coded_size_ = *coded_size;
+
+    // Before the first pictures there is no layout to go by, and a stream
+    // going back to the size of the pictures we have needs none.
+    if (!output_stride_ || sps_coded_size_ == picture_coded_size_) {
+      preallocator_->Clear();
+      continue;
+    }
+    size_t alloc_size = OmxrPicturePreallocator::PredictAllocSize(
+        sps_coded_size_,
+        OmxrPicturePreallocator::Geometry{output_stride_,
+                                          output_slice_height_,
+                                          picture_alloc_size_},
+        page_size_);
+    VLOGF(1) << "SPS for " << sps_coded_size_.ToString()
+             << ", preparing pictures of " << alloc_size << " bytes";
+    preallocator_->Prepare(alloc_size, NumPicturesToRequest(alloc_size));
+  }
+}
 
-  // Abuse the header's nTimeStamp field to propagate the bitstream buffer ID to
-  // the output buffer's nTimeStamp field, so we can report it back to the
-  // client in PictureReady().
-  omx_buffer->nTimeStamp = input_buffer->id;
+bool OmxrVideoDecodeAccelerator::StreamSlice(
+    const BitstreamBufferRef& input_buffer,
+    const OmxrBitstreamFramer::Span& span) {
+  DCHECK(!free_input_buffers_.empty());
+  TRACE_EVENT2("media,gpu", "OVDA::StreamSlice",
+               "Buffer id", input_buffer.id,
+               "New frame", span.starts_access_unit);
+
+  // The first slice of a new access unit tells us the previous one is
+  // complete.
+  if (span.starts_access_unit && slice_au_open_ && !CloseStreamedAccessUnit())
+    return false;
 
-  memcpy(omx_buffer->pBuffer + input_buffer_offset_, data, size);
-  input_buffer_offset_ += size;
+  if (!slice_au_open_) {
+    slice_au_id_ = input_buffer.id;
+    NoteAccessUnitSubmitted(slice_au_id_, input_buffer.arrival_time);
+  }
 
-  omx_buffer->nFlags = OMX_BUFFERFLAG_ENDOFFRAME;
-  omx_buffer->nFilledLen = input_buffer_offset_;
+  OMX_BUFFERHEADERTYPE* omx_buffer = free_input_buffers_.front();
+  size_t offset;
+  RETURN_ON_FAILURE(
+      RestoreParameterSets(omx_buffer->pBuffer, input_config_.size, &offset),
+      "Parameter sets exceed the input buffer size", PLATFORM_FAILURE, false);
+  size_t written;
+  RETURN_ON_FAILURE(
+      CopyToInputBuffer(
+          omx_buffer->pBuffer + offset, input_config_.size - offset,
+          static_cast<const uint8_t*>(input_buffer.memory) + span.offset,
+          span.size, &written),
+      "Slice exceeds the input buffer size " << input_config_.size,
+      PLATFORM_FAILURE, false);
+  free_input_buffers_.pop();
+  offset += written;
+  omx_buffer->nFilledLen = offset;
   omx_buffer->nAllocLen = omx_buffer->nFilledLen;
+  omx_buffer->nFlags = 0;
+  // All slices of an access unit carry the id of its first one, which is what
+  // the picture reports back in PictureReady().
+  omx_buffer->nTimeStamp = slice_au_id_;
 
-  //processed |input_buffer|s go out of scope here and return to client.
+  first_input_buffer_sent_ = true;
+  OMX_ERRORTYPE result =
+      VENDOR_CALL(OMX_EmptyThisBuffer(component_handle_, omx_buffer));
+  RETURN_ON_OMX_FAILURE(result, "OMX_EmptyThisBuffer() failed",
+                        PLATFORM_FAILURE, false);
+  input_buffers_at_component_++;
+  if (input_tuner_) {
+    input_tuner_->OnSubmitted(base::TimeTicks::Now(), omx_buffer->nFilledLen,
+                              input_buffers_at_component_);
+  }
+  slice_au_open_ = true;
+  return true;
+}
+
+bool OmxrVideoDecodeAccelerator::CloseStreamedAccessUnit() {
+  DCHECK(slice_au_open_);
+  DCHECK(!free_input_buffers_.empty());
+  // Its slices are already at the component; an empty ENDOFFRAME buffer
+  // terminates it.
+  OMX_BUFFERHEADERTYPE* marker = free_input_buffers_.front();
+  free_input_buffers_.pop();
+  marker->nFilledLen = 0;
+  marker->nAllocLen = marker->nFilledLen;
+  marker->nFlags = OMX_BUFFERFLAG_ENDOFFRAME;
+  marker->nTimeStamp = slice_au_id_;
+  OMX_ERRORTYPE result =
+      VENDOR_CALL(OMX_EmptyThisBuffer(component_handle_, marker));
+  RETURN_ON_OMX_FAILURE(result, "OMX_EmptyThisBuffer() failed",
+                        PLATFORM_FAILURE, false);
+  input_buffers_at_component_++;
+  slice_au_open_ = false;
+  return true;
+}
+
+bool OmxrVideoDecodeAccelerator::StepToCachedPicture(int32_t bitstream_id) {
+  DCHECK(child_task_runner_->BelongsToCurrentThread());
+  if (!gop_cache_ || !frame_store_)
+    return false;
+
+  // The ring is only filled from here on; forward playback pays no copies.
+  stepping_ = true;
+  base::TimeTicks now = base::TimeTicks::Now();
+  if (frame_store_->Contains(bitstream_id)) {
+    pending_serves_.push_back(PendingServe{frame_store_.get(), bitstream_id,
+                                           bitstream_id, now, true});
+    ServeCachedPictures();
+    return true;
+  }
+
+  std::vector<const OmxrGopCache::CachedBuffer*> buffers;
+  if (refill_target_id_ >= 0 || current_state_change_ != NO_TRANSITION ||
+      !gop_cache_->GetDecodeRange(bitstream_id, &buffers)) {
+    return false;
+  }
+
+  VLOGF(1) << "Re-decoding " << buffers.size() << " cached buffers up to "
+           << bitstream_id;
+  TRACE_EVENT1("media,gpu", "OVDA::StepToCachedPicture",
+               "Buffers", buffers.size());
+  refill_target_id_ = bitstream_id;
+  refill_start_time_ = now;
+  // Finish whatever access unit is pending before the GOP starts over.
+  DecodeBuffer(std::make_unique<BitstreamBufferRef>(kEndOfReplayId,
+                                                    nullptr, 0));
+  for (size_t i = 0; i < buffers.size(); ++i) {
+    DecodeBuffer(std::make_unique<BitstreamBufferRef>(
+        buffers[i]->id, buffers[i]->data.data(), buffers[i]->data.size()));
+  }
+  DecodeBuffer(std::make_unique<BitstreamBufferRef>(kEndOfReplayId,
+                                                    nullptr, 0));
+  return true;
+}
+
+bool OmxrVideoDecodeAccelerator::UsesSparePictures() const {
+  return !!gop_cache_;
+}
+
+uint32_t OmxrVideoDecodeAccelerator::NumPicturesToRequest(
+    size_t alloc_size) const {
+  uint32_t count = tuning_.num_picture_buffers;
+  if (UsesSparePictures())
+    count += kNumSparePictures;
+  if (loop_cache_ && alloc_size)
+    count += loop_cache_max_bytes_ / alloc_size;
+  return count;
+}
+
+void OmxrVideoDecodeAccelerator::ReturnLoopCachePictures() {
+  for (int32_t picture_buffer_id : loop_cache_->TakeReleasedPictures())
+    QueuePictureBuffer(picture_buffer_id);
+  stats_.loop_cache_bytes = loop_cache_->size() * picture_alloc_size_;
+}
+
+void OmxrVideoDecodeAccelerator::ServeCachedPictures() {
+  while (!pending_serves_.empty()) {
+    PendingServe serve = pending_serves_.front();
+    int32_t picture_buffer_id = serve.key;
+    if (serve.store) {
+      if (spare_picture_ids_.empty())
+        break;
+      picture_buffer_id = spare_picture_ids_.back();
+      spare_picture_ids_.pop_back();
+      OutputPictureById::iterator it = pictures_.find(picture_buffer_id);
+      if (it == pictures_.end())
+        continue;
+      pending_serves_.pop_front();
+      if (!serve.store->CopyOut(serve.key, it->second->mmngr_buf.virt_addr)) {
+        spare_picture_ids_.push_back(picture_buffer_id);
+        continue;
+      }
+    } else {
+      // The loop cache hands out the picture itself, once the client has
+      // returned it from its previous showing.
+      if (loop_cache_->Holds(picture_buffer_id) &&
+          !loop_cache_->IsAvailable(picture_buffer_id)) {
+        break;
+      }
+      pending_serves_.pop_front();
+      if (!loop_cache_->Holds(picture_buffer_id))
+        continue;
+      loop_cache_->OnPictureServed(picture_buffer_id);
+    }
+
+    if (serve.step)
+      stats_.AddStep(base::TimeTicks::Now() - serve.requested);
+    else
+      ++stats_.loop_frames_served;
+    media::Picture picture(picture_buffer_id, serve.bitstream_id,
+              gfx::Rect(picture_buffer_dimensions_), gfx::ColorSpace(), false);
+    NotifyPictureReady(picture);
+  }
+
+  // A Flush() has to wait for the pictures of the input before it.
+  if (pending_serves_.empty() && flush_pending_ && !IsParked()) {
+    flush_pending_ = false;
+    Flush();
+  }
+}
+
+void OmxrVideoDecodeAccelerator::NoteAccessUnitSubmitted(
+    int32_t id, base::TimeTicks arrival_time) {
+  // Bitstream ids need not grow with arrival; evict the oldest entry.
+  if (au_arrival_times_.size() >= kMaxTimedAccessUnits) {
+    au_arrival_times_.erase(std::min_element(
+        au_arrival_times_.begin(), au_arrival_times_.end(),
+        [](const std::pair<const int32_t, base::TimeTicks>& a,
+           const std::pair<const int32_t, base::TimeTicks>& b) {
+          return a.second < b.second;
+        }));
+  }
+  au_arrival_times_[id] = arrival_time;
+}
+
+void OmxrVideoDecodeAccelerator::JoinSharedStream(const std::string& key) {
+  DCHECK(!init_begun_);
+  shared_key_ = key;
+}
+
+void OmxrVideoDecodeAccelerator::SetViewRect(const gfx::Rect& rect) {
+  view_rect_ = rect;
+}
+
+gfx::Rect OmxrVideoDecodeAccelerator::VisibleRect(
+    const gfx::Size& size) const {
+  gfx::Rect rect(size);
+  if (!view_rect_.IsEmpty())
+    rect.Intersect(view_rect_);
+  return rect;
+}
+
+void OmxrVideoDecodeAccelerator::RememberSharedInput(
+    const BitstreamBufferRef& input_buffer) {
+  if (shared_input_hashes_.size() >= kMaxTimedAccessUnits) {
+    shared_input_hashes_.erase(std::min_element(
+        shared_input_hashes_.begin(), shared_input_hashes_.end(),
+        [](const std::pair<const int32_t, SharedInput>& a,
+           const std::pair<const int32_t, SharedInput>& b) {
+          return a.second.arrival_time < b.second.arrival_time;
+        }));
+  }
+  shared_input_hashes_[input_buffer.id] = SharedInput{
+      base::PersistentHash(input_buffer.memory, input_buffer.size),
+      input_buffer.arrival_time};
+}
+
+void OmxrVideoDecodeAccelerator::FollowSharedInput(
+    std::unique_ptr<BitstreamBufferRef> input_buffer) {
+  if (input_buffer->id < 0)
+    return;
+  if (shared_pending_inputs_.size() >= kMaxTimedAccessUnits)
+    DropSharedInputs(1);
+  shared_pending_inputs_.emplace_back(
+      base::PersistentHash(input_buffer->memory, input_buffer->size),
+      input_buffer->id);
+  DeliverSharedPictures();
+  // |input_buffer| returns to the client here; the leader decodes its copy.
+}
+
+void OmxrVideoDecodeAccelerator::OnSharedPicture(
+    const OmxrSharedDecodeRegistry::SharedPicture& picture) {
+  DCHECK(child_task_runner_->BelongsToCurrentThread());
+  DCHECK(shared_follower_);
+  shared_pending_pictures_.push_back(
+      PendingSharedPicture{picture, base::TimeTicks::Now()});
+  DeliverSharedPictures();
+}
+
+void OmxrVideoDecodeAccelerator::DeliverSharedPictures() {
+  OmxrSharedDecodeRegistry* registry = OmxrSharedDecodeRegistry::Get();
+  // The leader cannot refill pictures we hold on to; rather drop some of
+  // ours than stall every view of the stream.  For the same reason our
+  // client gets at most half of the leader's pictures at a time.
+  while (shared_pending_pictures_.size() > kMaxSharedPendingPictures) {
+    registry->Release(shared_key_,
+                      shared_pending_pictures_.front().picture.reference_id);
+    shared_pending_pictures_.pop_front();
+  }
+  const size_t max_bound = std::max(1, tuning_.num_picture_buffers / 2);
+
+  while (!shared_pending_pictures_.empty()) {
+    const OmxrSharedDecodeRegistry::SharedPicture picture =
+        shared_pending_pictures_.front().picture;
+    if (picture.size != shared_texture_size_) {
+      // First picture, or the stream changed resolution.
+      RetireSharedTextures();
+      shared_texture_size_ = picture.size;
+      if (client_) {
+        client_->ProvidePictureBuffers(tuning_.num_picture_buffers,
+                                       PIXEL_FORMAT_NV12,
+                                       1, picture.size,
+                                       GL_TEXTURE_EXTERNAL_OES);
+      }
+      break;
+    }
+
+    // Our copy of the bitstream buffer may still be on its way.
+    auto input = std::find_if(
+        shared_pending_inputs_.begin(), shared_pending_inputs_.end(),
+        [&picture](const std::pair<uint32_t, int32_t>& input) {
+          return input.first == picture.input_hash;
+        });
+    if (input == shared_pending_inputs_.end())
+      break;
+
+    size_t bound = std::count_if(
+        shared_textures_.begin(), shared_textures_.end(),
+        [](const std::pair<const int32_t, SharedTexture>& texture) {
+          return texture.second.reference_id >= 0;
+        });
+    if (bound >= max_bound)
+      break;
+    auto texture = std::find_if(
+        shared_textures_.begin(), shared_textures_.end(),
+        [](const std::pair<const int32_t, SharedTexture>& texture) {
+          return texture.second.reference_id < 0;
+        });
+    if (texture == shared_textures_.end())
+      break;
+
+    RETURN_ON_FAILURE(make_context_current_.Run(),
+                      "Failed to make context current", PLATFORM_FAILURE,);
+    glBindTexture(GL_TEXTURE_EXTERNAL_OES, texture->second.texture_id);
+    glEGLImageTargetTexture2DOES(GL_TEXTURE_EXTERNAL_OES,
+                                 static_cast<EGLImageKHR>(picture.egl_image));
+    texture->second.reference_id = picture.reference_id;
+
+    // Buffers before the matched one gave no picture of their own.
+    int32_t bitstream_id = input->second;
+    DropSharedInputs(input - shared_pending_inputs_.begin() + 1);
+    shared_pending_pictures_.pop_front();
+
+    NotifyPictureReady(media::Picture(texture->first, bitstream_id,
+                                      VisibleRect(picture.size),
+                                      gfx::ColorSpace(), false));
+  }
+
+  MaybeFinishSharedFlush();
+  ArmSharedTimer();
+}
+
+void OmxrVideoDecodeAccelerator::ReleaseSharedTexture(
+    int32_t picture_buffer_id) {
+  auto it = shared_textures_.find(picture_buffer_id);
+  if (it == shared_textures_.end())
+    return;
+  if (it->second.reference_id >= 0) {
+    OmxrSharedDecodeRegistry::Get()->Release(shared_key_,
+                                             it->second.reference_id);
+    it->second.reference_id = -1;
+  }
+  if (it->second.stale) {
+    shared_textures_.erase(it);
+    DeliverNotifications();
+    if (client_)
+      client_->DismissPictureBuffer(picture_buffer_id);
+  }
+}
+
+void OmxrVideoDecodeAccelerator::RetireSharedTextures() {
+  DeliverNotifications();
+  for (auto it = shared_textures_.begin(); it != shared_textures_.end();) {
+    // Dismissing a texture the client holds would leave us no way to tell
+    // when the leader's picture is free to go.
+    if (it->second.reference_id >= 0) {
+      it->second.stale = true;
+      ++it;
+      continue;
+    }
+    if (client_)
+      client_->DismissPictureBuffer(it->first);
+    it = shared_textures_.erase(it);
+  }
+  shared_texture_size_ = gfx::Size();
+}
+
+void OmxrVideoDecodeAccelerator::ReleaseSharedPendingPictures() {
+  for (const PendingSharedPicture& pending : shared_pending_pictures_) {
+    OmxrSharedDecodeRegistry::Get()->Release(shared_key_,
+                                             pending.picture.reference_id);
+  }
+  shared_pending_pictures_.clear();
+}
+
+void OmxrVideoDecodeAccelerator::DropSharedInputs(size_t count) {
+  DCHECK_LE(count, shared_pending_inputs_.size());
+  shared_pending_inputs_.erase(shared_pending_inputs_.begin(),
+                               shared_pending_inputs_.begin() + count);
+  if (shared_flush_pending_)
+    shared_flush_inputs_ -= std::min(count, shared_flush_inputs_);
+}
+
+void OmxrVideoDecodeAccelerator::MaybeFinishSharedFlush() {
+  if (!shared_flush_pending_ || shared_flush_inputs_ > 0)
+    return;
+  shared_flush_pending_ = false;
+  DeliverNotifications();
+  child_task_runner_->PostTask(FROM_HERE, base::Bind(
+     &Client::NotifyFlushDone, client_));
+}
+
+void OmxrVideoDecodeAccelerator::ArmSharedTimer() {
+  if (shared_timer_armed_ ||
+      (shared_pending_pictures_.empty() && !shared_flush_pending_)) {
+    return;
+  }
+  shared_timer_armed_ = true;
+  child_task_runner_->PostDelayedTask(FROM_HERE, base::Bind(
+      &OmxrVideoDecodeAccelerator::CheckSharedTimeouts, weak_this_),
+      base::TimeDelta::FromMilliseconds(kSharedPendingTimeoutMs / 2));
+}
+
+void OmxrVideoDecodeAccelerator::CheckSharedTimeouts() {
+  DCHECK(child_task_runner_->BelongsToCurrentThread());
+  shared_timer_armed_ = false;
+  if (!shared_follower_)
+    return;
+  base::TimeTicks now = base::TimeTicks::Now();
+  // A picture that never matches one of our buffers would keep the leader
+  // from refilling it.
+  while (!shared_pending_pictures_.empty() &&
+         now - shared_pending_pictures_.front().received >
+             base::TimeDelta::FromMilliseconds(kSharedPendingTimeoutMs)) {
+    OmxrSharedDecodeRegistry::Get()->Release(
+        shared_key_, shared_pending_pictures_.front().picture.reference_id);
+    shared_pending_pictures_.pop_front();
+  }
+  if (shared_flush_pending_ && now >= shared_flush_deadline_) {
+    VLOGF(1) << "No pictures from the leader for " << shared_flush_inputs_
+             << " buffers, completing the flush without them";
+    DropSharedInputs(shared_flush_inputs_);
+  }
+  DeliverSharedPictures();
+}
+
+void OmxrVideoDecodeAccelerator::OnSharedPictureReleased(int32_t picture_id) {
+  DCHECK(child_task_runner_->BelongsToCurrentThread());
+  if (shared_awaiting_release_.erase(picture_id))
+    QueuePictureBuffer(picture_id);
+}
+
+void OmxrVideoDecodeAccelerator::OnLeaderGone() {
+  DCHECK(child_task_runner_->BelongsToCurrentThread());
+  VLOGF(1) << "Leader of shared stream " << shared_key_ << " left";
+  // Pictures our client holds stay valid until it returns them.
+  ReleaseSharedPendingPictures();
+}
+
+void OmxrVideoDecodeAccelerator::OnPromoted() {
+  DCHECK(child_task_runner_->BelongsToCurrentThread());
+  VLOGF(1) << "Taking over shared stream " << shared_key_;
+  shared_follower_ = false;
+  RetireSharedTextures();
+  // What was queued before a pending flush is not coming any more.
+  shared_pending_inputs_.clear();
+  shared_flush_inputs_ = 0;
+  MaybeFinishSharedFlush();
+  // Reference frames died with the leader's component.
+  wait_for_keyframe_ = true;
+  promoted_from_follower_ = true;
+  InitializeComponent();  // Does its own RETURN_ON_FAILURE dances.
+}
+
+void OmxrVideoDecodeAccelerator::LeaveSharedStream() {
+  if (shared_key_.empty())
+    return;
+  OmxrSharedDecodeRegistry* registry = OmxrSharedDecodeRegistry::Get();
+  // A promoted follower may still hold textures from following.
+  for (const auto& texture : shared_textures_) {
+    if (texture.second.reference_id >= 0)
+      registry->Release(shared_key_, texture.second.reference_id);
+  }
+  shared_textures_.clear();
+  ReleaseSharedPendingPictures();
+  registry->Leave(shared_key_, this);
+  shared_key_.clear();
 }
 
 void OmxrVideoDecodeAccelerator::AssignPictureBuffers(
     const std::vector<media::PictureBuffer>& buffers) {
   DCHECK(child_task_runner_->BelongsToCurrentThread());
+  CpuTaskScope cpu_scope(this, OmxrDecoderStats::CPU_ASSIGN_PICTURE_BUFFERS);
+
+  // A follower's textures get the leader's EGLImages, no memory of their own.
+  if (shared_follower_) {
+    for (const media::PictureBuffer& buffer : buffers) {
+      shared_textures_[buffer.id()] =
+          SharedTexture{buffer.service_texture_ids()[0], -1, false};
+    }
+    DeliverSharedPictures();
+    return;
+  }
 
   // If we are resetting/destroying/erroring, don't bother, as
   // OMX_FillThisBuffer will fail anyway. In case we're in the middle of
@@ -660,9 +1818,10 @@ void OmxrVideoDecodeAccelerator::AssignPictureBuffers(
     return;
 
   RETURN_ON_FAILURE(CanFillBuffer(), "Can't fill buffer", ILLEGAL_STATE,);
-  RETURN_ON_FAILURE((kNumPictureBuffers <= buffers.size()),
+  RETURN_ON_FAILURE(
+      (static_cast<size_t>(tuning_.num_picture_buffers) <= buffers.size()),
       "Failed to provide requested picture buffers. (Got " << buffers.size() <<
-      ", requested " << kNumPictureBuffers << ")", INVALID_ARGUMENT,);
+      ", requested " << tuning_.num_picture_buffers << ")", INVALID_ARGUMENT,);
 
   DCHECK_EQ(output_buffers_at_component_, 0);
   DCHECK_EQ(fake_output_buffers_.size(), 0U);
@@ -677,9 +1836,8 @@ void OmxrVideoDecodeAccelerator::AssignPictureBuffers(
   InitParam(&port_format);
   port_format.nPortIndex = output_port_;
 
-  result = OMX_GetParameter(component_handle_,
-                            OMX_IndexParamPortDefinition,
-                            &port_format);
+  result = VENDOR_CALL(OMX_GetParameter(
+      component_handle_, OMX_IndexParamPortDefinition, &port_format));
 
   RETURN_ON_OMX_FAILURE(result,
                         "GetParameter(OMX_IndexParamPortDefinition) failed",
@@ -687,62 +1845,60 @@ void OmxrVideoDecodeAccelerator::AssignPictureBuffers(
 
   port_format.nBufferCountActual = buffers.size();
 
-  result = OMX_SetParameter(component_handle_,
-                            OMX_IndexParamPortDefinition,
-                            &port_format);
+  result = VENDOR_CALL(OMX_SetParameter(
+      component_handle_, OMX_IndexParamPortDefinition, &port_format));
   RETURN_ON_OMX_FAILURE(result,
                         "SetParameter(OMX_IndexParamPortDefinition) failed",
                         PLATFORM_FAILURE,);
 
+  int alloc_size = (port_format.nBufferSize + (page_size_ - 1)) & ~(page_size_ - 1);
+  if (gop_cache_) {
+    frame_store_.reset(
+        new OmxrFrameStore(alloc_size, kOmxrGopCacheRingFrames.Get()));
+  }
+  if (loop_cache_) {
+    // Whatever the client gave beyond what decoding needs keeps the loop.
+    size_t needed = tuning_.num_picture_buffers +
+                    (UsesSparePictures() ? kNumSparePictures : 0);
+    loop_cache_->SetCapacity(buffers.size() > needed
+                                 ? buffers.size() - needed
+                                 : 0);
+  }
+
+  output_stride_ = port_format.format.video.nStride;
+  output_slice_height_ = port_format.format.video.nSliceHeight;
+
   for (size_t i = 0; i < buffers.size(); ++i) {
-    void *dummy;
     EGLImageKHR egl_image;
     struct MmngrBuffer mbuf;
-    int alloc_size = (port_format.nBufferSize + (page_size_ - 1)) & ~(page_size_ - 1);
 
     gfx::Size size = buffers[i].size();
     DCHECK_EQ(picture_buffer_dimensions_.width(), size.width());
     DCHECK_EQ(picture_buffer_dimensions_.height(), size.height());
 
-    int ret = mmngr_alloc_in_user_ext(&mbuf.mem_id, alloc_size,
-            &mbuf.hard_addr, &dummy, MMNGR_PA_SUPPORT, NULL);
-
-    RETURN_ON_FAILURE(!ret, "Cannot allocate output buffer memory" << ret,
-        PLATFORM_FAILURE,);
+    OmxrPicturePreallocator::Block block;
+    if (preallocator_ && preallocator_->Take(alloc_size, &block)) {
+      mbuf = MmngrBuffer{block.mem_id, block.hard_addr, block.dmabuf_id,
+                         block.dmabuf_fd, block.virt_addr};
+      ++stats_.preallocated_pictures;
+    } else {
+      // The blocks left are too small or still to come; free them before
+      // allocating, so that the carveout never holds both.
+      if (preallocator_)
+        preallocator_->Clear();
+      int ret = VENDOR_CALL(OmxrResourceTracker::Get()->AllocCarveout(
+          &mbuf.mem_id, alloc_size, &mbuf.hard_addr, &mbuf.virt_addr));
+
+      RETURN_ON_FAILURE(!ret, "Cannot allocate output buffer memory" << ret,
+          PLATFORM_FAILURE,);
 
-    ret = mmngr_export_start_in_user_ext(&mbuf.dmabuf_id, alloc_size,
-        mbuf.hard_addr, &mbuf.dmabuf_fd, NULL);
-    /* Make EGLImage */
-
-    std::vector<EGLint> attrs;
-    attrs.push_back(EGL_WIDTH);
-    attrs.push_back(size.width());
-    attrs.push_back(EGL_HEIGHT);
-    attrs.push_back(size.height());
-    attrs.push_back(EGL_LINUX_DRM_FOURCC_EXT);
-    attrs.push_back(DRM_FORMAT_NV12);
-
-    static const int plane_count = 2; // NV12 has 2 planes
-
-    size_t plane_offset = 0;
-    for (size_t plane = 0; plane < plane_count; ++plane) {
-      attrs.push_back(EGL_DMA_BUF_PLANE0_FD_EXT + plane * 3);
-      attrs.push_back(mbuf.dmabuf_fd);
-      attrs.push_back(EGL_DMA_BUF_PLANE0_OFFSET_EXT + plane * 3);
-      attrs.push_back(plane_offset);
-      attrs.push_back(EGL_DMA_BUF_PLANE0_PITCH_EXT + plane * 3);
-      attrs.push_back(port_format.format.video.nStride);
-
-      plane_offset += port_format.format.video.nStride *
-                      port_format.format.video.nSliceHeight;
+      ret = VENDOR_CALL(mmngr_export_start_in_user_ext(
+          &mbuf.dmabuf_id, alloc_size, mbuf.hard_addr, &mbuf.dmabuf_fd, NULL));
     }
 
-    attrs.push_back(EGL_NONE);
-
     uint32_t texture_id = buffers[i].service_texture_ids()[0];
 
-    egl_image = eglCreateImageKHR(
-        egl_display_, EGL_NO_CONTEXT, EGL_LINUX_DMA_BUF_EXT, NULL, &attrs[0]);
+    egl_image = CreateEGLImage(size, mbuf.dmabuf_fd);
     RETURN_ON_FAILURE((egl_image != EGL_NO_IMAGE_KHR), "Cannot create EGLImage " << ui::GetLastEGLErrorString(),
           PLATFORM_FAILURE,);
 
@@ -754,6 +1910,12 @@ void OmxrVideoDecodeAccelerator::AssignPictureBuffers(
     pictures_.insert(std::make_pair(buffers[i].id(),
         std::make_unique<OutputPicture>(*this, buffers[i], nullptr, egl_image, mbuf)));
   }
+  picture_alloc_size_ = alloc_size;
+  UpdateCarveoutStats();
+  // Blocks left over or of a mispredicted size are of no use now.
+  if (preallocator_)
+    preallocator_->Clear();
+  picture_coded_size_ = sps_coded_size_;
 
   if (!SendCommandToPort(OMX_CommandPortEnable, output_port_))
     return;
@@ -761,13 +1923,150 @@ void OmxrVideoDecodeAccelerator::AssignPictureBuffers(
     return;
   VLOGF(1) << "Resize complete";
   current_state_change_ = NO_TRANSITION;
+  if (!resize_start_.is_null()) {
+    ++stats_.resizes;
+    stats_.total_resize_time += base::TimeTicks::Now() - resize_start_;
+    resize_start_ = base::TimeTicks();
+  }
+}
+
+EGLImageKHR OmxrVideoDecodeAccelerator::CreateEGLImage(
+    const gfx::Size& size,
+    int dmabuf_fd) const {
+  std::vector<EGLint> attrs;
+  attrs.push_back(EGL_WIDTH);
+  attrs.push_back(size.width());
+  attrs.push_back(EGL_HEIGHT);
+  attrs.push_back(size.height());
+  attrs.push_back(EGL_LINUX_DRM_FOURCC_EXT);
+  attrs.push_back(DRM_FORMAT_NV12);
+
+  static const int plane_count = 2; // NV12 has 2 planes
+
+  size_t plane_offset = 0;
+  for (size_t plane = 0; plane < plane_count; ++plane) {
+    attrs.push_back(EGL_DMA_BUF_PLANE0_FD_EXT + plane * 3);
+    attrs.push_back(dmabuf_fd);
+    attrs.push_back(EGL_DMA_BUF_PLANE0_OFFSET_EXT + plane * 3);
+    attrs.push_back(plane_offset);
+    attrs.push_back(EGL_DMA_BUF_PLANE0_PITCH_EXT + plane * 3);
+    attrs.push_back(output_stride_);
+
+    plane_offset += output_stride_ * output_slice_height_;
+  }
+
+  attrs.push_back(EGL_NONE);
+
+  return eglCreateImageKHR(egl_display_, EGL_NO_CONTEXT,
+                           EGL_LINUX_DMA_BUF_EXT, NULL, &attrs[0]);
+}
+
+bool OmxrVideoDecodeAccelerator::RestoreContext(
+    const base::Callback<bool(void)>& make_context_current,
+    const std::vector<media::PictureBuffer>& buffers) {
+  DCHECK(child_task_runner_->BelongsToCurrentThread());
+  TRACE_EVENT1("media,gpu", "OVDA::RestoreContext", "Pictures",
+               buffers.size());
+
+  // Followers bind the leader's EGLImages, which would go away under them.
+  if (!shared_key_.empty() || current_state_change_ == DESTROYING ||
+      current_state_change_ == ERRORING || current_state_change_ == RESIZING) {
+    VLOGF(1) << "Cannot restore the context in this state";
+    return false;
+  }
+  if (buffers.size() != pictures_.size())
+    return false;
+  for (const media::PictureBuffer& buffer : buffers) {
+    auto it = pictures_.find(buffer.id());
+    if (it == pictures_.end() ||
+        it->second->picture_buffer.size() != buffer.size() ||
+        buffer.service_texture_ids().empty()) {
+      VLOGF(1) << "Picture buffer " << buffer.id() << " does not match";
+      return false;
+    }
+  }
+
+  base::TimeTicks start = base::TimeTicks::Now();
+  // Pictures of notifications still queued count as handed out.
+  DeliverNotifications();
+  make_context_current_ = make_context_current;
+  RETURN_ON_FAILURE(make_context_current_.Run(),
+                    "Failed to make context current", PLATFORM_FAILURE, false);
+
+  std::vector<int32_t> taken_back;
+  for (const media::PictureBuffer& buffer : buffers) {
+    OutputPicture& picture = *pictures_[buffer.id()];
+    // The component keeps writing into the carveout, so only the image that
+    // the textures sample from is recreated.
+    EGLImageKHR egl_image =
+        CreateEGLImage(buffer.size(), picture.mmngr_buf.dmabuf_fd);
+    RETURN_ON_FAILURE(egl_image != EGL_NO_IMAGE_KHR,
+                      "Cannot create EGLImage "
+                          << ui::GetLastEGLErrorString(),
+                      PLATFORM_FAILURE, false);
+    eglDestroyImageKHR(egl_display_, picture.egl_image);
+    picture.egl_image = egl_image;
+    picture.picture_buffer = buffer;
+    glBindTexture(GL_TEXTURE_EXTERNAL_OES, buffer.service_texture_ids()[0]);
+    glEGLImageTargetTexture2DOES(GL_TEXTURE_EXTERNAL_OES, egl_image);
+
+    if (picture.at_client) {
+      picture.at_client = false;
+      taken_back.push_back(buffer.id());
+    }
+  }
+  // Fences of pictures returned before the loss belong to the old context.
+  ++context_generation_;
+
+  // The textures the client showed these pictures in are gone.
+  for (int32_t picture_buffer_id : taken_back)
+    QueuePictureBuffer(picture_buffer_id);
+
+  VLOGF(1) << "Restored " << buffers.size() << " pictures in "
+           << (base::TimeTicks::Now() - start).InMillisecondsF() << " ms, "
+           << taken_back.size() << " taken back from the client";
+  return true;
+}
+
+bool OmxrVideoDecodeAccelerator::MapPicture(
+    int32_t picture_buffer_id,
+    omxr_nv12::Picture* picture) const {
+  DCHECK(child_task_runner_->BelongsToCurrentThread());
+  auto it = pictures_.find(picture_buffer_id);
+  if (it == pictures_.end() || !it->second->at_client ||
+      !it->second->mmngr_buf.virt_addr) {
+    return false;
+  }
+  const uint8_t* base =
+      static_cast<const uint8_t*>(it->second->mmngr_buf.virt_addr);
+  // Chroma starts at an even row and column of the visible area.
+  gfx::Rect rect = VisibleRect(picture_buffer_dimensions_);
+  picture->y = base + rect.y() * output_stride_ + rect.x();
+  picture->y_stride = output_stride_;
+  picture->uv = base + output_stride_ * output_slice_height_ +
+                (rect.y() / 2) * output_stride_ + (rect.x() & ~1);
+  picture->uv_stride = output_stride_;
+  picture->size = rect.size();
+  return true;
 }
 
 void OmxrVideoDecodeAccelerator::ReusePictureBuffer(int32_t picture_buffer_id) {
   DCHECK(child_task_runner_->BelongsToCurrentThread());
+  CpuTaskScope cpu_scope(this, OmxrDecoderStats::CPU_REUSE_PICTURE_BUFFER);
   TRACE_EVENT1("media,gpu", "OVDA::ReusePictureBuffer",
                "Picture id", picture_buffer_id);
 
+  auto it = pictures_.find(picture_buffer_id);
+  if (it != pictures_.end()) {
+    // Taken back by RestoreContext() already.
+    if (!it->second->at_client) {
+      VLOGF(1) << "Ignoring picture " << picture_buffer_id
+               << " the client does not hold";
+      return;
+    }
+    it->second->at_client = false;
+  }
+
   RETURN_ON_FAILURE(make_context_current_.Run(),
                     "Failed to make context current",
                     PLATFORM_FAILURE,);
@@ -775,11 +2074,13 @@ void OmxrVideoDecodeAccelerator::ReusePictureBuffer(int32_t picture_buffer_id) {
   auto picture_sync_fence = gl::GLFence::Create();
 
   // Start checking sync status periodically.
-  CheckPictureStatus(picture_buffer_id, std::move(picture_sync_fence));
+  CheckPictureStatus(picture_buffer_id, context_generation_,
+                     std::move(picture_sync_fence));
 }
 
 void OmxrVideoDecodeAccelerator::CheckPictureStatus(
     int32_t picture_buffer_id,
+    int context_generation,
     std::unique_ptr<gl::GLFence> fence_obj
     ) {
   DCHECK(child_task_runner_->BelongsToCurrentThread());
@@ -790,11 +2091,13 @@ void OmxrVideoDecodeAccelerator::CheckPictureStatus(
   // stopped. In that case we may never call QueuePictureBuffer().
   // This is fine though, because all pictures, irrespective of their state,
   // are in pictures_ map and that's what will be used to do the clean up.
-  if (!fence_obj->HasCompleted()) {
+  // Nothing reads from the textures of a lost context any more.
+  if (context_generation == context_generation_ &&
+      !fence_obj->HasCompleted()) {
     child_task_runner_->PostDelayedTask(FROM_HERE, base::Bind(
         &OmxrVideoDecodeAccelerator::CheckPictureStatus, weak_this_,
-        picture_buffer_id, base::Passed(&fence_obj)),
-        base::TimeDelta::FromMilliseconds(kSyncPollDelayMs));
+        picture_buffer_id, context_generation, base::Passed(&fence_obj)),
+        base::TimeDelta::FromMilliseconds(tuning_.sync_poll_delay_ms));
     return;
   }
   // Synced successfully. Queue the buffer for reuse.
@@ -807,12 +2110,37 @@ void OmxrVideoDecodeAccelerator::QueuePictureBuffer(int32_t picture_buffer_id) {
   if (picture_buffer_id < 0)
      return;
 
-  // During port-flushing, do not call OMX FillThisBuffer.
-  if (current_state_change_ == RESETTING) {
+  // A promoted follower's client may still return textures of the leader's
+  // pictures.
+  if (shared_follower_ || shared_textures_.count(picture_buffer_id)) {
+    ReleaseSharedTexture(picture_buffer_id);
+    if (shared_follower_)
+      DeliverSharedPictures();
+    return;
+  }
+
+  // During port-flushing, do not call OMX FillThisBuffer.  While parked the
+  // picture is kept for whichever component we get next.
+  if (current_state_change_ == RESETTING || IsParked()) {
     queued_picture_buffer_ids_.push_back(picture_buffer_id);
     return;
   }
 
+  // Followers still show the picture; it comes back once they are done.
+  // One a resize took the OMX buffer of goes now, its memory once they are
+  // done.
+  if (!shared_key_.empty() &&
+      OmxrSharedDecodeRegistry::Get()->RefCount(shared_key_,
+                                                picture_buffer_id)) {
+    auto it = pictures_.find(picture_buffer_id);
+    if (it != pictures_.end() && !it->second->omx_buffer_header) {
+      pictures_.erase(it);
+      return;
+    }
+    shared_awaiting_release_.insert(picture_buffer_id);
+    return;
+  }
+
   // We might have started destroying while waiting for the picture. It's safe
   // to drop it here, because we will free all the pictures regardless of their
   // state using the pictures_ map.
@@ -831,19 +2159,59 @@ void OmxrVideoDecodeAccelerator::QueuePictureBuffer(int32_t picture_buffer_id) {
     return;
   }
 
+  // Kept by the loop cache until it is served again.
+  if (loop_cache_ && loop_cache_->OnPictureReturned(picture_buffer_id)) {
+    ServeCachedPictures();
+    return;
+  }
+
+  if (UsesSparePictures() && spare_picture_ids_.size() < kNumSparePictures) {
+    spare_picture_ids_.push_back(picture_buffer_id);
+    ServeCachedPictures();
+    return;
+  }
+
   ++output_buffers_at_component_;
   output_picture.at_component = true;
   TRACE_EVENT2("media,gpu", "OVDA::QueuePictureBuffer",
                "Picture id", picture_buffer_id,
                "At component", output_buffers_at_component_);
   OMX_ERRORTYPE result =
-      OMX_FillThisBuffer(component_handle_, output_picture.omx_buffer_header);
+      VENDOR_CALL(OMX_FillThisBuffer(component_handle_,
+                                     output_picture.omx_buffer_header));
   RETURN_ON_OMX_FAILURE(result, "OMX_FillThisBuffer() failed",
                         PLATFORM_FAILURE,);
 }
 
 void OmxrVideoDecodeAccelerator::Flush() {
   DCHECK(child_task_runner_->BelongsToCurrentThread());
+  CpuTaskScope cpu_scope(this, OmxrDecoderStats::CPU_OTHER);
+  if (shared_follower_) {
+    // The pictures of the buffers queued so far come first, unless the
+    // leader does not deliver them in time.
+    shared_flush_pending_ = true;
+    shared_flush_inputs_ = shared_pending_inputs_.size();
+    shared_flush_deadline_ = base::TimeTicks::Now() +
+        base::TimeDelta::FromMilliseconds(kSharedFlushTimeoutMs);
+    DeliverSharedPictures();
+    return;
+  }
+  if (IsParked()) {
+    VLOGF(1) << "Postponing flush until the component is back";
+    flush_pending_ = true;
+    return;
+  }
+  if (!pending_serves_.empty()) {
+    VLOGF(1) << "Postponing flush until cached pictures are served";
+    flush_pending_ = true;
+    return;
+  }
+  if (IsIdling()) {
+    VLOGF(1) << "Postponing flush until the component is awake";
+    flush_pending_ = true;
+    WakeFromIdle();
+    return;
+  }
   DCHECK_EQ(current_state_change_, NO_TRANSITION);
   DCHECK_EQ(client_state_, OMX_StateExecuting);
   VLOGF(1);
@@ -851,6 +2219,11 @@ void OmxrVideoDecodeAccelerator::Flush() {
 
   if (!first_input_buffer_sent_ ) {
     VLOGF(1) << "Nothing to flush, scheduling FlushDone";
+    if (loop_cache_) {
+      loop_cache_->OnFlushDone();
+      ReturnLoopCachePictures();
+    }
+    DeliverNotifications();
     child_task_runner_->PostTask(FROM_HERE, base::Bind(
        &Client::NotifyFlushDone, client_));
     return;
@@ -863,6 +2236,11 @@ void OmxrVideoDecodeAccelerator::OnReachedEOSInFlushing() {
   DCHECK_EQ(client_state_, OMX_StateExecuting);
   VLOGF(1);
   current_state_change_ = NO_TRANSITION;
+  if (loop_cache_) {
+    loop_cache_->OnFlushDone();
+    ReturnLoopCachePictures();
+  }
+  DeliverNotifications();
   if (client_)
     client_->NotifyFlushDone();
 }
@@ -885,11 +2263,137 @@ void OmxrVideoDecodeAccelerator::InputPortFlushDone() {
 void OmxrVideoDecodeAccelerator::OutputPortFlushDone() {
   DCHECK(child_task_runner_->BelongsToCurrentThread());
   DCHECK_EQ(output_buffers_at_component_, 0);
+  // With both ports flushed every input buffer is back with us, so this is
+  // where the input port can be re-sized.
+  if (BeginInputPortRetune())
+    return;
+  BeginTransitionToState(OMX_StateExecuting);
+}
+
+bool OmxrVideoDecodeAccelerator::BeginInputPortRetune() {
+  if (!input_tuner_ ||
+      !input_tuner_->Recommend(base::TimeTicks::Now(), input_config_,
+                               &pending_input_config_)) {
+    return false;
+  }
+  DCHECK_EQ(input_buffers_at_component_, 0);
+  if (!SendCommandToPort(OMX_CommandPortDisable, input_port_))
+    return true;
+  while (!free_input_buffers_.empty()) {
+    OMX_BUFFERHEADERTYPE* omx_buffer = free_input_buffers_.front();
+    free_input_buffers_.pop();
+    OMX_ERRORTYPE result =
+        VENDOR_CALL(OMX_FreeBuffer(component_handle_, input_port_, omx_buffer));
+    RETURN_ON_OMX_FAILURE(result, "OMX_FreeBuffer", PLATFORM_FAILURE, true);
+  }
+  return true;
+}
+
+void OmxrVideoDecodeAccelerator::OnInputPortDisabled() {
+  DCHECK_EQ(current_state_change_, RESETTING);
+  if (!SetInputPortBuffers(pending_input_config_))
+    return;
+  if (!SendCommandToPort(OMX_CommandPortEnable, input_port_))
+    return;
+  AllocateInputBuffers();
+}
+
+void OmxrVideoDecodeAccelerator::OnInputPortEnabled() {
+  DCHECK_EQ(current_state_change_, RESETTING);
   BeginTransitionToState(OMX_StateExecuting);
 }
 
+bool OmxrVideoDecodeAccelerator::SetInputPortBuffers(
+    const OmxrInputTuner::Config& config) {
+  OMX_PARAM_PORTDEFINITIONTYPE port_format;
+  InitParam(&port_format);
+  port_format.nPortIndex = input_port_;
+  OMX_ERRORTYPE result = VENDOR_CALL(OMX_GetParameter(
+      component_handle_, OMX_IndexParamPortDefinition, &port_format));
+  RETURN_ON_OMX_FAILURE(result,
+                        "GetParameter(OMX_IndexParamPortDefinition) failed",
+                        PLATFORM_FAILURE, false);
+
+  VLOGF(1) << "Input port: " << port_format.nBufferCountActual << " -> "
+           << config.count << " buffers, " << port_format.nBufferSize
+           << " -> " << config.size << " bytes each";
+  port_format.nBufferCountActual = config.count;
+  port_format.nBufferSize = config.size;
+  result = VENDOR_CALL(OMX_SetParameter(
+      component_handle_, OMX_IndexParamPortDefinition, &port_format));
+  RETURN_ON_OMX_FAILURE(result,
+                        "SetParameter(OMX_IndexParamPortDefinition) failed",
+                        PLATFORM_FAILURE, false);
+
+  input_buffer_count_ = config.count;
+  input_buffer_size_ = config.size;
+  return true;
+}
+
 void OmxrVideoDecodeAccelerator::Reset() {
   DCHECK(child_task_runner_->BelongsToCurrentThread());
+  CpuTaskScope cpu_scope(this, OmxrDecoderStats::CPU_OTHER);
+  if (shared_follower_) {
+    shared_pending_inputs_.clear();
+    shared_flush_pending_ = false;
+    ReleaseSharedPendingPictures();
+    DeliverNotifications();
+    child_task_runner_->PostTask(FROM_HERE, base::Bind(
+       &Client::NotifyResetDone, client_));
+    return;
+  }
+  // Cached pictures still to be served belong to the input before the
+  // reset, and so does a flush waiting for them.
+  if (!pending_serves_.empty()) {
+    pending_serves_.clear();
+    flush_pending_ = false;
+  }
+  stepping_ = false;
+  // Input after the reset may not bring the resize they were prepared for.
+  if (preallocator_)
+    preallocator_->Clear();
+  if (loop_cache_) {
+    loop_cache_->OnReset();
+    ReturnLoopCachePictures();
+  }
+  if (IsParked()) {
+    // Apart from the EOS buffer draining the previous component, the queued
+    // input has not reached a component yet.
+    VLOGF(1) << "Reset while parked, dropping queued input";
+    base::EraseIf(queued_bitstream_buffers_,
+                  [](const std::unique_ptr<BitstreamBufferRef>& buffer) {
+                    return buffer->id >= 0;
+                  });
+    flush_pending_ = false;
+    catching_up_ = dropping_au_ = skip_to_keyframe_ = false;
+    if (current_state_change_ == PARKING) {
+      // The drain still returns pictures of input from before the reset.
+      // They are held back, and the reset completes once it has ended.
+      parking_reset_pending_ = true;
+      return;
+    }
+    if (first_input_buffer_sent_) {
+      // The re-created component has input already; reset it regularly once
+      // it has its pictures back.
+      VLOGF(1) << "Postponing reset until the session is resumed";
+      reset_pending_ = true;
+      return;
+    }
+    DeliverNotifications();
+    child_task_runner_->PostTask(FROM_HERE, base::Bind(
+       &Client::NotifyResetDone, client_));
+    return;
+  }
+  // No need to wake the component up first: the ports can be flushed while
+  // it is paused, and the reset brings it back to Executing.  The reset
+  // takes over a flush waiting for the wake-up.
+  if (IsIdling()) {
+    flush_pending_ = false;
+    reset_pending_ = true;
+    if (current_state_change_ == IDLE)
+      ResetFromIdle();
+    return;
+  }
   DCHECK(current_state_change_ == NO_TRANSITION ||
         current_state_change_ == FLUSHING ||
         current_state_change_ == RESIZING);
@@ -900,6 +2404,7 @@ void OmxrVideoDecodeAccelerator::Reset() {
     input_buffer_offset_ = 0;
     first_input_buffer_sent_ = false;
 
+    DeliverNotifications();
     child_task_runner_->PostTask(FROM_HERE, base::Bind(
        &Client::NotifyResetDone, client_));
     return;
@@ -926,16 +2431,61 @@ void OmxrVideoDecodeAccelerator::Destroy() {
   DCHECK(child_task_runner_->BelongsToCurrentThread());
 
   std::unique_ptr<OmxrVideoDecodeAccelerator> deleter(this);
+  // Closes before |deleter| deletes |this|.
+  CpuTaskScope cpu_scope(this, OmxrDecoderStats::CPU_OTHER);
   client_ptr_factory_->InvalidateWeakPtrs();
+  // Promotes a follower if we lead, before our pictures go away.
+  LeaveSharedStream();
+
+  if (component_hung_) {
+    AbandonComponent(std::move(deleter));
+    return;
+  }
+
+  VLOGF(1) << (slice_streaming_ ? "Slice streaming" : "Whole access unit")
+           << " decode, " << stats_;
+  ReportCpuUsage();
+  if (!catch_up_threshold_.is_zero()) {
+    UMA_HISTOGRAM_COUNTS_100("Media.OmxrDecoder.CatchUps", stats_.catch_ups);
+    UMA_HISTOGRAM_COUNTS_10000("Media.OmxrDecoder.SkippedAccessUnits",
+                               stats_.skipped_access_units);
+    UMA_HISTOGRAM_COUNTS_100("Media.OmxrDecoder.SkipsToKeyframe",
+                             stats_.skipped_to_keyframe);
+  }
 
   if (current_state_change_ == ERRORING ||
       current_state_change_ == DESTROYING) {
     return;
   }
 
+  // A session still waiting for its first component has nothing to tear
+  // down.
+  if (current_state_change_ == INITIALIZING && !component_handle_)
+    return;
+
+  // A parked session has no component; only the pictures are left to free.
+  // The same holds once parking has already freed the buffer headers.
+  if (current_state_change_ == PARKED ||
+      (current_state_change_ == PARKING && client_state_ == OMX_StateIdle)) {
+    pictures_.clear();
+    queued_picture_buffer_ids_.clear();
+  }
+  // Parking has the component on its way to Idle or Loaded already; the
+  // destroying handlers take over from whichever state it reaches.
+  if (current_state_change_ == PARKING && parking_drained_) {
+    current_state_change_ = DESTROYING;
+    if (!hang_timeout_.is_zero())
+      destroy_deadline_ = base::TimeTicks::Now() + hang_timeout_;
+    BusyLoopInDestroying(std::move(deleter));
+    return;
+  }
+
   DCHECK(current_state_change_ == NO_TRANSITION ||
          current_state_change_ == FLUSHING ||
-         current_state_change_ == RESETTING) << current_state_change_;
+         current_state_change_ == RESETTING ||
+         current_state_change_ == PARKING ||
+         current_state_change_ == PARKED ||
+         IsIdling()) << current_state_change_;
 
   // If we were never initializeed there's no teardown to do.
   if (client_state_ == OMX_StateMax)
@@ -949,6 +2499,8 @@ void OmxrVideoDecodeAccelerator::Destroy() {
          client_state_ == OMX_StateIdle ||
          client_state_ == OMX_StatePause);
   current_state_change_ = DESTROYING;
+  if (!hang_timeout_.is_zero())
+    destroy_deadline_ = base::TimeTicks::Now() + hang_timeout_;
   BeginTransitionToState(OMX_StateIdle);
   BusyLoopInDestroying(std::move(deleter));
 }
@@ -968,8 +2520,8 @@ void OmxrVideoDecodeAccelerator::BeginTransitionToState(
 
   if (current_state_change_ == ERRORING)
     return;
-  OMX_ERRORTYPE result = OMX_SendCommand(
-      component_handle_, OMX_CommandStateSet, new_state, 0);
+  OMX_ERRORTYPE result = VENDOR_CALL(OMX_SendCommand(
+      component_handle_, OMX_CommandStateSet, new_state, 0));
   RETURN_ON_FAILURE(result == OMX_ErrorNone || new_state == OMX_StateInvalid,
                         "SendCommand(OMX_CommandStateSet) failed",
                         PLATFORM_FAILURE,);
@@ -996,10 +2548,23 @@ void OmxrVideoDecodeAccelerator::OnReachedExecutingInInitializing() {
            fake_output_buffers_.begin();
        it != fake_output_buffers_.end(); ++it) {
     OMX_BUFFERHEADERTYPE* buffer = *it;
-    OMX_ERRORTYPE result = OMX_FillThisBuffer(component_handle_, buffer);
+    OMX_ERRORTYPE result =
+        VENDOR_CALL(OMX_FillThisBuffer(component_handle_, buffer));
     RETURN_ON_OMX_FAILURE(result, "OMX_FillThisBuffer()", PLATFORM_FAILURE,);
     ++output_buffers_at_component_;
   }
+  if (resuming_from_park_) {
+    VLOGF(1) << "Resumed session " << mux_session_id_;
+    DecodeQueuedBitstreamBuffers();
+    return;
+  }
+  // Our client was told about initialization when we joined as follower.
+  if (promoted_from_follower_) {
+    promoted_from_follower_ = false;
+    VLOGF(1) << "Leading shared stream " << shared_key_;
+    DecodeQueuedBitstreamBuffers();
+    return;
+  }
   if (deferred_init_allowed_ && client_) {
     client_->NotifyInitializationComplete(true);
      // Drain queues of input & output buffers held during the init.
@@ -1023,10 +2588,161 @@ void OmxrVideoDecodeAccelerator::DecodeQueuedBitstreamBuffers() {
       current_state_change_ == ERRORING) {
     return;
   }
+  if (catch_up_skip_to_keyframe_ && !buffers.empty() &&
+      base::TimeTicks::Now() - buffers.front()->arrival_time >
+          catch_up_threshold_) {
+    SkipToLatestKeyframe(&buffers);
+  }
   for (size_t i = 0; i < buffers.size(); ++i)
     DecodeBuffer(std::move(buffers[i]));
 }
 
+void OmxrVideoDecodeAccelerator::UpdateCatchUp(
+    const BitstreamBufferRef& input_buffer) {
+  if (catch_up_threshold_.is_zero() || input_buffer.replayed)
+    return;
+  // The component decodes as fast as it is fed, so input waiting here is all
+  // the delay there is to make up.
+  base::TimeDelta lag = base::TimeTicks::Now() - input_buffer.arrival_time;
+  if (!catching_up_ && lag > catch_up_threshold_) {
+    VLOGF(1) << "Input " << lag.InMilliseconds() << " ms late, catching up";
+    catching_up_ = true;
+    ++stats_.catch_ups;
+    TraceCatchUp();
+  } else if (catching_up_ && lag < catch_up_target_) {
+    VLOGF(1) << "Caught up after " << stats_.skipped_access_units
+             << " skipped access units";
+    catching_up_ = false;
+  }
+}
+
+bool OmxrVideoDecodeAccelerator::ShouldSkipSpan(
+    const BitstreamBufferRef& input_buffer,
+    const OmxrBitstreamFramer::Span& span) {
+  if (skip_to_keyframe_) {
+    if (!span.keyframe)
+      return true;
+    skip_to_keyframe_ = false;
+    return false;
+  }
+  if (dropping_au_) {
+    if (!span.starts_access_unit)
+      return true;
+    dropping_au_ = false;
+  }
+  // Only whole access units go: a span continuing one already started is
+  // kept with it.
+  if (!catching_up_ || !span.disposable || input_buffer.replayed ||
+      (!span.starts_access_unit && (input_buffer_offset_ || slice_au_open_))) {
+    return false;
+  }
+  dropping_au_ = true;
+  ++stats_.skipped_access_units;
+  TraceCatchUp();
+  return true;
+}
+
+void OmxrVideoDecodeAccelerator::SkipToLatestKeyframe(
+    BitstreamBufferList* buffers) {
+  // A streamed access unit cannot be taken back from the component.
+  if (slice_au_open_)
+    return;
+  // Only plain input before the keyframe may go; EOS, replays and the end of
+  // a replay stop the search.
+  size_t keyframe_index = 0;
+  for (size_t i = 0; i < buffers->size(); ++i) {
+    const BitstreamBufferRef& buffer = *(*buffers)[i];
+    if (buffer.id < 0 || buffer.replayed)
+      break;
+    bool keyframe =
+        buffer.framed
+            ? std::any_of(buffer.spans.begin() + buffer.next_span,
+                          buffer.spans.end(),
+                          [](const OmxrBitstreamFramer::Span& span) {
+                            return span.keyframe;
+                          })
+            : framer_->ContainsKeyframe(
+                  static_cast<const uint8_t*>(buffer.memory), buffer.size);
+    if (keyframe)
+      keyframe_index = i;
+  }
+  if (!keyframe_index)
+    return;
+
+  VLOGF(1) << "Skipping " << keyframe_index << " buffers to a keyframe";
+  // The dropped buffers return to the client here.
+  buffers->erase(buffers->begin(), buffers->begin() + keyframe_index);
+  input_buffer_offset_ = 0;
+  dropping_au_ = false;
+  skip_to_keyframe_ = true;
+  ++stats_.skipped_to_keyframe;
+  if (!catching_up_) {
+    catching_up_ = true;
+    ++stats_.catch_ups;
+  }
+  TraceCatchUp();
+}
+
+void OmxrVideoDecodeAccelerator::TraceCatchUp() {
+  TRACE_COUNTER_ID1("media,gpu", "OVDA catch-ups", this, stats_.catch_ups);
+  TRACE_COUNTER_ID2("media,gpu", "OVDA catch-up skips", this, "Access units",
+                    stats_.skipped_access_units, "To keyframe",
+                    stats_.skipped_to_keyframe);
+}
+
+OmxrVideoDecodeAccelerator::CpuTaskScope::CpuTaskScope(
+    OmxrVideoDecodeAccelerator* decoder,
+    OmxrDecoderStats::CpuTask task)
+    : decoder_(decoder),
+      task_(task),
+      // Only the outermost scope reads the clock.
+      start_(decoder->cpu_task_depth_ ? base::ThreadTicks() : CpuNow()) {
+  ++decoder_->cpu_task_depth_;
+}
+
+OmxrVideoDecodeAccelerator::CpuTaskScope::~CpuTaskScope() {
+  if (--decoder_->cpu_task_depth_)
+    return;
+  OmxrDecoderStats& stats = decoder_->stats_;
+  stats.task_cpu_time[task_] += CpuNow() - start_;
+  TRACE_COUNTER_ID2("media,gpu", "OVDA CPU ms", decoder_, "Tasks",
+                    stats.TotalCpuTime().InMilliseconds(), "Vendor",
+                    stats.vendor_cpu_time.InMilliseconds());
+}
+
+OmxrVideoDecodeAccelerator::VendorCallScope::VendorCallScope(
+    OmxrVideoDecodeAccelerator* decoder)
+    : task_scope_(decoder, OmxrDecoderStats::CPU_OTHER),
+      decoder_(decoder),
+      start_(CpuNow()) {}
+
+OmxrVideoDecodeAccelerator::VendorCallScope::~VendorCallScope() {
+  decoder_->stats_.vendor_cpu_time += CpuNow() - start_;
+}
+
+// static
+std::map<std::string, OmxrResourceTracker::CpuUsage>
+OmxrVideoDecodeAccelerator::GetCpuUsage() {
+  return OmxrResourceTracker::Get()->GetCpuUsage();
+}
+
+void OmxrVideoDecodeAccelerator::ReportCpuUsage() {
+  base::TimeDelta task_time = stats_.TotalCpuTime();
+  if (cpu_stream_class_.empty() || task_time == cpu_reported_.task_time)
+    return;
+  OmxrResourceTracker::Get()->AddCpuUsage(
+      cpu_stream_class_, task_time - cpu_reported_.task_time,
+      stats_.vendor_cpu_time - cpu_reported_.vendor_time);
+  cpu_reported_.task_time = task_time;
+  cpu_reported_.vendor_time = stats_.vendor_cpu_time;
+}
+
+// static
+base::ThreadTicks OmxrVideoDecodeAccelerator::CpuNow() {
+  return base::ThreadTicks::IsSupported() ? base::ThreadTicks::Now()
+                                          : base::ThreadTicks();
+}
+
 void OmxrVideoDecodeAccelerator::OnReachedExecutingInResetting() {
   DCHECK_EQ(client_state_, OMX_StatePause);
   VLOGF(1);
@@ -1034,8 +2750,12 @@ void OmxrVideoDecodeAccelerator::OnReachedExecutingInResetting() {
   current_state_change_ = NO_TRANSITION;
 
   input_buffer_offset_ = 0;
-  previous_frame_has_data_ = false;
+  framer_->Reset();
   first_input_buffer_sent_ = false;
+  slice_au_open_ = false;
+  catching_up_ = dropping_au_ = skip_to_keyframe_ = false;
+  au_arrival_times_.clear();
+  refill_target_id_ = -1;
 
   if (!client_)
     return;
@@ -1046,6 +2766,7 @@ void OmxrVideoDecodeAccelerator::OnReachedExecutingInResetting() {
     QueuePictureBuffer(queued_picture_buffer_ids_[i]);
   queued_picture_buffer_ids_.clear();
 
+  DeliverNotifications();
   client_->NotifyResetDone();
 }
 
@@ -1060,6 +2781,14 @@ void OmxrVideoDecodeAccelerator::OnReachedExecutingInResetting() {
 void OmxrVideoDecodeAccelerator::BusyLoopInDestroying(
     std::unique_ptr<OmxrVideoDecodeAccelerator> self) {
   if (!component_handle_) return;
+  if (!destroy_deadline_.is_null() &&
+      base::TimeTicks::Now() > destroy_deadline_) {
+    LOG(ERROR) << "OMX component did not shut down in time";
+    component_hung_ = true;
+    NoteComponentHung();
+    AbandonComponent(std::move(self));
+    return;
+  }
   // Can't use PostDelayedTask here because MessageLoop doesn't drain delayed
   // tasks.  Instead we sleep for 5ms.  Really.
   base::PlatformThread::Sleep(base::TimeDelta::FromMilliseconds(5));
@@ -1096,15 +2825,319 @@ void OmxrVideoDecodeAccelerator::OnReachedInvalidInErroring() {
   ShutdownComponent();
 }
 
+void OmxrVideoDecodeAccelerator::BeginParking(
+    std::unique_ptr<struct BitstreamBufferRef> idr_buffer) {
+  DCHECK(child_task_runner_->BelongsToCurrentThread());
+  TRACE_EVENT1("media,gpu", "OVDA::BeginParking",
+               "Session", mux_session_id_);
+  VLOGF(1) << "Yielding component of session " << mux_session_id_;
+  current_state_change_ = PARKING;
+  resuming_from_park_ = true;
+  parking_drained_ = false;
+
+  // Drain everything before the IDR through the regular EOS path.  The IDR and
+  // anything after it waits in |queued_bitstream_buffers_| for the next
+  // component.
+  DecodeBuffer(std::make_unique<BitstreamBufferRef>(
+      media::BitstreamBuffer(-1, base::SharedMemoryHandle(), 0),
+      decode_task_runner_, decode_client_));
+  queued_bitstream_buffers_.push_back(std::move(idr_buffer));
+}
+
+void OmxrVideoDecodeAccelerator::OnReachedEOSInParking() {
+  DCHECK(child_task_runner_->BelongsToCurrentThread());
+  DCHECK_EQ(client_state_, OMX_StateExecuting);
+  VLOGF(1);
+  parking_drained_ = true;
+  BeginTransitionToState(OMX_StateIdle);
+}
+
+void OmxrVideoDecodeAccelerator::OnReachedIdleInParking() {
+  DCHECK_EQ(client_state_, OMX_StateExecuting);
+  DCHECK_EQ(input_buffers_at_component_, 0);
+  DCHECK_EQ(output_buffers_at_component_, 0);
+  client_state_ = OMX_StateIdle;
+  BeginTransitionToState(OMX_StateLoaded);
+
+  // Free the buffer headers, but keep the pictures' carveout, EGLImages and
+  // textures for the next component.
+  while (!free_input_buffers_.empty()) {
+    OMX_BUFFERHEADERTYPE* omx_buffer = free_input_buffers_.front();
+    free_input_buffers_.pop();
+    OMX_ERRORTYPE result =
+        VENDOR_CALL(OMX_FreeBuffer(component_handle_, input_port_, omx_buffer));
+    RETURN_ON_OMX_FAILURE(result, "OMX_FreeBuffer", PLATFORM_FAILURE,);
+  }
+  for (OutputPictureById::iterator it = pictures_.begin();
+       it != pictures_.end(); ++it) {
+    OMX_ERRORTYPE result = VENDOR_CALL(it->second->FreeOMXHandle());
+    RETURN_ON_OMX_FAILURE(result, "OMX_FreeBuffer", PLATFORM_FAILURE,);
+    it->second->allocated = false;
+  }
+}
+
+void OmxrVideoDecodeAccelerator::OnReachedLoadedInParking() {
+  DCHECK_EQ(client_state_, OMX_StateIdle);
+  OMX_ERRORTYPE result = VENDOR_CALL(OMX_FreeHandle(component_handle_));
+  component_handle_ = NULL;
+  client_state_ = OMX_StateMax;
+  current_state_change_ = PARKED;
+  restore_parameter_sets_ = true;
+  RETURN_ON_OMX_FAILURE(result, "OMX_FreeHandle", PLATFORM_FAILURE,);
+  OmxrResourceTracker::Get()->ComponentFreed();
+
+  VLOGF(1) << "Session " << mux_session_id_ << " parked";
+  // Nothing has reached the next component yet.
+  first_input_buffer_sent_ = false;
+  if (parking_reset_pending_) {
+    parking_reset_pending_ = false;
+    DeliverNotifications();
+    child_task_runner_->PostTask(FROM_HERE, base::Bind(
+       &Client::NotifyResetDone, client_));
+  }
+  OmxrSessionMultiplexer* multiplexer = OmxrSessionMultiplexer::Get();
+  multiplexer->ReleaseComponent(mux_session_id_);
+  if (multiplexer->AcquireComponent(
+          mux_session_id_,
+          base::Bind(&OmxrVideoDecodeAccelerator::OnComponentGranted,
+                     weak_this_))) {
+    OnComponentGranted();
+  }
+}
+
+void OmxrVideoDecodeAccelerator::ReattachPictureBuffers() {
+  DCHECK(child_task_runner_->BelongsToCurrentThread());
+  VLOGF(1) << "Re-using " << pictures_.size() << " parked pictures";
+  OMX_PARAM_PORTDEFINITIONTYPE port_format;
+  InitParam(&port_format);
+  port_format.nPortIndex = output_port_;
+  OMX_ERRORTYPE result = VENDOR_CALL(OMX_GetParameter(
+      component_handle_, OMX_IndexParamPortDefinition, &port_format));
+  RETURN_ON_OMX_FAILURE(result, "OMX_GetParameter", PLATFORM_FAILURE,);
+
+  port_format.nBufferCountActual = pictures_.size();
+  result = VENDOR_CALL(OMX_SetParameter(
+      component_handle_, OMX_IndexParamPortDefinition, &port_format));
+  RETURN_ON_OMX_FAILURE(result,
+                        "SetParameter(OMX_IndexParamPortDefinition) failed",
+                        PLATFORM_FAILURE,);
+
+  if (!SendCommandToPort(OMX_CommandPortEnable, output_port_))
+    return;
+  if (!AllocateOutputBuffers(port_format.nBufferSize))
+    return;
+  current_state_change_ = NO_TRANSITION;
+}
+
+bool OmxrVideoDecodeAccelerator::IsParked() const {
+  return current_state_change_ == PARKING ||
+         current_state_change_ == PARKED ||
+         resuming_from_park_;
+}
+
 void OmxrVideoDecodeAccelerator::ShutdownComponent() {
-  OMX_ERRORTYPE result = OMX_FreeHandle(component_handle_);
+  OMX_ERRORTYPE result = VENDOR_CALL(OMX_FreeHandle(component_handle_));
   if (result != OMX_ErrorNone)
     DLOG(ERROR) << "OMX_FreeHandle() error. Error code: " << result;
+  else
+    OmxrResourceTracker::Get()->ComponentFreed();
   client_state_ = OMX_StateMax;
   // Allow BusyLoopInDestroying to exit and delete |this|.
   component_handle_ = NULL;
 }
 
+bool OmxrVideoDecodeAccelerator::ComponentOwesProgress() const {
+  switch (current_state_change_) {
+    case INITIALIZING:
+    case RESETTING:
+    case DESTROYING:
+      return true;
+    case IDLING:
+    case WAKING:
+      return true;
+    case RESIZING:
+    case PARKED:
+    case IDLE:
+    case ERRORING:
+      return false;
+    case FLUSHING:
+      // The EOS buffer completes the last access unit.
+      return input_buffers_at_component_ > 0 &&
+             output_buffers_at_component_ > 0;
+    default:
+      // The component may keep the last access unit until the next one
+      // begins, as it does whenever a live stream stalls, and the slices of
+      // an incomplete one in any case.  Only an access unit followed by more
+      // input is owed, and nothing is without pictures to fill.
+      return input_buffers_at_component_ > 1 &&
+             output_buffers_at_component_ > 0 && !slice_au_open_;
+  }
+}
+
+void OmxrVideoDecodeAccelerator::NoteComponentProgress() {
+  if (watchdog_armed_)
+    last_component_progress_ = base::TimeTicks::Now();
+}
+
+void OmxrVideoDecodeAccelerator::CheckComponentProgress() {
+  DCHECK(child_task_runner_->BelongsToCurrentThread());
+  // Re-armed by InitializeComponent() when parking re-creates the component.
+  if (!component_handle_ || current_state_change_ == ERRORING) {
+    watchdog_armed_ = false;
+    return;
+  }
+  base::TimeTicks now = base::TimeTicks::Now();
+  if (!ComponentOwesProgress()) {
+    last_component_progress_ = now;
+  } else if (now - last_component_progress_ > hang_timeout_) {
+    OnComponentHung();
+    return;
+  }
+  child_task_runner_->PostDelayedTask(FROM_HERE, base::Bind(
+      &OmxrVideoDecodeAccelerator::CheckComponentProgress, weak_this_),
+      hang_timeout_ / 4);
+}
+
+void OmxrVideoDecodeAccelerator::OnComponentHung() {
+  LOG(ERROR) << "OMX component silent for "
+             << (base::TimeTicks::Now() - last_component_progress_)
+                    .InMilliseconds()
+             << " ms during state change " << current_state_change_ << ", "
+             << input_buffers_at_component_ << " input and "
+             << output_buffers_at_component_
+             << " output buffers at component";
+  watchdog_armed_ = false;
+  component_hung_ = true;
+  NoteComponentHung();
+  StopOnError(PLATFORM_FAILURE);
+}
+
+void OmxrVideoDecodeAccelerator::AbandonComponent(
+    std::unique_ptr<OmxrVideoDecodeAccelerator> self) {
+  VLOGF(1) << "Leaking the hung component and its buffers";
+  if (mux_session_id_) {
+    OmxrSessionMultiplexer::Get()->UnregisterSession(mux_session_id_);
+    mux_session_id_ = 0;
+  }
+  // The component may still write into our buffers or call us back, so
+  // nothing it knows about can be freed, |this| included.  Its callbacks
+  // stop at the invalidated |weak_this_|.
+  weak_this_factory_.InvalidateWeakPtrs();
+  ignore_result(self.release());
+}
+
+void OmxrVideoDecodeAccelerator::ArmIdleTimer() {
+  if (idle_delay_.is_zero() || idle_timer_armed_)
+    return;
+  idle_timer_armed_ = true;
+  child_task_runner_->PostDelayedTask(FROM_HERE, base::Bind(
+      &OmxrVideoDecodeAccelerator::CheckForIdle, weak_this_), idle_delay_);
+}
+
+void OmxrVideoDecodeAccelerator::CheckForIdle() {
+  DCHECK(child_task_runner_->BelongsToCurrentThread());
+  CpuTaskScope cpu_scope(this, OmxrDecoderStats::CPU_OTHER);
+  idle_timer_armed_ = false;
+  // Re-armed by the next Decode() once the component is back or idle.
+  if (!component_handle_ || IsIdling() ||
+      current_state_change_ == DESTROYING ||
+      current_state_change_ == ERRORING) {
+    return;
+  }
+  base::TimeDelta quiet = base::TimeTicks::Now() - last_decode_time_;
+  if (quiet < idle_delay_) {
+    idle_timer_armed_ = true;
+    child_task_runner_->PostDelayedTask(FROM_HERE, base::Bind(
+        &OmxrVideoDecodeAccelerator::CheckForIdle, weak_this_),
+        idle_delay_ - quiet);
+    return;
+  }
+  if (!CanIdle()) {
+    ArmIdleTimer();
+    return;
+  }
+  VLOGF(1) << "No input for " << quiet.InMilliseconds()
+           << " ms, pausing the component";
+  current_state_change_ = IDLING;
+  BeginTransitionToState(OMX_StatePause);
+}
+
+bool OmxrVideoDecodeAccelerator::CanIdle() const {
+  // The component must have consumed all input, including any incomplete
+  // access unit, so that nothing it owes us waits behind the pause.
+  return current_state_change_ == NO_TRANSITION &&
+         client_state_ == OMX_StateExecuting &&
+         input_buffers_at_component_ == 0 && input_buffer_offset_ == 0 &&
+         !slice_au_open_ && queued_bitstream_buffers_.empty() &&
+         pending_serves_.empty();
+}
+
+void OmxrVideoDecodeAccelerator::WakeFromIdle() {
+  DCHECK(IsIdling());
+  if (wake_requested_.is_null())
+    wake_requested_ = base::TimeTicks::Now();
+  // An IDLING component is woken once its pause completes.
+  if (current_state_change_ != IDLE)
+    return;
+  VLOGF(1) << "Waking the component";
+  stats_.total_idle_time += base::TimeTicks::Now() - idle_since_;
+  current_state_change_ = WAKING;
+  BeginTransitionToState(OMX_StateExecuting);
+}
+
+void OmxrVideoDecodeAccelerator::ResetFromIdle() {
+  DCHECK_EQ(current_state_change_, IDLE);
+  DCHECK_EQ(client_state_, OMX_StatePause);
+  VLOGF(1) << "Resetting the paused component";
+  stats_.total_idle_time += base::TimeTicks::Now() - idle_since_;
+  wake_requested_ = base::TimeTicks();
+  // As FinishReset(), but the component is paused already.
+  current_state_change_ = RESETTING;
+  reset_pending_ = false;
+  queued_bitstream_buffers_.clear();
+  FlushIOPorts();
+  ArmIdleTimer();
+}
+
+void OmxrVideoDecodeAccelerator::OnReachedPauseInIdling() {
+  DCHECK_EQ(client_state_, OMX_StateExecuting);
+  client_state_ = OMX_StatePause;
+  current_state_change_ = IDLE;
+  idle_since_ = base::TimeTicks::Now();
+  ++stats_.idles;
+  if (reset_pending_)
+    ResetFromIdle();
+  else if (!wake_requested_.is_null())
+    WakeFromIdle();
+}
+
+void OmxrVideoDecodeAccelerator::OnReachedExecutingInWaking() {
+  DCHECK_EQ(client_state_, OMX_StatePause);
+  client_state_ = OMX_StateExecuting;
+  current_state_change_ = NO_TRANSITION;
+  base::TimeDelta latency = base::TimeTicks::Now() - wake_requested_;
+  VLOGF(1) << "Component awake after " << latency.InMillisecondsF() << " ms";
+  stats_.AddWakeUp(latency);
+  wake_requested_ = base::TimeTicks();
+  if (reset_pending_) {
+    flush_pending_ = false;
+    FinishReset();
+    return;
+  }
+  DecodeQueuedBitstreamBuffers();
+  // A flush alone does not re-arm the timer.
+  ArmIdleTimer();
+  if (flush_pending_) {
+    flush_pending_ = false;
+    Flush();
+  }
+}
+
+bool OmxrVideoDecodeAccelerator::IsIdling() const {
+  return current_state_change_ == IDLING || current_state_change_ == IDLE ||
+         current_state_change_ == WAKING;
+}
+
 void OmxrVideoDecodeAccelerator::StopOnError(
     media::VideoDecodeAccelerator::Error error) {
   DCHECK(child_task_runner_->BelongsToCurrentThread());
@@ -1112,6 +3145,8 @@ void OmxrVideoDecodeAccelerator::StopOnError(
   if (current_state_change_ == ERRORING)
     return;
 
+  // What the client was told before the error still reaches it first.
+  DeliverNotifications();
   if (client_ && init_begun_)
     client_->NotifyError(error);
   client_ptr_factory_->InvalidateWeakPtrs();
@@ -1119,19 +3154,33 @@ void OmxrVideoDecodeAccelerator::StopOnError(
   if (client_state_ == OMX_StateInvalid || client_state_ == OMX_StateMax)
       return;
 
+  // A hung component would not answer, if the call returned at all.
+  if (component_hung_) {
+    current_state_change_ = ERRORING;
+    return;
+  }
+
   BeginTransitionToState(OMX_StateInvalid);
   current_state_change_ = ERRORING;
 }
 
+void OmxrVideoDecodeAccelerator::UpdateCarveoutStats() {
+  stats_.SetCarveoutBytes(pictures_.size() * picture_alloc_size_ +
+                          input_config_.count * input_config_.size +
+                          stats_.frame_store_bytes);
+}
+
 bool OmxrVideoDecodeAccelerator::AllocateInputBuffers() {
   DCHECK(child_task_runner_->BelongsToCurrentThread());
   VLOG(1) << __func__ << ": Allocating " << input_buffer_count_ << " buffers of size: " << input_buffer_size_;
+  input_config_ = {input_buffer_count_, static_cast<size_t>(input_buffer_size_)};
   for (int i = 0; i < input_buffer_count_; ++i) {
     OMX_BUFFERHEADERTYPE* buffer;
     OMX_ERRORTYPE result =
-        OMX_AllocateBuffer(component_handle_, &buffer, input_port_,
-                      NULL, /* pAppPrivate gets set in Decode(). */
-                      input_buffer_size_);
+        VENDOR_CALL(OMX_AllocateBuffer(
+            component_handle_, &buffer, input_port_,
+            NULL, /* pAppPrivate gets set in Decode(). */
+            input_buffer_size_));
     RETURN_ON_OMX_FAILURE(result, "OMX_AllocateBuffer() Input buffer error",
                           PLATFORM_FAILURE, false);
     buffer->nInputPortIndex = input_port_;
@@ -1139,17 +3188,19 @@ bool OmxrVideoDecodeAccelerator::AllocateInputBuffers() {
     buffer->nFlags = 0;
     free_input_buffers_.push(buffer);
   }
+  UpdateCarveoutStats();
   return true;
 }
 
 bool OmxrVideoDecodeAccelerator::AllocateFakeOutputBuffers() {
   // Fill the component with fake output buffers.
-  VLOG(1) << __func__ << ": Allocating " << kNumPictureBuffers << " buffers of size: " << output_buffer_size_;
-  for (unsigned int i = 0; i < kNumPictureBuffers; ++i) {
+  VLOG(1) << __func__ << ": Allocating " << tuning_.num_picture_buffers << " buffers of size: " << output_buffer_size_;
+  for (int i = 0; i < tuning_.num_picture_buffers; ++i) {
     OMX_BUFFERHEADERTYPE* buffer;
     OMX_ERRORTYPE result;
-    result = OMX_AllocateBuffer(component_handle_, &buffer, output_port_,
-                                NULL, output_buffer_size_);
+    result = VENDOR_CALL(OMX_AllocateBuffer(component_handle_, &buffer,
+                                            output_port_, NULL,
+                                            output_buffer_size_));
     RETURN_ON_OMX_FAILURE(result, "OMX_AllocateBuffer failed",
                           PLATFORM_FAILURE, false);
     buffer->pAppPrivate = NULL;
@@ -1174,9 +3225,9 @@ bool OmxrVideoDecodeAccelerator::AllocateOutputBuffers(int size) {
     uint32_t hard_addr = output_picture->mmngr_buf.hard_addr;
     DCHECK(!*omx_buffer);
 
-    OMX_ERRORTYPE result = OMX_UseBuffer(
+    OMX_ERRORTYPE result = VENDOR_CALL(OMX_UseBuffer(
         component_handle_, omx_buffer, output_port_, output_picture, size,
-        reinterpret_cast<OMX_U8*>(hard_addr));
+        reinterpret_cast<OMX_U8*>(hard_addr)));
 
     RETURN_ON_OMX_FAILURE(result, "OMX_UseBuffer", PLATFORM_FAILURE, false);
   }
@@ -1190,7 +3241,7 @@ void OmxrVideoDecodeAccelerator::FreeOMXBuffers() {
     OMX_BUFFERHEADERTYPE* omx_buffer = free_input_buffers_.front();
     free_input_buffers_.pop();
     OMX_ERRORTYPE result =
-        OMX_FreeBuffer(component_handle_, input_port_, omx_buffer);
+        VENDOR_CALL(OMX_FreeBuffer(component_handle_, input_port_, omx_buffer));
     if (result != OMX_ErrorNone) {
       DLOG(ERROR) << "OMX_FreeBuffer failed: 0x" << std::hex << result;
       failure_seen = true;
@@ -1198,6 +3249,7 @@ void OmxrVideoDecodeAccelerator::FreeOMXBuffers() {
   }
 
   pictures_.clear();
+  shared_awaiting_release_.clear();
 
   // Delete pending fake_output_buffers_ //TODO(dhobsong): still not liking these
   for (std::set<OMX_BUFFERHEADERTYPE*>::iterator it =
@@ -1205,7 +3257,7 @@ void OmxrVideoDecodeAccelerator::FreeOMXBuffers() {
        it != fake_output_buffers_.end(); ++it) {
     OMX_BUFFERHEADERTYPE* buffer = *it;
     OMX_ERRORTYPE result =
-        OMX_FreeBuffer(component_handle_, output_port_, buffer);
+        VENDOR_CALL(OMX_FreeBuffer(component_handle_, output_port_, buffer));
     if (result != OMX_ErrorNone) {
       DLOG(ERROR) << "OMX_FreeBuffer failed: 0x" << std::hex << result;
       failure_seen = true;
@@ -1214,6 +3266,7 @@ void OmxrVideoDecodeAccelerator::FreeOMXBuffers() {
   fake_output_buffers_.clear();
 
   // Dequeue pending queued_picture_buffer_ids_
+  DeliverNotifications();
   if (client_) {
     for (size_t i = 0; i < queued_picture_buffer_ids_.size(); ++i)
       client_->DismissPictureBuffer(queued_picture_buffer_ids_[i]);
@@ -1226,26 +3279,50 @@ void OmxrVideoDecodeAccelerator::FreeOMXBuffers() {
 void OmxrVideoDecodeAccelerator::OnPortSettingsChanged() {
   VLOGF(1) << "Port settings changed received";
   current_state_change_ = RESIZING;
+  resize_start_ = base::TimeTicks::Now();
   SendCommandToPort(OMX_CommandPortDisable, output_port_);
 
+  // Pictures only followers still show are not coming back to the
+  // component; their memory goes once the followers are done.
+  for (int32_t picture_buffer_id : shared_awaiting_release_)
+    pictures_.erase(picture_buffer_id);
+  shared_awaiting_release_.clear();
+
   for (OutputPictureById::iterator it = pictures_.begin();
            it != pictures_.end(); ++it) {
     if (!it->second->at_component) {
-      OMX_ERRORTYPE result = it->second->FreeOMXHandle();
+      OMX_ERRORTYPE result = VENDOR_CALL(it->second->FreeOMXHandle());
       RETURN_ON_OMX_FAILURE(result, "OMX_FreeBuffer", PLATFORM_FAILURE,);
     }
   }
 }
 
+void OmxrVideoDecodeAccelerator::DropCachedPictures() {
+  for (size_t i = 0; i < spare_picture_ids_.size(); ++i)
+    pictures_.erase(spare_picture_ids_[i]);
+  spare_picture_ids_.clear();
+  if (loop_cache_) {
+    // Those the client holds are freed once it returns them.
+    loop_cache_->SetCapacity(0);
+    for (int32_t picture_buffer_id : loop_cache_->TakeReleasedPictures())
+      pictures_.erase(picture_buffer_id);
+    stats_.loop_cache_bytes = 0;
+  }
+  pending_serves_.clear();
+  refill_target_id_ = -1;
+  frame_store_.reset();
+}
+
 void OmxrVideoDecodeAccelerator::OnOutputPortDisabled() {
   DCHECK(child_task_runner_->BelongsToCurrentThread());
   OMX_PARAM_PORTDEFINITIONTYPE port_format;
   InitParam(&port_format);
   port_format.nPortIndex = output_port_;
-  OMX_ERRORTYPE result = OMX_GetParameter(
-      component_handle_, OMX_IndexParamPortDefinition, &port_format);
+  OMX_ERRORTYPE result = VENDOR_CALL(OMX_GetParameter(
+      component_handle_, OMX_IndexParamPortDefinition, &port_format));
   RETURN_ON_OMX_FAILURE(result, "OMX_GetParameter", PLATFORM_FAILURE,);
-  DCHECK_LE(port_format.nBufferCountMin, kNumPictureBuffers);
+  DCHECK_LE(port_format.nBufferCountMin,
+            static_cast<OMX_U32>(tuning_.num_picture_buffers));
 
   // TODO(fischman): to support mid-stream resize, need to free/dismiss any
   // |pictures_| we already have.  Make sure that the shutdown-path agrees with
@@ -1257,9 +3334,35 @@ void OmxrVideoDecodeAccelerator::OnOutputPortDisabled() {
   const OMX_VIDEO_PORTDEFINITIONTYPE& vformat = port_format.format.video;
   picture_buffer_dimensions_.SetSize(vformat.nFrameWidth,
                                                     vformat.nFrameHeight);
+  // The time so far goes to the size decoded until now.
+  ReportCpuUsage();
+  cpu_stream_class_ = (codec_ == H264 ? "h264 " : "vp8 ") +
+                      picture_buffer_dimensions_.ToString();
+
+  if (resuming_from_park_) {
+    // The spares, the loop cache and the frame store stay with the pictures
+    // they belong to.
+    if (!pictures_.empty() &&
+        pictures_.begin()->second->picture_buffer.size() ==
+            picture_buffer_dimensions_) {
+      ReattachPictureBuffers();
+      return;
+    }
+    // The stream changed resolution across the switch; drop the parked
+    // pictures we hold and continue like a regular resize.  Those still held
+    // by the client are released when they come back.
+    resuming_from_park_ = false;
+    for (size_t i = 0; i < queued_picture_buffer_ids_.size(); ++i)
+      pictures_.erase(queued_picture_buffer_ids_[i]);
+    queued_picture_buffer_ids_.clear();
+  }
+  // Cached pictures of the old size are of no use any more.
+  DropCachedPictures();
   if (client_) {
+    size_t alloc_size =
+        (port_format.nBufferSize + (page_size_ - 1)) & ~(page_size_ - 1);
     client_->ProvidePictureBuffers(
-        kNumPictureBuffers,
+        NumPicturesToRequest(alloc_size),
         PIXEL_FORMAT_NV12,
         1,
         picture_buffer_dimensions_,
@@ -1270,6 +3373,29 @@ void OmxrVideoDecodeAccelerator::OnOutputPortDisabled() {
 void OmxrVideoDecodeAccelerator::OnOutputPortEnabled() {
   DCHECK(child_task_runner_->BelongsToCurrentThread());
 
+  if (resuming_from_park_) {
+    // Only hand the component the pictures the client returned meanwhile;
+    // the spares and those the loop cache keeps stay where they were.
+    resuming_from_park_ = false;
+    for (OutputPictureById::iterator it = pictures_.begin();
+         it != pictures_.end(); ++it) {
+      it->second->allocated = true;
+    }
+    std::vector<int> picture_buffer_ids;
+    picture_buffer_ids.swap(queued_picture_buffer_ids_);
+    for (size_t i = 0; i < picture_buffer_ids.size(); ++i)
+      QueuePictureBuffer(picture_buffer_ids[i]);
+    if (reset_pending_) {
+      FinishReset();
+      return;
+    }
+    if (flush_pending_) {
+      flush_pending_ = false;
+      Flush();
+    }
+    return;
+  }
+
   if (current_state_change_ == RESETTING) {
     for (OutputPictureById::iterator it = pictures_.begin();
          it != pictures_.end(); ++it) {
@@ -1288,6 +3414,12 @@ void OmxrVideoDecodeAccelerator::OnOutputPortEnabled() {
        it != pictures_.end(); ++it) {
     if (it->second->allocated)
         continue;
+    if (UsesSparePictures() &&
+        spare_picture_ids_.size() < kNumSparePictures) {
+      it->second->allocated = true;
+      spare_picture_ids_.push_back(it->first);
+      continue;
+    }
     OMX_BUFFERHEADERTYPE* omx_buffer = it->second->omx_buffer_header;
     DCHECK(omx_buffer);
     // Clear EOS flag.
@@ -1295,7 +3427,8 @@ void OmxrVideoDecodeAccelerator::OnOutputPortEnabled() {
     omx_buffer->nOutputPortIndex = output_port_;
     ++output_buffers_at_component_;
     it->second->at_component = true;
-    OMX_ERRORTYPE result = OMX_FillThisBuffer(component_handle_, omx_buffer);
+    OMX_ERRORTYPE result =
+        VENDOR_CALL(OMX_FillThisBuffer(component_handle_, omx_buffer));
     RETURN_ON_OMX_FAILURE(result, "OMX_FillThisBuffer() failed",
                           PLATFORM_FAILURE,);
     it->second->allocated = true;
@@ -1305,6 +3438,7 @@ void OmxrVideoDecodeAccelerator::OnOutputPortEnabled() {
 void OmxrVideoDecodeAccelerator::FillBufferDoneTask(
     OMX_BUFFERHEADERTYPE* buffer) {
   VLOGF(2);
+  CpuTaskScope cpu_scope(this, OmxrDecoderStats::CPU_FILL_BUFFER_DONE);
   OutputPicture *output_picture =
       reinterpret_cast<OutputPicture*>(buffer->pAppPrivate);
 
@@ -1316,6 +3450,7 @@ void OmxrVideoDecodeAccelerator::FillBufferDoneTask(
   DCHECK(decode_task_runner_->BelongsToCurrentThread());
   DCHECK_GT(output_buffers_at_component_, 0);
   --output_buffers_at_component_;
+  NoteComponentProgress();
 
   // If we are destroying and then get a fillbuffer callback, calling into any
   // openmax function will put us in error mode, so bail now. In the RESETTING
@@ -1327,8 +3462,15 @@ void OmxrVideoDecodeAccelerator::FillBufferDoneTask(
 
   // During the transition from Executing to Idle, and during port-flushing, all
   // pictures are sent back through here.  Avoid giving them to the client.
-  if (current_state_change_ == RESETTING) {
+  if (current_state_change_ == RESETTING ||
+      (current_state_change_ == PARKING &&
+       (parking_drained_ || parking_reset_pending_))) {
     queued_picture_buffer_ids_.push_back(picture_buffer_id);
+    if (current_state_change_ == PARKING && !parking_drained_ &&
+        (buffer->nFlags & OMX_BUFFERFLAG_EOS)) {
+      buffer->nFlags &= ~OMX_BUFFERFLAG_EOS;
+      OnReachedEOSInParking();
+    }
     return;
   }
 
@@ -1336,7 +3478,7 @@ void OmxrVideoDecodeAccelerator::FillBufferDoneTask(
     size_t erased = fake_output_buffers_.erase(buffer);
     DCHECK_EQ(erased, 1U);
     OMX_ERRORTYPE result =
-        OMX_FreeBuffer(component_handle_, output_port_, buffer);
+        VENDOR_CALL(OMX_FreeBuffer(component_handle_, output_port_, buffer));
     RETURN_ON_OMX_FAILURE(result, "OMX_FreeBuffer failed", PLATFORM_FAILURE,);
     return;
   }
@@ -1350,13 +3492,19 @@ void OmxrVideoDecodeAccelerator::FillBufferDoneTask(
     return;
   }
 
-  if (reset_pending_)
+  // Pending resets of an idle component are finished once its transition is.
+  if (reset_pending_ && !IsIdling())
     FinishReset();
 
   // When the EOS picture is delivered back to us, notify the client and reuse
   // the underlying picturebuffer.
   if (buffer->nFlags & OMX_BUFFERFLAG_EOS) {
     buffer->nFlags &= ~OMX_BUFFERFLAG_EOS;
+    if (current_state_change_ == PARKING) {
+      queued_picture_buffer_ids_.push_back(picture_buffer_id);
+      OnReachedEOSInParking();
+      return;
+    }
     OnReachedEOSInFlushing();
     QueuePictureBuffer(picture_buffer_id);
     return;
@@ -1365,21 +3513,90 @@ void OmxrVideoDecodeAccelerator::FillBufferDoneTask(
 
   //TODO(dhobsong): Set up colorspace (BT.601 vs BT.709)*/
   media::Picture picture(picture_buffer_id, buffer->nTimeStamp,
-            gfx::Rect(picture_buffer_dimensions_), gfx::ColorSpace(), false);
+            VisibleRect(picture_buffer_dimensions_), gfx::ColorSpace(), false);
+
+  if (mux_session_id_)
+    OmxrSessionMultiplexer::Get()->RecordFrameDecoded(mux_session_id_);
+
+  if (frame_store_ && stepping_) {
+    frame_store_->Store(buffer->nTimeStamp, output_picture->mmngr_buf.virt_addr);
+    stats_.frame_store_bytes = frame_store_->memory_usage();
+    if (refill_target_id_ >= 0) {
+      // Pictures before the target only fill the ring.
+      if (buffer->nTimeStamp != refill_target_id_) {
+        QueuePictureBuffer(picture_buffer_id);
+        return;
+      }
+      refill_target_id_ = -1;
+      stats_.AddStep(base::TimeTicks::Now() - refill_start_time_);
+    }
+  }
+
+  if (loop_cache_) {
+    loop_cache_->OnPicture(buffer->nTimeStamp, picture_buffer_id);
+    ReturnLoopCachePictures();
+  }
+  UpdateCarveoutStats();
+
+  auto arrival = au_arrival_times_.find(buffer->nTimeStamp);
+  if (arrival != au_arrival_times_.end()) {
+    base::TimeDelta latency = base::TimeTicks::Now() - arrival->second;
+    stats_.AddLatency(latency);
+    au_arrival_times_.erase(arrival);
+    TRACE_COUNTER1("media,gpu", "OVDA access unit latency (us)",
+                   latency.InMicroseconds());
+  }
+
+  auto input_hash = shared_input_hashes_.find(buffer->nTimeStamp);
+  if (input_hash != shared_input_hashes_.end()) {
+    OmxrSharedDecodeRegistry::Get()->Publish(
+        shared_key_, OmxrSharedDecodeRegistry::SharedPicture{
+                         picture_buffer_id, input_hash->second.hash,
+                         output_picture->egl_image,
+                         picture_buffer_dimensions_, -1});
+    shared_input_hashes_.erase(input_hash);
+  }
 
   // See Decode() for an explanation of this abuse of nTimeStamp.
+  NotifyPictureReady(picture);
+}
+
+void OmxrVideoDecodeAccelerator::NotifyPictureReady(
+    const media::Picture& picture) {
+  auto it = pictures_.find(picture.picture_buffer_id());
+  if (it != pictures_.end())
+    it->second->at_client = true;
+  // Pictures are not batched: the client's rendering must not wait for the
+  // next delivery.
   if (decode_client_)
     decode_client_->PictureReady(picture);
 }
 
+void OmxrVideoDecodeAccelerator::DeliverNotifications() {
+  if (notification_batcher_)
+    notification_batcher_->Deliver();
+}
+
+void OmxrVideoDecodeAccelerator::OnNotificationsDelivered(size_t count) {
+  ++stats_.notification_batches;
+  stats_.batched_notifications += count;
+}
+
 void OmxrVideoDecodeAccelerator::EmptyBufferDoneTask(
     OMX_BUFFERHEADERTYPE* buffer) {
   TRACE_EVENT1("media,gpu", "OVDA::EmptyBufferDoneTask",
                "Buffer id", buffer->nTimeStamp);
   DCHECK(child_task_runner_->BelongsToCurrentThread());
+  CpuTaskScope cpu_scope(this, OmxrDecoderStats::CPU_EMPTY_BUFFER_DONE);
   DCHECK_GT(input_buffers_at_component_, 0);
+  NoteComponentProgress();
   free_input_buffers_.push(buffer);
   input_buffers_at_component_--;
+  // Buffers flushed back by Reset() say nothing about the pipeline depth.
+  if (input_tuner_ && current_state_change_ != RESETTING) {
+    input_tuner_->OnReturned(base::TimeTicks::Now(),
+                             input_buffers_at_component_);
+  }
   if (buffer->nFlags & OMX_BUFFERFLAG_EOS)
     return;
 
@@ -1433,6 +3650,36 @@ void OmxrVideoDecodeAccelerator::DispatchStateReached(OMX_STATETYPE reached) {
           NOTREACHED() << "Unexpected state in DESTROYING: " << reached;
           return;
       }
+    case PARKING:
+      switch (reached) {
+        case OMX_StateIdle:
+          OnReachedIdleInParking();
+          return;
+        case OMX_StateLoaded:
+          OnReachedLoadedInParking();
+          return;
+        default:
+          NOTREACHED() << "Unexpected state in PARKING: " << reached;
+          return;
+      }
+    case IDLING:
+      switch (reached) {
+        case OMX_StatePause:
+          OnReachedPauseInIdling();
+          return;
+        default:
+          NOTREACHED() << "Unexpected state in IDLING: " << reached;
+          return;
+      }
+    case WAKING:
+      switch (reached) {
+        case OMX_StateExecuting:
+          OnReachedExecutingInWaking();
+          return;
+        default:
+          NOTREACHED() << "Unexpected state in WAKING: " << reached;
+          return;
+      }
     case ERRORING:
       switch (reached) {
         case OMX_StateInvalid:
@@ -1476,14 +3723,24 @@ void OmxrVideoDecodeAccelerator::EventHandlerCompleteTask(OMX_EVENTTYPE event,
                                                          OMX_U32 data2) {
   VLOGF(1) << "event:" << event << " data:" << data1 << ":" << data2;
   DCHECK(child_task_runner_->BelongsToCurrentThread());
+  CpuTaskScope cpu_scope(this, OmxrDecoderStats::CPU_EVENT);
+  NoteComponentProgress();
   switch (event) {
     case OMX_EventCmdComplete:
       switch (data1) {
         case OMX_CommandPortDisable:
+          if (data2 == input_port_) {
+            OnInputPortDisabled();
+            return;
+          }
           DCHECK_EQ(data2, output_port_);
           OnOutputPortDisabled();
           return;
         case OMX_CommandPortEnable:
+          if (data2 == input_port_) {
+            OnInputPortEnabled();
+            return;
+          }
           DCHECK_EQ(data2, output_port_);
           OnOutputPortEnabled();
           return;
@@ -1539,7 +3796,8 @@ void OmxrVideoDecodeAccelerator::EventHandlerCompleteTask(OMX_EVENTTYPE event,
         // In case of Destroy() interrupting Flush().
         if (current_state_change_ == DESTROYING)
           return;
-        DCHECK_EQ(current_state_change_, FLUSHING);
+        DCHECK(current_state_change_ == FLUSHING ||
+               current_state_change_ == PARKING);
         // Do nothing; rely on the EOS picture delivery to notify the client.
       } else {
         RETURN_ON_FAILURE(false,
@@ -1557,8 +3815,15 @@ void OmxrVideoDecodeAccelerator::EventHandlerCompleteTask(OMX_EVENTTYPE event,
 // static
 void OmxrVideoDecodeAccelerator::PreSandboxInitialization() {
   VLOG(1) << "Starting pre sandbox init";
+  // The probe loads the libraries the profile names.
+  OmxrTuningProfile::Load();
   //enumerate and dlopen codec libraries*/
-  OmxrProfileManager::Get();
+  OmxrProfileManager::StartProbe();
+}
+
+// static
+void OmxrVideoDecodeAccelerator::WaitForPreSandboxInitialization() {
+  OmxrProfileManager::WaitForProbe();
 }
 
 // static
@@ -1636,8 +3901,8 @@ bool OmxrVideoDecodeAccelerator::CanFillBuffer() {
 bool OmxrVideoDecodeAccelerator::SendCommandToPort(
     OMX_COMMANDTYPE cmd, int port_index) {
   DCHECK(child_task_runner_->BelongsToCurrentThread());
-  OMX_ERRORTYPE result = OMX_SendCommand(component_handle_,
-                                         cmd, port_index, 0);
+  OMX_ERRORTYPE result =
+      VENDOR_CALL(OMX_SendCommand(component_handle_, cmd, port_index, 0));
   RETURN_ON_OMX_FAILURE(result, "SendCommand() failed" << cmd,
                         PLATFORM_FAILURE, false);
   return true;
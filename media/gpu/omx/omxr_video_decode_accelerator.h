@@ -6,6 +6,7 @@
 #define CONTENT_COMMON_GPU_MEDIA_OMX_VIDEO_DECODE_ACCELERATOR_H_
 
 #include <dlfcn.h>
+#include <deque>
 #include <map>
 #include <queue>
 #include <set>
@@ -15,12 +16,25 @@
 
 #include "base/compiler_specific.h"
 #include "base/logging.h"
+#include "base/macros.h"
 #include "base/memory/shared_memory.h"
 #include "base/message_loop/message_loop.h"
 #include "base/synchronization/lock.h"
 #include "base/synchronization/condition_variable.h"
 #include "content/common/content_export.h"
-#include "media/video/h264_parser.h"
+#include "media/gpu/omx/omxr_bitstream_framer.h"
+#include "media/gpu/omx/omxr_decoder_stats.h"
+#include "media/gpu/omx/omxr_frame_store.h"
+#include "media/gpu/omx/omxr_gop_cache.h"
+#include "media/gpu/omx/omxr_input_tuner.h"
+#include "media/gpu/omx/omxr_loop_cache.h"
+#include "media/gpu/omx/omxr_notification_batcher.h"
+#include "media/gpu/omx/omxr_nv12_kernels.h"
+#include "media/gpu/omx/omxr_picture_preallocator.h"
+#include "media/gpu/omx/omxr_resource_tracker.h"
+#include "media/gpu/omx/omxr_session_multiplexer.h"
+#include "media/gpu/omx/omxr_shared_decode_registry.h"
+#include "media/gpu/omx/omxr_tuning_profile.h"
 #include "media/video/video_decode_accelerator.h"
 #include "third_party/mmngr/mmngr_user_public.h"
 #include "third_party/mmngr/mmngr_buf_user_public.h"
@@ -40,7 +54,8 @@ namespace media {
 // that it is never accessed from any other.  OMX callbacks are trampolined from
 // the OMX component's thread to maintain this invariant, using |weak_this()|.
 class CONTENT_EXPORT OmxrVideoDecodeAccelerator :
-    public VideoDecodeAccelerator {
+    public VideoDecodeAccelerator,
+    public OmxrSharedDecodeRegistry::Member {
  public:
   // Does not take ownership of |client| which must outlive |*this|.
   OmxrVideoDecodeAccelerator(
@@ -62,9 +77,70 @@ class CONTENT_EXPORT OmxrVideoDecodeAccelerator :
 
   base::WeakPtr<OmxrVideoDecodeAccelerator> weak_this() { return weak_this_; }
 
+  const OmxrDecoderStats& GetStats() const { return stats_; }
+  // CPU time of all decoders by stream class, e.g. "h264 1920x1088", as of
+  // their last resize or destruction.
+  static std::map<std::string, OmxrResourceTracker::CpuUsage> GetCpuUsage();
+
+  // GOP cache mode (kOmxrGopCache): hand out the picture decoded from
+  // |bitstream_id| once more, for backward stepping and reverse playback.
+  // Pictures still in the decoded ring are copied out directly; otherwise the
+  // cached GOP is re-decoded up to |bitstream_id|, filling the ring on the
+  // way.  The ring is only filled once stepping has begun, so forward
+  // playback copies nothing.  The picture arrives through PictureReady() as
+  // usual.  Returns false if neither the picture nor its GOP is cached.
+  // Forward decoding must be paused while stepping and restarted with
+  // Reset().
+  bool StepToCachedPicture(int32_t bitstream_id);
+
+  // AVCC input mode: H.264 bitstream buffers hold length-prefixed NAL units
+  // as stored in MP4, described by the AVCDecoderConfigurationRecord |data|.
+  // Must be called before Initialize().  Access units are found by walking
+  // the length fields; the component is switched to length-prefixed input if
+  // it supports that, otherwise the prefixes are turned into start codes
+  // while copying into the input buffers.  Returns false if the record is
+  // malformed.
+  bool SetAvcConfigurationRecord(const uint8_t* data, size_t size);
+
+  // Shared decode: decoders that join the same stream |key| (e.g. the camera
+  // URL) before Initialize() share one hardware decode.  Each still gets all
+  // of the stream's bitstream buffers through Decode(); only the first one to
+  // join decodes them, the others show its pictures.  Called by the
+  // embedder, which knows the stream behind each decoder; nothing in this
+  // tree does, VideoDecodeAccelerator::Config carrying no stream identity.
+  void JoinSharedStream(const std::string& key);
+  // Crops the pictures handed to our client to |rect|, or not at all if it
+  // is empty.  Decoders sharing a stream each have their own.  Set by the
+  // embedder along with JoinSharedStream().
+  void SetViewRect(const gfx::Rect& rect);
+
+  // GL context loss: binds our pictures to |buffers|, new textures with the
+  // ids and sizes of the current picture buffers, on the context that
+  // |make_context_current| makes current.  The component, its carveout and
+  // the decode state are kept, so decoding goes on without a restart.
+  // Pictures handed out before are taken back, their textures being gone;
+  // returning them afterwards is ignored.  Returns false, changing nothing,
+  // if |buffers| do not match the pictures or the decoder is in the middle
+  // of a resize or shares its stream; the client then destroys the decoder
+  // as before.
+  bool RestoreContext(const base::Callback<bool(void)>& make_context_current,
+                      const std::vector<media::PictureBuffer>& buffers);
+
+  // CPU access to the carveout of a picture the client holds, e.g. for the
+  // omxr_nv12 kernels.  Valid until the picture is returned through
+  // ReusePictureBuffer().  Returns false for pictures the client does not
+  // hold or that have no CPU mapping.
+  bool MapPicture(int32_t picture_buffer_id, omxr_nv12::Picture* picture) const;
+
   static VideoDecodeAccelerator::SupportedProfiles GetSupportedProfiles();
-  // Do any necessary initialization before the sandbox is enabled.
+  // Do any necessary initialization before the sandbox is enabled.  Loading
+  // the OMX libraries and probing the components runs on a background thread
+  // so that it overlaps with the rest of GPU initialization;
+  // GetSupportedProfiles() and Initialize() wait for it.
   static void PreSandboxInitialization();
+  // Waits for the probing to finish.  Must be called before the sandbox is
+  // engaged, which needs the probing thread to be gone.
+  static void WaitForPreSandboxInitialization();
 
  private:
   // Because OMX state-transitions are described solely by the "state reached"
@@ -78,6 +154,11 @@ class CONTENT_EXPORT OmxrVideoDecodeAccelerator :
     FLUSHING,
     RESETTING,
     RESIZING,
+    PARKING,  // Draining to hand the component back to the multiplexer.
+    PARKED,   // Waiting for the multiplexer to grant a component again.
+    IDLING,   // Pausing the component for lack of input.
+    IDLE,     // Paused for lack of input.
+    WAKING,   // Resuming the component from IDLE.
     DESTROYING,
     ERRORING,  // Trumps all other transitions; no recovery is possible.
   };
@@ -103,6 +184,7 @@ class CONTENT_EXPORT OmxrVideoDecodeAccelerator :
     uint32_t hard_addr;
     int dmabuf_id;
     int dmabuf_fd;
+    void* virt_addr;
   };
 
   // Helper struct for keeping track of all output buffer metadata
@@ -117,6 +199,9 @@ class CONTENT_EXPORT OmxrVideoDecodeAccelerator :
     virtual ~OutputPicture();
 
     OMX_ERRORTYPE FreeOMXHandle();
+    static void FreePictureMemory(EGLDisplay egl_display,
+                                  EGLImageKHR egl_image,
+                                  const MmngrBuffer& mmngr_buf);
 
     const OmxrVideoDecodeAccelerator &decoder;
     media::PictureBuffer picture_buffer;
@@ -124,12 +209,17 @@ class CONTENT_EXPORT OmxrVideoDecodeAccelerator :
     EGLImageKHR egl_image;
     struct MmngrBuffer mmngr_buf;
     bool at_component;
+    // Handed to the client in PictureReady() and not returned yet.
+    bool at_client;
     bool allocated;
   };
 
   class OmxrProfileManager {
   public:
+    // Waits for a probe started by StartProbe(), or probes right away.
     static const OmxrProfileManager &Get();
+    static void StartProbe();
+    static void WaitForProbe();
 
     OmxrProfileManager();
     ~OmxrProfileManager() = default;
@@ -138,6 +228,9 @@ class CONTENT_EXPORT OmxrVideoDecodeAccelerator :
     const std::vector<VideoCodecProfile> & getSupportedProfiles() const { return supported_profiles_;}
 
   private:
+    class ProbeThread;
+    static const OmxrProfileManager &Instance();
+
     void InitOMXLibs(void);
 
   private:
@@ -153,24 +246,43 @@ class CONTENT_EXPORT OmxrVideoDecodeAccelerator :
       const media::BitstreamBuffer &buf,
       scoped_refptr<base::SingleThreadTaskRunner> tr,
       base::WeakPtr<Client> cl);
+    // A copy of a cached buffer, decoded again without notifying the client.
+    BitstreamBufferRef(int32_t replay_id, const uint8_t* data, size_t data_size);
     virtual ~BitstreamBufferRef();
 
     std::unique_ptr<base::SharedMemory> shm;
     scoped_refptr<base::SingleThreadTaskRunner> task_runner;
     base::WeakPtr<Client> client;
+    // Takes the end of bitstream notification, if set.
+    base::WeakPtr<OmxrNotificationBatcher> batcher;
     int32_t id;
     size_t size;
     void *memory;
+    // When Decode() received the buffer.
+    base::TimeTicks arrival_time;
+    bool replayed = false;
+    std::vector<uint8_t> replay_data;
+    // Access unit spans, found the first time the buffer is decoded, and the
+    // first one not yet handed to the component.
+    bool framed = false;
+    std::vector<OmxrBitstreamFramer::Span> spans;
+    size_t next_span = 0;
+    bool keyframe = false;
   };
 
+  typedef std::vector<std::unique_ptr<BitstreamBufferRef>> BitstreamBufferList;
   typedef std::map<int32_t, std::unique_ptr<OutputPicture>> OutputPictureById;
 
   scoped_refptr<base::SingleThreadTaskRunner> child_task_runner_;
 
   OMX_HANDLETYPE component_handle_;
+  // This board's tuning, as of our creation.
+  const OmxrTuningProfile tuning_;
 
   // Create the Component for OMX. Handles all OMX initialization.
   bool CreateComponent(const struct CodecInfo &cinfo);
+  // Create and configure the component and start the transition to Executing.
+  bool InitializeComponent();
   // Do any decoder specific initialization not covered in the standard OMX spec
   bool DecoderSpecificInitialization();
 
@@ -197,6 +309,9 @@ class CONTENT_EXPORT OmxrVideoDecodeAccelerator :
   void OnReachedLoadedInDestroying();
   void OnReachedEOSInFlushing();
   void OnReachedInvalidInErroring();
+  void OnReachedEOSInParking();
+  void OnReachedIdleInParking();
+  void OnReachedLoadedInParking();
   void ShutdownComponent();
   void BusyLoopInDestroying(std::unique_ptr<OmxrVideoDecodeAccelerator> self);
 
@@ -205,9 +320,29 @@ class CONTENT_EXPORT OmxrVideoDecodeAccelerator :
   void InputPortFlushDone();
   void OutputPortFlushDone();
 
+  // Input pipeline tuning.  At the end of a Reset() the input port is
+  // disabled, re-sized to what |input_tuner_| recommends and enabled again
+  // before going back to Executing.  Returns false if nothing changes.
+  bool BeginInputPortRetune();
+  void OnInputPortDisabled();
+  void OnInputPortEnabled();
+  // Programs the input port's buffer count and size; the port must be
+  // disabled or the component in Loaded.
+  bool SetInputPortBuffers(const OmxrInputTuner::Config& config);
+
+  // Wraps the NV12 picture in carveout behind |dmabuf_fd| in an EGLImage.
+  EGLImageKHR CreateEGLImage(const gfx::Size& size, int dmabuf_fd) const;
+
   // Stop the component when any error is detected.
   void StopOnError(media::VideoDecodeAccelerator::Error error);
 
+  // Client notifications.  End of bitstream notifications may be batched
+  // (kOmxrBatchedNotifications); DeliverNotifications() comes before any
+  // client call that must not overtake them.
+  void NotifyPictureReady(const media::Picture& picture);
+  void DeliverNotifications();
+  void OnNotificationsDelivered(size_t count);
+
   // Determine whether we can issue fill buffer to the decoder based on the
   // current state (and outstanding state change) of the component.
   bool CanFillBuffer();
@@ -225,6 +360,178 @@ class CONTENT_EXPORT OmxrVideoDecodeAccelerator :
   // Decode bitstream buffers that were queued (see queued_bitstream_buffers_).
   void DecodeQueuedBitstreamBuffers();
 
+  // Session multiplexing.  When the multiplexer wants our component for
+  // another session we drain to an IDR boundary, release the component but
+  // keep |pictures_|, and re-create it once a slot is granted again.
+  void BeginParking(std::unique_ptr<struct BitstreamBufferRef> idr_buffer);
+  void OnComponentGranted();
+  // Re-use the parked |pictures_| for the re-created component's output port.
+  void ReattachPictureBuffers();
+  bool IsParked() const;
+  void SaveParameterSets(
+      const std::vector<OmxrBitstreamFramer::ParameterSet>& parameter_sets);
+  // Copies the saved parameter sets to |dst| if the component still needs
+  // them, setting |written| to the number of bytes written.  Returns false if
+  // they do not fit in |capacity| bytes.
+  bool RestoreParameterSets(OMX_U8* dst, size_t capacity, size_t* written);
+  // Size of the prefix the component expects before each NAL unit.
+  size_t NalPrefixSize() const;
+  // Writes the prefix the component expects before a NAL unit of |nal_size|
+  // bytes to |dst|.  Returns the number of bytes written.
+  size_t WriteNalPrefix(OMX_U8* dst, size_t nal_size) const;
+  // Copies |size| bytes of bitstream to |dst|, turning AVCC length prefixes
+  // into start codes if the component cannot take them, and sets |written|
+  // to the number of bytes written.  Returns false if the result does not
+  // fit in |capacity| bytes.
+  bool CopyToInputBuffer(OMX_U8* dst,
+                         size_t capacity,
+                         const uint8_t* src,
+                         size_t size,
+                         size_t* written) const;
+
+  // Predictive resize (kOmxrPredictiveResize).  Starts allocating pictures
+  // for a new coded size announced by an SPS in |parameter_sets|.
+  void PredictResize(
+      const std::vector<OmxrBitstreamFramer::ParameterSet>& parameter_sets);
+
+  // Slice streaming: submit |span| of |input_buffer| to the component right
+  // away as a partial access unit, terminating the access unit in flight if
+  // |span| starts a new one.  Needs two free input buffers in that case, one
+  // otherwise.  Returns false on error.
+  bool StreamSlice(const BitstreamBufferRef& input_buffer,
+                   const OmxrBitstreamFramer::Span& span);
+  // Terminates the streamed access unit in flight with an empty ENDOFFRAME
+  // buffer.  Returns false on error.
+  bool CloseStreamedAccessUnit();
+  // Hands the access unit assembled in the front free input buffer to the
+  // component.
+  bool SubmitAccumulatedInput();
+
+  // GOP and loop cache helpers.  GOP cache pictures are copied into spare
+  // pictures kept away from the component; the loop cache keeps decoded
+  // pictures themselves and hands them out again.
+  bool UsesSparePictures() const;
+  // Pictures to ask the client for, given their size in carveout.
+  uint32_t NumPicturesToRequest(size_t alloc_size) const;
+  // Hands the pictures the loop cache let go of back to the component.
+  void ReturnLoopCachePictures();
+  // Frees the spare pictures, those the loop cache keeps and the frame store,
+  // once the coded size changes.
+  void DropCachedPictures();
+  void ServeCachedPictures();
+  // Remember when the access unit submitted with timestamp |id| started
+  // arriving, to time it once its picture comes out.
+  void NoteAccessUnitSubmitted(int32_t id, base::TimeTicks arrival_time);
+  // Recomputes the carveout held by input and output buffers and the frame
+  // caches for |stats_|.
+  void UpdateCarveoutStats();
+
+  // OmxrSharedDecodeRegistry::Member implementation.
+  void OnSharedPicture(
+      const OmxrSharedDecodeRegistry::SharedPicture& picture) override;
+  void OnSharedPictureReleased(int32_t picture_id) override;
+  void OnLeaderGone() override;
+  void OnPromoted() override;
+
+  // Shared decode helpers.  A follower matches the leader's pictures to its
+  // own bitstream buffers by content hash, and binds them to its textures.
+  gfx::Rect VisibleRect(const gfx::Size& size) const;
+  void RememberSharedInput(const BitstreamBufferRef& input_buffer);
+  void FollowSharedInput(std::unique_ptr<BitstreamBufferRef> input_buffer);
+  void DeliverSharedPictures();
+  void ReleaseSharedTexture(int32_t picture_buffer_id);
+  // Dismisses the follower's textures.  Those the client holds keep the
+  // leader's picture bound until they are returned, and go then.
+  void RetireSharedTextures();
+  void ReleaseSharedPendingPictures();
+  // Drops the |count| oldest bitstream buffers waiting for a picture.
+  void DropSharedInputs(size_t count);
+  void MaybeFinishSharedFlush();
+  void ArmSharedTimer();
+  void CheckSharedTimeouts();
+  void LeaveSharedStream();
+
+  // Hang watchdog (kOmxrHangWatchdog).  A component that owes us a state
+  // change, or a picture for a complete access unit while it has a free
+  // output buffer, and stays silent for longer than |hang_timeout_| is given
+  // up on: our client gets an error, and the component, its buffers and
+  // |this| are leaked rather than freed under it.
+  bool ComponentOwesProgress() const;
+  void NoteComponentProgress();
+  void CheckComponentProgress();
+  void OnComponentHung();
+  void AbandonComponent(std::unique_ptr<OmxrVideoDecodeAccelerator> self);
+
+  // Automatic idling (kOmxrAutoIdle).  Once no input came for |idle_delay_|
+  // and the component has returned all of it, the component is paused; input
+  // arriving meanwhile is queued and wakes it up again.  A Reset() while
+  // paused does not wait for a wake-up: it flushes the ports of the paused
+  // component, which then goes back to Executing like after any reset.  A
+  // Flush() postponed until the wake-up is dropped by the reset.
+  void ArmIdleTimer();
+  void CheckForIdle();
+  bool CanIdle() const;
+  void WakeFromIdle();
+  void ResetFromIdle();
+  void OnReachedPauseInIdling();
+  void OnReachedExecutingInWaking();
+  bool IsIdling() const;
+
+  // Live catch-up (kOmxrLiveCatchUp).  Starts and stops catching up by how
+  // long |input_buffer| waited before being fed to the component.
+  void UpdateCatchUp(const BitstreamBufferRef& input_buffer);
+  // Returns true if |span| of |input_buffer| is to be dropped.
+  bool ShouldSkipSpan(const BitstreamBufferRef& input_buffer,
+                      const OmxrBitstreamFramer::Span& span);
+  // Drops the backlog in |buffers| up to the last keyframe in it, if any.
+  void SkipToLatestKeyframe(BitstreamBufferList* buffers);
+  // Reports the catch-up counts of |stats_| in trace counters.
+  void TraceCatchUp();
+
+  // CPU accounting.  A CpuTaskScope adds the thread CPU time it spans to
+  // |stats_|; a scope opened inside another one adds nothing, so that the
+  // outermost task gets the time.
+  class CpuTaskScope {
+   public:
+    CpuTaskScope(OmxrVideoDecodeAccelerator* decoder,
+                 OmxrDecoderStats::CpuTask task);
+    ~CpuTaskScope();
+
+   private:
+    OmxrVideoDecodeAccelerator* const decoder_;
+    const OmxrDecoderStats::CpuTask task_;
+    const base::ThreadTicks start_;
+
+    DISALLOW_COPY_AND_ASSIGN(CpuTaskScope);
+  };
+
+  // Counts the thread CPU time of a call into the vendor libraries.
+  class VendorCallScope {
+   public:
+    explicit VendorCallScope(OmxrVideoDecodeAccelerator* decoder);
+    ~VendorCallScope();
+
+   private:
+    CpuTaskScope task_scope_;
+    OmxrVideoDecodeAccelerator* const decoder_;
+    const base::ThreadTicks start_;
+
+    DISALLOW_COPY_AND_ASSIGN(VendorCallScope);
+  };
+
+  template <typename Call>
+  auto VendorCall(Call call) -> decltype(call()) {
+    VendorCallScope scope(this);
+    return call();
+  }
+
+  // Null where thread CPU time is not supported, which makes every duration
+  // zero.
+  static base::ThreadTicks CpuNow();
+  // Adds the CPU time since the last call to the resource tracker under
+  // |cpu_stream_class_|.
+  void ReportCpuUsage();
+
   // Weak pointer to |this|; used to safely trampoline calls from the OMX thread
   // to the ChildThread.  Since |this| is kept alive until OMX is fully shut
   // down, only the OMX->Child thread direction needs to be guarded this way.
@@ -249,10 +556,13 @@ class CONTENT_EXPORT OmxrVideoDecodeAccelerator :
   OMX_U32 input_port_;
   int input_buffers_at_component_;
 
-  std::unique_ptr<H264Parser> h264_parser_;
+  std::unique_ptr<OmxrBitstreamFramer> framer_;
   int input_buffer_offset_;
+  // Input buffers as allocated, and as about to be re-allocated by a retune.
+  std::unique_ptr<OmxrInputTuner> input_tuner_;
+  OmxrInputTuner::Config input_config_;
+  OmxrInputTuner::Config pending_input_config_;
   bool first_input_buffer_sent_;
-  bool previous_frame_has_data_;
 
   // Following are output port related variables.
   OMX_U32 output_port_;
@@ -262,20 +572,79 @@ class CONTENT_EXPORT OmxrVideoDecodeAccelerator :
 
   gfx::Size picture_buffer_dimensions_;
 
+  // Slice streaming state.  |slice_au_open_| is set while slices of the
+  // access unit |slice_au_id_| have been submitted without ENDOFFRAME.
+  bool slice_streaming_;
+  bool slice_au_open_;
+  int32_t slice_au_id_;
+
+  // Arrival time of the access unit being assembled, and of the submitted
+  // access units keyed by the bitstream id they carry as timestamp.
+  base::TimeTicks au_arrival_time_;
+  std::map<int32_t, base::TimeTicks> au_arrival_times_;
+  OmxrDecoderStats stats_;
+  // Carveout size of each output picture.
+  size_t picture_alloc_size_;
+
+  // A cached picture waiting for a spare picture to be copied into or, with
+  // no |store|, the loop cache picture |key| waiting to be handed out again.
+  struct PendingServe {
+    const OmxrFrameStore* store;
+    int32_t key;
+    int32_t bitstream_id;
+    base::TimeTicks requested;
+    // Requested by StepToCachedPicture() rather than the loop cache.
+    bool step;
+  };
+
+  // GOP cache mode.  |refill_target_id_| is the picture a GOP replay is
+  // decoding towards, or -1.  Pictures are copied into |frame_store_| only
+  // while |stepping_|, from the first step until the next Reset().
+  std::unique_ptr<OmxrGopCache> gop_cache_;
+  std::unique_ptr<OmxrFrameStore> frame_store_;
+  std::deque<PendingServe> pending_serves_;
+  std::vector<int32_t> spare_picture_ids_;
+  int32_t refill_target_id_;
+  base::TimeTicks refill_start_time_;
+  bool stepping_;
+
+  // Loop cache mode.  |loop_cache_max_bytes_| of extra pictures are asked
+  // for to keep the loop in.
+  std::unique_ptr<OmxrLoopCache> loop_cache_;
+  size_t loop_cache_max_bytes_;
+
+  // Predictive resize mode.  |sps_coded_size_| is the coded size of the
+  // latest SPS, |picture_coded_size_| the one of the SPS the pictures were
+  // allocated under.
+  std::unique_ptr<OmxrPicturePreallocator> preallocator_;
+  gfx::Size sps_coded_size_;
+  gfx::Size picture_coded_size_;
+  // When the component asked for new pictures, during a resize.
+  base::TimeTicks resize_start_;
+
   /* Helpers to handle restrictions on Reset() timing*/
   bool reset_pending_;
   void FinishReset();
 
   // NOTE: someday there may be multiple contexts for a single decoder.  But not
-  // today.
-  // TODO(fischman,vrk): handle lost contexts?
+  // today.  A lost context is replaced through RestoreContext(), which bumps
+  // |context_generation_|.
   EGLDisplay egl_display_;
   EGLContext egl_context_;
   base::Callback<bool(void)> make_context_current_;
+  int context_generation_;
+
+  // Layout of the output pictures in carveout, for their EGLImages.
+  int output_stride_;
+  int output_slice_height_;
 
   // Free input OpenMAX buffers that can be used to take bitstream from demuxer.
   std::queue<OMX_BUFFERHEADERTYPE*> free_input_buffers_;
 
+  // Batches notifications to the client, or null.  Declared before the
+  // pictures and bitstream buffers, which use it when they go away.
+  std::unique_ptr<OmxrNotificationBatcher> notification_batcher_;
+
   // For output buffer recycling cases.
   OutputPictureById pictures_;
 
@@ -287,7 +656,6 @@ class CONTENT_EXPORT OmxrVideoDecodeAccelerator :
 
   // Encoded bitstream buffers awaiting decode, queued while the decoder was
   // unable to accept them.
-  typedef std::vector<std::unique_ptr<BitstreamBufferRef>> BitstreamBufferList;
   BitstreamBufferList queued_bitstream_buffers_;
   // Available output picture buffers released during Reset() and awaiting
   // re-use once Reset is done.  Is empty most of the time and drained right
@@ -310,8 +678,111 @@ class CONTENT_EXPORT OmxrVideoDecodeAccelerator :
 
   // These members are only used during Initialization.
   Codec codec_;
+  CodecInfo codec_info_;
   bool deferred_init_allowed_;
 
+  // Multiplexer session, or 0 when the component is not shared.
+  OmxrSessionMultiplexer::SessionId mux_session_id_;
+  // True from the start of parking until the re-created component's output
+  // port has been handed the parked pictures.
+  bool resuming_from_park_;
+  // The EOS buffer has come back; anything returned after it is a flush.
+  bool parking_drained_;
+  // Reset() came while draining; pictures are held back until parked.
+  bool parking_reset_pending_;
+  // Flush() requested while parked or while cached pictures are still
+  // waiting to be served; issued once the component is back or the pictures
+  // are out.
+  bool flush_pending_;
+  // AVCC input mode.  |avcc_length_size_| is the size of the NAL length
+  // fields, or 0 for Annex-B input.  |avcc_native_| is set when the component
+  // accepts the length fields as they are.
+  int avcc_length_size_;
+  bool avcc_native_;
+
+  // Latest parameter set of each id (NAL units without prefix), replayed into
+  // a freshly re-created component before the IDR it resumes at, and into a
+  // new one in AVCC mode where they come out of band.
+  std::map<int, std::vector<uint8_t>> saved_sps_;
+  std::map<int, std::vector<uint8_t>> saved_pps_;
+  bool restore_parameter_sets_;
+
+  // A follower texture, the reference it holds on the leader picture bound
+  // to it or -1, and whether it is dismissed once the client returns it.
+  // Only textures handed to the client have a picture bound.
+  struct SharedTexture {
+    uint32_t texture_id;
+    int32_t reference_id;
+    bool stale;
+  };
+  struct PendingSharedPicture {
+    OmxrSharedDecodeRegistry::SharedPicture picture;
+    base::TimeTicks received;
+  };
+
+  // Shared decode.  |shared_key_| is empty unless JoinSharedStream() was
+  // called.  A follower has no component; it binds the leader's pictures to
+  // |shared_textures_| instead.
+  std::string shared_key_;
+  bool shared_follower_;
+  gfx::Rect view_rect_;
+  // Leader: input hashes of the bitstream buffers being decoded, and pictures
+  // our client returned while followers still show them.
+  struct SharedInput {
+    uint32_t hash;
+    base::TimeTicks arrival_time;
+  };
+  std::map<int32_t, SharedInput> shared_input_hashes_;
+  std::set<int32_t> shared_awaiting_release_;
+  // Follower: bitstream buffers (hash, id) and published pictures not yet
+  // matched with each other.  A promoted follower keeps the textures its
+  // client holds until they are returned.
+  std::map<int32_t, SharedTexture> shared_textures_;
+  gfx::Size shared_texture_size_;
+  std::deque<std::pair<uint32_t, int32_t>> shared_pending_inputs_;
+  std::deque<PendingSharedPicture> shared_pending_pictures_;
+  // Follower: a Flush() completes once the |shared_flush_inputs_| oldest
+  // bitstream buffers got their picture or were dropped, or at
+  // |shared_flush_deadline_|.
+  bool shared_flush_pending_;
+  size_t shared_flush_inputs_;
+  base::TimeTicks shared_flush_deadline_;
+  bool shared_timer_armed_;
+  // A promoted follower creates its component and starts at a keyframe.
+  bool promoted_from_follower_;
+  bool wait_for_keyframe_;
+
+  // Hang watchdog; |hang_timeout_| is zero when it is off.
+  base::TimeDelta hang_timeout_;
+  base::TimeTicks last_component_progress_;
+  base::TimeTicks destroy_deadline_;
+  bool watchdog_armed_;
+  bool component_hung_;
+
+  // Automatic idling; |idle_delay_| is zero when it is off.  |wake_requested_|
+  // is when the input that ends the idle period came, null until then.
+  base::TimeDelta idle_delay_;
+  base::TimeTicks last_decode_time_;
+  base::TimeTicks idle_since_;
+  base::TimeTicks wake_requested_;
+  bool idle_timer_armed_;
+
+  // Live catch-up; |catch_up_threshold_| is zero when it is off.
+  base::TimeDelta catch_up_threshold_;
+  base::TimeDelta catch_up_target_;
+  bool catch_up_skip_to_keyframe_;
+  bool catching_up_;
+  // Dropping the rest of an access unit, or all input up to a keyframe.
+  bool dropping_au_;
+  bool skip_to_keyframe_;
+
+  // Nesting depth of CpuTaskScopes.  |cpu_stream_class_| is the codec and
+  // coded size, set when either changes; the CPU time reported for it so far
+  // is in |cpu_reported_|.
+  int cpu_task_depth_;
+  std::string cpu_stream_class_;
+  OmxrResourceTracker::CpuUsage cpu_reported_;
+
   // Handle syncronous transition to EXECUTING state when deferred init is
   // not available.
   void HandleSyncronousInit(OMX_EVENTTYPE event,
@@ -351,7 +822,10 @@ class CONTENT_EXPORT OmxrVideoDecodeAccelerator :
   // that its contents have been read out by rendering layer, before we start
   // overwriting it with the decoder. Use a GPU fence and CheckPicutreStatus()
   // to poll for the fence completion before sending it to the decoder.
+  // Fences of a context lost since ReusePictureBuffer(), i.e. of an older
+  // |context_generation|, are not waited for.
   void CheckPictureStatus(int32_t picture_buffer_id,
+            int context_generation,
             std::unique_ptr<gl::GLFence> fence_obj);
 
   // Queue a picture for use by the decoder, either by sending it directly to it
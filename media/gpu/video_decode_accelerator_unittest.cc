@@ -15,6 +15,7 @@
 //   infrastructure.
 
 #include <fcntl.h>
+#include <inttypes.h>
 #include <stddef.h>
 #include <stdint.h>
 #include <sys/stat.h>
@@ -44,6 +45,7 @@
 #include "base/stl_util.h"
 #include "base/strings/string_number_conversions.h"
 #include "base/strings/string_split.h"
+#include "base/strings/string_util.h"
 #include "base/strings/stringize_macros.h"
 #include "base/strings/stringprintf.h"
 #include "base/strings/utf_string_conversions.h"
@@ -85,7 +87,9 @@
 #endif  // BUILDFLAG(USE_VAAPI)
 
 #if BUILDFLAG(USE_OMX_CODEC)
+#include "media/gpu/omx/omxr_nv12_kernels.h"
 #include "media/gpu/omx/omxr_video_decode_accelerator.h"
+#include "ui/gl/gl_surface_egl.h"
 #endif  // BUILDFLAG(USE_OMX_CODEC)
 
 #if defined(OS_CHROMEOS)
@@ -145,6 +149,11 @@ bool g_validate_frames = false;
 bool g_calculate_checksums = false;
 // Write decoded frames to YUV files.
 bool g_output_frames = false;
+// Validate decoded frames against golden omxr_nv12::Checksum() values, taken
+// from the decoder's mapped output rather than read back through GL.  The
+// pictures still go to GL textures, so an EGL context is needed all the same.
+// Set by the switch "--omxr_checksums".
+bool g_check_omxr_checksums = false;
 
 // This is the location of the test files. If empty, they're in the current
 // working directory.
@@ -291,6 +300,8 @@ class GLRenderingVDAClient
     size_t delay_reuse_after_frame_num = std::numeric_limits<size_t>::max();
     size_t decode_calls_per_second = 0;
     size_t num_frames = 0;
+    // Whether to checksum each picture with omxr_nv12::Checksum().
+    bool omxr_checksums = false;
   };
 
   // Doesn't take ownership of |rendering_helper| or |note|, which must outlive
@@ -336,6 +347,10 @@ class GLRenderingVDAClient
   // Return the median of the decode time of all decoded frames.
   base::TimeDelta decode_time_median();
   bool decoder_deleted() { return !decoder_.get(); }
+  const std::vector<std::string>& frame_checksums() const {
+    return frame_checksums_;
+  }
+  base::TimeDelta checksum_time() const { return checksum_time_; }
 
  private:
   typedef std::map<int32_t, scoped_refptr<media::test::TextureRef>>
@@ -363,6 +378,10 @@ class GLRenderingVDAClient
   int next_bitstream_buffer_id_;
   media::test::ClientStateNotification<ClientState>* const note_;
   std::unique_ptr<VideoDecodeAccelerator> decoder_;
+#if BUILDFLAG(USE_OMX_CODEC)
+  // |decoder_|, with Config::omxr_checksums.
+  OmxrVideoDecodeAccelerator* omxr_decoder_ = nullptr;
+#endif  // BUILDFLAG(USE_OMX_CODEC)
   base::WeakPtr<VideoDecodeAccelerator> weak_vda_;
   std::unique_ptr<base::WeakPtrFactory<VideoDecodeAccelerator>>
       weak_vda_ptr_factory_;
@@ -382,6 +401,10 @@ class GLRenderingVDAClient
   std::map<int, base::TimeTicks> decode_start_time_;
   // The decode time of all decoded frames.
   std::vector<base::TimeDelta> decode_time_;
+  // Checksums of the decoded frames, with Config::omxr_checksums, and the
+  // time taken computing them.
+  std::vector<std::string> frame_checksums_;
+  base::TimeDelta checksum_time_;
 
   // A map of the textures that are currently active for the decoder, i.e.,
   // have been created via AssignPictureBuffers() and not dismissed via
@@ -474,11 +497,24 @@ void GLRenderingVDAClient::CreateAndStartDecoder() {
   LOG_ASSERT(!decoder_.get());
 
   VideoDecodeAccelerator::Config vda_config(config_.profile);
+  // Checksums map the pictures of the OMXR decoder.
+  LOG_ASSERT(!config_.omxr_checksums || !config_.fake_decoder);
 
   if (config_.fake_decoder) {
     decoder_.reset(new FakeVideoDecodeAccelerator(
         frame_size_, base::Bind([]() { return true; })));
     LOG_ASSERT(decoder_->Initialize(vda_config, this));
+#if BUILDFLAG(USE_OMX_CODEC)
+  } else if (config_.omxr_checksums) {
+    // The factory may hand out a decoder spreading the stream over several
+    // OmxrVideoDecodeAccelerators; the checksums map the pictures of one.
+    omxr_decoder_ = new OmxrVideoDecodeAccelerator(
+        gl::GLSurfaceEGL::GetHardwareDisplay(),
+        base::Bind([]() { return true; }));
+    decoder_.reset(omxr_decoder_);
+    if (!decoder_->Initialize(vda_config, this))
+      decoder_.reset();
+#endif  // BUILDFLAG(USE_OMX_CODEC)
   } else {
     if (!vda_factory_) {
       if (g_use_gl_renderer) {
@@ -614,6 +650,17 @@ void GLRenderingVDAClient::PictureReady(const Picture& picture) {
       base::Bind(&GLRenderingVDAClient::ReturnPicture, AsWeakPtr(),
                  picture.picture_buffer_id()));
   pending_textures_.insert(*texture_it);
+#if BUILDFLAG(USE_OMX_CODEC)
+  if (config_.omxr_checksums) {
+    omxr_nv12::Picture mapped;
+    ASSERT_TRUE(
+        omxr_decoder_->MapPicture(picture.picture_buffer_id(), &mapped));
+    base::TimeTicks checksum_start = base::TimeTicks::Now();
+    uint64_t checksum = omxr_nv12::Checksum(mapped);
+    checksum_time_ += base::TimeTicks::Now() - checksum_start;
+    frame_checksums_.push_back(base::StringPrintf("%016" PRIx64, checksum));
+  }
+#endif  // BUILDFLAG(USE_OMX_CODEC)
   if (video_frame_validator_) {
     auto video_frame = texture_it->second->ExportVideoFrame(visible_rect);
     ASSERT_NE(video_frame.get(), nullptr);
@@ -833,6 +880,9 @@ void GLRenderingVDAClient::DeleteDecoder() {
     return;
   weak_vda_ptr_factory_->InvalidateWeakPtrs();
   decoder_.reset();
+#if BUILDFLAG(USE_OMX_CODEC)
+  omxr_decoder_ = nullptr;
+#endif  // BUILDFLAG(USE_OMX_CODEC)
 
   active_textures_.clear();
 
@@ -1187,6 +1237,15 @@ CreateAndInitializeVideoFrameValidator(
   return media::test::VideoFrameValidator::Create(frame_checksums);
 }
 
+#if BUILDFLAG(USE_OMX_CODEC)
+// Golden checksums of |video_file|, one per line in decode order.
+base::FilePath GetOmxrChecksumsFilePath(
+    const base::FilePath::StringType& video_file) {
+  return base::FilePath(video_file)
+      .AddExtension(FILE_PATH_LITERAL(".omxr_checksums"));
+}
+#endif  // BUILDFLAG(USE_OMX_CODEC)
+
 std::unique_ptr<media::test::VideoFrameFileWriter>
 CreateAndInitializeVideoFrameWriter(
     const base::FilePath::StringType& video_file) {
@@ -1277,6 +1336,7 @@ TEST_P(VideoDecodeAcceleratorParamTest, MAYBE_TestSimpleDecode) {
     config.fake_decoder = g_fake_decoder;
     config.delay_reuse_after_frame_num = delay_reuse_after_frame_num;
     config.num_frames = video_file->num_frames;
+    config.omxr_checksums = g_check_omxr_checksums;
 
     std::unique_ptr<media::test::VideoFrameValidator> video_frame_validator;
     if (g_validate_frames) {
@@ -1385,6 +1445,37 @@ TEST_P(VideoDecodeAcceleratorParamTest, MAYBE_TestSimpleDecode) {
       if (min_fps > 0 && !test_reuse_delay)
         EXPECT_GT(client->frames_per_second(), min_fps);
     }
+#if BUILDFLAG(USE_OMX_CODEC)
+    // Other reset points decode some frames twice or not at all.
+    if (g_check_omxr_checksums && reset_point == END_OF_STREAM_RESET) {
+      base::FilePath checksums_path =
+          GetOmxrChecksumsFilePath(video_file->file_name);
+      std::string golden;
+      ASSERT_TRUE(base::ReadFileToString(checksums_path, &golden))
+          << "Failed to read checksums in " << checksums_path;
+      std::vector<std::string> golden_checksums = base::SplitString(
+          golden, "\n", base::TRIM_WHITESPACE, base::SPLIT_WANT_NONEMPTY);
+      const std::vector<std::string>& checksums = client->frame_checksums();
+      EXPECT_EQ(golden_checksums.size(), checksums.size());
+      size_t num_mismatches = 0;
+      for (size_t n = 0;
+           n < std::min(golden_checksums.size(), checksums.size()); ++n) {
+        if (checksums[n] == golden_checksums[n])
+          continue;
+        LOG(ERROR) << "Frame " << std::setw(4) << n << " " << checksums[n]
+                   << " (expected: " << golden_checksums[n] << " )";
+        ++num_mismatches;
+      }
+      EXPECT_EQ(0u, num_mismatches)
+          << "# of checksum mismatched frames (Decoder #" << i << " )";
+      if (!checksums.empty()) {
+        LOG(INFO) << "Decoder " << i << " checksum time per frame: "
+                  << client->checksum_time().InMicrosecondsF() /
+                         checksums.size()
+                  << " us";
+      }
+    }
+#endif  // BUILDFLAG(USE_OMX_CODEC)
   }
 
   if (render_as_thumbnails) {
@@ -1750,6 +1841,40 @@ TEST_F(VideoDecodeAcceleratorTest, DISABLED_GenMD5) {
 }
 #endif
 
+#if BUILDFLAG(USE_OMX_CODEC)
+// Generates the golden checksums for --omxr_checksums, as DISABLED_GenMD5
+// does for the frame validator.
+TEST_F(VideoDecodeAcceleratorTest, DISABLED_GenOmxrChecksums) {
+  ASSERT_EQ(test_video_files_.size(), 1u);
+  notes_.push_back(
+      std::make_unique<media::test::ClientStateNotification<ClientState>>());
+  const TestVideoFile* video_file = test_video_files_[0].get();
+  GLRenderingVDAClient::Config config;
+  config.frame_size = gfx::Size(video_file->width, video_file->height);
+  config.profile = video_file->profile;
+  config.num_frames = video_file->num_frames;
+  config.omxr_checksums = true;
+  clients_.push_back(std::make_unique<GLRenderingVDAClient>(
+      std::move(config), video_file->data_str, &rendering_helper_, nullptr,
+      nullptr, notes_[0].get()));
+  RenderingHelperParams helper_params;
+  helper_params.num_windows = 1;
+  InitializeRenderingHelper(helper_params);
+  CreateAndStartDecoder(clients_[0].get(), notes_[0].get());
+  ClientState last_state = WaitUntilDecodeFinish(notes_[0].get());
+  EXPECT_NE(CS_ERROR, last_state);
+
+  std::string checksums =
+      base::JoinString(clients_[0]->frame_checksums(), "\n") + "\n";
+  base::FilePath checksums_path =
+      GetOmxrChecksumsFilePath(video_file->file_name);
+  EXPECT_EQ(static_cast<int>(checksums.size()),
+            base::WriteFile(checksums_path, checksums.data(),
+                            checksums.size()))
+      << "Failed to write checksums to " << checksums_path;
+}
+#endif  // BUILDFLAG(USE_OMX_CODEC)
+
 // TODO(fischman, vrk): add more tests!  In particular:
 // - Test life-cycle: Seek/Stop/Pause/Play for a single decoder.
 // - Test alternate configurations
@@ -1880,6 +2005,10 @@ int main(int argc, char** argv) {
 #endif
       continue;
     }
+    if (it->first == "omxr_checksums") {
+      media::g_check_omxr_checksums = true;
+      continue;
+    }
     if (it->first == "use-test-data-path") {
       media::g_test_file_path = media::GetTestDataFilePath("");
       continue;